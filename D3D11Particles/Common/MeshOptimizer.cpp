@@ -0,0 +1,363 @@
+#include <algorithm>
+#include <cmath>
+
+#include "MeshOptimizer.h"
+
+namespace
+{
+	// --------------------------------------------------------
+	// A FIFO post-transform cache, as most GPUs have: a vertex
+	// is still cached if fewer than cacheSize misses happened
+	// since its own.  Reset() empties it in constant time.
+	// --------------------------------------------------------
+	class FifoCache
+	{
+	public:
+		FifoCache(size_t vertexCount, size_t cacheSize) :
+			missedAt(vertexCount, 0), cacheSize(cacheSize), misses(cacheSize + 1) {}
+
+		// Returns how many of the triangle's vertices were missing
+		unsigned int Triangle(const unsigned int* corners)
+		{
+			unsigned int missed = 0;
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int v = corners[k];
+				if (misses - missedAt[v] > cacheSize)
+				{
+					missedAt[v] = misses++;
+					missed++;
+				}
+			}
+			return missed;
+		}
+
+		void Reset() { misses += cacheSize + 1; }
+
+	private:
+		std::vector<size_t> missedAt;
+		size_t cacheSize;
+		size_t misses;
+	};
+
+	// --------------------------------------------------------
+	// Forsyth's vertex score: high for vertices near the front
+	// of the (modeled LRU) cache, and for vertices with few
+	// triangles left, so that they get finished off
+	// --------------------------------------------------------
+	const int ScoringCacheSize = 32;
+
+	float VertexScore(int cachePosition, unsigned int trianglesLeft)
+	{
+		if (trianglesLeft == 0)
+			return -1.0f;
+
+		float score = 0.0f;
+		if (cachePosition >= 0)
+		{
+			// The last triangle's vertices score the same, so the next
+			// triangle isn't chosen just for sharing the newest one
+			if (cachePosition < 3)
+				score = 0.75f;
+			else
+				score = std::pow(1.0f - (cachePosition - 3) / float(ScoringCacheSize - 3), 1.5f);
+		}
+		return score + 2.0f / std::sqrt((float)trianglesLeft);
+	}
+}
+
+
+// --------------------------------------------------------
+// Simulates a FIFO cache of the given size over the indices
+// --------------------------------------------------------
+VertexCacheStats AnalyzeVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount, size_t cacheSize)
+{
+	FifoCache cache(vertexCount, cacheSize);
+	size_t misses = 0;
+	for (size_t i = 0; i + 2 < indexCount; i += 3)
+		misses += cache.Triangle(indices + i);
+
+	VertexCacheStats stats{};
+	stats.ACMR = indexCount >= 3 ? misses / float(indexCount / 3) : 0.0f;
+	stats.ATVR = vertexCount > 0 ? misses / float(vertexCount) : 0.0f;
+	return stats;
+}
+
+
+// --------------------------------------------------------
+// Forsyth's greedy triangle ordering
+//
+// - Each vertex keeps the list of triangles not yet drawn that
+//   use it, so scores only need updating around the cache
+// - The next triangle is the best one touching the cache; when
+//   nothing there is left, the next undrawn one in the input
+// --------------------------------------------------------
+void OptimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount)
+{
+	const unsigned int none = 0xFFFFFFFFu;
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	// Triangles of each vertex, packed by vertex
+	std::vector<unsigned int> trianglesLeft(vertexCount, 0);
+	std::vector<unsigned int> firstTriangle(vertexCount + 1, 0);
+	std::vector<unsigned int> vertexTriangles(triangleCount * 3);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		trianglesLeft[indices[i]]++;
+	for (size_t v = 0; v < vertexCount; v++)
+		firstTriangle[v + 1] = firstTriangle[v] + trianglesLeft[v];
+	std::vector<unsigned int> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		vertexTriangles[fill[indices[i]]++] = (unsigned int)(i / 3);
+
+	// Starting scores
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+		vertexScore[v] = VertexScore(-1, trianglesLeft[v]);
+
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<bool> drawn(triangleCount, false);
+	unsigned int best = 0;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		const unsigned int* tri = indices + 3 * t;
+		triangleScore[t] = vertexScore[tri[0]] + vertexScore[tri[1]] + vertexScore[tri[2]];
+		if (triangleScore[t] > triangleScore[best])
+			best = (unsigned int)t;
+	}
+
+	std::vector<unsigned int> output;
+	output.reserve(triangleCount * 3);
+	unsigned int cache[ScoringCacheSize + 3];
+	int cacheCount = 0;
+	size_t nextInOrder = 0;
+
+	for (size_t drawnCount = 0; drawnCount < triangleCount; drawnCount++)
+	{
+		if (best == none)
+		{
+			while (drawn[nextInOrder])
+				nextInOrder++;
+			best = (unsigned int)nextInOrder;
+		}
+
+		// Draw it, and take it off its vertices' lists
+		const unsigned int* tri = indices + 3 * size_t(best);
+		drawn[best] = true;
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int v = tri[k];
+			output.push_back(v);
+
+			unsigned int* list = &vertexTriangles[firstTriangle[v]];
+			unsigned int* last = list + trianglesLeft[v] - 1;
+			unsigned int* entry = std::find(list, last, best);
+			std::swap(*entry, *last);
+			trianglesLeft[v]--;
+		}
+
+		// Move its vertices to the front of the cache
+		unsigned int updated[ScoringCacheSize + 3];
+		int updatedCount = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			if (std::find(updated, updated + updatedCount, tri[k]) == updated + updatedCount)
+				updated[updatedCount++] = tri[k];
+		}
+		for (int i = 0; i < cacheCount; i++)
+		{
+			if (cache[i] != tri[0] && cache[i] != tri[1] && cache[i] != tri[2])
+				updated[updatedCount++] = cache[i];
+		}
+
+		// Rescore everything that was or is in the cache, passing the
+		// change on to the undrawn triangles around each vertex
+		for (int i = 0; i < updatedCount; i++)
+		{
+			unsigned int v = updated[i];
+			cachePosition[v] = i < ScoringCacheSize ? i : -1;
+			float score = VertexScore(cachePosition[v], trianglesLeft[v]);
+			float change = score - vertexScore[v];
+			vertexScore[v] = score;
+
+			const unsigned int* list = &vertexTriangles[firstTriangle[v]];
+			for (unsigned int j = 0; j < trianglesLeft[v]; j++)
+				triangleScore[list[j]] += change;
+		}
+
+		cacheCount = std::min(updatedCount, ScoringCacheSize);
+		for (int i = 0; i < cacheCount; i++)
+			cache[i] = updated[i];
+
+		// The next triangle is the best one around the cache
+		best = none;
+		float bestScore = -1e30f;
+		for (int i = 0; i < cacheCount; i++)
+		{
+			unsigned int v = cache[i];
+			const unsigned int* list = &vertexTriangles[firstTriangle[v]];
+			for (unsigned int j = 0; j < trianglesLeft[v]; j++)
+			{
+				if (triangleScore[list[j]] > bestScore)
+				{
+					bestScore = triangleScore[list[j]];
+					best = list[j];
+				}
+			}
+		}
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+
+// --------------------------------------------------------
+// Cluster sorting for overdraw
+//
+// - Hard boundaries are where the cache starts over anyway: a
+//   triangle none of whose vertices were cached
+// - Soft boundaries split those clusters further, wherever the
+//   cluster so far, simulated from an empty cache, is already
+//   within the threshold of the whole mesh's ACMR
+// - Clusters are drawn in order of how far their average normal
+//   points away from the mesh's center, outermost first
+// --------------------------------------------------------
+void OptimizeOverdraw(
+	unsigned int* indices,
+	size_t indexCount,
+	const float* positions,
+	size_t positionStride,
+	size_t vertexCount,
+	float threshold)
+{
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount < 2)
+		return;
+
+	const size_t cacheSize = 16;
+	float inputACMR = AnalyzeVertexCache(indices, indexCount, vertexCount, cacheSize).ACMR;
+
+	// Find the clusters
+	std::vector<size_t> clusterStart;
+	{
+		FifoCache cache(vertexCount, cacheSize);
+		FifoCache coldCache(vertexCount, cacheSize);
+		size_t clusterMisses = 0;
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			bool hard = cache.Triangle(indices + 3 * t) == 3;
+			if (t == 0 || hard)
+			{
+				clusterStart.push_back(t);
+				coldCache.Reset();
+				clusterMisses = 0;
+			}
+
+			clusterMisses += coldCache.Triangle(indices + 3 * t);
+			size_t clusterSize = t + 1 - clusterStart.back();
+			if (t + 1 < triangleCount && clusterMisses <= threshold * inputACMR * clusterSize)
+			{
+				clusterStart.push_back(t + 1);
+				coldCache.Reset();
+				clusterMisses = 0;
+			}
+		}
+	}
+	clusterStart.push_back(triangleCount);
+	size_t clusterCount = clusterStart.size() - 1;
+	if (clusterCount < 2)
+		return;
+
+	// Area-weighted centroids and normals of every cluster, and of the mesh
+	auto position = [&](unsigned int v, int axis)
+	{
+		return *(const float*)((const char*)positions + v * positionStride + axis * sizeof(float));
+	};
+	std::vector<float> clusterCentroid(clusterCount * 3, 0.0f), clusterNormal(clusterCount * 3, 0.0f);
+	float meshCentroid[3] = {};
+	float meshArea = 0.0f;
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		float area = 0.0f;
+		for (size_t t = clusterStart[c]; t < clusterStart[c + 1]; t++)
+		{
+			const unsigned int* tri = indices + 3 * t;
+			float p0[3], e1[3], e2[3];
+			for (int a = 0; a < 3; a++)
+			{
+				p0[a] = position(tri[0], a);
+				e1[a] = position(tri[1], a) - p0[a];
+				e2[a] = position(tri[2], a) - p0[a];
+			}
+			float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			float twiceArea = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			for (int a = 0; a < 3; a++)
+			{
+				float center = p0[a] + (e1[a] + e2[a]) / 3.0f;
+				clusterCentroid[3 * c + a] += center * twiceArea;
+				clusterNormal[3 * c + a] += n[a];
+				meshCentroid[a] += center * twiceArea;
+			}
+			area += twiceArea;
+		}
+		for (int a = 0; a < 3; a++)
+			clusterCentroid[3 * c + a] /= std::max(area, 1e-30f);
+		meshArea += area;
+	}
+	for (int a = 0; a < 3; a++)
+		meshCentroid[a] /= std::max(meshArea, 1e-30f);
+
+	std::vector<float> sortKey(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		float* n = &clusterNormal[3 * c];
+		float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		float key = 0.0f;
+		for (int a = 0; a < 3; a++)
+			key += (clusterCentroid[3 * c + a] - meshCentroid[a]) * n[a];
+		sortKey[c] = length > 0.0f ? key / length : 0.0f;
+	}
+
+	std::vector<size_t> order(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++)
+		order[c] = c;
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKey[a] > sortKey[b]; });
+
+	std::vector<unsigned int> sorted;
+	sorted.reserve(triangleCount * 3);
+	for (size_t c : order)
+		sorted.insert(sorted.end(), indices + 3 * clusterStart[c], indices + 3 * clusterStart[c + 1]);
+
+	// Keep the cache-optimized order if sorting cost too much of its locality
+	if (AnalyzeVertexCache(sorted.data(), sorted.size(), vertexCount, cacheSize).ACMR > threshold * inputACMR)
+		return;
+	std::copy(sorted.begin(), sorted.end(), indices);
+}
+
+
+// --------------------------------------------------------
+// Numbers vertices in first-use order, so the vertex fetches
+// walk through memory along with the triangles
+// --------------------------------------------------------
+void OptimizeVertexFetch(unsigned int* indices, size_t indexCount, size_t vertexCount, std::vector<unsigned int>& remap)
+{
+	const unsigned int unused = 0xFFFFFFFFu;
+	remap.assign(vertexCount, unused);
+
+	unsigned int next = 0;
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		unsigned int& to = remap[indices[i]];
+		if (to == unused)
+			to = next++;
+		indices[i] = to;
+	}
+
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		if (remap[v] == unused)
+			remap[v] = next++;
+	}
+}
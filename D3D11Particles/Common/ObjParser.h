@@ -0,0 +1,50 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// Wavefront .obj parsing, independent of D3D
+//
+// - The whole file is read in one block and scanned in place,
+//   with std::from_chars for the numbers, so lines can be any
+//   length and no per-line copies or format strings are needed
+// - Faces may have any number of corners (split into triangle
+//   fans) and may use negative (relative) indices
+// - Groups, materials and other statements are skipped
+// --------------------------------------------------------
+
+struct ObjFloat2 { float x, y; };
+struct ObjFloat3 { float x, y, z; };
+
+// One triangle corner: zero-based indices into ObjData's
+// arrays, or -1 where the face didn't give that element
+struct ObjCorner
+{
+	int Position;
+	int UV;
+	int Normal;
+};
+
+struct ObjData
+{
+	std::vector<ObjFloat3> Positions;
+	std::vector<ObjFloat2> UVs;
+	std::vector<ObjFloat3> Normals;
+	std::vector<ObjCorner> Corners;	// Three per triangle, in the file's winding order
+};
+
+// Parses OBJ text into data (replacing its contents).  On failure,
+// returns false and describes the problem in error, if given.
+bool ParseObj(const char* text, size_t length, ObjData& data, std::string* error = nullptr);
+
+// Reads and parses a whole .obj file
+bool LoadObj(const std::filesystem::path& path, ObjData& data, std::string* error = nullptr);
+
+// Welds corners with the same position, uv and normal indices into
+// shared vertices: vertices gets each distinct corner once, and
+// indices (three per triangle, like data.Corners) refers into it.
+// Corners without a normal aren't welded, since they'll need their
+// own triangle's face normal.
+void WeldObjCorners(const ObjData& data, std::vector<ObjCorner>& vertices, std::vector<unsigned int>& indices);
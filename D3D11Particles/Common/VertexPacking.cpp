@@ -0,0 +1,238 @@
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#include "VertexPacking.h"
+
+namespace
+{
+	float SignNotZero(float value)
+	{
+		return value >= 0.0f ? 1.0f : -1.0f;
+	}
+
+	float SnormToFloat(int8_t value)
+	{
+		float f = value / 127.0f;
+		return f < -1.0f ? -1.0f : f;
+	}
+
+	int8_t FloatToSnorm(float value)
+	{
+		float scaled = std::round(value * 127.0f);
+		return (int8_t)(scaled < -127.0f ? -127.0f : (scaled > 127.0f ? 127.0f : scaled));
+	}
+}
+
+
+// --------------------------------------------------------
+// Float to half with round to nearest even, as the GPU
+// would convert it
+//
+// - Too large for a half: clamps to the largest half
+//   (rather than infinity, which would poison interpolation)
+// - Too small for a normal half: becomes a denormal, or 0
+// --------------------------------------------------------
+uint16_t FloatToHalf(float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+	uint32_t magnitude = bits & 0x7FFFFFFF;
+
+	if (magnitude > 0x7F800000)
+		return sign | 0x7E00;	// NaN
+	if (magnitude >= 0x477FF000)
+		return sign | 0x7BFF;	// 65504, the largest half, even for infinity
+
+	if (magnitude < 0x38800000)
+	{
+		// A denormal half: shift the mantissa (with its implicit 1) into place
+		if (magnitude < 0x33000000)
+			return sign;
+		uint32_t exponent = magnitude >> 23;
+		uint32_t mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+		uint32_t shift = 126 - exponent;
+		uint32_t half = mantissa >> shift;
+		uint32_t remainder = mantissa & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+		if (remainder > halfway || (remainder == halfway && (half & 1)))
+			half++;
+		return sign | (uint16_t)half;
+	}
+
+	// A normal half: rebias the exponent and round off 13 mantissa bits
+	uint32_t half = (magnitude - 0x38000000) >> 13;
+	uint32_t remainder = magnitude & 0x1FFF;
+	if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+		half++;
+	return sign | (uint16_t)half;
+}
+
+float HalfToFloat(uint16_t half)
+{
+	uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+	uint32_t exponent = (half >> 10) & 0x1F;
+	uint32_t mantissa = half & 0x3FF;
+
+	uint32_t bits;
+	if (exponent == 0x1F)
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	else if (exponent != 0)
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	else
+	{
+		// Denormal (or zero): exact in a float
+		float value = mantissa * (1.0f / 16777216.0f);
+		return sign ? -value : value;
+	}
+
+	float value;
+	std::memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+
+// --------------------------------------------------------
+// Octahedral encoding (Cigolle et al., "A Survey of
+// Efficient Representations for Independent Unit Vectors")
+//
+// - The vector is projected onto the octahedron |x|+|y|+|z| = 1,
+//   and the lower half folded out over the corners of the square
+// - Of the four 8-bit points around the exact result, the one
+//   that decodes closest to the vector is kept, which cuts the
+//   largest error by a third over plain rounding
+// - Zero-length (or NaN) vectors encode as +Z
+// --------------------------------------------------------
+void OctEncode(const float vector[3], int8_t encoded[2])
+{
+	float l1 = std::fabs(vector[0]) + std::fabs(vector[1]) + std::fabs(vector[2]);
+	if (!(l1 > 0.0f) || !(l1 < FLT_MAX))
+	{
+		encoded[0] = 0;
+		encoded[1] = 0;
+		return;
+	}
+
+	float u = vector[0] / l1;
+	float v = vector[1] / l1;
+	if (vector[2] < 0.0f)
+	{
+		float foldedU = (1.0f - std::fabs(v)) * SignNotZero(u);
+		float foldedV = (1.0f - std::fabs(u)) * SignNotZero(v);
+		u = foldedU;
+		v = foldedV;
+	}
+
+	float length = std::sqrt(vector[0] * vector[0] + vector[1] * vector[1] + vector[2] * vector[2]);
+	float bestDot = -2.0f;
+	for (int corner = 0; corner < 4; corner++)
+	{
+		float cu = (corner & 1) ? std::ceil(u * 127.0f) : std::floor(u * 127.0f);
+		float cv = (corner & 2) ? std::ceil(v * 127.0f) : std::floor(v * 127.0f);
+		int8_t candidate[2] = { FloatToSnorm(cu / 127.0f), FloatToSnorm(cv / 127.0f) };
+
+		float decoded[3];
+		OctDecode(candidate, decoded);
+		float dot = (decoded[0] * vector[0] + decoded[1] * vector[1] + decoded[2] * vector[2]) / length;
+		if (dot > bestDot)
+		{
+			bestDot = dot;
+			encoded[0] = candidate[0];
+			encoded[1] = candidate[1];
+		}
+	}
+}
+
+void OctDecode(const int8_t encoded[2], float vector[3])
+{
+	float x = SnormToFloat(encoded[0]);
+	float y = SnormToFloat(encoded[1]);
+	float z = 1.0f - std::fabs(x) - std::fabs(y);
+	if (z < 0.0f)
+	{
+		float unfoldedX = (1.0f - std::fabs(y)) * SignNotZero(x);
+		float unfoldedY = (1.0f - std::fabs(x)) * SignNotZero(y);
+		x = unfoldedX;
+		y = unfoldedY;
+	}
+
+	float length = std::sqrt(x * x + y * y + z * z);
+	vector[0] = x / length;
+	vector[1] = y / length;
+	vector[2] = z / length;
+}
+
+
+VertexQuantization QuantizeBounds(const float boundsMin[3], const float boundsMax[3])
+{
+	VertexQuantization quantization{};
+	for (int k = 0; k < 3; k++)
+	{
+		quantization.Offset[k] = (boundsMin[k] + boundsMax[k]) * 0.5f;
+		quantization.Scale[k] = boundsMax[k] > boundsMin[k] ? (boundsMax[k] - boundsMin[k]) * 0.5f : 0.0f;
+	}
+	return quantization;
+}
+
+
+// --------------------------------------------------------
+// Packs a mesh's vertices, after finding the bounds its
+// positions are quantized across
+// --------------------------------------------------------
+void PackVertices(
+	const float* vertices,
+	size_t vertexStride,
+	size_t vertexCount,
+	PackedVertex* packed,
+	float boundsMin[3],
+	float boundsMax[3])
+{
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(vertices);
+	auto vertexAt = [&](size_t i) { return reinterpret_cast<const float*>(bytes + i * vertexStride); };
+
+	for (int k = 0; k < 3; k++)
+	{
+		boundsMin[k] = 0.0f;
+		boundsMax[k] = 0.0f;
+	}
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		const float* position = vertexAt(i);
+		for (int k = 0; k < 3; k++)
+		{
+			if (i == 0 || position[k] < boundsMin[k]) boundsMin[k] = position[k];
+			if (i == 0 || position[k] > boundsMax[k]) boundsMax[k] = position[k];
+		}
+	}
+	VertexQuantization quantization = QuantizeBounds(boundsMin, boundsMax);
+
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		const float* vertex = vertexAt(i);
+		PackedVertex& p = packed[i];
+
+		for (int k = 0; k < 3; k++)
+		{
+			float snorm = quantization.Scale[k] > 0.0f ? (vertex[k] - quantization.Offset[k]) / quantization.Scale[k] : 0.0f;
+			float q = std::round(snorm * 32767.0f);
+			p.Position[k] = (int16_t)(q < -32767.0f ? -32767.0f : (q > 32767.0f ? 32767.0f : q));
+		}
+		p.Position[3] = 0;
+
+		p.UV[0] = FloatToHalf(vertex[3]);
+		p.UV[1] = FloatToHalf(vertex[4]);
+		OctEncode(vertex + 5, p.Normal);
+		OctEncode(vertex + 8, p.Tangent);
+	}
+}
+
+void UnpackVertex(const PackedVertex& packed, const VertexQuantization& quantization, float vertex[11])
+{
+	for (int k = 0; k < 3; k++)
+		vertex[k] = quantization.Offset[k] + quantization.Scale[k] * (packed.Position[k] / 32767.0f);
+	vertex[3] = HalfToFloat(packed.UV[0]);
+	vertex[4] = HalfToFloat(packed.UV[1]);
+	OctDecode(packed.Normal, vertex + 5);
+	OctDecode(packed.Tangent, vertex + 8);
+}
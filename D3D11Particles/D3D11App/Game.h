@@ -70,6 +70,7 @@ private:
 	// Shaders for solid color spheres
 	std::shared_ptr<SimplePixelShader> solidColorPS;
 	std::shared_ptr<SimpleVertexShader> vertexShader;
+	std::shared_ptr<SimpleVertexShader> vertexShaderPacked;
 
 	// Rendering state objects for particle emitters
 	Microsoft::WRL::ComPtr<ID3D11DepthStencilState> particleDepthState;
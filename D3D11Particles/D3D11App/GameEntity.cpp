@@ -21,7 +21,7 @@ void GameEntity::SetMaterial(std::shared_ptr<Material> material) { this->materia
 void GameEntity::Draw(std::shared_ptr<Camera> camera)
 {
 	// Set up the material (shaders and their data)
-	material->PrepareMaterial(transform, camera);
+	material->PrepareMaterial(transform, camera, mesh);
 
 	// Draw the mesh
 	mesh->SetBuffersAndDraw();
@@ -20,6 +20,7 @@ Material::Material(
 
 std::shared_ptr<SimplePixelShader> Material::GetPixelShader() { return ps; }
 std::shared_ptr<SimpleVertexShader> Material::GetVertexShader() { return vs; }
+std::shared_ptr<SimpleVertexShader> Material::GetPackedVertexShader() { return packedVS; }
 DirectX::XMFLOAT3 Material::GetColorTint() { return colorTint; }
 DirectX::XMFLOAT2 Material::GetUVScale() { return uvScale; }
 DirectX::XMFLOAT2 Material::GetUVOffset() { return uvOffset; }
@@ -63,6 +64,7 @@ std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11SamplerState>>& Mat
 
 void Material::SetPixelShader(std::shared_ptr<SimplePixelShader> ps) { this->ps = ps; }
 void Material::SetVertexShader(std::shared_ptr<SimpleVertexShader> vs) { this->vs = vs; }
+void Material::SetPackedVertexShader(std::shared_ptr<SimpleVertexShader> vs) { packedVS = vs; }
 void Material::SetColorTint(DirectX::XMFLOAT3 tint) { this->colorTint = tint; }
 void Material::SetUVScale(DirectX::XMFLOAT2 scale) { uvScale = scale; }
 void Material::SetUVOffset(DirectX::XMFLOAT2 offset) { uvOffset = offset; }
@@ -87,18 +89,28 @@ void Material::RemoveSampler(std::string name)
 	samplers.erase(name);
 }
 
-void Material::PrepareMaterial(std::shared_ptr<Transform> transform, std::shared_ptr<Camera> camera)
+void Material::PrepareMaterial(std::shared_ptr<Transform> transform, std::shared_ptr<Camera> camera, std::shared_ptr<Mesh> mesh)
 {
+	// Meshes with packed vertices need the vertex shader (and
+	// input layout) that decodes them
+	std::shared_ptr<SimpleVertexShader> meshVS = mesh->HasPackedVertices() ? packedVS : vs;
+
 	// Turn on these shaders
-	vs->SetShader();
+	meshVS->SetShader();
 	ps->SetShader();
 
 	// Send data to the vertex shader
-	vs->SetMatrix4x4("world", transform->GetWorldMatrix());
-	vs->SetMatrix4x4("worldInvTrans", transform->GetWorldInverseTransposeMatrix());
-	vs->SetMatrix4x4("view", camera->GetView());
-	vs->SetMatrix4x4("projection", camera->GetProjection());
-	vs->CopyAllBufferData();
+	if (mesh->HasPackedVertices())
+	{
+		VertexQuantization quantization = mesh->GetVertexQuantization();
+		meshVS->SetFloat3("positionOffset", quantization.Offset);
+		meshVS->SetFloat3("positionScale", quantization.Scale);
+	}
+	meshVS->SetMatrix4x4("world", transform->GetWorldMatrix());
+	meshVS->SetMatrix4x4("worldInvTrans", transform->GetWorldInverseTransposeMatrix());
+	meshVS->SetMatrix4x4("view", camera->GetView());
+	meshVS->SetMatrix4x4("projection", camera->GetProjection());
+	meshVS->CopyAllBufferData();
 
 	// Send data to the pixel shader
 	ps->SetFloat3("colorTint", colorTint);
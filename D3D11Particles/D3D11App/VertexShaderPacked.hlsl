@@ -0,0 +1,52 @@
+
+#include "ShaderStructs.hlsli"
+
+cbuffer ExternalData : register(b0)
+{
+	matrix world;
+	matrix worldInvTrans;
+	matrix view;
+	matrix projection;
+	float3 positionOffset;	// Undoes the mesh's quantization (see VertexPacking.h)
+	float3 positionScale;
+}
+
+// Unit vector from its octahedral encoding (OctDecode in VertexPacking.cpp)
+float3 OctDecode(float2 encoded)
+{
+	float3 v = float3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+	if (v.z < 0)
+	{
+		float2 signs = float2(v.x >= 0 ? 1.0f : -1.0f, v.y >= 0 ? 1.0f : -1.0f);
+		v.xy = (1.0f - abs(v.yx)) * signs;
+	}
+	return normalize(v);
+}
+
+// --------------------------------------------------------
+// The vertex shader for meshes with packed vertices, which
+// is VertexShader.hlsl once the vertex is decoded
+// --------------------------------------------------------
+VertexToPixel main(VertexShaderInputPacked input)
+{
+	// Set up output struct
+	VertexToPixel output;
+
+	// Scale the position back out of the mesh's bounds, and
+	// unfold the normal and tangent from the octahedron
+	float3 localPosition = positionOffset + input.localPosition.xyz * positionScale;
+	float3 normal = OctDecode(input.normalTangent.xy);
+	float3 tangent = OctDecode(input.normalTangent.zw);
+
+	// Calculate screen position of this vertex
+	matrix wvp = mul(projection, mul(view, world));
+	output.screenPosition = mul(wvp, float4(localPosition, 1.0f));
+
+	// Pass other data through (for now)
+	output.uv = input.uv;
+	output.normal = normalize(mul((float3x3)worldInvTrans, normal));
+	output.tangent = normalize(mul((float3x3)worldInvTrans, tangent));
+	output.worldPos = mul(world, float4(localPosition, 1.0f)).xyz;
+
+	return output;
+}
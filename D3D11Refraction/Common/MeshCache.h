@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+// --------------------------------------------------------
+// Binary caches of loaded meshes, independent of D3D
+//
+// - A mesh's cache sits next to its source file, as
+//   "<source>.meshcache", and holds the final vertex and
+//   index arrays exactly as they go to the GPU, so a later
+//   load maps the file and hands those arrays straight to
+//   the buffers, with no parsing and no per-element copies
+// - A cache is current if it matches the source's size and
+//   timestamp, or, when only the timestamp changed (a fresh
+//   checkout, say), the hash of the source's contents
+// - Anything that doesn't match is simply rebuilt from the
+//   source and rewritten
+// --------------------------------------------------------
+
+// Bump this whenever the vertex layout or how Mesh turns a
+// source file into vertices changes, so old caches are rebuilt
+const uint32_t MeshCacheVersion = 1;
+
+// The start of every cache file, followed by the vertices and
+// then the (32-bit) indices
+struct MeshCacheHeader
+{
+	char Magic[8];				// "MESHCACH"
+	uint32_t Version;			// MeshCacheVersion
+	uint32_t VertexSize;		// Bytes per vertex
+	uint64_t VertexCount;
+	uint64_t IndexCount;
+	uint64_t SourceSize;		// The source file this was built from
+	int64_t SourceWriteTime;
+	uint64_t SourceHash;
+	float BoundsMin[3];			// Of the vertex positions
+	float BoundsMax[3];
+};
+
+// --------------------------------------------------------
+// A whole file, mapped read-only into memory
+// --------------------------------------------------------
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile() { Close(); }
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Fails for missing or empty files
+	bool Open(const std::filesystem::path& path);
+	void Close();
+
+	const unsigned char* Data() const { return data; }
+	size_t Size() const { return size; }
+
+private:
+	void* file = nullptr;
+	void* mapping = nullptr;
+	const unsigned char* data = nullptr;
+	size_t size = 0;
+};
+
+// --------------------------------------------------------
+// A mesh's cache, mapped while it's open
+// --------------------------------------------------------
+class MeshCache
+{
+public:
+	// Opens the cache of the given source file if it's current
+	// and holds vertices of the given size
+	bool Open(const std::filesystem::path& sourcePath, size_t vertexSize);
+	void Close() { file.Close(); }
+
+	// Valid until the cache is closed
+	const void* Vertices() const { return file.Data() + sizeof(MeshCacheHeader); }
+	const unsigned int* Indices() const;
+
+	size_t VertexCount() const { return (size_t)Header().VertexCount; }
+	size_t IndexCount() const { return (size_t)Header().IndexCount; }
+	const MeshCacheHeader& Header() const { return *reinterpret_cast<const MeshCacheHeader*>(file.Data()); }
+
+private:
+	MappedFile file;
+};
+
+std::filesystem::path MeshCachePath(const std::filesystem::path& sourcePath);
+
+// Writes the cache of the given source file.  Unless bounds are
+// given (min x, y, z, then max x, y, z), each vertex must start
+// with its position as three floats.  Returns false if the cache
+// couldn't be written, which only costs the next load time.
+bool WriteMeshCache(
+	const std::filesystem::path& sourcePath,
+	const void* vertices,
+	size_t vertexSize,
+	size_t vertexCount,
+	const unsigned int* indices,
+	size_t indexCount,
+	const float* bounds = nullptr);
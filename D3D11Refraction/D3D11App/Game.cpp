@@ -182,14 +182,39 @@ void Game::LoadAssetsAndCreateEntities()
 	std::shared_ptr<SimpleVertexShader> skyVS = std::make_shared<SimpleVertexShader>(Graphics::Device, Graphics::Context, FixPath(L"SkyVS.cso").c_str());
 	std::shared_ptr<SimplePixelShader> skyPS = std::make_shared<SimplePixelShader>(Graphics::Device, Graphics::Context, FixPath(L"SkyPS.cso").c_str());
 
-	// Load 3D models	
+	// The vertex shader for packed vertices (see VertexPacking.h), with an input
+	// layout of its own, since reflection would only see the floats the input
+	// assembler turns them back into
+	{
+		D3D11_INPUT_ELEMENT_DESC packedElements[] =
+		{
+			{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_SNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },	// Position within the mesh's bounds
+			{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },		// Half float UV
+			{ "NORMAL", 0, DXGI_FORMAT_R8G8B8A8_SNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },		// Octahedral normal and tangent
+		};
+
+		std::wstring packedVSPath = FixPath(L"VertexShaderPacked.cso");
+		Microsoft::WRL::ComPtr<ID3DBlob> packedVSByteCode;
+		Microsoft::WRL::ComPtr<ID3D11InputLayout> packedInputLayout;
+		D3DReadFileToBlob(packedVSPath.c_str(), packedVSByteCode.GetAddressOf());
+		Graphics::Device->CreateInputLayout(
+			packedElements,
+			ARRAYSIZE(packedElements),
+			packedVSByteCode->GetBufferPointer(),
+			packedVSByteCode->GetBufferSize(),
+			packedInputLayout.GetAddressOf());
+		vertexShaderPacked = std::make_shared<SimpleVertexShader>(Graphics::Device, Graphics::Context, packedVSPath.c_str(), packedInputLayout, false);
+	}
+
+	// Load 3D models, with their vertices packed to 16 bytes (see VertexPacking.h),
+	// except the cube, which the sky also draws and SkyVS reads as floats
 	std::shared_ptr<Mesh> cubeMesh = std::make_shared<Mesh>("Cube", FixPath(AssetPath + L"Meshes/cube.obj").c_str());
-	//std::shared_ptr<Mesh> cylinderMesh = std::make_shared<Mesh>("Cylinder", FixPath(AssetPath + L"Meshes/cylinder.obj").c_str());
-	//std::shared_ptr<Mesh> helixMesh = std::make_shared<Mesh>("Helix", FixPath(AssetPath + L"Meshes/helix.obj").c_str());
-	std::shared_ptr<Mesh> sphereMesh = std::make_shared<Mesh>("Sphere", FixPath(AssetPath + L"Meshes/sphere.obj").c_str());
-	std::shared_ptr<Mesh> torusMesh = std::make_shared<Mesh>("Torus", FixPath(AssetPath + L"Meshes/torus.obj").c_str());
-	//std::shared_ptr<Mesh> quadMesh = std::make_shared<Mesh>("Quad", FixPath(AssetPath + L"Meshes/quad.obj").c_str());
-	//std::shared_ptr<Mesh> quad2sidedMesh = std::make_shared<Mesh>("Double-Sided Quad", FixPath(AssetPath + L"Meshes/quad_double_sided.obj").c_str());
+	//std::shared_ptr<Mesh> cylinderMesh = std::make_shared<Mesh>("Cylinder", FixPath(AssetPath + L"Meshes/cylinder.obj").c_str(), true);
+	//std::shared_ptr<Mesh> helixMesh = std::make_shared<Mesh>("Helix", FixPath(AssetPath + L"Meshes/helix.obj").c_str(), true);
+	std::shared_ptr<Mesh> sphereMesh = std::make_shared<Mesh>("Sphere", FixPath(AssetPath + L"Meshes/sphere.obj").c_str(), true);
+	std::shared_ptr<Mesh> torusMesh = std::make_shared<Mesh>("Torus", FixPath(AssetPath + L"Meshes/torus.obj").c_str(), true);
+	//std::shared_ptr<Mesh> quadMesh = std::make_shared<Mesh>("Quad", FixPath(AssetPath + L"Meshes/quad.obj").c_str(), true);
+	//std::shared_ptr<Mesh> quad2sidedMesh = std::make_shared<Mesh>("Double-Sided Quad", FixPath(AssetPath + L"Meshes/quad_double_sided.obj").c_str(), true);
 
 	// Add all meshes to vector
 	meshes.insert(meshes.end(), { cubeMesh, sphereMesh, torusMesh });
@@ -416,6 +441,10 @@ void Game::LoadAssetsAndCreateEntities()
 		geNonMetal->GetTransform()->SetPosition(i * 2.0f - 10.0f, -1, 0);
 	}
 
+	// Every material draws packed meshes with the same vertex shader
+	for (auto& m : materials)
+		m->SetPackedVertexShader(vertexShaderPacked);
+
 	// Set up render targets
 	{
 		// Load shaders
@@ -782,13 +811,23 @@ void Game::Draw(float deltaTime, float totalTime)
 		solidColorPS->CopyAllBufferData();
 		for (auto& e : refractionEntities)
 		{
-			std::shared_ptr<SimpleVertexShader> vs = e->GetMaterial()->GetVertexShader();
+			// Packed meshes (see VertexPacking.h) need the shader that decodes them
+			std::shared_ptr<Mesh> mesh = e->GetMesh();
+			std::shared_ptr<SimpleVertexShader> vs = mesh->HasPackedVertices() ?
+				e->GetMaterial()->GetPackedVertexShader() : e->GetMaterial()->GetVertexShader();
+			vs->SetShader();
+			if (mesh->HasPackedVertices())
+			{
+				VertexQuantization quantization = mesh->GetVertexQuantization();
+				vs->SetFloat3("positionOffset", quantization.Offset);
+				vs->SetFloat3("positionScale", quantization.Scale);
+			}
 			vs->SetMatrix4x4("world", e->GetTransform()->GetWorldMatrix());
 			vs->SetMatrix4x4("view", camera->GetView());
 			vs->SetMatrix4x4("projection", camera->GetProjection());
 			vs->CopyAllBufferData();
 
-			e->GetMesh()->SetBuffersAndDraw();
+			mesh->SetBuffersAndDraw();
 		}
 
 		// Reset depth state
@@ -851,13 +890,22 @@ void Game::DrawLightSources()
 	Microsoft::WRL::ComPtr<ID3D11Buffer> ib = pointLightMesh->GetIndexBuffer();
 	unsigned int indexCount = pointLightMesh->GetIndexCount();
 
+	// Its vertices may be packed (see VertexPacking.h)
+	std::shared_ptr<SimpleVertexShader> vs = pointLightMesh->HasPackedVertices() ? vertexShaderPacked : vertexShader;
+
 	// Turn on these shaders
-	vertexShader->SetShader();
+	vs->SetShader();
 	solidColorPS->SetShader();
 
 	// Set up vertex shader
-	vertexShader->SetMatrix4x4("view", camera->GetView());
-	vertexShader->SetMatrix4x4("projection", camera->GetProjection());
+	if (pointLightMesh->HasPackedVertices())
+	{
+		VertexQuantization quantization = pointLightMesh->GetVertexQuantization();
+		vs->SetFloat3("positionOffset", quantization.Offset);
+		vs->SetFloat3("positionScale", quantization.Scale);
+	}
+	vs->SetMatrix4x4("view", camera->GetView());
+	vs->SetMatrix4x4("projection", camera->GetProjection());
 
 	for (int i = 0; i < lightOptions.LightCount; i++)
 	{
@@ -868,7 +916,7 @@ void Game::DrawLightSources()
 			continue;
 
 		// Set buffers in the input assembler
-		UINT stride = sizeof(Vertex);
+		UINT stride = pointLightMesh->GetVertexStride();
 		UINT offset = 0;
 		Graphics::Context->IASetVertexBuffers(0, 1, vb.GetAddressOf(), &stride, &offset);
 		Graphics::Context->IASetIndexBuffer(ib.Get(), DXGI_FORMAT_R32_UINT, 0);
@@ -884,7 +932,7 @@ void Game::DrawLightSources()
 		XMStoreFloat4x4(&world, scaleMat * transMat);
 
 		// Set up the world matrix for this light
-		vertexShader->SetMatrix4x4("world", world);
+		vs->SetMatrix4x4("world", world);
 
 		// Set up the pixel shader data
 		XMFLOAT3 finalColor = light.Color;
@@ -894,7 +942,7 @@ void Game::DrawLightSources()
 		solidColorPS->SetFloat3("Color", finalColor);
 
 		// Copy data
-		vertexShader->CopyAllBufferData();
+		vs->CopyAllBufferData();
 		solidColorPS->CopyAllBufferData();
 
 		// Draw
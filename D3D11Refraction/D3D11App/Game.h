@@ -69,6 +69,7 @@ private:
 	// Shaders for solid color spheres
 	std::shared_ptr<SimplePixelShader> solidColorPS;
 	std::shared_ptr<SimpleVertexShader> vertexShader;
+	std::shared_ptr<SimpleVertexShader> vertexShaderPacked;
 
 	// Post processing shaders
 	std::shared_ptr<SimplePixelShader> texturePS;
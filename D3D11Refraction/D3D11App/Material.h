@@ -9,6 +9,7 @@
 #include "SimpleShader.h"
 #include "Camera.h"
 #include "Transform.h"
+#include "Mesh.h"
 
 class Material
 {
@@ -25,6 +26,7 @@ public:
 
 	std::shared_ptr<SimplePixelShader> GetPixelShader();
 	std::shared_ptr<SimpleVertexShader> GetVertexShader();
+	std::shared_ptr<SimpleVertexShader> GetPackedVertexShader();
 	DirectX::XMFLOAT3 GetColorTint();
 	DirectX::XMFLOAT2 GetUVScale();
 	DirectX::XMFLOAT2 GetUVOffset();
@@ -39,6 +41,7 @@ public:
 
 	void SetPixelShader(std::shared_ptr<SimplePixelShader> ps);
 	void SetVertexShader(std::shared_ptr<SimpleVertexShader> ps);
+	void SetPackedVertexShader(std::shared_ptr<SimpleVertexShader> vs);
 	void SetColorTint(DirectX::XMFLOAT3 tint);
 	void SetUVScale(DirectX::XMFLOAT2 scale);
 	void SetUVOffset(DirectX::XMFLOAT2 offset);
@@ -51,7 +54,7 @@ public:
 	void RemoveTextureSRV(std::string name);
 	void RemoveSampler(std::string name);
 
-	void PrepareMaterial(std::shared_ptr<Transform> transform, std::shared_ptr<Camera> camera);
+	void PrepareMaterial(std::shared_ptr<Transform> transform, std::shared_ptr<Camera> camera, std::shared_ptr<Mesh> mesh);
 
 private:
 
@@ -61,6 +64,7 @@ private:
 	// Shaders
 	std::shared_ptr<SimplePixelShader> ps;
 	std::shared_ptr<SimpleVertexShader> vs;
+	std::shared_ptr<SimpleVertexShader> packedVS;	// For meshes with packed vertices
 
 	// Material properties
 	DirectX::XMFLOAT3 colorTint;
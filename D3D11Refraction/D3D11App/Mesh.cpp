@@ -1,9 +1,13 @@
-#include <fstream>
+#include <cstdio>
 #include <vector>
 #include <stdexcept>
 
 #include "Mesh.h"
 #include "Graphics.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "ObjParser.h"
+#include "VertexPacking.h"
 
 using namespace DirectX;
 
@@ -19,213 +23,139 @@ using namespace DirectX;
 Mesh::Mesh(const char* name, Vertex* vertArray, size_t numVerts, unsigned int* indexArray, size_t numIndices) :
 	name(name)
 {
+	CalculateTangents(vertArray, numVerts, indexArray, numIndices);
 	CreateBuffers(vertArray, numVerts, indexArray, numIndices);
 }
 
 // --------------------------------------------------------
 // Creates a new mesh by loading vertices from the given .obj file
 // 
-// objFile  - Path to the .obj 3D model file to load
+// objFile      - Path to the .obj 3D model file to load
+// packVertices - Whether to pack the vertices to 16 bytes each
+//                (see VertexPacking.h)
 // --------------------------------------------------------
-Mesh::Mesh(const char* name, const std::wstring& objFile) :
+Mesh::Mesh(const char* name, const std::wstring& objFile, bool packVertices) :
 	name(name)
 {
 	// Set indicies to 0 in the event the file reading fails
 	numIndices = 0;
 	numVertices = 0;
+	packedVertices = packVertices;
 
-	// File input object
-	std::ifstream obj(objFile);
-
-	// Check for successful open
-	if (!obj.is_open())
-		throw std::invalid_argument("Error opening file: Invalid file path or file is inaccessible");
-
-	// Variables used while reading the file
-	std::vector<XMFLOAT3> positions;	// Positions from the file
-	std::vector<XMFLOAT3> normals;		// Normals from the file
-	std::vector<XMFLOAT2> uvs;			// UVs from the file
-	std::vector<Vertex> verts;			// Verts we're assembling
-	std::vector<UINT> indices;			// Indices of these verts
-	unsigned int vertCounter = 0;		// Count of vertices/indices
-	int indexCounter = 0;				// Count of indices
-	char chars[100];					// String for line reading
-
-	// Still have data left?
-	while (obj.good())
+	// Use the binary cache of the file's final vertices and indices
+	// if it's still current (see MeshCache.h), straight from the
+	// mapped file, which can be closed once the buffers exist
+	MeshCache cache;
+	if (cache.Open(objFile, packedVertices ? sizeof(PackedVertex) : sizeof(Vertex)))
 	{
-		// Get the line (100 characters should be more than enough)
-		obj.getline(chars, 100);
+		printf("Mesh %s: %zu triangles, %zu vertices from its mesh cache\n", name, cache.IndexCount() / 3, cache.VertexCount());
 
-		// Check the type of line
-		if (chars[0] == 'v' && chars[1] == 'n')
-		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 norm{};
-			sscanf_s(
-				chars,
-				"vn %f %f %f",
-				&norm.x, &norm.y, &norm.z);
-
-			// Add to the list of normals
-			normals.push_back(norm);
-		}
-		else if (chars[0] == 'v' && chars[1] == 't')
-		{
-			// Read the 2 numbers directly into an XMFLOAT2
-			XMFLOAT2 uv{};
-			sscanf_s(
-				chars,
-				"vt %f %f",
-				&uv.x, &uv.y);
-
-			// Add to the list of uv's
-			uvs.push_back(uv);
-		}
-		else if (chars[0] == 'v')
+		// The cache's bounds are the ones the positions were packed across
+		if (packedVertices)
+			quantization = QuantizeBounds(cache.Header().BoundsMin, cache.Header().BoundsMax);
+
+		CreateBuffers(cache.Vertices(), cache.VertexCount(), cache.Indices(), cache.IndexCount());
+		return;
+	}
+
+	// Parse the file, which also splits every face into triangles
+	ObjData obj;
+	std::string error;
+	if (!LoadObj(objFile, obj, &error))
+		throw std::invalid_argument("Error loading OBJ file: " + error);
+	if (obj.Corners.empty())
+		throw std::invalid_argument("Error loading OBJ file: no faces");
+
+	// Build one vertex per distinct corner
+	// - OBJ files index positions, uvs and normals separately, so corners
+	//    with the same three indices are welded into one vertex, which the
+	//    index buffer then refers to from every triangle using it
+	// - The model is most likely in a right-handed space, especially if it
+	//    came from Maya.  We want a left-handed space for DirectX, so we
+	//    invert the Z of positions and normals and flip the winding order
+	// - UVs are flipped vertically too, since DirectX defines (0,0) as the
+	//    top left of the texture, and many 3D modeling packages use the
+	//    bottom left
+	// - Corners without uvs get (0,0), and corners without normals get
+	//    their triangle's face normal
+	std::vector<ObjCorner> corners;
+	std::vector<unsigned int> indices;
+	WeldObjCorners(obj, corners, indices);
+
+	std::vector<Vertex> verts(corners.size());
+	for (size_t i = 0; i < corners.size(); i++)
+	{
+		const ObjCorner& corner = corners[i];
+		Vertex& v = verts[i];
+
+		ObjFloat3 pos = obj.Positions[corner.Position];
+		v.Position = XMFLOAT3(pos.x, pos.y, -pos.z);
+
+		ObjFloat2 uv = corner.UV >= 0 ? obj.UVs[corner.UV] : ObjFloat2{ 0, 0 };
+		v.UV = XMFLOAT2(uv.x, 1.0f - uv.y);
+
+		if (corner.Normal >= 0)
 		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 pos{};
-			sscanf_s(
-				chars,
-				"v %f %f %f",
-				&pos.x, &pos.y, &pos.z);
-
-			// Add to the positions
-			positions.push_back(pos);
+			ObjFloat3 norm = obj.Normals[corner.Normal];
+			v.Normal = XMFLOAT3(norm.x, norm.y, -norm.z);
 		}
-		else if (chars[0] == 'f')
-		{
-			// Read the face indices into an array
-			// NOTE: This assumes the given obj file contains
-			//  vertex positions, uv coordinates AND normals.
-			unsigned int i[12]{};
-			int numbersRead = sscanf_s(
-				chars,
-				"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
-				&i[0], &i[1], &i[2],
-				&i[3], &i[4], &i[5],
-				&i[6], &i[7], &i[8],
-				&i[9], &i[10], &i[11]);
-
-			// If we only got the first number, chances are the OBJ
-			// file has no UV coordinates.  This isn't great, but we
-			// still want to load the model without crashing, so we
-			// need to re-read a different pattern (in which we assume
-			// there are no UVs denoted for any of the vertices)
-			if (numbersRead == 1)
-			{
-				// Re-read with a different pattern
-				numbersRead = sscanf_s(
-					chars,
-					"f %d//%d %d//%d %d//%d %d//%d",
-					&i[0], &i[2],
-					&i[3], &i[5],
-					&i[6], &i[8],
-					&i[9], &i[11]);
-
-				// The following indices are where the UVs should 
-				// have been, so give them a valid value
-				i[1] = 1;
-				i[4] = 1;
-				i[7] = 1;
-				i[10] = 1;
-
-				// If we have no UVs, create a single UV coordinate
-				// that will be used for all vertices
-				if (uvs.size() == 0)
-					uvs.push_back(XMFLOAT2(0, 0));
-			}
+	}
 
-			// - Create the verts by looking up
-			//    corresponding data from vectors
-			// - OBJ File indices are 1-based, so
-			//    they need to be adusted
-			Vertex v1{};
-			v1.Position = positions[max(i[0] - 1, 0)];
-			v1.UV = uvs[max(i[1] - 1, 0)];
-			v1.Normal = normals[max(i[2] - 1, 0)];
-
-			Vertex v2{};
-			v2.Position = positions[max(i[3] - 1, 0)];
-			v2.UV = uvs[max(i[4] - 1, 0)];
-			v2.Normal = normals[max(i[5] - 1, 0)];
-
-			Vertex v3{};
-			v3.Position = positions[max(i[6] - 1, 0)];
-			v3.UV = uvs[max(i[7] - 1, 0)];
-			v3.Normal = normals[max(i[8] - 1, 0)];
-
-			// The model is most likely in a right-handed space,
-			// especially if it came from Maya.  We want to convert
-			// to a left-handed space for DirectX.  This means we 
-			// need to:
-			//  - Invert the Z position
-			//  - Invert the normal's Z
-			//  - Flip the winding order
-			// We also need to flip the UV coordinate since DirectX
-			// defines (0,0) as the top left of the texture, and many
-			// 3D modeling packages use the bottom left as (0,0)
-
-			// Flip the UV's since they're probably "upside down"
-			v1.UV.y = 1.0f - v1.UV.y;
-			v2.UV.y = 1.0f - v2.UV.y;
-			v3.UV.y = 1.0f - v3.UV.y;
-
-			// Flip Z (LH vs. RH)
-			v1.Position.z *= -1.0f;
-			v2.Position.z *= -1.0f;
-			v3.Position.z *= -1.0f;
-
-			// Flip normal's Z
-			v1.Normal.z *= -1.0f;
-			v2.Normal.z *= -1.0f;
-			v3.Normal.z *= -1.0f;
-
-			// Add the verts to the vector (flipping the winding order)
-			verts.push_back(v1);
-			verts.push_back(v3);
-			verts.push_back(v2);
-			vertCounter += 3;
-
-			// Add three more indices
-			indices.push_back(indexCounter); indexCounter += 1;
-			indices.push_back(indexCounter); indexCounter += 1;
-			indices.push_back(indexCounter); indexCounter += 1;
-
-			// Was there a 4th face?
-			// - 12 numbers read means 4 faces WITH uv's
-			// - 8 numbers read means 4 faces WITHOUT uv's
-			if (numbersRead == 12 || numbersRead == 8)
+	for (size_t t = 0; t < indices.size(); t += 3)
+	{
+		// Flip the winding order
+		std::swap(indices[t + 1], indices[t + 2]);
+
+		// Unwelded corners without a normal belong to this triangle alone
+		bool missingNormal = false;
+		for (size_t k = 0; k < 3; k++)
+			missingNormal |= corners[indices[t + k]].Normal < 0;
+		if (missingNormal)
+		{
+			XMVECTOR p0 = XMLoadFloat3(&verts[indices[t]].Position);
+			XMVECTOR faceNormal = XMVector3Normalize(XMVector3Cross(
+				XMVectorSubtract(XMLoadFloat3(&verts[indices[t + 1]].Position), p0),
+				XMVectorSubtract(XMLoadFloat3(&verts[indices[t + 2]].Position), p0)));
+			for (size_t k = 0; k < 3; k++)
 			{
-				// Make the last vertex
-				Vertex v4{};
-				v4.Position = positions[max(i[9] - 1, 0)];
-				v4.UV = uvs[max(i[10] - 1, 0)];
-				v4.Normal = normals[max(i[11] - 1, 0)];
-
-				// Flip the UV, Z pos and normal's Z
-				v4.UV.y = 1.0f - v4.UV.y;
-				v4.Position.z *= -1.0f;
-				v4.Normal.z *= -1.0f;
-
-				// Add a whole triangle (flipping the winding order)
-				verts.push_back(v1);
-				verts.push_back(v4);
-				verts.push_back(v3);
-				vertCounter += 3;
-
-				// Add three more indices
-				indices.push_back(indexCounter); indexCounter += 1;
-				indices.push_back(indexCounter); indexCounter += 1;
-				indices.push_back(indexCounter); indexCounter += 1;
+				if (corners[indices[t + k]].Normal < 0)
+					XMStoreFloat3(&verts[indices[t + k]].Normal, faceNormal);
 			}
 		}
 	}
 
-	// Close the file and create the actual buffers
-	obj.close();
-	CreateBuffers(&verts[0], vertCounter, &indices[0], indexCounter);
+	// Reorder for the GPU (see MeshOptimizer.h): triangles for the
+	// post-transform vertex cache, then runs of them for overdraw,
+	// then the vertices themselves in the order they're first used
+	OptimizeVertexCache(&indices[0], indices.size(), verts.size());
+	OptimizeOverdraw(&indices[0], indices.size(), &verts[0].Position.x, sizeof(Vertex), verts.size());
+	std::vector<unsigned int> remap;
+	OptimizeVertexFetch(&indices[0], indices.size(), verts.size(), remap);
+	RemapVertices(verts, remap);
+
+	// Report what welding saved over a vertex per corner
+	printf("Mesh %s: %zu triangles, %zu vertices instead of %zu (%.1f KB less vertex data)\n",
+		name, indices.size() / 3, verts.size(), indices.size(),
+		(indices.size() - verts.size()) * sizeof(Vertex) / 1024.0);
+
+	CalculateTangents(&verts[0], verts.size(), &indices[0], indices.size());
+
+	// Pack the finished vertices, if asked, keeping the bounds
+	// they're packed across in the cache
+	if (packedVertices)
+	{
+		std::vector<PackedVertex> packed(verts.size());
+		float bounds[6];
+		PackVertices(&verts[0].Position.x, sizeof(Vertex), verts.size(), &packed[0], bounds, bounds + 3);
+		quantization = QuantizeBounds(bounds, bounds + 3);
+
+		WriteMeshCache(objFile, &packed[0], sizeof(PackedVertex), packed.size(), &indices[0], indices.size(), bounds);
+		CreateBuffers(&packed[0], packed.size(), &indices[0], indices.size());
+		return;
+	}
+
+	WriteMeshCache(objFile, &verts[0], sizeof(Vertex), verts.size(), &indices[0], indices.size());
+	CreateBuffers(&verts[0], verts.size(), &indices[0], indices.size());
 }
 
 
@@ -243,6 +173,9 @@ Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetIndexBuffer() { return ib; }
 const char* Mesh::GetName() { return name; }
 unsigned int Mesh::GetIndexCount() { return numIndices; }
 unsigned int Mesh::GetVertexCount() { return numVertices; }
+unsigned int Mesh::GetVertexStride() { return packedVertices ? sizeof(PackedVertex) : sizeof(Vertex); }
+bool Mesh::HasPackedVertices() { return packedVertices; }
+VertexQuantization Mesh::GetVertexQuantization() { return quantization; }
 
 
 // --------------------------------------------------------
@@ -254,14 +187,12 @@ unsigned int Mesh::GetVertexCount() { return numVertices; }
 // numIndices - The number of indices in the index array
 // device     - The D3D device to use for buffer creation
 // --------------------------------------------------------
-void Mesh::CreateBuffers(Vertex* vertArray, size_t numVerts, unsigned int* indexArray, size_t numIndices)
+void Mesh::CreateBuffers(const void* vertArray, size_t numVerts, const unsigned int* indexArray, size_t numIndices)
 {
-	CalculateTangents(vertArray, numVerts, indexArray, numIndices);
-
 	// Create the vertex buffer
 	D3D11_BUFFER_DESC vbd = {};
 	vbd.Usage = D3D11_USAGE_IMMUTABLE;
-	vbd.ByteWidth = sizeof(Vertex) * (UINT)numVerts; // Number of vertices
+	vbd.ByteWidth = GetVertexStride() * (UINT)numVerts; // Number of vertices
 	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 	vbd.CPUAccessFlags = 0;
 	vbd.MiscFlags = 0;
@@ -382,7 +313,7 @@ void Mesh::CalculateTangents(Vertex* verts, size_t numVerts, unsigned int* indic
 void Mesh::SetBuffersAndDraw()
 {
 	// Set buffers in the input assembler
-	UINT stride = sizeof(Vertex);
+	UINT stride = GetVertexStride();
 	UINT offset = 0;
 	Graphics::Context->IASetVertexBuffers(0, 1, vb.GetAddressOf(), &stride, &offset);
 	Graphics::Context->IASetIndexBuffer(ib.Get(), DXGI_FORMAT_R32_UINT, 0);
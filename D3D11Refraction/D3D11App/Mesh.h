@@ -5,13 +5,14 @@
 #include <string>
 
 #include "Vertex.h"
+#include "VertexPacking.h"
 
 
 class Mesh
 {
 public:
 	Mesh(const char* name, Vertex* vertArray, size_t numVerts, unsigned int* indexArray, size_t numIndices);
-	Mesh(const char* name, const std::wstring& objFile);
+	Mesh(const char* name, const std::wstring& objFile, bool packVertices = false);
 	~Mesh();
 
 	// Getters for mesh data
@@ -20,6 +21,11 @@ public:
 	const char* GetName();
 	unsigned int GetIndexCount();
 	unsigned int GetVertexCount();
+	unsigned int GetVertexStride();
+
+	// Packed meshes hold PackedVertex instead of Vertex (see VertexPacking.h)
+	bool HasPackedVertices();
+	VertexQuantization GetVertexQuantization();
 
 	// Basic mesh drawing
 	void SetBuffersAndDraw();
@@ -33,11 +39,15 @@ private:
 	unsigned int numIndices;
 	unsigned int numVertices;
 
+	// Packed vertices, and how to undo their positions' quantization
+	bool packedVertices = false;
+	VertexQuantization quantization{};
+
 	// Name (mostly for UI purposes)
 	const char* name;
 
 	// Helper for creating buffers (in the event we add more constructor overloads)
-	void CreateBuffers(Vertex* vertArray, size_t numVerts, unsigned int* indexArray, size_t numIndices);
+	void CreateBuffers(const void* vertArray, size_t numVerts, const unsigned int* indexArray, size_t numIndices);
 	void CalculateTangents(Vertex* verts, size_t numVerts, unsigned int* indices, size_t numIndices);
 };
 
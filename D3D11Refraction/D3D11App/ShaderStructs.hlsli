@@ -12,6 +12,15 @@ struct VertexShaderInput
 	float3 tangent			: TANGENT;
 };
 
+// VS input for a packed vertex (see VertexPacking.h), which the
+// input assembler has already turned back into floats
+struct VertexShaderInputPacked
+{
+	float4 localPosition	: POSITION;	// XYZ snorm across the mesh's bounds
+	float2 uv				: TEXCOORD;
+	float4 normalTangent	: NORMAL;	// Octahedral normal (xy) and tangent (zw)
+};
+
 
 
 // VS Output / PS Input struct for basic lighting
@@ -9,6 +9,10 @@ struct VertexShaderExternalData
 	DirectX::XMFLOAT4X4 view;
 	DirectX::XMFLOAT4X4 projection;
 	DirectX::XMFLOAT4X4 worldInvTranspose;
+	DirectX::XMFLOAT3 positionOffset;	// Packed vertices only (see VertexPacking.h)
+	float pad0;
+	DirectX::XMFLOAT3 positionScale;
+	float pad1;
 };
 
 struct PixelShaderExternalData
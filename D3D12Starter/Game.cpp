@@ -52,6 +52,7 @@ void Game::CreateRootSigAndPipelineState()
 {
 	// Blobs to hold raw shader byte code used in several steps below
 	Microsoft::WRL::ComPtr<ID3DBlob> vertexShaderByteCode;
+	Microsoft::WRL::ComPtr<ID3DBlob> packedVertexShaderByteCode;
 	Microsoft::WRL::ComPtr<ID3DBlob> pixelShaderByteCode;
 
 	// Load shaders
@@ -60,6 +61,8 @@ void Game::CreateRootSigAndPipelineState()
 		// - Essentially just "open the file and plop its contents here"
 		D3DReadFileToBlob(
 			FixPath(L"VertexShader.cso").c_str(), vertexShaderByteCode.GetAddressOf());
+		D3DReadFileToBlob(
+			FixPath(L"VertexShaderPacked.cso").c_str(), packedVertexShaderByteCode.GetAddressOf());
 		D3DReadFileToBlob(
 			FixPath(L"PixelShader.cso").c_str(), pixelShaderByteCode.GetAddressOf());
 	}
@@ -89,6 +92,27 @@ void Game::CreateRootSigAndPipelineState()
 		inputElements[3].SemanticIndex = 0;                    // This is the first TANGENT semantic
 	}
 
+	// Input layout for packed vertices (see VertexPacking.h), which
+	// the input assembler turns back into floats for the shader
+	const unsigned int packedInputElementCount = 3;
+	D3D12_INPUT_ELEMENT_DESC packedInputElements[packedInputElementCount] = {};
+	{
+		packedInputElements[0].AlignedByteOffset = D3D12_APPEND_ALIGNED_ELEMENT;
+		packedInputElements[0].Format = DXGI_FORMAT_R16G16B16A16_SNORM; // Position within the mesh's bounds
+		packedInputElements[0].SemanticName = "POSITION";
+		packedInputElements[0].SemanticIndex = 0;
+
+		packedInputElements[1].AlignedByteOffset = D3D12_APPEND_ALIGNED_ELEMENT;
+		packedInputElements[1].Format = DXGI_FORMAT_R16G16_FLOAT;       // Half float UV
+		packedInputElements[1].SemanticName = "TEXCOORD";
+		packedInputElements[1].SemanticIndex = 0;
+
+		packedInputElements[2].AlignedByteOffset = D3D12_APPEND_ALIGNED_ELEMENT;
+		packedInputElements[2].Format = DXGI_FORMAT_R8G8B8A8_SNORM;     // Octahedral normal and tangent
+		packedInputElements[2].SemanticName = "NORMAL";
+		packedInputElements[2].SemanticIndex = 0;
+	}
+
 
 	// Root Signature
 	{
@@ -230,6 +254,15 @@ void Game::CreateRootSigAndPipelineState()
 		Graphics::Device->CreateGraphicsPipelineState(
 			&psoDesc,
 			IID_PPV_ARGS(pipelineState.GetAddressOf()));
+
+		// The same state for packed vertices, with their own layout and vertex shader
+		psoDesc.InputLayout.NumElements = packedInputElementCount;
+		psoDesc.InputLayout.pInputElementDescs = packedInputElements;
+		psoDesc.VS.pShaderBytecode = packedVertexShaderByteCode->GetBufferPointer();
+		psoDesc.VS.BytecodeLength = packedVertexShaderByteCode->GetBufferSize();
+		Graphics::Device->CreateGraphicsPipelineState(
+			&psoDesc,
+			IID_PPV_ARGS(packedPipelineState.GetAddressOf()));
 	}
 
 	// Set up the viewport and scissor rectangle
@@ -277,14 +310,14 @@ void Game::CreateCameras()
 // --------------------------------------------------------
 void Game::CreateGeometry()
 {
-	// Load meshes
-	meshes.push_back(std::make_shared<Mesh>("Cube", FixPath(L"../../Assets/Models/cube.obj").c_str()));
-	meshes.push_back(std::make_shared<Mesh>("Cylinder", FixPath(L"../../Assets/Models/cylinder.obj").c_str()));
-	meshes.push_back(std::make_shared<Mesh>("Helix", FixPath(L"../../Assets/Models/helix.obj").c_str()));
-	meshes.push_back(std::make_shared<Mesh>("Quad", FixPath(L"../../Assets/Models/quad.obj").c_str()));
-	meshes.push_back(std::make_shared<Mesh>("Quad_Double_Sided", FixPath(L"../../Assets/Models/quad_double_sided.obj").c_str()));
-	meshes.push_back(std::make_shared<Mesh>("Sphere", FixPath(L"../../Assets/Models/sphere.obj").c_str()));
-	meshes.push_back(std::make_shared<Mesh>("Torus", FixPath(L"../../Assets/Models/torus.obj").c_str()));
+	// Load meshes, with their vertices packed to 16 bytes (see VertexPacking.h)
+	meshes.push_back(std::make_shared<Mesh>("Cube", FixPath(L"../../Assets/Models/cube.obj").c_str(), true));
+	meshes.push_back(std::make_shared<Mesh>("Cylinder", FixPath(L"../../Assets/Models/cylinder.obj").c_str(), true));
+	meshes.push_back(std::make_shared<Mesh>("Helix", FixPath(L"../../Assets/Models/helix.obj").c_str(), true));
+	meshes.push_back(std::make_shared<Mesh>("Quad", FixPath(L"../../Assets/Models/quad.obj").c_str(), true));
+	meshes.push_back(std::make_shared<Mesh>("Quad_Double_Sided", FixPath(L"../../Assets/Models/quad_double_sided.obj").c_str(), true));
+	meshes.push_back(std::make_shared<Mesh>("Sphere", FixPath(L"../../Assets/Models/sphere.obj").c_str(), true));
+	meshes.push_back(std::make_shared<Mesh>("Torus", FixPath(L"../../Assets/Models/torus.obj").c_str(), true));
 }
 
 
@@ -474,7 +507,9 @@ void Game::Draw(float deltaTime, float totalTime)
 		{
 			// Material setup
 			std::shared_ptr<Material> mat = entities[i]->GetMaterial();
-			Graphics::CommandList->SetPipelineState(mat->GetPipelineState().Get());
+			std::shared_ptr<Mesh> mesh = entities[i]->GetMesh();
+			Graphics::CommandList->SetPipelineState(mesh->HasPackedVertices() ?
+				packedPipelineState.Get() : mat->GetPipelineState().Get());
 			// Set the SRV descriptor handle for this material's textures
 			// Note: This assumes that descriptor table 2 is for textures (as per our root sig)
 			Graphics::CommandList->SetGraphicsRootDescriptorTable(
@@ -488,6 +523,12 @@ void Game::Draw(float deltaTime, float totalTime)
 				cameras[activeCameraIndex]->GetProjectionMatrix(),
 				entities[i]->GetTransform()->GetWorldInverseTransposeMatrix(),
 			};
+			if (mesh->HasPackedVertices())
+			{
+				VertexQuantization quantization = mesh->GetVertexQuantization();
+				shaderData.positionOffset = DirectX::XMFLOAT3(quantization.Offset);
+				shaderData.positionScale = DirectX::XMFLOAT3(quantization.Scale);
+			}
 			D3D12_GPU_DESCRIPTOR_HANDLE cbvHandle = Graphics::FillNextConstantBufferAndGetGPUDescriptorHandle(&shaderData, sizeof(VertexShaderExternalData));
 			Graphics::CommandList->SetGraphicsRootDescriptorTable(0, cbvHandle);
 
@@ -37,6 +37,7 @@ private:
 	// Pipeline
 	Microsoft::WRL::ComPtr<ID3D12RootSignature> rootSignature;
 	Microsoft::WRL::ComPtr<ID3D12PipelineState> pipelineState;
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> packedPipelineState; // For meshes with packed vertices
 
 	// Geometry
 	Microsoft::WRL::ComPtr<ID3D12Resource> vertexBuffer;
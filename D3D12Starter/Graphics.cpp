@@ -498,7 +498,7 @@ void Graphics::ResizeBuffers(unsigned int width, unsigned int height)
 // data - Pointer to the data itself
 // --------------------------------------------------------
 Microsoft::WRL::ComPtr<ID3D12Resource> Graphics::CreateStaticBuffer(
-	size_t dataStride, size_t dataCount, void* data)
+	size_t dataStride, size_t dataCount, const void* data)
 {
 	// Creates a temporary command allocator and list so we don't
 	// screw up any other ongoing work (since resetting a command allocator
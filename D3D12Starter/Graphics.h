@@ -76,7 +76,7 @@ namespace Graphics
 
 	// Resource creation
 	Microsoft::WRL::ComPtr<ID3D12Resource> CreateStaticBuffer(
-		size_t dataStride, size_t dataCount, void* data);
+		size_t dataStride, size_t dataCount, const void* data);
 
 	// Constant buffer handling
 	D3D12_GPU_DESCRIPTOR_HANDLE FillNextConstantBufferAndGetGPUDescriptorHandle(
@@ -1,7 +1,11 @@
 #include "Mesh.h"
 #include "Graphics.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "ObjParser.h"
+#include "VertexPacking.h"
 #include <Windows.h>
-#include <fstream>
+#include <cstdio>
 #include <vector>
 #include <DirectXMath.h>
 #include <string>
@@ -15,232 +19,128 @@ Mesh::Mesh(std::string name, Vertex* vertices, int numVertices, unsigned int* in
 	CreateBuffers(vertices, numVertices, indices, numIndices);
 }
 
-Mesh::Mesh(std::string name, const wchar_t* filename) :
+Mesh::Mesh(std::string name, const wchar_t* filename, bool packVertices) :
 	name(name)
 {
 	numVertices = 0;
 	numIndices = 0;
+	packedVertices = packVertices;
 
-	// ========================================
-	// Load vertices from OBJ file [[ NOT MY CODE ]]
-	// 
-	// Author: Chris Cascioli
-	// Purpose: Basic .OBJ 3D model loading, supporting positions, uvs and normals
+	// Use the binary cache of the file's final vertices and indices
+	// if it's still current (see MeshCache.h), straight from the
+	// mapped file, which can be closed once the buffers exist
+	MeshCache cache;
+	if (cache.Open(filename, packedVertices ? sizeof(PackedVertex) : sizeof(Vertex)))
+	{
+		numVertices = (int)cache.VertexCount();
+		numIndices = (int)cache.IndexCount();
+		printf("Mesh %s: %d triangles, %d vertices from its mesh cache\n", name.c_str(), numIndices / 3, numVertices);
 
-	#pragma region Vertex Loading Code by Chris Cascioli
+		// The cache's bounds are the ones the positions were packed across
+		if (packedVertices)
+			quantization = QuantizeBounds(cache.Header().BoundsMin, cache.Header().BoundsMax);
 
-	// File input object
-	std::ifstream obj(filename);
+		CreateBuffers(cache.Vertices(), numVertices, cache.Indices(), numIndices);
+		return;
+	}
 
-	// Check for successful open
-	if (!obj.is_open())
+	// Parse the file, which also splits every face into triangles
+	ObjData obj;
+	if (!LoadObj(filename, obj) || obj.Corners.empty())
 		return;
 
-	// Variables used while reading the file
-	std::vector<DirectX::XMFLOAT3> positions;	// Positions from the file
-	std::vector<DirectX::XMFLOAT3> normals;		// Normals from the file
-	std::vector<DirectX::XMFLOAT2> uvs;		// UVs from the file
-	std::vector<Vertex> verts;		// Verts we're assembling
-	std::vector<UINT> indices;		// Indices of these verts
-	int vertCounter = 0;			// Count of vertices
-	int indexCounter = 0;			// Count of indices
-	char chars[100];			// String for line reading
-
-	// Still have data left?
-	while (obj.good())
+	// Build one vertex per distinct corner
+	// - OBJ files index positions, uvs and normals separately, so corners
+	//    with the same three indices are welded into one vertex, which the
+	//    index buffer then refers to from every triangle using it
+	// - The model is most likely in a right-handed space, especially if it
+	//    came from Maya.  We want a left-handed space for DirectX, so we
+	//    invert the Z of positions and normals and flip the winding order
+	// - UVs are flipped vertically too, since DirectX defines (0,0) as the
+	//    top left of the texture, and many 3D modeling packages use the
+	//    bottom left
+	// - Corners without uvs get (0,0), and corners without normals get
+	//    their triangle's face normal
+	std::vector<ObjCorner> corners;
+	std::vector<unsigned int> indices;
+	WeldObjCorners(obj, corners, indices);
+
+	std::vector<Vertex> verts(corners.size());
+	for (size_t i = 0; i < corners.size(); i++)
 	{
-		// Get the line (100 characters should be more than enough)
-		obj.getline(chars, 100);
+		const ObjCorner& corner = corners[i];
+		Vertex& v = verts[i];
 
-		// Check the type of line
-		if (chars[0] == 'v' && chars[1] == 'n')
-		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			DirectX::XMFLOAT3 norm;
-			sscanf_s(
-				chars,
-				"vn %f %f %f",
-				&norm.x, &norm.y, &norm.z);
-
-			// Add to the list of normals
-			normals.push_back(norm);
-		}
-		else if (chars[0] == 'v' && chars[1] == 't')
-		{
-			// Read the 2 numbers directly into an XMFLOAT2
-			DirectX::XMFLOAT2 uv;
-			sscanf_s(
-				chars,
-				"vt %f %f",
-				&uv.x, &uv.y);
-
-			// Add to the list of uv's
-			uvs.push_back(uv);
-		}
-		else if (chars[0] == 'v')
+		ObjFloat3 pos = obj.Positions[corner.Position];
+		v.Position = DirectX::XMFLOAT3(pos.x, pos.y, -pos.z);
+
+		ObjFloat2 uv = corner.UV >= 0 ? obj.UVs[corner.UV] : ObjFloat2{ 0, 0 };
+		v.UV = DirectX::XMFLOAT2(uv.x, 1.0f - uv.y);
+
+		if (corner.Normal >= 0)
 		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			DirectX::XMFLOAT3 pos;
-			sscanf_s(
-				chars,
-				"v %f %f %f",
-				&pos.x, &pos.y, &pos.z);
-
-			// Add to the positions
-			positions.push_back(pos);
+			ObjFloat3 norm = obj.Normals[corner.Normal];
+			v.Normal = DirectX::XMFLOAT3(norm.x, norm.y, -norm.z);
 		}
-		else if (chars[0] == 'f')
-		{
-			// Read the face indices into an array
-			// NOTE: This assumes the given obj file contains
-			//  vertex positions, uv coordinates AND normals.
-			unsigned int i[12];
-			int numbersRead = sscanf_s(
-				chars,
-				"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
-				&i[0], &i[1], &i[2],
-				&i[3], &i[4], &i[5],
-				&i[6], &i[7], &i[8],
-				&i[9], &i[10], &i[11]);
-
-			// If we only got the first number, chances are the OBJ
-			// file has no UV coordinates.  This isn't great, but we
-			// still want to load the model without crashing, so we
-			// need to re-read a different pattern (in which we assume
-			// there are no UVs denoted for any of the vertices)
-			if (numbersRead == 1)
-			{
-				// Re-read with a different pattern
-				numbersRead = sscanf_s(
-					chars,
-					"f %d//%d %d//%d %d//%d %d//%d",
-					&i[0], &i[2],
-					&i[3], &i[5],
-					&i[6], &i[8],
-					&i[9], &i[11]);
-
-				// The following indices are where the UVs should 
-				// have been, so give them a valid value
-				i[1] = 1;
-				i[4] = 1;
-				i[7] = 1;
-				i[10] = 1;
-
-				// If we have no UVs, create a single UV coordinate
-				// that will be used for all vertices
-				if (uvs.size() == 0)
-					uvs.push_back(DirectX::XMFLOAT2(0, 0));
-			}
+	}
 
-			// - Create the verts by looking up
-			//    corresponding data from vectors
-			// - OBJ File indices are 1-based, so
-			//    they need to be adusted
-			Vertex v1;
-			v1.Position = positions[i[0] - 1];
-			v1.UV = uvs[i[1] - 1];
-			v1.Normal = normals[i[2] - 1];
-
-			Vertex v2;
-			v2.Position = positions[i[3] - 1];
-			v2.UV = uvs[i[4] - 1];
-			v2.Normal = normals[i[5] - 1];
-
-			Vertex v3;
-			v3.Position = positions[i[6] - 1];
-			v3.UV = uvs[i[7] - 1];
-			v3.Normal = normals[i[8] - 1];
-
-			// The model is most likely in a right-handed space,
-			// especially if it came from Maya.  We want to convert
-			// to a left-handed space for DirectX.  This means we 
-			// need to:
-			//  - Invert the Z position
-			//  - Invert the normal's Z
-			//  - Flip the winding order
-			// We also need to flip the UV coordinate since DirectX
-			// defines (0,0) as the top left of the texture, and many
-			// 3D modeling packages use the bottom left as (0,0)
-
-			// Flip the UV's since they're probably "upside down"
-			v1.UV.y = 1.0f - v1.UV.y;
-			v2.UV.y = 1.0f - v2.UV.y;
-			v3.UV.y = 1.0f - v3.UV.y;
-
-			// Flip Z (LH vs. RH)
-			v1.Position.z *= -1.0f;
-			v2.Position.z *= -1.0f;
-			v3.Position.z *= -1.0f;
-
-			// Flip normal's Z
-			v1.Normal.z *= -1.0f;
-			v2.Normal.z *= -1.0f;
-			v3.Normal.z *= -1.0f;
-
-			// Add the verts to the vector (flipping the winding order)
-			verts.push_back(v1);
-			verts.push_back(v3);
-			verts.push_back(v2);
-			vertCounter += 3;
-
-			// Add three more indices
-			indices.push_back(indexCounter); indexCounter += 1;
-			indices.push_back(indexCounter); indexCounter += 1;
-			indices.push_back(indexCounter); indexCounter += 1;
-
-			// Was there a 4th face?
-			// - 12 numbers read means 4 faces WITH uv's
-			// - 8 numbers read means 4 faces WITHOUT uv's
-			if (numbersRead == 12 || numbersRead == 8)
+	for (size_t t = 0; t < indices.size(); t += 3)
+	{
+		// Flip the winding order
+		std::swap(indices[t + 1], indices[t + 2]);
+
+		// Unwelded corners without a normal belong to this triangle alone
+		bool missingNormal = false;
+		for (size_t k = 0; k < 3; k++)
+			missingNormal |= corners[indices[t + k]].Normal < 0;
+		if (missingNormal)
+		{
+			DirectX::XMVECTOR p0 = XMLoadFloat3(&verts[indices[t]].Position);
+			DirectX::XMVECTOR faceNormal = DirectX::XMVector3Normalize(DirectX::XMVector3Cross(
+				DirectX::XMVectorSubtract(XMLoadFloat3(&verts[indices[t + 1]].Position), p0),
+				DirectX::XMVectorSubtract(XMLoadFloat3(&verts[indices[t + 2]].Position), p0)));
+			for (size_t k = 0; k < 3; k++)
 			{
-				// Make the last vertex
-				Vertex v4;
-				v4.Position = positions[i[9] - 1];
-				v4.UV = uvs[i[10] - 1];
-				v4.Normal = normals[i[11] - 1];
-
-				// Flip the UV, Z pos and normal's Z
-				v4.UV.y = 1.0f - v4.UV.y;
-				v4.Position.z *= -1.0f;
-				v4.Normal.z *= -1.0f;
-
-				// Add a whole triangle (flipping the winding order)
-				verts.push_back(v1);
-				verts.push_back(v4);
-				verts.push_back(v3);
-				vertCounter += 3;
-
-				// Add three more indices
-				indices.push_back(indexCounter); indexCounter += 1;
-				indices.push_back(indexCounter); indexCounter += 1;
-				indices.push_back(indexCounter); indexCounter += 1;
+				if (corners[indices[t + k]].Normal < 0)
+					XMStoreFloat3(&verts[indices[t + k]].Normal, faceNormal);
 			}
 		}
 	}
 
-	// Close the file and create the actual buffers
-	obj.close();
-
-	// - At this point, "verts" is a vector of Vertex structs, and can be used
-	//    directly to create a vertex buffer:  &verts[0] is the address of the first vert
-	//
-	// - The vector "indices" is similar. It's a vector of unsigned ints and
-	//    can be used directly for the index buffer: &indices[0] is the address of the first int
-	//
-	// - "vertCounter" is the number of vertices
-	// - "indexCounter" is the number of indices
-	// - Yes, these are effectively the same since OBJs do not index entire vertices!  This means
-	//    an index buffer isn't doing much for us.  We could try to optimize the mesh ourselves
-	//    and detect duplicate vertices, but at that point it would be better to use a more
-	//    sophisticated model loading library like TinyOBJLoader or The Open Asset Importer Library
-	#pragma endregion 	
-
-	// ========================================
-	
-	numVertices = vertCounter;
-	numIndices = indexCounter;
+	// Reorder for the GPU (see MeshOptimizer.h): triangles for the
+	// post-transform vertex cache, then runs of them for overdraw,
+	// then the vertices themselves in the order they're first used
+	OptimizeVertexCache(&indices[0], indices.size(), verts.size());
+	OptimizeOverdraw(&indices[0], indices.size(), &verts[0].Position.x, sizeof(Vertex), verts.size());
+	std::vector<unsigned int> remap;
+	OptimizeVertexFetch(&indices[0], indices.size(), verts.size(), remap);
+	RemapVertices(verts, remap);
+
+	// Report what welding saved over a vertex per corner
+	printf("Mesh %s: %zu triangles, %zu vertices instead of %zu (%.1f KB less vertex data)\n",
+		name.c_str(), indices.size() / 3, verts.size(), indices.size(),
+		(indices.size() - verts.size()) * sizeof(Vertex) / 1024.0);
+
+	numVertices = (int)verts.size();
+	numIndices = (int)indices.size();
 
 	CalculateTangents(&verts[0], numVertices, &indices[0], numIndices);
+
+	// Pack the finished vertices, if asked, keeping the bounds
+	// they're packed across in the cache
+	if (packedVertices)
+	{
+		std::vector<PackedVertex> packed(verts.size());
+		float bounds[6];
+		PackVertices(&verts[0].Position.x, sizeof(Vertex), verts.size(), &packed[0], bounds, bounds + 3);
+		quantization = QuantizeBounds(bounds, bounds + 3);
+
+		WriteMeshCache(filename, &packed[0], sizeof(PackedVertex), packed.size(), &indices[0], indices.size(), bounds);
+		CreateBuffers(&packed[0], numVertices, &indices[0], numIndices);
+		return;
+	}
+
+	WriteMeshCache(filename, &verts[0], sizeof(Vertex), verts.size(), &indices[0], indices.size());
 	CreateBuffers(&verts[0], numVertices, &indices[0], numIndices);
 }
 
@@ -337,18 +237,19 @@ void Mesh::CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices,
 
 
 void Mesh::CreateBuffers(
-	void* vertices,
+	const void* vertices,
 	int numVertices,
-	void* indices,
+	const void* indices,
 	int numIndices
 ) {
 	// Create the two buffers
-	vertexBuffer = Graphics::CreateStaticBuffer(sizeof(Vertex), numVertices, vertices);
+	UINT vertexSize = packedVertices ? sizeof(PackedVertex) : sizeof(Vertex);
+	vertexBuffer = Graphics::CreateStaticBuffer(vertexSize, numVertices, vertices);
 	indexBuffer = Graphics::CreateStaticBuffer(sizeof(unsigned int), numIndices, indices);
 
 	// Set up the views
-	vbView.StrideInBytes = sizeof(Vertex);
-	vbView.SizeInBytes = sizeof(Vertex) * numVertices;
+	vbView.StrideInBytes = vertexSize;
+	vbView.SizeInBytes = vertexSize * numVertices;
 	vbView.BufferLocation = vertexBuffer->GetGPUVirtualAddress();
 
 	ibView.Format = DXGI_FORMAT_R32_UINT;
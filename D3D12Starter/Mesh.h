@@ -5,6 +5,7 @@
 #include <string>
 
 #include "Vertex.h"
+#include "VertexPacking.h"
 
 class Mesh {
 	
@@ -18,7 +19,8 @@ public:
 	);
 	Mesh(
 		std::string name,
-		const wchar_t* filename
+		const wchar_t* filename,
+		bool packVertices = false
 	);
 	~Mesh();
 
@@ -29,12 +31,19 @@ public:
 	int GetIndexCount();
 	std::string GetName();
 
+	// Packed meshes hold PackedVertex instead of Vertex (see VertexPacking.h)
+	bool HasPackedVertices() { return packedVertices; }
+	VertexQuantization GetVertexQuantization() { return quantization; }
+
 private:
 	std::string name = "MyMesh";
 
 	int numVertices;
 	int numIndices;
 
+	bool packedVertices = false;
+	VertexQuantization quantization{};
+
 	Microsoft::WRL::ComPtr<ID3D12Resource> vertexBuffer;
 	D3D12_VERTEX_BUFFER_VIEW vbView{};
 	Microsoft::WRL::ComPtr<ID3D12Resource> indexBuffer;
@@ -42,9 +51,9 @@ private:
 
 	void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
 	void CreateBuffers(
-		void* vertices, 
+		const void* vertices, 
 		int numVertices, 
-		void* indices, 
+		const void* indices, 
 		int numIndices
 	);
 };
\ No newline at end of file
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// --------------------------------------------------------
+// Triangle and vertex reordering for faster drawing,
+// independent of D3D
+//
+// Run the passes in this order, on an indexed triangle list:
+//  1. OptimizeVertexCache - reorders triangles so vertices are
+//     reused while still in the post-transform cache
+//  2. OptimizeOverdraw - reorders runs of those triangles so
+//     outward-facing parts tend to draw first, without giving
+//     up much of the cache locality
+//  3. OptimizeVertexFetch + RemapVertices - renumbers vertices
+//     in the order the triangles first use them
+//
+// None of them change what is drawn, only the order.
+// --------------------------------------------------------
+
+// How well an index order uses a FIFO post-transform cache of
+// the given size:
+//  - ACMR: vertex shader runs per triangle (0.5 at best, 3 at worst)
+//  - ATVR: vertex shader runs per vertex (1 at best)
+struct VertexCacheStats
+{
+	float ACMR;
+	float ATVR;
+};
+
+VertexCacheStats AnalyzeVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount, size_t cacheSize = 16);
+
+// Tom Forsyth's "Linear-Speed Vertex Cache Optimisation":
+// greedily emits the best-scoring triangle next to the ones
+// just drawn, scoring vertices by cache position and by how
+// few triangles still need them
+void OptimizeVertexCache(unsigned int* indices, size_t indexCount, size_t vertexCount);
+
+// Sander, Nehab and Barczak's "Fast Triangle Reordering for
+// Vertex Locality and Reduced Overdraw": splits the cache
+// ordered triangles into clusters where the cache starts over,
+// and sorts the clusters to draw outward-facing ones first.
+// Positions are read as three floats every positionStride
+// bytes.  Keeps the original order if the sort would raise
+// the ACMR by more than the given factor.
+void OptimizeOverdraw(
+	unsigned int* indices,
+	size_t indexCount,
+	const float* positions,
+	size_t positionStride,
+	size_t vertexCount,
+	float threshold = 1.05f);
+
+// Renumbers vertices in the order the indices first use them,
+// rewriting the indices.  remap gets each old vertex's new
+// number; unused vertices move to the end.
+void OptimizeVertexFetch(unsigned int* indices, size_t indexCount, size_t vertexCount, std::vector<unsigned int>& remap);
+
+// Moves each vertex to its new number from OptimizeVertexFetch
+template<typename T>
+void RemapVertices(std::vector<T>& vertices, const std::vector<unsigned int>& remap)
+{
+	std::vector<T> remapped(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++)
+		remapped[remap[i]] = vertices[i];
+	vertices.swap(remapped);
+}
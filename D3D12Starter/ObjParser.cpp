@@ -0,0 +1,297 @@
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+#include "ObjParser.h"
+
+namespace
+{
+	// --------------------------------------------------------
+	// The rest of one line of the file, read from left to right
+	// --------------------------------------------------------
+	struct LineReader
+	{
+		const char* c;
+		const char* end;	// Where the line's newline (or the text) ends
+
+		void SkipSpace()
+		{
+			while (c < end && (*c == ' ' || *c == '\t' || *c == '\r'))
+				c++;
+		}
+
+		bool ReadFloat(float& value)
+		{
+			SkipSpace();
+			if (c < end && *c == '+')
+				c++;	// from_chars takes no plus sign
+
+			std::from_chars_result result = std::from_chars(c, end, value);
+			if (result.ptr == c)
+				return false;
+
+			// Values too small for a float come back out of range; they're zero
+			if (result.ec == std::errc::result_out_of_range)
+				value = 0.0f;
+
+			c = result.ptr;
+			return true;
+		}
+
+		bool ReadInt(long long& value)
+		{
+			// Hand-rolled, since indices are short and this is the hot loop for faces
+			bool negative = c < end && *c == '-';
+			const char* digits = (negative || (c < end && *c == '+')) ? c + 1 : c;
+			const char* p = digits;
+			long long result = 0;
+			while (p < end && *p >= '0' && *p <= '9' && result < (1ll << 40))
+				result = result * 10 + (*p++ - '0');
+			if (p == digits)
+				return false;
+
+			value = negative ? -result : result;
+			c = p;
+			return true;
+		}
+	};
+
+	// Turns a 1-based or negative (counted back from the end) index
+	// into a 0-based one, or -1 if it doesn't refer to an element
+	int ResolveIndex(long long index, size_t count)
+	{
+		long long resolved = index < 0 ? (long long)count + index : index - 1;
+		return (index != 0 && resolved >= 0 && resolved < (long long)count) ? (int)resolved : -1;
+	}
+
+	size_t HashCorner(const ObjCorner& corner)
+	{
+		// Multiplicative mixing of the three indices; the table takes the high bits
+		uint64_t h = (uint64_t)(uint32_t)corner.Position * 0x9E3779B97F4A7C15ull;
+		h = (h ^ (uint32_t)corner.UV) * 0xC2B2AE3D27D4EB4Full;
+		h = (h ^ (uint32_t)corner.Normal) * 0x165667B19E3779F9ull;
+		return (size_t)(h >> 32);
+	}
+
+	bool SameCorner(const ObjCorner& a, const ObjCorner& b)
+	{
+		return a.Position == b.Position && a.UV == b.UV && a.Normal == b.Normal;
+	}
+}
+
+
+// --------------------------------------------------------
+// Parses OBJ text, one line at a time, straight out of the
+// given buffer
+//
+// - "v", "vt" and "vn" lines add to the element arrays
+// - "f" lines list corners as v, v/vt, v//vn or v/vt/vn,
+//   and are split into triangles (0, k-1, k) around their
+//   first corner
+// --------------------------------------------------------
+bool ParseObj(const char* text, size_t length, ObjData& data, std::string* error)
+{
+	data = ObjData();
+
+	const char* c = text;
+	const char* textEnd = text + length;
+	size_t lineNumber = 0;
+
+	auto fail = [&](const char* message)
+	{
+		if (error)
+			*error = "line " + std::to_string(lineNumber) + ": " + message;
+		return false;
+	};
+
+	while (c < textEnd)
+	{
+		lineNumber++;
+		const char* lineEnd = static_cast<const char*>(std::memchr(c, '\n', (size_t)(textEnd - c)));
+		if (!lineEnd)
+			lineEnd = textEnd;
+
+		LineReader line{ c, lineEnd };
+		c = lineEnd < textEnd ? lineEnd + 1 : textEnd;
+
+		line.SkipSpace();
+		if (line.end - line.c < 2)
+			continue;
+
+		// Check the type of line by its keyword
+		const char* k = line.c;
+		auto spaceAt = [&](int offset) { return k + offset < line.end && (k[offset] == ' ' || k[offset] == '\t'); };
+
+		if (k[0] == 'v' && spaceAt(1))
+		{
+			line.c += 2;
+			ObjFloat3 pos{};
+			if (!line.ReadFloat(pos.x) || !line.ReadFloat(pos.y) || !line.ReadFloat(pos.z))
+				return fail("expected three numbers for a position");
+			data.Positions.push_back(pos);
+		}
+		else if (k[0] == 'v' && k[1] == 't' && spaceAt(2))
+		{
+			// The second coordinate (and a third, for 3D textures) is optional
+			line.c += 3;
+			ObjFloat2 uv{};
+			if (!line.ReadFloat(uv.x))
+				return fail("expected a number for a uv coordinate");
+			line.ReadFloat(uv.y);
+			data.UVs.push_back(uv);
+		}
+		else if (k[0] == 'v' && k[1] == 'n' && spaceAt(2))
+		{
+			line.c += 3;
+			ObjFloat3 norm{};
+			if (!line.ReadFloat(norm.x) || !line.ReadFloat(norm.y) || !line.ReadFloat(norm.z))
+				return fail("expected three numbers for a normal");
+			data.Normals.push_back(norm);
+		}
+		else if (k[0] == 'f' && spaceAt(1))
+		{
+			line.c += 2;
+			ObjCorner first{}, previous{};
+			int cornerCount = 0;
+
+			while (true)
+			{
+				line.SkipSpace();
+				long long v = 0, vt = 0, vn = 0;
+				if (!line.ReadInt(v))
+					break;
+				if (line.c < line.end && *line.c == '/')
+				{
+					line.c++;
+					line.ReadInt(vt);	// Absent in "v//vn"
+					if (line.c < line.end && *line.c == '/')
+					{
+						line.c++;
+						if (!line.ReadInt(vn))
+							return fail("expected a normal index after '//'");
+					}
+				}
+
+				ObjCorner corner{
+					ResolveIndex(v, data.Positions.size()),
+					vt != 0 ? ResolveIndex(vt, data.UVs.size()) : -1,
+					vn != 0 ? ResolveIndex(vn, data.Normals.size()) : -1 };
+				if (corner.Position < 0 || (vt != 0 && corner.UV < 0) || (vn != 0 && corner.Normal < 0))
+					return fail("face refers to an element that doesn't exist");
+
+				// Every corner past the second completes another triangle of the fan
+				if (cornerCount == 0)
+					first = corner;
+				else if (cornerCount >= 2)
+				{
+					data.Corners.push_back(first);
+					data.Corners.push_back(previous);
+					data.Corners.push_back(corner);
+				}
+				previous = corner;
+				cornerCount++;
+			}
+
+			line.SkipSpace();
+			if (line.c != line.end)
+				return fail("unexpected text in a face");
+			if (cornerCount < 3)
+				return fail("face has fewer than three corners");
+		}
+	}
+
+	return true;
+}
+
+
+// --------------------------------------------------------
+// Reads a whole .obj file in one block and parses it
+// --------------------------------------------------------
+bool LoadObj(const std::filesystem::path& path, ObjData& data, std::string* error)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+	{
+		if (error)
+			*error = "could not open file";
+		return false;
+	}
+
+	std::string text((size_t)file.tellg(), '\0');
+	file.seekg(0);
+	if (!file.read(text.data(), (std::streamsize)text.size()))
+	{
+		if (error)
+			*error = "could not read file";
+		return false;
+	}
+
+	return ParseObj(text.data(), text.size(), data, error);
+}
+
+
+// --------------------------------------------------------
+// Welds identical corners with an open-addressing hash table
+// of vertex numbers, keyed by the corners' index triples
+//
+// - Linear probing over a power-of-two table, kept at most
+//   half full, so a lookup is usually one or two probes
+// - The table starts at twice the largest element array,
+//   which is close to the vertex count of most meshes
+// --------------------------------------------------------
+void WeldObjCorners(const ObjData& data, std::vector<ObjCorner>& vertices, std::vector<unsigned int>& indices)
+{
+	const unsigned int empty = 0xFFFFFFFFu;
+
+	vertices.clear();
+	indices.resize(data.Corners.size());
+
+	size_t expected = std::max(data.Positions.size(), std::max(data.UVs.size(), data.Normals.size()));
+	size_t capacity = 64;
+	while (capacity < 2 * expected)
+		capacity *= 2;
+	std::vector<unsigned int> table(capacity, empty);
+
+	for (size_t i = 0; i < data.Corners.size(); i++)
+	{
+		const ObjCorner& corner = data.Corners[i];
+		if (corner.Normal < 0)
+		{
+			indices[i] = (unsigned int)vertices.size();
+			vertices.push_back(corner);
+			continue;
+		}
+
+		size_t slot = HashCorner(corner) & (capacity - 1);
+		while (table[slot] != empty && !SameCorner(vertices[table[slot]], corner))
+			slot = (slot + 1) & (capacity - 1);
+
+		if (table[slot] != empty)
+		{
+			indices[i] = table[slot];
+			continue;
+		}
+
+		// A new vertex
+		indices[i] = table[slot] = (unsigned int)vertices.size();
+		vertices.push_back(corner);
+
+		// Keep the table at most half full, rehashing into one twice the size
+		if (2 * vertices.size() > capacity)
+		{
+			capacity *= 2;
+			table.assign(capacity, empty);
+			for (unsigned int v = 0; v < (unsigned int)vertices.size(); v++)
+			{
+				if (vertices[v].Normal < 0)
+					continue;
+				size_t s = HashCorner(vertices[v]) & (capacity - 1);
+				while (table[s] != empty)
+					s = (s + 1) & (capacity - 1);
+				table[s] = v;
+			}
+		}
+	}
+}
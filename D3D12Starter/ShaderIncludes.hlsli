@@ -10,6 +10,15 @@ struct VertexShaderInput
     float3 tangent : TANGENT;
 };
 
+// Struct representing a single packed vertex (see VertexPacking.h),
+// which the input assembler has already turned into floats
+struct VertexShaderInputPacked
+{
+    float4 localPosition : POSITION; // XYZ snorm across the mesh's bounds
+    float2 uv : TEXCOORD;
+    float4 normalTangent : NORMAL; // Octahedral normal (xy) and tangent (zw)
+};
+
 // Struct representing the data we're sending down the pipeline
 struct VertexToPixel
 {
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// --------------------------------------------------------
+// A 16 byte vertex layout for meshes, in place of the 44
+// byte Vertex, independent of D3D
+//
+// - Position: 16-bit snorm per axis, spanning the mesh's
+//   bounds, which VertexQuantization maps back to (DXGI
+//   R16G16B16A16_SNORM, with w unused; snorm rather than
+//   unorm, since raytracing takes it at any DXR tier)
+// - UV: half floats (R16G16_FLOAT)
+// - Normal and tangent: octahedral, with two 8-bit snorm
+//   components each (R8G8B8A8_SNORM: normal in xy, tangent
+//   in zw)
+//
+// Largest errors after packing and unpacking:
+// - Position: about half a step, 1/131068 of the mesh's size
+//   on each axis
+// - UV: 1/2048 of the value (1/4096 across [0.5, 1]); past
+//   half float's range of 65504 they clamp
+// - Normal and tangent: 0.64 degrees (0.32 on average), since
+//   the encoder picks whichever neighboring 8-bit point decodes
+//   closest; plain rounding would allow 0.95
+// --------------------------------------------------------
+
+struct PackedVertex
+{
+	int16_t Position[4];
+	uint16_t UV[2];
+	int8_t Normal[2];
+	int8_t Tangent[2];
+};
+
+// Maps snorm positions back to the mesh: offset + snorm * scale,
+// so the bounds' center and half their size
+struct VertexQuantization
+{
+	float Offset[3];
+	float Scale[3];
+};
+
+uint16_t FloatToHalf(float value);
+float HalfToFloat(uint16_t half);
+
+// Unit vectors to and from octahedral 8-bit snorm, decoded the way
+// the GPU reads snorm (c / 127)
+void OctEncode(const float vector[3], int8_t encoded[2]);
+void OctDecode(const int8_t encoded[2], float vector[3]);
+
+// The quantization that spans the given bounds
+VertexQuantization QuantizeBounds(const float boundsMin[3], const float boundsMax[3]);
+
+// Packs vertices laid out like Vertex (position, uv, normal and
+// tangent, as floats) every vertexStride bytes, quantizing their
+// positions across their own bounds, which come back in boundsMin
+// and boundsMax for QuantizeBounds
+void PackVertices(
+	const float* vertices,
+	size_t vertexStride,
+	size_t vertexCount,
+	PackedVertex* packed,
+	float boundsMin[3],
+	float boundsMax[3]);
+
+// Unpacks one vertex into 11 floats, laid out like Vertex
+void UnpackVertex(const PackedVertex& packed, const VertexQuantization& quantization, float vertex[11]);
@@ -0,0 +1,51 @@
+#include "ShaderIncludes.hlsli"
+
+// Struct representing data from a constant buffer
+cbuffer ExternalData : register(b0)
+{
+    matrix world;
+    matrix view;
+    matrix projection;
+    matrix worldInvTranspose;
+    float3 positionOffset;
+    float pad0;
+    float3 positionScale;
+    float pad1;
+}
+
+// Unit vector from its octahedral encoding (OctDecode in VertexPacking.cpp)
+float3 OctDecode(float2 encoded)
+{
+    float3 v = float3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+    if (v.z < 0)
+    {
+        float2 signs = float2(v.x >= 0 ? 1.0f : -1.0f, v.y >= 0 ? 1.0f : -1.0f);
+        v.xy = (1.0f - abs(v.yx)) * signs;
+    }
+    return normalize(v);
+}
+
+// --------------------------------------------------------
+// The vertex shader for meshes with packed vertices
+// 
+// - Same as VertexShader.hlsl once the vertex is decoded:
+//   positions are scaled back out of the mesh's bounds, and
+//   normals and tangents unfolded from the octahedron
+// --------------------------------------------------------
+VertexToPixel main( VertexShaderInputPacked input )
+{
+	VertexToPixel output;
+	
+    float3 localPosition = positionOffset + input.localPosition.xyz * positionScale;
+    float3 normal = OctDecode(input.normalTangent.xy);
+    float3 tangent = OctDecode(input.normalTangent.zw);
+
+    matrix wvp = mul(projection, mul(view, world));
+    output.screenPosition = mul(wvp, float4(localPosition, 1.0f));
+    output.uv = input.uv;
+    output.normal = mul((float3x3) worldInvTranspose, normal);
+    output.tangent = mul((float3x3) world, tangent);
+    output.worldPosition = mul(world, float4(localPosition, 1.0f)).xyz;
+
+	return output;
+}
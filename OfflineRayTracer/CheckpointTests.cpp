@@ -0,0 +1,115 @@
+// Checks for progressive checkpoints (camera::render_progressive, accumulation_buffer.h).
+//
+// A console program of its own, not part of the renderer. Build and run it with, for example:
+//
+//   g++ -O2 -std=c++17 -pthread CheckpointTests.cpp -o checkpoint_tests
+//   ./checkpoint_tests
+//
+// A finished checkpoint of N samples per pixel, extended by a render of 2N, must give exactly
+// the image of a fresh 2N render, since the samples are drawn and added in the same order.
+// Extending is allowed only for samplers whose numbers do not depend on the target sample
+// count, and only when every stored pass was a full one; other checkpoints must be ignored.
+// The images are written as float maps to the temp directory. Exits nonzero if any check fails.
+
+#include "offlineRT.h"
+
+#include "camera.h"
+#include "hittable_list.h"
+#include "material.h"
+#include "sphere.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+struct test_scene {
+    test_scene() {
+        world.add(make_shared<sphere>(point3(0, -100.5, -1), 100, materials.add(lambertian(color(0.5, 0.5, 0.5)))));
+        world.add(make_shared<sphere>(point3(-1, 0, -1), 0.5, materials.add(dielectric(1.5))));
+        world.add(make_shared<sphere>(point3(0, 0, -1), 0.5, materials.add(lambertian(color(0.1, 0.2, 0.5)))));
+        world.add(make_shared<sphere>(point3(1, 0, -1), 0.5, materials.add(metal(color(0.8, 0.6, 0.2), 0.2))));
+    }
+
+    material_library materials;
+    hittable_list world;
+};
+
+std::string temp_file(const std::string& name) {
+    return (std::filesystem::temp_directory_path() / ("checkpoint_tests_" + name)).string();
+}
+
+std::string read_file(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+std::string render(const test_scene& scene, sampler_type sampling, int samples_per_pixel,
+                   const std::string& checkpoint_path, std::string& log) {
+    // Renders the scene in passes of two samples and returns the image file's contents, with
+    // what the camera logged in `log`.
+    camera cam;
+    cam.image_width = 48;
+    cam.aspect_ratio = 4.0 / 3.0;
+    cam.max_depth = 8;
+    cam.thread_count = 2;
+    cam.tile_size = 16;
+    cam.sampling = sampling;
+    cam.samples_per_pixel = samples_per_pixel;
+    cam.samples_per_pass = 2;
+    cam.checkpoint_path = checkpoint_path;
+    cam.output_format = image_format::pfm;
+    cam.output_path = temp_file("image.pfm");
+
+    std::ostringstream captured;
+    auto previous = std::clog.rdbuf(captured.rdbuf());
+    cam.render(scene.world, scene.materials);
+    std::clog.rdbuf(previous);
+
+    log = captured.str();
+    return read_file(cam.output_path);
+}
+
+bool check_extend(const test_scene& scene, sampler_type sampling, const char* name, int first_samples,
+                  bool extends) {
+    // Renders `first_samples` into a fresh checkpoint, then 8 samples from it, and compares
+    // the result with 8 samples rendered without one.
+    auto checkpoint = temp_file("snapshot.ortc");
+    std::filesystem::remove(checkpoint);
+
+    std::string log;
+    render(scene, sampling, first_samples, checkpoint, log);
+    auto extended = render(scene, sampling, 8, checkpoint, log);
+    bool resumed = log.find("Resuming from") != std::string::npos;
+    std::filesystem::remove(checkpoint);
+
+    std::string fresh_log;
+    auto fresh = render(scene, sampling, 8, "", fresh_log);
+
+    bool pass = !fresh.empty() && extended == fresh && resumed == extends;
+    std::printf("%s  %s, %d then 8 samples: %s, %s\n", pass ? "ok  " : "FAIL", name, first_samples,
+                resumed ? "extended" : "started over", extended == fresh ? "same image" : "DIFFERENT IMAGE");
+    return pass;
+}
+
+int main() {
+    test_scene scene;
+    bool pass = true;
+
+    pass &= check_extend(scene, sampler_type::pcg32, "pcg32", 4, true);
+    pass &= check_extend(scene, sampler_type::counter, "counter", 4, true);
+
+    // The strata are laid out over the target sample count, so these start over.
+    pass &= check_extend(scene, sampler_type::stratified, "stratified", 4, false);
+    pass &= check_extend(scene, sampler_type::sobol, "sobol", 4, false);
+
+    // The last of 3 samples in passes of 2 was a short pass, which a longer render would not have.
+    pass &= check_extend(scene, sampler_type::pcg32, "pcg32", 3, false);
+
+    std::filesystem::remove(temp_file("image.pfm"));
+
+    std::printf(pass ? "All checks passed\n" : "Some checks failed\n");
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,75 @@
+// Checks for the denoiser (denoiser.h).
+//
+// A console program of its own, not part of the renderer. Build and run it with, for example:
+//
+//   g++ -O2 -std=c++17 -pthread -fsanitize=address DenoiserTests.cpp -o denoiser_tests
+//   ./denoiser_tests
+//
+// Every pixel is filtered from the previous pass alone, so cutting the image into tiles must
+// not change the result. Each check denoises the same noisy image with the default tiles and
+// with one tile covering the whole image, at widths that leave the last column of tiles 0 to
+// 5 pixels wide, and compares the two. Exits nonzero if any check fails.
+
+#include "offlineRT.h"
+
+#include "denoiser.h"
+#include "sampler.h"
+
+#include <cmath>
+#include <cstdio>
+
+struct test_image {
+    test_image(int width, int height) : radiance(width, height), albedo(width, height), normal(width, height) {
+        // Noisy radiance over two regions with different albedo and normals, so the edge
+        // stopping weights all come into play.
+        pcg32_sampler rng;
+        for (int j = 0; j < height; j++) {
+            for (int i = 0; i < width; i++) {
+                bool left = i < width / 2;
+                albedo.at(i, j) = left ? color(0.8, 0.3, 0.2) : color(0.2, 0.5, 0.8);
+                normal.at(i, j) = left ? color(0, 1, 0) : color(0.6, 0.8, 0);
+                radiance.at(i, j) = albedo.at(i, j) * real(rng.random_double(0, 2));
+            }
+        }
+    }
+
+    framebuffer radiance, albedo, normal;
+};
+
+bool check_tiling(int width, int height, int thread_count) {
+    test_image input(width, height);
+
+    denoiser filter;
+    filter.iterations = 3;
+    filter.thread_count = thread_count;
+
+    framebuffer tiled = input.radiance;
+    filter.apply(tiled, input.albedo, input.normal);
+
+    framebuffer whole = input.radiance;
+    filter.tile_size = width;
+    filter.apply(whole, input.albedo, input.normal);
+
+    // The narrowest tiles are filtered by the scalar path rather than in SIMD groups, which
+    // may round differently in the last bits.
+    double worst = 0;
+    for (size_t k = 0; k < whole.size(); k++)
+        for (int c = 0; c < 3; c++)
+            worst = std::max(worst, double(std::fabs(tiled[k][c] - whole[k][c])));
+
+    bool pass = worst <= 1e-5;
+    std::printf("%s  %dx%d, %d thread(s): largest difference %g\n",
+                pass ? "ok  " : "FAIL", width, height, thread_count, worst);
+    return pass;
+}
+
+int main() {
+    bool pass = true;
+    for (int width : { 64, 65, 66, 67, 68, 69, 130, 131 }) {
+        pass &= check_tiling(width, 5, 1);
+        pass &= check_tiling(width, 70, 4);
+    }
+
+    std::printf(pass ? "All checks passed\n" : "Some checks failed\n");
+    return pass ? 0 : 1;
+}
@@ -1,62 +1,153 @@
 #include "offlineRT.h"
 
+#include "bvh.h"
 #include "camera.h"
 #include "hittable.h"
 #include "hittable_list.h"
+#include "instance.h"
+#include "light_list.h"
 #include "material.h"
+#include "scene_file.h"
 #include "sphere.h"
+#include "sphere_batch.h"
+#include "tlas.h"
+#include "transform.h"
+#include "triangle_mesh.h"
 
-int main() {
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
 
-	// ====== World ======
+// Distributed rendering and denoising options from the command line, given to every scene's
+// camera.
+static struct {
+    int workers = 0;
+    int port = -1;
+    std::string coordinator;
+    bool denoise = false;
+    std::string albedo_path;
+    std::string normal_path;
+} options;
 
-	hittable_list world;
+void apply_options(camera& cam) {
+    cam.cluster_workers = options.workers;
+    cam.cluster_port = options.port;
+    cam.coordinator = options.coordinator;
 
-    auto ground_material = make_shared<lambertian>(color(0.5, 0.5, 0.5));
-    world.add(make_shared<sphere>(point3(0, -1000, 0), 1000, ground_material));
+    // Scene files can ask for these too; the command line only adds to what they ask for.
+    cam.denoise = cam.denoise || options.denoise;
+    if (!options.albedo_path.empty())
+        cam.albedo_path = options.albedo_path;
+    if (!options.normal_path.empty())
+        cam.normal_path = options.normal_path;
+}
+
+class ray_counter : public hittable {
+public:
+    // Passes every ray through to `world`, counting them. Workers count into slots picked by
+    // their thread, so they rarely contend for a cache line.
+    explicit ray_counter(const hittable& world) : world(world) {}
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        auto slot = std::hash<std::thread::id>()(std::this_thread::get_id()) % slot_count;
+        counts[slot].rays.fetch_add(1, std::memory_order_relaxed);
+        return world.hit(r, ray_t, rec);
+    }
+
+    aabb bounding_box() const override { return world.bounding_box(); }
+
+    uint64_t rays() const {
+        uint64_t total = 0;
+        for (const auto& c : counts)
+            total += c.rays;
+        return total;
+    }
+
+private:
+    static const size_t slot_count = 64;
+    struct alignas(64) slot {
+        std::atomic<uint64_t> rays{ 0 };
+    };
+
+    const hittable& world;
+    mutable slot counts[slot_count];
+};
+
+struct render_count {
+    uint64_t rays;
+    double   seconds;
+
+    double rays_per_second() const { return rays / seconds; }
+};
+
+render_count counted_render(camera& cam, const hittable& world, const material_library& materials) {
+    // Renders `world` through a ray_counter, so always locally, and returns the rays traced and
+    // the wall time they took.
+    ray_counter counted(world);
+    auto start = std::chrono::steady_clock::now();
+    cam.render(counted, materials);
+    return { counted.rays(), std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() };
+}
+
+hittable_list book_world(material_library& materials) {
+    // The book's final scene: three large spheres among hundreds of small random ones.
+
+	sphere_batch spheres;
+    pcg32_sampler rng;
+
+    auto ground_material = materials.add(lambertian(color(0.5, 0.5, 0.5)));
+    spheres.add(point3(0, -1000, 0), 1000, ground_material);
 
     for (int a = -11; a < 11; a++) {
         for (int b = -11; b < 11; b++) {
-            auto choose_mat = random_double();
-            point3 center(a + 0.9 * random_double(), 0.2, b + 0.9 * random_double());
+            auto choose_mat = rng.random_double();
+            point3 center(a + 0.9 * rng.random_double(), 0.2, b + 0.9 * rng.random_double());
 
             if ((center - point3(4, 0.2, 0)).length() > 0.9) {
-                shared_ptr<material> sphere_material;
+                material_handle sphere_material;
 
                 if (choose_mat < 0.8) {
                     // diffuse
-                    auto albedo = color::random() * color::random();
-                    sphere_material = make_shared<lambertian>(albedo);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
+                    auto albedo = color::random(rng) * color::random(rng);
+                    sphere_material = materials.add(lambertian(albedo));
+                    spheres.add(center, 0.2, sphere_material);
                 }
                 else if (choose_mat < 0.95) {
                     // metal
-                    auto albedo = color::random(0.5, 1);
-                    auto fuzz = random_double(0, 0.5);
-                    sphere_material = make_shared<metal>(albedo, fuzz);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
+                    auto albedo = color::random(rng, 0.5, 1);
+                    auto fuzz = rng.random_double(0, 0.5);
+                    sphere_material = materials.add(metal(albedo, fuzz));
+                    spheres.add(center, 0.2, sphere_material);
                 }
                 else {
                     // glass
-                    sphere_material = make_shared<dielectric>(1.5);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
+                    sphere_material = materials.add(dielectric(1.5));
+                    spheres.add(center, 0.2, sphere_material);
                 }
             }
         }
     }
 
-    auto material1 = make_shared<dielectric>(1.5);
-    world.add(make_shared<sphere>(point3(0, 1, 0), 1.0, material1));
-
-    auto material2 = make_shared<lambertian>(color(0.4, 0.2, 0.1));
-    world.add(make_shared<sphere>(point3(-4, 1, 0), 1.0, material2));
+    auto material1 = materials.add(dielectric(1.5));
+    spheres.add(point3(0, 1, 0), 1.0, material1);
 
-    auto material3 = make_shared<metal>(color(0.7, 0.6, 0.5), 0.0);
-    world.add(make_shared<sphere>(point3(4, 1, 0), 1.0, material3));
+    auto material2 = materials.add(lambertian(color(0.4, 0.2, 0.1)));
+    spheres.add(point3(-4, 1, 0), 1.0, material2);
 
+    auto material3 = materials.add(metal(color(0.7, 0.6, 0.5), 0.0));
+    spheres.add(point3(4, 1, 0), 1.0, material3);
 
-	// ====== Camera ======
+    // Group the spheres into SIMD batches and use each batch as a BVH leaf.
+    return hittable_list(make_shared<bvh_node>(spheres.split()));
+}
 
+camera book_camera() {
 	camera cam;
 
     cam.aspect_ratio = 16.0 / 9.0;
@@ -72,5 +163,662 @@ int main() {
     cam.defocus_angle = 0.6;
     cam.focus_dist = 10.0;
 
-	cam.render(world);
-}
\ No newline at end of file
+    return cam;
+}
+
+void random_spheres() {
+    material_library materials;
+    auto world = book_world(materials);
+
+    camera cam = book_camera();
+    apply_options(cam);
+    cam.render(world, materials);
+}
+
+void thread_scaling(int image_width, int samples_per_pixel) {
+    // Thread scaling benchmark: renders the book's scene with 1, 2, 4, 8 and 16 worker threads,
+    // then with every hardware thread, and reports each time. The images are written to
+    // threads_<count>.ppm ("threads_all.ppm" for every thread) and checked against the
+    // single-threaded one, which a fixed seed must reproduce exactly. Renders always run locally.
+    material_library materials;
+    auto world = book_world(materials);
+
+    auto read_file = [](const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    };
+
+    double single_seconds = 0;
+    std::string single_image;
+    for (int threads : { 1, 2, 4, 8, 16, 0 }) {
+        camera cam = book_camera();
+        cam.image_width = image_width;
+        cam.samples_per_pixel = samples_per_pixel;
+        cam.thread_count = threads;
+        cam.output_path = "threads_" + (threads > 0 ? std::to_string(threads) : std::string("all")) + ".ppm";
+
+        auto start = std::chrono::steady_clock::now();
+        cam.render(world, materials);
+        auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        auto image = read_file(cam.output_path);
+        if (threads == 1) {
+            single_seconds = seconds;
+            single_image = image;
+        }
+        auto hardware = tile_scheduler::resolve_thread_count(0);
+        std::clog << (threads > 0 ? std::to_string(threads) : "all (" + std::to_string(hardware) + ")")
+                  << " threads: " << seconds << "s ("
+                  << single_seconds / seconds << "x), "
+                  << (image == single_image ? "same image" : "DIFFERENT IMAGE") << '\n';
+    }
+}
+
+void precision_benchmark(int image_width, int samples_per_pixel) {
+    // Precision benchmark: renders the book's scene with a fixed seed and sample count and
+    // reports rays per second. Precision is chosen at compile time (see offlineRT.h), so compare
+    // the default build against ones with OFFLINERT_USE_FLOAT, and with OFFLINERT_USE_FLOAT and
+    // OFFLINERT_USE_SSE, for example
+    //
+    //   g++ -O2 -std=c++17 -pthread -DOFFLINERT_USE_FLOAT -DOFFLINERT_USE_SSE Main.cpp
+    //
+    // The image is written to precision_<build>.ppm, to compare the builds' noise by eye.
+#if defined(OFFLINERT_USE_SSE)
+    std::string build = "float_sse";
+#elif defined(OFFLINERT_USE_FLOAT)
+    std::string build = "float";
+#else
+    std::string build = "double";
+#endif
+
+    material_library materials;
+    auto world = book_world(materials);
+
+    camera cam = book_camera();
+    cam.image_width = image_width;
+    cam.samples_per_pixel = samples_per_pixel;
+    cam.seed = 0;
+    cam.output_path = "precision_" + build + ".ppm";
+
+    auto count = counted_render(cam, world, materials);
+    std::clog << build << ": " << count.rays << " rays in " << count.seconds << "s, "
+              << count.rays_per_second() / 1e6 << " Mrays/s\n";
+}
+
+void roulette_benchmark(int image_width, int samples_per_pixel) {
+    // Russian roulette benchmark: renders the book's scene with a fixed seed and sample count,
+    // once with paths terminated at random after the camera's default roulette depth and once
+    // with roulette off, and reports each one's rays, time and rays per second. The images are
+    // written to roulette_on.ppm and roulette_off.ppm. Renders always run locally.
+    material_library materials;
+    auto world = book_world(materials);
+
+    render_count on{}, off{};
+    for (bool roulette : { true, false }) {
+        camera cam = book_camera();
+        cam.image_width = image_width;
+        cam.samples_per_pixel = samples_per_pixel;
+        cam.seed = 0;
+        if (!roulette)
+            cam.russian_roulette_depth = -1;
+        cam.output_path = roulette ? "roulette_on.ppm" : "roulette_off.ppm";
+
+        auto& count = roulette ? on : off;
+        count = counted_render(cam, world, materials);
+        std::clog << "Roulette " << (roulette ? "on" : "off") << ": " << count.rays << " rays in "
+                  << count.seconds << "s, " << count.rays_per_second() / 1e6 << " Mrays/s\n";
+    }
+    std::clog << "Roulette traces " << double(on.rays) / off.rays << "x the rays in "
+              << on.seconds / off.seconds << "x the time\n";
+}
+
+void bvh_scaling(int max_count) {
+    // BVH benchmark: for 10, 100, ... up to max_count spheres, renders the same world once as
+    // a flat hittable_list, which tests every sphere for every ray, and once as a bvh_node over
+    // those spheres, and reports each one's rays per second. Spheres are scattered through a
+    // cube that grows with their count, so every image looks alike. The images are written to
+    // bvh_<count>_list.ppm and bvh_<count>_bvh.ppm. Renders always run locally, since the
+    // rays are counted in this process.
+
+    auto seconds_since = [](std::chrono::steady_clock::time_point t) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - t).count();
+    };
+
+    for (int count = 10; count <= max_count; count *= 10) {
+        material_library materials;
+        pcg32_sampler rng;
+        std::vector<material_handle> palette;
+        for (int k = 0; k < 16; k++)
+            palette.push_back(materials.add(lambertian(color::random(rng, 0.2, 0.9))));
+
+        hittable_list spheres;
+        auto side = 2 * std::cbrt(double(count));
+        for (int k = 0; k < count; k++) {
+            auto center = point3(rng.random_double(-side / 2, side / 2), rng.random_double(-side / 2, side / 2),
+                                 rng.random_double(-side / 2, side / 2));
+            spheres.add(make_shared<sphere>(center, 0.4, palette[k % palette.size()]));
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        bvh_node tree(spheres);
+        auto build_seconds = seconds_since(start);
+
+        auto rays_per_second = [&](const hittable& world, const char* kind) {
+            camera cam;
+
+            cam.aspect_ratio = 16.0 / 9.0;
+            cam.image_width = 192;
+            cam.samples_per_pixel = 4;
+            cam.max_depth = 4;
+
+            cam.vfov = 40;
+            cam.lookfrom = point3(0.9 * side, 0.7 * side, 1.5 * side);
+            cam.lookat = point3(0, 0, 0);
+            cam.vup = vec3(0, 1, 0);
+
+            cam.output_path = "bvh_" + std::to_string(count) + "_" + kind + ".ppm";
+            return counted_render(cam, world, materials).rays_per_second();
+        };
+
+        auto list_rate = rays_per_second(spheres, "list");
+        auto tree_rate = rays_per_second(tree, "bvh");
+        std::clog << count << " spheres: hittable_list " << list_rate / 1e6 << " Mrays/s, bvh_node "
+                  << tree_rate / 1e6 << " Mrays/s (" << tree_rate / list_rate << "x; built in "
+                  << build_seconds << "s)\n";
+    }
+}
+
+void batch_scaling(int max_count) {
+    // sphere_batch benchmark: for 4, 16, 64, ... up to max_count spheres, intersects the same
+    // rays once with a sphere_batch, which tests lane_width spheres at a time, and once by
+    // calling sphere::hit on each sphere in turn, as hittable_list does, and reports each one's
+    // nanoseconds per ray. Both must find the same closest hits. Runs on this thread only.
+
+    auto seconds_since = [](std::chrono::steady_clock::time_point t) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - t).count();
+    };
+
+    for (int count = 4; count <= max_count; count *= 4) {
+        pcg32_sampler rng;
+        material_handle mat;
+
+        sphere_batch batch;
+        std::vector<sphere> spheres;
+        auto side = 2 * std::cbrt(double(count));
+        for (int k = 0; k < count; k++) {
+            auto center = point3(rng.random_double(-side / 2, side / 2), rng.random_double(-side / 2, side / 2),
+                                 rng.random_double(-side / 2, side / 2));
+            batch.add(center, 0.4, mat);
+            spheres.emplace_back(center, 0.4, mat);
+        }
+
+        // Rays from a shell around the spheres toward points among them, enough for about 2^24
+        // sphere tests.
+        std::vector<ray> rays(std::max(4096, (1 << 24) / count));
+        for (auto& r : rays) {
+            auto origin = point3(0, 0, 0) + side * unit_vector(vec3::random(rng, -1, 1));
+            auto target = vec3::random(rng, -side / 2, side / 2);
+            r = ray(origin, target - origin);
+        }
+
+        auto ns_per_ray = [&](auto hit, double& t_sum) {
+            t_sum = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (const auto& r : rays) {
+                hit_record rec;
+                if (hit(r, rec))
+                    t_sum += rec.t;
+            }
+            return seconds_since(start) * 1e9 / rays.size();
+        };
+
+        double batch_t, scalar_t;
+        auto batch_ns = ns_per_ray([&](const ray& r, hit_record& rec) {
+            return batch.hit(r, interval(0.001, infinity), rec);
+        }, batch_t);
+        auto scalar_ns = ns_per_ray([&](const ray& r, hit_record& rec) {
+            bool hit_anything = false;
+            real closest = infinity;
+            for (const auto& s : spheres) {
+                if (s.hit(r, interval(0.001, closest), rec)) {
+                    hit_anything = true;
+                    closest = rec.t;
+                }
+            }
+            return hit_anything;
+        }, scalar_t);
+
+        // The SIMD path may round the hit distances a little differently.
+        bool same = std::fabs(batch_t - scalar_t) <= 1e-4 * std::fabs(scalar_t);
+        std::clog << count << " spheres: sphere_batch " << batch_ns << " ns/ray, sphere::hit "
+                  << scalar_ns << " ns/ray (" << scalar_ns / batch_ns << "x), "
+                  << (same ? "same hits" : "DIFFERENT HITS") << '\n';
+    }
+}
+
+void helix_instances(int instance_count, const std::string& obj_path) {
+    // Benchmark scene: instance_count copies of one helix mesh, sharing a single mesh BVH,
+    // placed on a grid under random rotations in a top-level BVH.
+
+    auto start = std::chrono::steady_clock::now();
+    auto seconds_since = [](std::chrono::steady_clock::time_point t) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - t).count();
+    };
+
+    material_library materials;
+    auto helix = triangle_mesh::load_obj(obj_path, materials.add(lambertian(color(0.7, 0.3, 0.2))));
+    if (!helix) {
+        std::clog << "Could not load '" << obj_path << "'\n";
+        return;
+    }
+    std::clog << "Loaded " << helix->triangle_count() << " triangles in " << seconds_since(start) << "s\n";
+
+    hittable_list world;
+    pcg32_sampler rng;
+
+    auto ground_material = materials.add(lambertian(color(0.5, 0.5, 0.5)));
+    world.add(make_shared<sphere>(point3(0, -1000, 0), 998.5, ground_material));
+
+    start = std::chrono::steady_clock::now();
+    auto helices = make_shared<tlas>();
+    int side = int(std::ceil(std::cbrt(double(instance_count))));
+    for (int k = 0; k < instance_count; k++) {
+        int a = k % side, b = (k / side) % side, c = k / (side * side);
+        auto offset = vec3(3 * (a - (side - 1) / 2.0), 3 * c, 3 * (b - (side - 1) / 2.0));
+        auto rotation = transform::rotate(vec3::random(rng, -1, 1), rng.random_double(0, 360));
+        auto albedo = color::random(rng, 0.2, 1);
+        auto mat = instance_count > 1 ? materials.add(lambertian(albedo)) : material_handle();
+        helices->add(helix, transform::translate(offset) * rotation, mat);
+    }
+    helices->build();
+    world.add(helices);
+    std::clog << "Built " << instance_count << " instances in " << seconds_since(start) << "s ("
+              << helix->memory_bytes() / 1024 << " KB mesh, " << helices->memory_bytes() / 1024
+              << " KB top level)\n";
+
+    camera cam;
+
+    cam.aspect_ratio = 16.0 / 9.0;
+    cam.image_width = 400;
+    cam.samples_per_pixel = 32;
+    cam.max_depth = 8;
+
+    auto extent = 3.0 * side;
+    cam.vfov = 40;
+    cam.lookfrom = point3(0.8 * extent + 2, 0.8 * extent + 3, 1.6 * extent + 4);
+    cam.lookat = point3(0, 1.5 * (side - 1), 0);
+    cam.vup = vec3(0, 1, 0);
+
+    start = std::chrono::steady_clock::now();
+    apply_options(cam);
+    cam.render(world, materials);
+    std::clog << "Rendered in " << seconds_since(start) << "s\n";
+}
+
+void lamp_field(int lamp_count, bool light_sampling) {
+    // Light sampling benchmark: a field of diffuse and metal spheres under a black sky, lit
+    // only by lamp_count small emissive spheres. Their total power is the same at any count.
+
+    material_library materials;
+    light_list lights;
+    sphere_batch spheres;
+    pcg32_sampler rng;
+
+    spheres.add(point3(0, -1000, 0), 1000, materials.add(lambertian(color(0.5, 0.5, 0.5))));
+
+    for (int a = -6; a < 6; a++) {
+        for (int b = -6; b < 6; b++) {
+            point3 center(a + 0.9 * rng.random_double(), 0.3, b + 0.9 * rng.random_double());
+            auto mat = rng.random_double() < 0.75
+                ? materials.add(lambertian(color::random(rng, 0.2, 0.9)))
+                : materials.add(metal(color::random(rng, 0.5, 1), rng.random_double(0, 0.3)));
+            spheres.add(center, 0.3, mat);
+        }
+    }
+
+    const real lamp_radius = 0.05;
+    auto lamp_power = 400.0 / lamp_count;
+    for (int k = 0; k < lamp_count; k++) {
+        point3 center(rng.random_double(-6, 6), rng.random_double(0.8, 3), rng.random_double(-6, 6));
+        auto emission = color::random(rng, 0.3, 1) * real(lamp_power / (4 * pi * lamp_radius * lamp_radius));
+        spheres.add(center, lamp_radius, lights.add_sphere(center, lamp_radius, emission, materials));
+    }
+    lights.build();
+
+    hittable_list world(make_shared<bvh_node>(spheres.split()));
+
+    camera cam;
+
+    cam.aspect_ratio = 16.0 / 9.0;
+    cam.image_width = 400;
+    cam.samples_per_pixel = 16;
+    cam.max_depth = 8;
+    cam.sky_light = false;
+    cam.next_event_estimation = light_sampling;
+
+    cam.vfov = 35;
+    cam.lookfrom = point3(9, 6, 12);
+    cam.lookat = point3(0, 0.5, 0);
+    cam.vup = vec3(0, 1, 0);
+
+    auto start = std::chrono::steady_clock::now();
+    apply_options(cam);
+    cam.render(world, materials, lights);
+    std::clog << "Rendered in " << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()
+              << "s\n";
+}
+
+void scene_from_file(const std::string& path, const std::string& binary_path) {
+    // Renders a scene file in either form (see scene_file.h). Given `binary_path`, converts it
+    // to the binary form there instead.
+    auto start = std::chrono::steady_clock::now();
+    scene s;
+    if (!s.load(path))
+        return;
+    std::clog << "Loaded " << s.spheres->size() << " spheres, " << s.meshes.size() << " meshes and "
+              << s.instances.size() << " instances in "
+              << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << "s\n";
+
+    if (!binary_path.empty()) {
+        if (s.save_binary(binary_path))
+            std::clog << "Wrote '" << binary_path << "'\n";
+        return;
+    }
+
+    apply_options(s.cam);
+    s.cam.render(s.world, s.materials, s.lights);
+}
+
+void textured_objects(const std::string& asset_directory, int budget_megabytes) {
+    // Texturing test scene: spheres and a torus wearing the RealTimeRayTracing albedo maps,
+    // on a checkered floor next to a marble sphere. The images are paged in through the
+    // texture cache, within budget_megabytes of resident tiles.
+    material_library materials;
+    materials.textures.images.budget_bytes = size_t(budget_megabytes) << 20;
+    pcg32_sampler rng;
+
+    auto image = [&](const std::string& name) {
+        return materials.textures.add_image(asset_directory + "Textures/" + name);
+    };
+    auto checker = materials.textures.add(checker_texture(0.5, color(0.8, 0.8, 0.8), color(0.1, 0.1, 0.1)));
+    auto marble = materials.textures.add(noise_texture(4, rng));
+
+    sphere_batch spheres;
+    spheres.add(point3(0, -1000, 0), 1000, materials.add(lambertian(checker)));
+    spheres.add(point3(-4, 1, 0), 1, materials.add(lambertian(image("Wood/wood_albedo.png"))));
+    spheres.add(point3(-2, 1, 2), 1, materials.add(lambertian(image("Cobblestone/cobblestone_albedo.png"))));
+    spheres.add(point3(0, 1, -2), 1, materials.add(metal(image("Bronze/bronze_albedo.png"), 0.1)));
+    spheres.add(point3(2, 1, 2), 1, materials.add(metal(image("Scratched/scratched_albedo.png"), 0.3)));
+    spheres.add(point3(4, 1, 0), 1, materials.add(lambertian(marble)));
+    spheres.build();
+
+    hittable_list world(make_shared<sphere_batch>(spheres));
+
+    auto torus_path = asset_directory + "Models/torus.obj";
+    auto torus = triangle_mesh::load_obj(torus_path, materials.add(lambertian(image("Rough/rough_albedo.png"))));
+    if (torus) {
+        auto placed = make_shared<tlas>();
+        placed->add(torus, transform::translate(vec3(0, 0.6, 3.5)) * transform::rotate(vec3(1, 0, 0), 20));
+        placed->build();
+        world.add(placed);
+    }
+    else {
+        std::clog << "Could not load '" << torus_path << "'\n";
+    }
+
+    camera cam;
+
+    cam.aspect_ratio = 16.0 / 9.0;
+    cam.image_width = 600;
+    cam.samples_per_pixel = 32;
+    cam.max_depth = 8;
+
+    cam.vfov = 35;
+    cam.lookfrom = point3(0, 5, 13);
+    cam.lookat = point3(0, 0.8, 0);
+    cam.vup = vec3(0, 1, 0);
+
+    auto start = std::chrono::steady_clock::now();
+    apply_options(cam);
+    cam.render(world, materials);
+    auto stats = materials.textures.images.stats();
+    std::clog << "Rendered in " << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()
+              << "s; " << stats.lookups << " texel lookups, " << stats.misses << " tile misses, "
+              << stats.evictions << " evictions, " << stats.resident_bytes / 1024 << " KB resident\n";
+}
+
+void game_animation(int frame_count, const std::string& model_directory, double shutter) {
+    // The RealTimeRayTracing demo scene (Game::CreateEntities) rendered as an image sequence,
+    // frame_000.ppm onwards. Game::Update is replayed at 60 updates per second of animation
+    // between 30 fps frames; each frame refits the top level, and every eighth rebuilds it.
+    // Positions are mirrored in z, from Direct3D's left-handed frame to this right-handed one.
+    //
+    // With a nonzero `shutter`, the fraction of the frame interval the shutter stays open,
+    // frames are motion blurred: every update step since the previous frame becomes a
+    // keyframe of the instances' motion, and the shutter closes on the frame's own time.
+
+    material_library materials;
+    auto default_material = materials.add(lambertian(color(0.5, 0.5, 0.5)));
+    auto load = [&](const char* name) {
+        auto mesh = triangle_mesh::load_obj(model_directory + name, default_material);
+        if (!mesh)
+            std::clog << "Could not load '" << model_directory + name << "'\n";
+        return mesh;
+    };
+    auto cube = load("cube.obj"), helix = load("helix.obj"), sphere_mesh = load("sphere.obj"), torus = load("torus.obj");
+    if (!cube || !helix || !sphere_mesh || !torus)
+        return;
+
+    struct entity {
+        size_t id;
+        vec3   position, scale;
+        double pitch = 0, yaw = 0;
+
+        transform world() const {
+            auto rotation = transform::rotate(vec3(0, 1, 0), yaw) * transform::rotate(vec3(1, 0, 0), pitch);
+            return transform::translate(position) * rotation * transform::scale(scale);
+        }
+    };
+
+    tlas scene;
+    std::vector<entity> entities;
+    auto place = [&](shared_ptr<triangle_mesh> mesh, material_handle mat, vec3 position, vec3 scale) {
+        entity e;
+        e.position = vec3(position.x(), position.y(), -position.z());
+        e.scale = scale;
+        e.id = scene.add(mesh, e.world(), mat);
+        entities.push_back(e);
+    };
+
+    place(cube, materials.add(lambertian(color(0.5, 0.5, 0.5))), vec3(0, 0, 1), vec3(4, 0.5, 4));       // Floor
+    place(torus, materials.add(lambertian(color(0.55, 0.5, 0.45))), vec3(0, 2, 0), vec3(0.5, 0.5, 0.5)); // Torus
+    place(helix, materials.add(metal(color(0.8, 0.8, 0.8), 0.3)), vec3(-2, 2, 0), vec3(0.5, 0.5, 0.5));  // Helix
+    place(cube, materials.add(lambertian(color(0.6, 0.4, 0.2))), vec3(2, 2, 0), vec3(0.4, 0.4, 0.4));    // Cube
+
+    pcg32_sampler rng;
+    const double roughnesses[] = { 0.0, 0.25, 0.5, 0.75, 1.0 };
+    std::vector<double> sphere_offsets;
+    for (int i = 0; i < 20; i++) {
+        auto albedo = color::random(rng);
+        auto roughness = roughnesses[int(rng.random_double(0, 5))];
+        auto mat = roughness >= 1 ? materials.add(lambertian(albedo)) : materials.add(metal(albedo, roughness));
+        auto scale = rng.random_double(0.1, 0.3);
+        place(sphere_mesh, mat, vec3(rng.random_double(-2, 2), scale + 0.5, rng.random_double(-2, 2)),
+              vec3(scale, scale, scale));
+
+        sphere_offsets.push_back(rng.random_double(-0.007, 0.007));  // x direction
+        sphere_offsets.push_back(rng.random_double(-0.007, 0.007));  // z direction
+        sphere_offsets.push_back(rng.random_double(-pi, pi));        // time offset
+    }
+
+    scene.build();
+    std::clog << scene.size() << " instances: " << scene.memory_bytes() / 1024 << " KB top level, "
+              << (cube->memory_bytes() + helix->memory_bytes() + sphere_mesh->memory_bytes()
+                  + torus->memory_bytes()) / 1024 << " KB of meshes\n";
+
+    camera cam;
+
+    cam.aspect_ratio = 16.0 / 9.0;
+    cam.image_width = 480;
+    cam.samples_per_pixel = 16;
+    cam.max_depth = 8;
+
+    cam.vfov = 60;
+    cam.lookfrom = point3(0.04, 2, 3.92);
+    cam.lookat = cam.lookfrom + vec3(0, -std::sin(0.2), -std::cos(0.2));
+    cam.vup = vec3(0, 1, 0);
+
+    const double frame_time = 1.0 / 30, update_time = 1.0 / 60;
+    const double spin = update_time * 180 / pi;  // Game::Update turns at one radian per second
+    double total_time = 0;
+
+    // Ray time 0 is the previous frame and 1 this one.
+    shutter = std::min(std::max(shutter, 0.0), 1.0);
+    std::vector<std::vector<transform>> keys(entities.size());
+
+    for (int frame = 0; frame < frame_count; frame++) {
+        auto start = std::chrono::steady_clock::now();
+        if (frame > 0) {
+            for (size_t k = 0; k < entities.size(); k++)
+                keys[k].assign(1, entities[k].world());
+
+            for (double t = 0; t < frame_time - 1e-9; t += update_time) {
+                // Game::Update, one step. Rotations are negated along with z.
+                total_time += update_time;
+                entities[1].pitch += spin;
+                entities[2].yaw += spin;
+                entities[3].pitch += spin;
+                entities[3].yaw += spin;
+                for (int i = 0; i < 20; i++) {
+                    auto& e = entities[i + 4];
+                    auto phase = total_time + sphere_offsets[i * 3 + 2];
+                    e.position += vec3(sphere_offsets[i * 3] * std::cos(phase * 0.8), 0,
+                                       -sphere_offsets[i * 3 + 1] * std::cos(phase) * 0.8);
+                }
+                for (size_t k = 0; k < entities.size(); k++)
+                    keys[k].push_back(entities[k].world());
+            }
+            for (size_t k = 0; k < entities.size(); k++) {
+                if (shutter > 0)
+                    scene.set_motion(entities[k].id, keys[k]);
+                else
+                    scene.set_transform(entities[k].id, keys[k].back());
+            }
+            cam.shutter_open = 1 - shutter;
+            cam.shutter_close = 1;
+
+            if (frame % 8 == 0)
+                scene.build();
+            else
+                scene.refit();
+        }
+        auto update_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        char name[32];
+        std::snprintf(name, sizeof(name), "frame_%03d.ppm", frame);
+        cam.output_path = name;
+        apply_options(cam);
+        cam.render(scene, materials);
+        if (frame > 0) {
+            std::clog << name << ": top level " << (frame % 8 == 0 ? "built" : "refit") << " in "
+                      << update_seconds * 1e6 << " us\n";
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    // With no arguments, renders the book's final scene. "threads [width] [samples]" renders it
+    // at each of several thread counts instead, "bvh [max count]" runs the bvh_node against
+    // hittable_list benchmark, "batch [max count]" the sphere_batch against sphere::hit
+    // benchmark, "precision [width] [samples]" the book's scene at this build's precision
+    // (float or double, see offlineRT.h), "roulette [width] [samples]" with Russian roulette on
+    // and off, "helix [count] [path.obj]" the mesh instancing benchmark, "lamps [count] [bsdf]"
+    // the light sampling benchmark (with "bsdf", lights are only found by scattering), "game [frames] [model directory] [shutter]" the animated
+    // RealTimeRayTracing scene (motion blurred when the shutter, a fraction of the frame
+    // interval, is nonzero), "textures [budget MB] [assets directory]" textured objects through
+    // the texture cache, and "file path [binary path]" a scene file.
+    //
+    // Options before the scene name distribute the render: "--workers N" forks N local worker
+    // processes, "--listen PORT" also accepts workers from other machines, and
+    // "--connect HOST:PORT" makes this process a worker for that coordinator. Workers must be
+    // started with the same scene arguments. "--denoise" filters the finished image (see
+    // denoiser.h), and "--albedo PATH" and "--normals PATH" write the first-hit feature images
+    // that guide it; all three need path mode and are skipped in distributed renders.
+    std::vector<std::string> args(argv + 1, argv + argc);
+    size_t first = 0;
+    while (first < args.size() && args[first].compare(0, 2, "--") == 0) {
+        auto option = args[first++];
+        if (option == "--denoise") {
+            options.denoise = true;
+            continue;
+        }
+        if (first == args.size()) {
+            std::clog << "Ignoring option " << option << " without a value\n";
+            break;
+        }
+        auto value = args[first++];
+        if (option == "--workers")
+            options.workers = std::max(0, std::atoi(value.c_str()));
+        else if (option == "--listen")
+            options.port = std::atoi(value.c_str());
+        else if (option == "--connect")
+            options.coordinator = value;
+        else if (option == "--albedo")
+            options.albedo_path = value;
+        else if (option == "--normals")
+            options.normal_path = value;
+        else
+            std::clog << "Ignoring unknown option " << option << '\n';
+    }
+    args.erase(args.begin(), args.begin() + first);
+    auto arg = [&](size_t k) { return k < args.size() ? args[k].c_str() : nullptr; };
+
+    std::string scene = arg(0) ? arg(0) : "spheres";
+
+    if (scene == "threads") {
+        int width = arg(1) ? std::max(16, std::atoi(arg(1))) : 1200;
+        int samples = arg(2) ? std::max(1, std::atoi(arg(2))) : 50;
+        thread_scaling(width, samples);
+    }
+    else if (scene == "precision") {
+        int width = arg(1) ? std::max(16, std::atoi(arg(1))) : 400;
+        int samples = arg(2) ? std::max(1, std::atoi(arg(2))) : 16;
+        precision_benchmark(width, samples);
+    }
+    else if (scene == "roulette") {
+        int width = arg(1) ? std::max(16, std::atoi(arg(1))) : 400;
+        int samples = arg(2) ? std::max(1, std::atoi(arg(2))) : 16;
+        roulette_benchmark(width, samples);
+    }
+    else if (scene == "bvh") {
+        int max_count = arg(1) ? std::max(10, std::atoi(arg(1))) : 1000000;
+        bvh_scaling(max_count);
+    }
+    else if (scene == "batch") {
+        int max_count = arg(1) ? std::max(4, std::atoi(arg(1))) : 4096;
+        batch_scaling(max_count);
+    }
+    else if (scene == "helix") {
+        int count = arg(1) ? std::max(1, std::atoi(arg(1))) : 1;
+        helix_instances(count, arg(2) ? arg(2) : "../RealTimeRayTracing/Assets/Models/helix.obj");
+    }
+    else if (scene == "lamps") {
+        int count = arg(1) ? std::max(1, std::atoi(arg(1))) : 1000;
+        lamp_field(count, !(arg(2) && std::string(arg(2)) == "bsdf"));
+    }
+    else if (scene == "game") {
+        int frames = arg(1) ? std::max(1, std::atoi(arg(1))) : 60;
+        game_animation(frames, arg(2) ? arg(2) : "../RealTimeRayTracing/Assets/Models/",
+                       arg(3) ? std::atof(arg(3)) : 0.0);
+    }
+    else if (scene == "textures") {
+        int budget = arg(1) ? std::max(1, std::atoi(arg(1))) : 64;
+        textured_objects(arg(2) ? arg(2) : "../RealTimeRayTracing/Assets/", budget);
+    }
+    else if (scene == "file" && arg(1)) {
+        scene_from_file(arg(1), arg(2) ? arg(2) : "");
+    }
+    else {
+        random_spheres();
+    }
+}
@@ -0,0 +1,62 @@
+// Checks for the sampler streams of the wavefront renderer (camera::wavefront_stream).
+//
+// A console program of its own, not part of the renderer. Build and run it with, for example:
+//
+//   g++ -O2 -std=c++17 -pthread WavefrontTests.cpp -o wavefront_tests
+//   ./wavefront_tests
+//
+// Every chunk of every stage of every iteration seeds its own pcg32 stream, so no two
+// (iteration, stage, chunk) triples may map to the same stream. pcg32 drops the top bit of the
+// stream id, so streams are compared without it. Exits nonzero if any check fails.
+
+#include "offlineRT.h"
+
+#include "camera.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+uint64_t pcg32_stream(uint64_t stream) {
+    return stream & ~(uint64_t(1) << 63);
+}
+
+bool check_unique(const char* name, std::vector<uint64_t> streams) {
+    std::sort(streams.begin(), streams.end());
+    auto repeat = std::adjacent_find(streams.begin(), streams.end());
+
+    bool pass = repeat == streams.end();
+    std::printf("%s  %s: %zu streams", pass ? "ok  " : "FAIL", name, streams.size());
+    if (!pass)
+        std::printf(", %llu used twice", (unsigned long long)*repeat);
+    std::printf("\n");
+    return pass;
+}
+
+int main() {
+    const int stages = camera::wavefront_stage_count;
+    const uint64_t chunks = camera::wavefront_chunk_streams;
+    bool pass = true;
+
+    // Every chunk a capped queue can have, over the first iterations.
+    std::vector<uint64_t> streams;
+    for (uint64_t iteration = 0; iteration < 4; iteration++)
+        for (int stage = 0; stage < stages; stage++)
+            for (uint64_t chunk = 0; chunk < chunks; chunk++)
+                streams.push_back(pcg32_stream(camera::wavefront_stream(iteration, stage, chunk)));
+    pass &= check_unique("all chunks, 4 iterations", streams);
+
+    // The first and last chunks of each stage, over many iterations, where neighbouring blocks
+    // meet.
+    streams.clear();
+    for (uint64_t iteration = 0; iteration < 100000; iteration++) {
+        for (int stage = 0; stage < stages; stage++) {
+            for (uint64_t chunk : { uint64_t(0), uint64_t(1), chunks - 1 })
+                streams.push_back(pcg32_stream(camera::wavefront_stream(iteration, stage, chunk)));
+        }
+    }
+    pass &= check_unique("block edges, 100000 iterations", streams);
+
+    std::printf(pass ? "All checks passed\n" : "Some checks failed\n");
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,146 @@
+#pragma once
+#ifndef AABB_H
+#define AABB_H
+
+#include "ray_packet.h"
+#include "simd4.h"
+
+class aabb {
+public:
+    interval x, y, z;
+
+    aabb() {} // The default AABB is empty, since intervals are empty by default.
+
+    aabb(const interval& x, const interval& y, const interval& z)
+        : x(x), y(y), z(z) {}
+
+    aabb(const point3& a, const point3& b) {
+        // Treat the two points a and b as extrema for the bounding box, so we don't require a
+        // particular minimum/maximum coordinate order.
+
+        x = (a[0] <= b[0]) ? interval(a[0], b[0]) : interval(b[0], a[0]);
+        y = (a[1] <= b[1]) ? interval(a[1], b[1]) : interval(b[1], a[1]);
+        z = (a[2] <= b[2]) ? interval(a[2], b[2]) : interval(b[2], a[2]);
+    }
+
+    aabb(const aabb& box0, const aabb& box1) {
+        x = interval(box0.x, box1.x);
+        y = interval(box0.y, box1.y);
+        z = interval(box0.z, box1.z);
+    }
+
+    const interval& axis_interval(int n) const {
+        if (n == 1) return y;
+        if (n == 2) return z;
+        return x;
+    }
+
+    bool hit(const ray& r, interval ray_t) const {
+        const point3& ray_orig = r.origin();
+        const vec3& ray_dir = r.direction();
+
+        for (int axis = 0; axis < 3; axis++) {
+            const interval& ax = axis_interval(axis);
+            const real adinv = 1 / ray_dir[axis];
+
+            auto t0 = (ax.min - ray_orig[axis]) * adinv;
+            auto t1 = (ax.max - ray_orig[axis]) * adinv;
+
+            if (t0 < t1) {
+                if (t0 > ray_t.min) ray_t.min = t0;
+                if (t1 < ray_t.max) ray_t.max = t1;
+            }
+            else {
+                if (t1 > ray_t.min) ray_t.min = t1;
+                if (t0 < ray_t.max) ray_t.max = t0;
+            }
+
+            if (ray_t.max <= ray_t.min)
+                return false;
+        }
+        return true;
+    }
+
+    uint32_t hit_packet(const ray_packet& packet, real t_min) const {
+        // Slab test of every active ray in the packet, each against its own closest hit so far.
+        // Returns the mask of active rays that enter the box.
+        uint32_t result = 0;
+
+#ifdef OFFLINERT_SIMD4
+        using pack = simd4<real>;
+        auto min_x = pack::set1(x.min), max_x = pack::set1(x.max);
+        auto min_y = pack::set1(y.min), max_y = pack::set1(y.max);
+        auto min_z = pack::set1(z.min), max_z = pack::set1(z.max);
+
+        for (int base = 0; base < packet.size; base += 4) {
+            if (((packet.active >> base) & 0xF) == 0)
+                continue;
+
+            auto ox = pack::load(packet.origin_x + base), ix = pack::load(packet.inv_dir_x + base);
+            auto oy = pack::load(packet.origin_y + base), iy = pack::load(packet.inv_dir_y + base);
+            auto oz = pack::load(packet.origin_z + base), iz = pack::load(packet.inv_dir_z + base);
+
+            auto tx0 = (min_x - ox) * ix, tx1 = (max_x - ox) * ix;
+            auto ty0 = (min_y - oy) * iy, ty1 = (max_y - oy) * iy;
+            auto tz0 = (min_z - oz) * iz, tz1 = (max_z - oz) * iz;
+
+            auto t_near = pack::max(pack::set1(t_min), pack::max(pack::min(tx0, tx1),
+                          pack::max(pack::min(ty0, ty1), pack::min(tz0, tz1))));
+            auto t_far = pack::min(pack::load(packet.t_max + base), pack::min(pack::max(tx0, tx1),
+                         pack::min(pack::max(ty0, ty1), pack::max(tz0, tz1))));
+
+            result |= uint32_t(pack::bits(pack::less(t_near, t_far))) << base;
+        }
+#else
+        for (int i = 0; i < packet.size; i++) {
+            if (!(packet.active & (1u << i)))
+                continue;
+
+            auto tx0 = (x.min - packet.origin_x[i]) * packet.inv_dir_x[i];
+            auto tx1 = (x.max - packet.origin_x[i]) * packet.inv_dir_x[i];
+            auto ty0 = (y.min - packet.origin_y[i]) * packet.inv_dir_y[i];
+            auto ty1 = (y.max - packet.origin_y[i]) * packet.inv_dir_y[i];
+            auto tz0 = (z.min - packet.origin_z[i]) * packet.inv_dir_z[i];
+            auto tz1 = (z.max - packet.origin_z[i]) * packet.inv_dir_z[i];
+
+            auto t_near = std::fmax(t_min, std::fmax(std::fmin(tx0, tx1),
+                          std::fmax(std::fmin(ty0, ty1), std::fmin(tz0, tz1))));
+            auto t_far = std::fmin(packet.t_max[i], std::fmin(std::fmax(tx0, tx1),
+                         std::fmin(std::fmax(ty0, ty1), std::fmax(tz0, tz1))));
+
+            if (t_near < t_far)
+                result |= 1u << i;
+        }
+#endif
+
+        return result & packet.active;
+    }
+
+    int longest_axis() const {
+        // Returns the index of the longest axis of the bounding box.
+
+        if (x.size() > y.size())
+            return x.size() > z.size() ? 0 : 2;
+        else
+            return y.size() > z.size() ? 1 : 2;
+    }
+
+    real surface_area() const {
+        // Returns the surface area of the box, or zero for an empty box.
+        auto dx = x.size(), dy = y.size(), dz = z.size();
+        if (dx < 0 || dy < 0 || dz < 0)
+            return 0;
+        return 2 * (dx * dy + dy * dz + dz * dx);
+    }
+
+    point3 centroid() const {
+        return point3((x.min + x.max) / 2, (y.min + y.max) / 2, (z.min + z.max) / 2);
+    }
+
+    static const aabb empty, universe;
+};
+
+const aabb aabb::empty = aabb(interval::empty, interval::empty, interval::empty);
+const aabb aabb::universe = aabb(interval::universe, interval::universe, interval::universe);
+
+#endif
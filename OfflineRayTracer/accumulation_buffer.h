@@ -0,0 +1,132 @@
+#pragma once
+#ifndef ACCUMULATION_BUFFER_H
+#define ACCUMULATION_BUFFER_H
+
+#include "framebuffer.h"
+#include "mapped_file.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// What a checkpoint was rendered with. A snapshot may only be resumed by a render whose
+// settings match, or the continued samples would not line up with the stored ones. Only the
+// target sample count may differ, and only for samplers whose numbers do not depend on it
+// (see camera::can_resume).
+struct checkpoint_header {
+    char     magic[4] = { 'O', 'R', 'T', 'C' };
+    uint32_t version = 1;
+    uint32_t width = 0, height = 0;
+    uint32_t samples_per_pixel = 0;  // Target sample count of the whole render
+    uint32_t samples_per_pass = 0;
+    uint32_t passes_done = 0;        // Completed passes held in the snapshot
+    uint32_t sampler = 0;            // sampler_type of the render
+    uint64_t seed = 0;
+
+    bool matches(const checkpoint_header& other) const {
+        return matches_passes(other) && samples_per_pixel == other.samples_per_pixel;
+    }
+
+    bool matches_passes(const checkpoint_header& other) const {
+        // Every setting but the target sample count.
+        return std::memcmp(magic, other.magic, sizeof(magic)) == 0 && version == other.version
+            && width == other.width && height == other.height
+            && samples_per_pass == other.samples_per_pass
+            && sampler == other.sampler && seed == other.seed;
+    }
+};
+
+static_assert(sizeof(checkpoint_header) == 40, "checkpoint_header must have no padding");
+
+class accumulation_buffer {
+public:
+    // Running per-pixel sums of linear radiance in 32-bit floats, with the number of samples
+    // behind each sum. Progressive passes add into it; resolve() turns it into an image.
+    //
+    // Snapshots are the header followed by the raw sum and count arrays, in host byte order.
+    // They are written through a fresh memory-mapped file that replaces the previous snapshot
+    // by rename only once complete, so a crash mid-write never destroys the last good one.
+
+    accumulation_buffer(int width, int height)
+      : image_width(width), image_height(height),
+        sums(3 * size_t(width) * height, 0.0f), counts(size_t(width) * height, 0) {}
+
+    int width() const { return image_width; }
+    int height() const { return image_height; }
+
+    void add(int i, int j, const color& sum, uint32_t samples) {
+        size_t p = size_t(j) * image_width + i;
+        sums[3 * p + 0] += float(sum.x());
+        sums[3 * p + 1] += float(sum.y());
+        sums[3 * p + 2] += float(sum.z());
+        counts[p] += samples;
+    }
+
+    uint32_t sample_count(int i, int j) const { return counts[size_t(j) * image_width + i]; }
+
+    void resolve(framebuffer& image) const {
+        // Pixels that have no samples yet come out black.
+        for (size_t p = 0; p < counts.size(); p++) {
+            auto scale = counts[p] ? real(1) / counts[p] : real(0);
+            image[p] = color(sums[3 * p], sums[3 * p + 1], sums[3 * p + 2]) * scale;
+        }
+    }
+
+    bool save(const std::string& path, const checkpoint_header& header) const {
+        std::string temp_path = path + ".tmp";
+        {
+            mapped_file file(temp_path, sizeof(header) + byte_size());
+            if (!file.is_open())
+                return false;
+
+            char* out = file.data();
+            std::memcpy(out, &header, sizeof(header));
+            out += sizeof(header);
+            std::memcpy(out, sums.data(), sums.size() * sizeof(float));
+            out += sums.size() * sizeof(float);
+            std::memcpy(out, counts.data(), counts.size() * sizeof(uint32_t));
+            file.flush();
+        }
+
+#ifdef _WIN32
+        return MoveFileExA(temp_path.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+        return std::rename(temp_path.c_str(), path.c_str()) == 0;
+#endif
+    }
+
+    bool load(const std::string& path, checkpoint_header& header) {
+        // Fills the buffer from a snapshot of the same dimensions, and returns its header.
+        mapped_file file(path);
+        if (!file.is_open() || file.size() != sizeof(header) + byte_size())
+            return false;
+
+        const char* in = file.data();
+        checkpoint_header stored;
+        std::memcpy(&stored, in, sizeof(stored));
+        if (std::memcmp(stored.magic, header.magic, sizeof(header.magic)) != 0
+            || stored.width != uint32_t(image_width) || stored.height != uint32_t(image_height))
+            return false;
+
+        in += sizeof(stored);
+        std::memcpy(sums.data(), in, sums.size() * sizeof(float));
+        in += sums.size() * sizeof(float);
+        std::memcpy(counts.data(), in, counts.size() * sizeof(uint32_t));
+        header = stored;
+        return true;
+    }
+
+private:
+    int image_width;
+    int image_height;
+    std::vector<float> sums;        // RGB sums, three floats per pixel
+    std::vector<uint32_t> counts;   // Samples per pixel
+
+    size_t byte_size() const {
+        return sums.size() * sizeof(float) + counts.size() * sizeof(uint32_t);
+    }
+};
+
+#endif
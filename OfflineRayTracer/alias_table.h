@@ -0,0 +1,78 @@
+#pragma once
+#ifndef ALIAS_TABLE_H
+#define ALIAS_TABLE_H
+
+#include <cstdint>
+#include <vector>
+
+class alias_table {
+public:
+    // Samples an index in proportion to a list of non-negative weights in constant time, by
+    // Vose's alias method: every slot holds a probability of keeping its own index and an
+    // alias to take otherwise, so one uniform number picks a slot and decides between the two.
+
+    alias_table() {}
+
+    explicit alias_table(const std::vector<double>& weights) {
+        size_t n = weights.size();
+        double total = 0;
+        for (auto w : weights)
+            total += w > 0 ? w : 0;
+        if (n == 0 || total <= 0)
+            return;
+
+        slots.resize(n);
+        std::vector<double> scaled(n);
+        std::vector<uint32_t> small, large;
+        for (uint32_t k = 0; k < n; k++) {
+            auto w = weights[k] > 0 ? weights[k] : 0;
+            slots[k].pmf = w / total;
+            scaled[k] = slots[k].pmf * n;
+            (scaled[k] < 1 ? small : large).push_back(k);
+        }
+
+        // Pair each under-full slot with an over-full one, which donates the remainder.
+        while (!small.empty() && !large.empty()) {
+            auto s = small.back(), l = large.back();
+            small.pop_back();
+            slots[s].keep = scaled[s];
+            slots[s].alias = l;
+            scaled[l] -= 1 - scaled[s];
+            if (scaled[l] < 1) {
+                large.pop_back();
+                small.push_back(l);
+            }
+        }
+
+        // What's left is full up to rounding.
+        for (auto k : large)
+            slots[k].keep = 1;
+        for (auto k : small)
+            slots[k].keep = 1;
+    }
+
+    size_t size() const { return slots.size(); }
+
+    uint32_t sample(double u) const {
+        // Maps u in [0,1) to an index. The slot is the integer part of u * size, and the
+        // fraction left over chooses between the slot and its alias.
+        auto scaled = u * slots.size();
+        auto k = uint32_t(scaled);
+        if (k >= slots.size())
+            k = uint32_t(slots.size() - 1);
+        return (scaled - k) < slots[k].keep ? k : slots[k].alias;
+    }
+
+    double pmf(uint32_t index) const { return slots[index].pmf; }
+
+private:
+    struct slot {
+        double   keep = 1;   // Probability of keeping this slot's own index
+        double   pmf = 0;    // Probability of the index overall
+        uint32_t alias = 0;  // Index taken otherwise
+    };
+
+    std::vector<slot> slots;
+};
+
+#endif
@@ -0,0 +1,93 @@
+#pragma once
+#ifndef BINARY_IO_H
+#define BINARY_IO_H
+
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Raw binary files built from plain values and arrays, in host byte order. An array is its
+// element count as a uint64 followed by the elements, which start on a 16-byte boundary of the
+// file, so a reader that maps the file sees every array properly aligned in place.
+
+class binary_writer {
+public:
+    explicit binary_writer(const std::string& path) : file(path, std::ios::binary | std::ios::trunc) {}
+
+    bool ok() const { return bool(file); }
+
+    template <typename T>
+    void put(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "binary files hold plain values only");
+        write(&value, sizeof(T));
+    }
+
+    template <typename T>
+    void put_array(const std::vector<T>& values) {
+        static_assert(std::is_trivially_copyable<T>::value, "binary files hold plain values only");
+        put(uint64_t(values.size()));
+        static const char zeros[alignment] = {};
+        write(zeros, (alignment - position % alignment) % alignment);
+        write(values.data(), values.size() * sizeof(T));
+    }
+
+private:
+    static constexpr size_t alignment = 16;
+
+    std::ofstream file;
+    size_t position = 0;
+
+    void write(const void* data, size_t size) {
+        file.write(static_cast<const char*>(data), std::streamsize(size));
+        position += size;
+    }
+};
+
+class binary_reader {
+public:
+    // Reads a file written by binary_writer through a read-only mapping. Every get fails,
+    // rather than reading past the end, once the data runs out.
+    explicit binary_reader(const std::string& path) : file(path) {}
+
+    bool is_open() const { return file.is_open(); }
+    size_t remaining() const { return file.size() - position; }
+
+    template <typename T>
+    bool get(T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "binary files hold plain values only");
+        if (remaining() < sizeof(T))
+            return false;
+        std::memcpy(&value, file.data() + position, sizeof(T));
+        position += sizeof(T);
+        return true;
+    }
+
+    template <typename T>
+    bool get_array(std::vector<T>& values) {
+        uint64_t count;
+        if (!get(count))
+            return false;
+        position += std::min(remaining(), (alignment - position % alignment) % alignment);
+        if (count > remaining() / sizeof(T))
+            return false;
+
+        auto first = reinterpret_cast<const T*>(file.data() + position);
+        values.assign(first, first + count);
+        position += size_t(count) * sizeof(T);
+        return true;
+    }
+
+private:
+    static constexpr size_t alignment = 16;
+
+    mapped_file file;
+    size_t position = 0;
+};
+
+#endif
@@ -0,0 +1,189 @@
+#pragma once
+#ifndef BVH_H
+#define BVH_H
+
+#include "aabb.h"
+#include "hittable.h"
+#include "hittable_list.h"
+
+#include <algorithm>
+#include <vector>
+
+class bvh_node : public hittable {
+public:
+    bvh_node(hittable_list list) : bvh_node(list.objects, 0, list.objects.size()) {
+        // There's a C++ subtlety here. This constructor (without span indices) creates an
+        // implicit copy of the hittable list, which we will modify. The lifetime of the copied
+        // list only extends until this constructor exits. That's OK, because we only need to
+        // persist the resulting bounding volume hierarchy.
+    }
+
+    bvh_node(std::vector<shared_ptr<hittable>>& objects, size_t start, size_t end) {
+        // Build the bounding box of the span of source objects, along with the bounds of their
+        // centroids, which is what the SAH bins are laid out over.
+        bbox = aabb::empty;
+        aabb centroid_bounds = aabb::empty;
+        for (size_t object_index = start; object_index < end; object_index++) {
+            auto object_box = objects[object_index]->bounding_box();
+            bbox = aabb(bbox, object_box);
+            auto c = object_box.centroid();
+            centroid_bounds = aabb(centroid_bounds, aabb(c, c));
+        }
+
+        size_t object_span = end - start;
+
+        if (object_span == 1) {
+            left = right = objects[start];
+            return;
+        }
+        else if (object_span == 2) {
+            left = objects[start];
+            right = objects[start + 1];
+            return;
+        }
+
+        size_t mid = start + object_span / 2;
+
+        if (!find_sah_split(objects, start, end, centroid_bounds, mid)) {
+            // SAH found no plane that separates the centroids (e.g. they all coincide), so
+            // split at the median along the longest axis instead.
+            int axis = centroid_bounds.longest_axis();
+            std::nth_element(
+                objects.begin() + start, objects.begin() + mid, objects.begin() + end,
+                [axis](const shared_ptr<hittable>& a, const shared_ptr<hittable>& b) {
+                    return centroid_on_axis(a, axis) < centroid_on_axis(b, axis);
+                });
+        }
+
+        left = make_shared<bvh_node>(objects, start, mid);
+        right = make_shared<bvh_node>(objects, mid, end);
+    }
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        if (!bbox.hit(r, ray_t))
+            return false;
+
+        bool hit_left = left->hit(r, ray_t, rec);
+        bool hit_right = right->hit(r, interval(ray_t.min, hit_left ? rec.t : ray_t.max), rec);
+
+        return hit_left || hit_right;
+    }
+
+    uint32_t hit_packet(ray_packet& packet, real t_min, hit_record* recs) const override {
+        // Descend with only the rays that enter this node's box, so the whole packet shares one
+        // visit (and one virtual call) per node.
+        uint32_t entering = bbox.hit_packet(packet, t_min);
+        if (!entering)
+            return 0;
+
+        uint32_t saved_active = packet.active;
+        packet.active = entering;
+        uint32_t hits = left->hit_packet(packet, t_min, recs);
+        hits |= right->hit_packet(packet, t_min, recs);
+        packet.active = saved_active;
+
+        return hits;
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+private:
+    shared_ptr<hittable> left;
+    shared_ptr<hittable> right;
+    aabb bbox;
+
+    static const int sah_bin_count = 12;
+
+    struct sah_bin {
+        aabb bounds;
+        int  count = 0;
+    };
+
+    static real centroid_on_axis(const shared_ptr<hittable>& object, int axis) {
+        auto box = object->bounding_box();
+        auto& ax = box.axis_interval(axis);
+        return (ax.min + ax.max) / 2;
+    }
+
+    static bool find_sah_split(
+        std::vector<shared_ptr<hittable>>& objects, size_t start, size_t end,
+        const aabb& centroid_bounds, size_t& mid
+    ) {
+        // Bin the objects by centroid along each axis and evaluate the surface area heuristic
+        // at every bin boundary. On success, the objects are partitioned about the cheapest
+        // plane and `mid` is set to the index of the first object on the right side.
+
+        double best_cost = infinity;
+        int    best_axis = 0;
+        int    best_split = -1;
+
+        for (int axis = 0; axis < 3; axis++) {
+            auto extent = centroid_bounds.axis_interval(axis);
+            if (extent.size() <= 0)
+                continue;
+
+            sah_bin bins[sah_bin_count];
+            auto scale = sah_bin_count / extent.size();
+
+            for (size_t object_index = start; object_index < end; object_index++) {
+                int b = bin_index(objects[object_index], axis, extent.min, scale);
+                bins[b].count++;
+                bins[b].bounds = aabb(bins[b].bounds, objects[object_index]->bounding_box());
+            }
+
+            // Sweep from the right to collect the area and count of each right-hand side, then
+            // sweep from the left and price each candidate plane.
+            double right_area[sah_bin_count];
+            int    right_count[sah_bin_count];
+            aabb   right_box;
+            int    count = 0;
+            for (int b = sah_bin_count - 1; b > 0; b--) {
+                right_box = aabb(right_box, bins[b].bounds);
+                count += bins[b].count;
+                right_area[b] = right_box.surface_area();
+                right_count[b] = count;
+            }
+
+            aabb left_box;
+            count = 0;
+            for (int b = 0; b < sah_bin_count - 1; b++) {
+                left_box = aabb(left_box, bins[b].bounds);
+                count += bins[b].count;
+                if (count == 0 || right_count[b + 1] == 0)
+                    continue;
+
+                auto cost = left_box.surface_area() * count
+                          + right_area[b + 1] * right_count[b + 1];
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_split = b;
+                }
+            }
+        }
+
+        if (best_split < 0)
+            return false;
+
+        auto extent = centroid_bounds.axis_interval(best_axis);
+        auto scale = sah_bin_count / extent.size();
+        int axis = best_axis;
+        auto min = extent.min;
+
+        auto it = std::partition(
+            objects.begin() + start, objects.begin() + end,
+            [=](const shared_ptr<hittable>& object) {
+                return bin_index(object, axis, min, scale) <= best_split;
+            });
+
+        mid = size_t(it - objects.begin());
+        return mid != start && mid != end;
+    }
+
+    static int bin_index(const shared_ptr<hittable>& object, int axis, real min, real scale) {
+        int b = int((centroid_on_axis(object, axis) - min) * scale);
+        return b < 0 ? 0 : (b >= sah_bin_count ? sah_bin_count - 1 : b);
+    }
+};
+
+#endif
@@ -2,8 +2,34 @@
 #ifndef CAMERA_H
 #define CAMERA_H
 
+#include "accumulation_buffer.h"
+#include "cluster.h"
+#include "denoiser.h"
+#include "framebuffer.h"
 #include "hittable.h"
+#include "image_writer.h"
+#include "light_list.h"
 #include "material.h"
+#include "tile_scheduler.h"
+#include "wavefront.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum class render_mode {
+    path,       // Each sample's path is traced alone, ray by ray
+    packet,     // All of a tile's paths advance together, traced in packets in pixel order
+    stream,     // As packet, but secondary rays are re-sorted by direction and origin first
+    wavefront   // Whole-image SoA path queue, advanced stage by stage with per-material loops
+};
 
 class camera {
 public:
@@ -11,6 +37,9 @@ public:
     int    image_width = 100;  // Rendered image width in pixel count
     int    samples_per_pixel = 10;  // Count of random samples for each pixel
     int    max_depth = 10;  // Maximum number of ray bounces into scene
+    int    russian_roulette_depth = 3;  // Bounces before paths may be randomly terminated (-1 = off)
+    bool   sky_light = true;  // Escaping rays see the sky gradient, rather than black
+    bool   next_event_estimation = true;  // Sample the light list at diffuse hits (path mode only)
 
     double vfov = 90;  // Verticle view angle (field of view)
     point3 lookfrom = point3(0, 0, 0);   // Point camera is looking from
@@ -20,29 +49,135 @@ public:
     double defocus_angle = 0;  // Variation angle of rays through each pixel
     double focus_dist = 10;    // Distance from camera lookfrom point to plane of perfect focus
 
-    void render(const hittable& world) {
+    double shutter_open = 0;   // Ray times the shutter stays open over, within the scene's
+    double shutter_close = 0;  // motion time 0..1 (equal values give no motion blur)
+
+    int    thread_count = 0;   // Render worker threads (0 uses every hardware thread)
+    int    tile_size = 16;     // Edge length of the square tiles handed to workers
+    uint64_t seed = 0;         // Base seed; a fixed seed gives the same image at any thread count
+    sampler_type sampling = sampler_type::pcg32;  // Random number source for camera and bounces
+
+    double adaptive_threshold = 0;    // Relative standard error at which a pixel stops (0 = off)
+    int    min_samples_per_pixel = 8; // Samples taken before a pixel may stop early
+
+    render_mode mode = render_mode::path;  // Traversal strategy (adaptive sampling is path-only)
+    int    packet_size = 8;    // Rays per packet in packet and stream modes (4, 8 or 16)
+    size_t wavefront_queue_size = size_t(1) << 20;  // In-flight paths in wavefront mode
+
+    image_format output_format = image_format::ppm_binary;  // Encoding of the finished image
+    std::string  output_path;  // File to write the image to (empty writes to stdout)
+
+    bool   denoise = false;      // Filter the image guided by first-hit albedo and normals (path mode)
+    std::string albedo_path;     // First-hit albedo image, averaged over samples (empty = none)
+    std::string normal_path;     // First-hit normal image; unclamped only in float formats
+
+    int    samples_per_pass = 0;     // Samples per pixel in each progressive pass (0 = one pass)
+    std::string checkpoint_path;     // Progressive snapshot to resume from and update (empty = none)
+    int    checkpoint_interval = 1;  // Passes between snapshots
+    std::string preview_path;        // Image rewritten as progressive passes finish (empty = none)
+    int    preview_interval = 1;     // Passes between preview images
+
+    int    cluster_workers = 0;  // Local worker processes for a distributed render (0 = none)
+    int    cluster_port = -1;    // Port that remote workers connect to (-1 = local workers only)
+    std::string coordinator;     // "host:port" to render jobs for, instead of writing an image
+
+    void render(
+        const hittable& world, const material_library& materials,
+        const light_list& lights = light_list()
+    ) {
+        // `materials` holds every material the world's hit records refer to, and `lights`
+        // the emitters to sample directly. Lights must also be in the world to be seen.
         initialize();
+        scene_materials = &materials;
+        scene_lights = &lights;
 
-        std::cout << "P3\n" << image_width << ' ' << image_height << "\n255\n";
+#ifdef OFFLINERT_CLUSTER
+        if (!coordinator.empty()) {
+            render_cluster_worker(world, coordinator);
+            return;
+        }
+        if (cluster_workers > 0 || cluster_port >= 0) {
+            render_cluster(world);
+            return;
+        }
+#else
+        if (!coordinator.empty() || cluster_workers > 0 || cluster_port >= 0)
+            std::clog << "Distributed rendering needs POSIX sockets; rendering locally\n";
+#endif
 
-        for (int j = 0; j < image_height; j++) {
-            std::clog << "\rScanlines remaining: " << (image_height - j) << ' ' << std::flush;
-            for (int i = 0; i < image_width; i++) {
-                color pixel_color(0, 0, 0);
-                for (int sample = 0; sample < samples_per_pixel; sample++) {
-                    ray r = get_ray(i, j);
-                    pixel_color += ray_color(r, max_depth, world);
-                }
-                write_color(std::cout, pixel_samples_scale * pixel_color);
+        if (wants_features() && mode != render_mode::path && samples_per_pass <= 0)
+            std::clog << "Feature images and denoising need path mode; skipping them\n";
+
+        if (samples_per_pass > 0) {
+            render_progressive(world);
+            return;
+        }
+
+        framebuffer image(image_width, image_height);
+
+        if (mode == render_mode::wavefront) {
+            render_wavefront(world, image);
+            write_framebuffer(image);
+            return;
+        }
+
+        std::unique_ptr<feature_images> features;
+        if (mode == render_mode::path && wants_features())
+            features.reset(new feature_images(image_width, image_height));
+
+        tile_scheduler scheduler(image_width, image_height, tile_size);
+        std::atomic<size_t> tiles_remaining(scheduler.tile_count());
+        std::atomic<uint64_t> samples_taken(0);
+        std::vector<bounce_stats> stats(max_depth);
+        std::mutex log_lock;
+
+        scheduler.run(thread_count, [&](const tile& t) {
+            std::vector<bounce_stats> tile_stats(max_depth);
+            if (mode == render_mode::path)
+                samples_taken += render_tile(t, world, image, features.get());
+            else
+                samples_taken += render_tile_packets(t, world, image, tile_stats);
+
+            auto remaining = --tiles_remaining;
+            std::lock_guard<std::mutex> guard(log_lock);
+            for (int bounce = 0; bounce < max_depth; bounce++) {
+                stats[bounce].rays += tile_stats[bounce].rays;
+                stats[bounce].seconds += tile_stats[bounce].seconds;
             }
+            std::clog << "\rTiles remaining: " << remaining << ' ' << std::flush;
+        });
+
+        if (features)
+            finish_features(image, features->albedo, features->normal);
+        write_framebuffer(image);
+
+        if (adaptive_threshold > 0) {
+            auto budget = uint64_t(image_width) * image_height * samples_per_pixel;
+            std::clog << "Samples taken: " << samples_taken << " of " << budget << " ("
+                      << 100.0 * (budget - samples_taken) / budget << "% saved)\n";
         }
 
-        std::clog << "\rDone.                 \n";
+        if (mode != render_mode::path) {
+            // Traversal throughput per bounce, in rays per second of worker time.
+            for (int bounce = 0; bounce < max_depth && stats[bounce].rays > 0; bounce++) {
+                std::clog << "Bounce " << bounce << ": " << stats[bounce].rays << " rays, "
+                          << stats[bounce].rays / stats[bounce].seconds / 1e6 << " Mrays/s\n";
+            }
+        }
+    }
+
+    // Sampler streams of the wavefront renderer. Each iteration takes one block of
+    // `wavefront_chunk_streams` streams per stage (generate, then the shading of each material
+    // kind, in material_kind order), and each chunk of a stage uses one stream of its block.
+    static constexpr int      wavefront_stage_count = 5;
+    static constexpr uint64_t wavefront_chunk_streams = 65536;
+
+    static uint64_t wavefront_stream(uint64_t iteration, int stage, size_t chunk) {
+        return (iteration * wavefront_stage_count + uint64_t(stage)) * wavefront_chunk_streams + chunk;
     }
 
 private:
     int    image_height;        // Rendered image height
-    double pixel_samples_scale; // Color scale factor for a sum of pixel samples
     point3 center;              // Camera center
     point3 pixel00_loc;         // Location of pixel 0, 0
     vec3   pixel_delta_u;       // Offset to pixel to the right
@@ -50,13 +185,72 @@ private:
     vec3   u, v, w;             // Camera frame basis vectors
     vec3   defocus_disk_u;       // Defocus disk horizontal radius
     vec3   defocus_disk_v;       // Defocus disk vertical radius
+    double pixel_spread;         // Angle one pixel subtends at the camera center
+    const material_library* scene_materials = nullptr;  // Materials of the world being rendered
+    const light_list*       scene_lights = nullptr;     // Its directly sampled emitters
+
+    struct bounce_stats {
+        uint64_t rays = 0;
+        double   seconds = 0;
+    };
+
+    struct surface_features {
+        color albedo;  // Of the first surface hit, or the background
+        vec3  normal;  // Of the first surface hit, facing the ray; zero for the background
+    };
+
+    struct feature_images {
+        feature_images(int width, int height) : albedo(width, height), normal(width, height) {}
+        framebuffer albedo, normal;
+    };
+
+    struct feature_sums {
+        feature_sums(int width, int height) : albedo(width, height), normal(width, height) {}
+        accumulation_buffer albedo, normal;
+    };
+
+    struct path_state {
+        ray      path_ray;
+        color    throughput;
+        int      i, j, sample;
+        uint64_t sort_key;
+    };
+
+    void write_framebuffer(const framebuffer& image) const {
+        auto writer = make_image_writer(output_format, tile_size);
+        if (!write_image(image, *writer, output_path))
+            std::clog << "\rCould not write image to '" << output_path << "'\n";
+
+        std::clog << "\rDone.                 \n";
+    }
+
+    bool wants_features() const {
+        return denoise || !albedo_path.empty() || !normal_path.empty();
+    }
+
+    void finish_features(framebuffer& image, const framebuffer& albedo, const framebuffer& normal) const {
+        // Writes the requested feature images, then denoises `image` with them if asked to.
+        auto writer = make_image_writer(output_format, tile_size);
+        if (!albedo_path.empty() && !write_image(albedo, *writer, albedo_path))
+            std::clog << "\rCould not write albedo image to '" << albedo_path << "'\n";
+        if (!normal_path.empty() && !write_image(normal, *writer, normal_path))
+            std::clog << "\rCould not write normal image to '" << normal_path << "'\n";
+
+        if (denoise) {
+            denoiser filter;
+            filter.thread_count = thread_count;
+            auto start = std::chrono::steady_clock::now();
+            filter.apply(image, albedo, normal);
+            std::clog << "\rDenoised in "
+                      << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()
+                      << "s\n";
+        }
+    }
 
     void initialize() {
         image_height = int(image_width / aspect_ratio);
         image_height = (image_height < 1) ? 1 : image_height;
 
-        pixel_samples_scale = 1.0 / samples_per_pixel;
-
         center = lookfrom;
 
         // Determine viewport dimensions.
@@ -77,6 +271,7 @@ private:
         // Calculate the horizontal and vertical delta vectors from pixel to pixel.
         pixel_delta_u = viewport_u / image_width;
         pixel_delta_v = viewport_v / image_height;
+        pixel_spread = pixel_delta_u.length() / focus_dist;
 
         // Calculate the location of the upper left pixel.
         auto viewport_upper_left = center - (focus_dist * w) - viewport_u / 2 - viewport_v / 2;
@@ -88,51 +283,954 @@ private:
         defocus_disk_v = v * defocus_radius;
     }
 
-    ray get_ray(int i, int j) const {
+    void render_progressive(const hittable& world) {
+        // Renders in passes of `samples_per_pass` samples per pixel, adding each pass into a
+        // float accumulation buffer. At pass boundaries the buffer can be snapshotted to
+        // `checkpoint_path` and resolved into a preview image. Both are copied at the boundary
+        // and written by a background thread while the next pass renders; if the previous write
+        // is still going, that boundary's write is skipped rather than waited for.
+        //
+        // A render that finds a snapshot it can resume (see can_resume) carries on after its last
+        // complete pass. Samplers are keyed on (pass, tile), and the stateless ones on the
+        // absolute sample index, so a resumed render draws exactly the samples an uninterrupted
+        // one would.
+        // Progressive passes always use the path tracer, without adaptive sampling. Feature
+        // images for denoising come only from the passes this process renders.
+
+        accumulation_buffer accumulation(image_width, image_height);
+        std::unique_ptr<feature_sums> features;
+        if (wants_features())
+            features.reset(new feature_sums(image_width, image_height));
+        auto header = render_settings(samples_per_pass);
+
+        int pass_count = (samples_per_pixel + samples_per_pass - 1) / samples_per_pass;
+        int first_pass = 0;
+
+        checkpoint_header stored = header;
+        if (!checkpoint_path.empty() && accumulation.load(checkpoint_path, stored)) {
+            if (can_resume(stored, header, pass_count)) {
+                first_pass = int(stored.passes_done);
+                std::clog << "Resuming from '" << checkpoint_path << "' after pass " << first_pass
+                          << " of " << pass_count << '\n';
+            }
+            else {
+                accumulation = accumulation_buffer(image_width, image_height);
+                std::clog << "Ignoring '" << checkpoint_path << "': render settings differ\n";
+            }
+        }
+
+        tile_scheduler scheduler(image_width, image_height, tile_size);
+        std::future<void> background_write;
+        std::mutex log_lock;
+
+        for (int pass = first_pass; pass < pass_count; pass++) {
+            int sample_begin = pass * samples_per_pass;
+            int sample_end = std::min(samples_per_pixel, sample_begin + samples_per_pass);
+            std::atomic<size_t> tiles_remaining(scheduler.tile_count());
+
+            scheduler.run(thread_count, [&](const tile& t) {
+                render_tile_pass(t, world, accumulation, features.get(), pass, sample_begin, sample_end);
+
+                auto remaining = --tiles_remaining;
+                std::lock_guard<std::mutex> guard(log_lock);
+                std::clog << "\rPass " << pass + 1 << " of " << pass_count << ", tiles remaining: "
+                          << remaining << ' ' << std::flush;
+            });
+
+            if (pass + 1 == pass_count)
+                break;
+
+            bool checkpoint = !checkpoint_path.empty() && (pass + 1) % std::max(1, checkpoint_interval) == 0;
+            bool preview = !preview_path.empty() && (pass + 1) % std::max(1, preview_interval) == 0;
+            if (!checkpoint && !preview)
+                continue;
+            if (background_write.valid()) {
+                if (background_write.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                    continue;
+                background_write.get();
+            }
+
+            header.passes_done = uint32_t(pass + 1);
+            auto snapshot = std::make_shared<accumulation_buffer>(accumulation);
+            background_write = std::async(std::launch::async, [this, snapshot, header, checkpoint, preview] {
+                if (checkpoint)
+                    snapshot->save(checkpoint_path, header);
+                if (preview) {
+                    framebuffer image(image_width, image_height);
+                    snapshot->resolve(image);
+                    write_image(image, *make_image_writer(output_format, tile_size), preview_path);
+                }
+            });
+        }
+
+        if (background_write.valid())
+            background_write.get();
+
+        if (!checkpoint_path.empty()) {
+            // Keep the finished buffer too, so a later render with more samples per pixel can
+            // extend it, where can_resume allows.
+            header.passes_done = uint32_t(pass_count);
+            if (!accumulation.save(checkpoint_path, header))
+                std::clog << "\rCould not write checkpoint '" << checkpoint_path << "'\n";
+        }
+
+        framebuffer image(image_width, image_height);
+        accumulation.resolve(image);
+        if (features) {
+            feature_images resolved(image_width, image_height);
+            features->albedo.resolve(resolved.albedo);
+            features->normal.resolve(resolved.normal);
+            finish_features(image, resolved.albedo, resolved.normal);
+        }
+        write_framebuffer(image);
+    }
+
+    bool can_resume(const checkpoint_header& stored, const checkpoint_header& header, int pass_count) const {
+        // A snapshot with the same settings resumes after its last complete pass. One with a
+        // smaller target sample count can be extended too, if every stored pass was a full one
+        // and the sampler draws the same numbers whatever the target: pcg32 and counter do,
+        // while the stratified and Sobol patterns are laid out over the whole count.
+        if (!stored.matches_passes(header))
+            return false;
+        if (stored.samples_per_pixel == header.samples_per_pixel)
+            return stored.passes_done <= uint32_t(pass_count);
+
+        bool target_free = sampling == sampler_type::pcg32 || sampling == sampler_type::counter;
+        return target_free && stored.samples_per_pixel < header.samples_per_pixel
+            && uint64_t(stored.passes_done) * stored.samples_per_pass <= stored.samples_per_pixel;
+    }
+
+    checkpoint_header render_settings(int pass_samples) const {
+        // The settings a snapshot, or a cluster worker, must share to add to this render.
+        checkpoint_header header;
+        header.width = uint32_t(image_width);
+        header.height = uint32_t(image_height);
+        header.samples_per_pixel = uint32_t(samples_per_pixel);
+        header.samples_per_pass = uint32_t(pass_samples);
+        header.sampler = uint32_t(sampling);
+        header.seed = seed;
+        return header;
+    }
+
+#ifdef OFFLINERT_CLUSTER
+    void render_cluster(const hittable& world) {
+        // Coordinates a render across worker processes: `cluster_workers` forked from this one,
+        // which share the scene copy-on-write, plus any that connect to `cluster_port` from
+        // elsewhere (see render_cluster_worker). The work is the progressive render's: one job
+        // per (tile, pass), handed out pass by pass, a couple in flight per worker so that none
+        // idles waiting for its next job. A worker that drops out has its unfinished jobs
+        // handed to the others.
+        //
+        // Results can arrive in any order, but each tile's passes are added to the accumulation
+        // buffer in pass order, holding early arrivals back. The float sums therefore round
+        // exactly as in a single-process progressive render with the same samples per pass,
+        // and the image is the same bit for bit however many workers took part and whichever
+        // finished first. Feature images, denoising and checkpoints are not distributed.
+
+        if (wants_features() || !checkpoint_path.empty() || !preview_path.empty())
+            std::clog << "Feature images, checkpoints and previews are skipped in distributed renders\n";
+
+        int pass_samples = samples_per_pass > 0 ? samples_per_pass : samples_per_pixel;
+        int pass_count = (samples_per_pixel + pass_samples - 1) / pass_samples;
+        tile_scheduler scheduler(image_width, image_height, tile_size);
+        auto tile_count = uint32_t(scheduler.tile_count());
+        auto settings = render_settings(pass_samples);
+
+        socket_listener listener(std::max(0, cluster_port), cluster_port < 0);
+        if (!listener.is_open()) {
+            std::clog << "Could not listen for workers on port " << cluster_port << '\n';
+            return;
+        }
+        if (cluster_port >= 0)
+            std::clog << "Waiting for workers on port " << listener.port() << '\n';
+
+        std::vector<pid_t> children;
+        for (int k = 0; k < cluster_workers; k++) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                listener.close();
+                render_cluster_worker(world, "127.0.0.1:" + std::to_string(listener.port()));
+                _exit(0);  // Skip the parent's destructors and buffered output
+            }
+            if (pid > 0)
+                children.push_back(pid);
+        }
+        size_t children_alive = children.size();
+
+        struct worker {
+            socket_connection connection;
+            bool ready = false;                 // Sent a matching hello
+            std::deque<cluster_job> in_flight;  // Sent jobs, in the order results come back
+        };
+        std::vector<std::unique_ptr<worker>> workers;
+
+        std::deque<cluster_job> queue;
+        for (uint32_t pass = 0; pass < uint32_t(pass_count); pass++)
+            for (uint32_t t = 0; t < tile_count; t++)
+                queue.push_back({ t, pass });
+
+        struct tile_result {
+            std::vector<float> sums;
+            std::vector<uint32_t> counts;
+        };
+        accumulation_buffer accumulation(image_width, image_height);
+        std::vector<uint32_t> next_pass(tile_count, 0);
+        std::map<std::pair<uint32_t, uint32_t>, tile_result> held;  // Keyed on (tile, pass)
+        size_t merged = 0, job_count = queue.size();
+
+        auto merge = [&](const tile& t, const tile_result& result) {
+            size_t k = 0;
+            for (int j = t.y0; j < t.y1; j++)
+                for (int i = t.x0; i < t.x1; i++, k++)
+                    accumulation.add(i, j, color(result.sums[3 * k], result.sums[3 * k + 1], result.sums[3 * k + 2]),
+                                     result.counts[k]);
+            next_pass[t.index]++;
+            merged++;
+        };
+
+        auto drop = [&](size_t w) {
+            auto& lost = workers[w]->in_flight;
+            for (auto job = lost.rbegin(); job != lost.rend(); ++job)
+                queue.push_front(*job);
+            workers.erase(workers.begin() + w);
+        };
+
+        auto start = std::chrono::steady_clock::now();
+        while (merged < job_count) {
+            // Top up every worker's jobs, then wait for a connection or a message.
+            for (size_t w = 0; w < workers.size(); w++) {
+                auto& wk = *workers[w];
+                while (wk.ready && wk.in_flight.size() < 2 && !queue.empty()) {
+                    if (!wk.connection.send_all(&queue.front(), sizeof(cluster_job)))
+                        break;
+                    wk.in_flight.push_back(queue.front());
+                    queue.pop_front();
+                }
+            }
+
+            for (pid_t pid; children_alive > 0 && (pid = waitpid(-1, nullptr, WNOHANG)) > 0;)
+                children_alive--;
+            if (workers.empty() && children_alive == 0 && cluster_port < 0) {
+                std::clog << "\rEvery worker stopped before the render finished\n";
+                return;
+            }
+
+            std::vector<pollfd> fds(1 + workers.size());
+            fds[0] = { listener.handle(), POLLIN, 0 };
+            for (size_t w = 0; w < workers.size(); w++)
+                fds[1 + w] = { workers[w]->connection.handle(), POLLIN, 0 };
+            if (poll(fds.data(), nfds_t(fds.size()), 1000) <= 0)
+                continue;
+
+            // Back to front, so dropping a worker leaves the indices still to visit intact.
+            for (size_t w = workers.size(); w-- > 0;) {
+                if (!fds[1 + w].revents)
+                    continue;
+                auto& wk = *workers[w];
+
+                if (!wk.ready) {
+                    cluster_hello hello;
+                    if (!wk.connection.receive_all(&hello, sizeof(hello)) || !hello.settings.matches(settings)
+                        || hello.tile_size != uint32_t(tile_size) || hello.max_depth != uint32_t(max_depth)) {
+                        std::clog << "\rRejected a worker with different render settings\n";
+                        drop(w);
+                        continue;
+                    }
+                    wk.ready = true;
+                    continue;
+                }
+
+                cluster_result header;
+                tile_result result;
+                bool ok = wk.connection.receive_all(&header, sizeof(header)) && !wk.in_flight.empty()
+                       && header.tile == wk.in_flight.front().tile && header.pass == wk.in_flight.front().pass;
+                if (ok) {
+                    const tile& t = scheduler.tile_at(header.tile);
+                    size_t pixels = size_t(t.x1 - t.x0) * (t.y1 - t.y0);
+                    result.sums.resize(3 * pixels);
+                    result.counts.resize(pixels);
+                    ok = wk.connection.receive_all(result.sums.data(), result.sums.size() * sizeof(float))
+                      && wk.connection.receive_all(result.counts.data(), result.counts.size() * sizeof(uint32_t));
+                }
+                if (!ok) {
+                    std::clog << "\rLost a worker; reassigning its " << wk.in_flight.size() << " jobs\n";
+                    drop(w);
+                    continue;
+                }
+                wk.in_flight.pop_front();
+
+                // Add this pass if it is the tile's next, then any later passes it unblocks.
+                const tile& t = scheduler.tile_at(header.tile);
+                if (header.pass != next_pass[header.tile]) {
+                    held[{ header.tile, header.pass }] = std::move(result);
+                    continue;
+                }
+                merge(t, result);
+                for (auto it = held.find({ header.tile, next_pass[header.tile] }); it != held.end();
+                     it = held.find({ header.tile, next_pass[header.tile] })) {
+                    merge(t, it->second);
+                    held.erase(it);
+                }
+                std::clog << "\rJobs merged: " << merged << " of " << job_count << ", workers: "
+                          << workers.size() << ' ' << std::flush;
+            }
+
+            if (fds[0].revents & POLLIN) {
+                auto connection = listener.accept_connection();
+                if (connection.is_open()) {
+                    workers.emplace_back(new worker);
+                    workers.back()->connection = std::move(connection);
+                }
+            }
+        }
+
+        cluster_job done;
+        for (auto& wk : workers)
+            wk->connection.send_all(&done, sizeof(done));
+        workers.clear();
+        for (auto pid : children)
+            waitpid(pid, nullptr, 0);
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::clog << "\rRendered " << job_count << " jobs in " << elapsed.count() << "s\n";
+
+        framebuffer image(image_width, image_height);
+        accumulation.resolve(image);
+        write_framebuffer(image);
+    }
+
+    void render_cluster_worker(const hittable& world, const std::string& address) {
+        // Renders jobs for the coordinator at `address` until it says it is done. The scene and
+        // camera must be set up exactly as the coordinator's; the hello carries the settings it
+        // can check. Each job is traced on one thread, so a many-core machine runs one worker
+        // process per core.
+        auto connection = socket_connection::connect_to(address);
+        if (!connection.is_open()) {
+            std::clog << "Could not connect to coordinator '" << address << "'\n";
+            return;
+        }
+
+        int pass_samples = samples_per_pass > 0 ? samples_per_pass : samples_per_pixel;
+        cluster_hello hello;
+        hello.settings = render_settings(pass_samples);
+        hello.tile_size = uint32_t(tile_size);
+        hello.max_depth = uint32_t(max_depth);
+        if (!connection.send_all(&hello, sizeof(hello)))
+            return;
+
+        tile_scheduler scheduler(image_width, image_height, tile_size);
+        std::vector<float> sums;
+        std::vector<uint32_t> counts;
+        cluster_job job;
+        while (connection.receive_all(&job, sizeof(job)) && job.tile < scheduler.tile_count()) {
+            const tile& t = scheduler.tile_at(job.tile);
+            int sample_begin = int(job.pass) * pass_samples;
+            int sample_end = std::min(samples_per_pixel, sample_begin + pass_samples);
+
+            sums.clear();
+            counts.clear();
+            trace_tile_pass(t, world, false, int(job.pass), sample_begin, sample_end,
+                [&](int, int, const color& sum, const color&, const color&, uint32_t count) {
+                    sums.push_back(float(sum.x()));
+                    sums.push_back(float(sum.y()));
+                    sums.push_back(float(sum.z()));
+                    counts.push_back(count);
+                });
+
+            cluster_result result{ job.tile, job.pass };
+            if (!connection.send_all(&result, sizeof(result))
+                || !connection.send_all(sums.data(), sums.size() * sizeof(float))
+                || !connection.send_all(counts.data(), counts.size() * sizeof(uint32_t)))
+                return;
+        }
+    }
+#endif
+
+    void render_tile_pass(
+        const tile& t, const hittable& world, accumulation_buffer& accumulation,
+        feature_sums* features, int pass, int sample_begin, int sample_end
+    ) const {
+        trace_tile_pass(t, world, features != nullptr, pass, sample_begin, sample_end,
+            [&](int i, int j, const color& sum, const color& albedo_sum, const color& normal_sum, uint32_t count) {
+                accumulation.add(i, j, sum, count);
+                if (features) {
+                    features->albedo.add(i, j, albedo_sum, count);
+                    features->normal.add(i, j, normal_sum, count);
+                }
+            });
+    }
+
+    template <typename Sink>
+    void trace_tile_pass(
+        const tile& t, const hittable& world, bool with_features,
+        int pass, int sample_begin, int sample_end, Sink&& sink
+    ) const {
+        // Traces samples [sample_begin, sample_end) of every pixel in the tile and hands each
+        // pixel's sums to `sink`. The sampler stream is keyed on the pass as well as the tile,
+        // so each pass draws its own numbers no matter which passes ran in this process.
+        auto stream = uint64_t(uint32_t(pass)) << 32 | uint32_t(t.index);
+        auto s = make_sampler(sampling, seed, stream, samples_per_pixel);
+
+        for (int j = t.y0; j < t.y1; j++) {
+            for (int i = t.x0; i < t.x1; i++) {
+                color pixel_color(0, 0, 0), albedo_sum(0, 0, 0), normal_sum(0, 0, 0);
+                surface_features first_hit;
+                for (int sample = sample_begin; sample < sample_end; sample++) {
+                    s->start_pixel(i, j, sample);
+                    ray r = get_ray(i, j, *s);
+                    pixel_color += ray_color(r, world, *s, with_features ? &first_hit : nullptr);
+                    if (with_features) {
+                        albedo_sum += first_hit.albedo;
+                        normal_sum += first_hit.normal;
+                    }
+                }
+                sink(i, j, pixel_color, albedo_sum, normal_sum, uint32_t(sample_end - sample_begin));
+            }
+        }
+    }
+
+    uint64_t render_tile(const tile& t, const hittable& world, framebuffer& image, feature_images* features) const {
+        // Renders one tile and returns the number of samples it took. With `features`, also
+        // averages each pixel's first-hit albedo and normal into them.
+
+        // Key the sampler on the tile index rather than the thread, so every tile draws the same
+        // random sequence whichever worker renders it.
+        auto s = make_sampler(sampling, seed, uint64_t(t.index), samples_per_pixel);
+        uint64_t samples_taken = 0;
+
+        for (int j = t.y0; j < t.y1; j++) {
+            for (int i = t.x0; i < t.x1; i++) {
+                color pixel_color(0, 0, 0), albedo_sum(0, 0, 0), normal_sum(0, 0, 0);
+                surface_features first_hit;
+                int sample = 0;
+                double mean = 0, m2 = 0;  // Running luminance mean and squared deviation
+
+                while (sample < samples_per_pixel) {
+                    s->start_pixel(i, j, sample);
+                    ray r = get_ray(i, j, *s);
+                    color sample_color = ray_color(r, world, *s, features ? &first_hit : nullptr);
+                    pixel_color += sample_color;
+                    if (features) {
+                        albedo_sum += first_hit.albedo;
+                        normal_sum += first_hit.normal;
+                    }
+                    sample++;
+
+                    if (adaptive_threshold > 0) {
+                        // Welford's update of the luminance variance, then stop once the
+                        // standard error of the mean is small next to the mean itself.
+                        auto y = luminance(sample_color);
+                        auto delta = y - mean;
+                        mean += delta / sample;
+                        m2 += delta * (y - mean);
+
+                        if (sample >= min_samples_per_pixel && sample > 1) {
+                            auto std_error = std::sqrt(m2 / (sample - 1) / sample);
+                            if (std_error <= adaptive_threshold * std::fmax(mean, 0.01))
+                                break;
+                        }
+                    }
+                }
+
+                image.at(i, j) = pixel_color / sample;
+                if (features) {
+                    features->albedo.at(i, j) = albedo_sum / sample;
+                    features->normal.at(i, j) = normal_sum / sample;
+                }
+                samples_taken += sample;
+            }
+        }
+
+        return samples_taken;
+    }
+
+    uint64_t render_tile_packets(
+        const tile& t, const hittable& world, framebuffer& image,
+        std::vector<bounce_stats>& stats
+    ) const {
+        // Advances every sample path of the tile one bounce at a time. Each bounce gathers the
+        // live paths into packets of `packet_size` rays for hittable::hit_packet, then scatters
+        // each path on its own. Primary rays are laid out in Morton order within the tile, so
+        // each packet covers a compact block of pixels. In stream mode the surviving paths are
+        // sorted by direction octant and origin before each secondary bounce, regrouping rays
+        // that diffuse bounces have scattered apart.
+
+        auto s = make_sampler(sampling, seed, uint64_t(t.index), samples_per_pixel);
+        int width = t.x1 - t.x0, height = t.y1 - t.y0;
+        int packet_rays = std::max(1, std::min(packet_size, ray_packet::max_size));
+
+        std::vector<int> pixel_order(size_t(width) * height);
+        for (int k = 0; k < width * height; k++)
+            pixel_order[k] = k;
+        std::sort(pixel_order.begin(), pixel_order.end(), [width](int a, int b) {
+            return morton_2d(a % width, a / width) < morton_2d(b % width, b / width);
+        });
+
+        std::vector<path_state> paths;
+        paths.reserve(pixel_order.size() * samples_per_pixel);
+        for (int sample = 0; sample < samples_per_pixel; sample++) {
+            for (int k : pixel_order) {
+                int i = t.x0 + k % width, j = t.y0 + k / width;
+                s->start_pixel(i, j, sample);
+                paths.push_back({ get_ray(i, j, *s), color(1, 1, 1), i, j, sample, 0 });
+            }
+        }
+
+        std::vector<color> tile_color(size_t(width) * height, color(0, 0, 0));
+        auto scene_box = world.bounding_box();
+        ray_packet packet;
+        hit_record recs[ray_packet::max_size];
+
+        for (int bounce = 0; bounce < max_depth && !paths.empty(); bounce++) {
+            if (mode == render_mode::stream && bounce > 0) {
+                for (auto& path : paths)
+                    path.sort_key = stream_key(path.path_ray, scene_box);
+                std::stable_sort(paths.begin(), paths.end(),
+                    [](const path_state& a, const path_state& b) { return a.sort_key < b.sort_key; });
+            }
+
+            size_t survivors = 0;
+            auto start_time = std::chrono::steady_clock::now();
+            double shading_seconds = 0;
+
+            for (size_t first = 0; first < paths.size(); first += packet_rays) {
+                size_t count = std::min(paths.size() - first, size_t(packet_rays));
+
+                packet.clear();
+                for (size_t k = 0; k < count; k++)
+                    packet.add(paths[first + k].path_ray, infinity);
+                uint32_t hits = world.hit_packet(packet, real(0.001), recs);
+
+                auto shade_start = std::chrono::steady_clock::now();
+                for (size_t k = 0; k < count; k++) {
+                    auto path = paths[first + k];
+                    auto& pixel = tile_color[size_t(path.j - t.y0) * width + (path.i - t.x0)];
+
+                    if (!(hits & (1u << k))) {
+                        pixel += path.throughput * background(path.path_ray);
+                        continue;
+                    }
+                    pixel += path.throughput * scene_materials->emitted(recs[k].mat, recs[k]);
+
+                    evaluate_texture(recs[k], path.path_ray, bounce);
+                    s->start_pixel(path.i, path.j, path.sample);
+                    if (extend_path(path.path_ray, recs[k], bounce, path.throughput, *s))
+                        paths[survivors++] = path;
+                }
+                shading_seconds += std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - shade_start).count();
+            }
+
+            stats[bounce].rays += paths.size();
+            stats[bounce].seconds += std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start_time).count() - shading_seconds;
+            paths.resize(survivors);
+        }
+
+        // Paths still alive past max_depth gather no more light.
+        for (int k = 0; k < width * height; k++)
+            image.at(t.x0 + k % width, t.y0 + k / width) = tile_color[k] / samples_per_pixel;
+
+        return uint64_t(width) * height * samples_per_pixel;
+    }
+
+    void render_wavefront(const hittable& world, framebuffer& image) const {
+        // Keeps up to `wavefront_queue_size` paths in flight in a structure-of-arrays queue and
+        // advances all of them one stage at a time:
+        //   generate   - refill dead slots with fresh camera samples
+        //   extend     - find the closest hit of every live path
+        //   accumulate - add the sky contribution of paths that escaped, and retire them
+        //   shade      - scatter the remaining paths, one tight loop per material type
+        // Every stage runs over fixed-size chunks, each with its own sampler stream, so the image
+        // does not depend on the worker count.
+
+        const size_t chunk_size = 4096;
+        const size_t pixel_count = size_t(image_width) * image_height;
+        const uint64_t total_jobs = uint64_t(pixel_count) * samples_per_pixel;
+
+        std::vector<color> accumulation(pixel_count, color(0, 0, 0));
+        // Each stage has a stream per chunk, so the queue is capped at one block of streams' worth
+        // of chunks.
+        auto max_queue = uint64_t(chunk_size) * wavefront_chunk_streams;
+        path_queue queue(size_t(std::max<uint64_t>(1, std::min({ uint64_t(wavefront_queue_size), total_jobs, max_queue }))));
+        uint64_t next_job = 0;
+
+        std::vector<size_t> fresh;
+        std::vector<uint64_t> fresh_jobs;
+        std::vector<size_t> by_material[4];
+        double stage_seconds[4] = {};
+        auto clock = [] { return std::chrono::steady_clock::now(); };
+        auto seconds_since = [&](std::chrono::steady_clock::time_point t) {
+            return std::chrono::duration<double>(clock() - t).count();
+        };
+
+        for (uint64_t iteration = 0;; iteration++) {
+            // Generate. Jobs are numbered sample-major, so neighbouring fresh paths are
+            // neighbouring pixels of the same sample.
+            auto start = clock();
+            fresh.clear();
+            fresh_jobs.clear();
+            for (size_t k = 0; k < queue.size() && next_job < total_jobs; k++) {
+                if (!queue.alive[k]) {
+                    fresh.push_back(k);
+                    fresh_jobs.push_back(next_job++);
+                }
+            }
+
+            tile_scheduler::parallel_chunks(fresh.size(), chunk_size, thread_count,
+                [&](size_t chunk, size_t begin, size_t end) {
+                    auto s = make_sampler(sampling, seed, wavefront_stream(iteration, 0, chunk), samples_per_pixel);
+                    for (size_t n = begin; n < end; n++) {
+                        auto k = fresh[n];
+                        auto pixel = uint32_t(fresh_jobs[n] % pixel_count);
+                        auto sample = int(fresh_jobs[n] / pixel_count);
+                        int i = int(pixel % image_width), j = int(pixel / image_width);
+
+                        s->start_pixel(i, j, sample);
+                        queue.set_ray(k, get_ray(i, j, *s));
+                        queue.set_throughput(k, color(1, 1, 1));
+                        queue.pixel[k] = pixel;
+                        queue.sample[k] = sample;
+                        queue.bounce[k] = 0;
+                        queue.alive[k] = 1;
+                    }
+                });
+            stage_seconds[0] += seconds_since(start);
+
+            // Extend.
+            start = clock();
+            std::atomic<size_t> live(0);
+            tile_scheduler::parallel_chunks(queue.size(), chunk_size, thread_count,
+                [&](size_t, size_t begin, size_t end) {
+                    size_t chunk_live = 0;
+                    for (size_t k = begin; k < end; k++) {
+                        if (!queue.alive[k])
+                            continue;
+                        auto path_ray = queue.path_ray(k);
+                        queue.hit[k] = world.hit(path_ray, interval(0.001, infinity), queue.hits[k]);
+                        if (queue.hit[k])
+                            evaluate_texture(queue.hits[k], path_ray, queue.bounce[k]);
+                        chunk_live++;
+                    }
+                    live += chunk_live;
+                });
+            stage_seconds[1] += seconds_since(start);
+
+            if (live == 0)
+                break;
+
+            // Accumulate escaped paths and emission, retire paths that hit lights, and bin the
+            // rest by material type.
+            start = clock();
+            for (auto& bin : by_material)
+                bin.clear();
+            for (size_t k = 0; k < queue.size(); k++) {
+                if (!queue.alive[k])
+                    continue;
+                if (!queue.hit[k]) {
+                    accumulation[queue.pixel[k]] += queue.throughput(k) * background(queue.path_ray(k));
+                    queue.alive[k] = 0;
+                    continue;
+                }
+                const auto& rec = queue.hits[k];
+                auto kind = rec.mat.kind();
+                if (kind == material_kind::diffuse_light || kind == material_kind::other)
+                    accumulation[queue.pixel[k]] += queue.throughput(k) * scene_materials->emitted(rec.mat, rec);
+                if (kind == material_kind::diffuse_light) {
+                    queue.alive[k] = 0;  // Lights scatter nothing
+                    continue;
+                }
+                by_material[int(kind)].push_back(k);
+            }
+            stage_seconds[2] += seconds_since(start);
+
+            // Shade.
+            start = clock();
+            shade_queue<material>(queue, by_material[int(material_kind::other)], material_kind::other, iteration);
+            shade_queue<lambertian>(queue, by_material[int(material_kind::lambertian)], material_kind::lambertian, iteration);
+            shade_queue<metal>(queue, by_material[int(material_kind::metal)], material_kind::metal, iteration);
+            shade_queue<dielectric>(queue, by_material[int(material_kind::dielectric)], material_kind::dielectric, iteration);
+            stage_seconds[3] += seconds_since(start);
+        }
+
+        for (size_t p = 0; p < pixel_count; p++)
+            image[p] = accumulation[p] / samples_per_pixel;
+
+        std::clog << "Wavefront queue " << queue.size() << ": generate " << stage_seconds[0]
+                  << "s, extend " << stage_seconds[1] << "s, accumulate " << stage_seconds[2]
+                  << "s, shade " << stage_seconds[3] << "s\n";
+    }
+
+    template <typename Material>
+    void shade_queue(path_queue& queue, const std::vector<size_t>& slots, material_kind kind,
+                     uint64_t iteration) const {
+        // Scatters every path in `slots`, all of which hit a `Material` of the given kind. For the
+        // built-in material types, the scatter call below is resolved statically and inlined into
+        // the loop.
+        tile_scheduler::parallel_chunks(slots.size(), 4096, thread_count,
+            [&](size_t chunk, size_t begin, size_t end) {
+                auto s = make_sampler(sampling, seed, wavefront_stream(iteration, 1 + int(kind), chunk), samples_per_pixel);
+                for (size_t n = begin; n < end; n++) {
+                    auto k = slots[n];
+                    const auto& rec = queue.hits[k];
+                    auto path_ray = queue.path_ray(k);
+                    auto throughput = queue.throughput(k);
+                    auto pixel = queue.pixel[k];
+
+                    s->start_pixel(int(pixel % image_width), int(pixel / image_width), queue.sample[k]);
+                    bool alive = extend_path_as(scene_materials->get<Material>(rec.mat.index()), path_ray, rec,
+                                                queue.bounce[k], throughput, *s);
+
+                    if (alive && ++queue.bounce[k] < max_depth) {
+                        queue.set_ray(k, path_ray);
+                        queue.set_throughput(k, throughput);
+                    }
+                    else {
+                        // The path was absorbed, lost at roulette, or ran out of bounces.
+                        queue.alive[k] = 0;
+                    }
+                }
+            });
+    }
+
+    static uint32_t morton_2d(int x, int y) {
+        uint32_t code = 0;
+        for (int bit = 0; bit < 16; bit++) {
+            code |= ((uint32_t(x) >> bit) & 1) << (2 * bit);
+            code |= ((uint32_t(y) >> bit) & 1) << (2 * bit + 1);
+        }
+        return code;
+    }
+
+    static uint64_t stream_key(const ray& r, const aabb& scene_box) {
+        // Direction octant in the top bits, then a 3D Morton code of the origin quantized to
+        // 10 bits per axis within the scene bounds.
+        const auto& d = r.direction();
+        uint64_t octant = (d.x() < 0 ? 1 : 0) | (d.y() < 0 ? 2 : 0) | (d.z() < 0 ? 4 : 0);
+
+        uint64_t code = 0;
+        for (int axis = 0; axis < 3; axis++) {
+            const auto& range = scene_box.axis_interval(axis);
+            auto f = range.size() > 0 ? (r.origin()[axis] - range.min) / range.size() : real(0);
+            auto q = uint64_t(std::fmin(std::fmax(f, real(0)), real(1)) * 1023);
+            for (int bit = 0; bit < 10; bit++)
+                code |= ((q >> bit) & 1) << (3 * bit + axis);
+        }
+
+        return (octant << 30) | code;
+    }
+
+    static double luminance(const color& c) {
+        return 0.2126 * c.x() + 0.7152 * c.y() + 0.0722 * c.z();
+    }
+
+    ray get_ray(int i, int j, sampler& s) const {
         // Construct a camera ray originating from the defocus disk and directed at a randomly
         // sampled point around the pixel location i, j.
 
-        auto offset = sample_square();
+        auto offset = sample_square(s);
         auto pixel_sample = pixel00_loc
             + ((i + offset.x()) * pixel_delta_u)
             + ((j + offset.y()) * pixel_delta_v);
 
-        auto ray_origin = (defocus_angle <= 0) ? center : defocus_disk_sample();
+        auto ray_origin = (defocus_angle <= 0) ? center : defocus_disk_sample(s);
         auto ray_direction = pixel_sample - ray_origin;
 
-        return ray(ray_origin, ray_direction);
+        // Only draw a time while the shutter is open, so still frames keep their samples.
+        if (shutter_close <= shutter_open)
+            return ray(ray_origin, ray_direction, real(shutter_open));
+        return ray(ray_origin, ray_direction, real(s.random_double(shutter_open, shutter_close)));
     }
 
-    vec3 sample_square() const {
+    vec3 sample_square(sampler& s) const {
         // Returns the vector to a random point in the [-.5,-.5]-[+.5,+.5] unit square.
-        return vec3(random_double() - 0.5, random_double() - 0.5, 0);
+        double u, v;
+        s.next_2d(u, v);
+        return vec3(u - 0.5, v - 0.5, 0);
     }
 
-    point3 defocus_disk_sample() const {
+    point3 defocus_disk_sample(sampler& s) const {
         // Returns a random point in the camera defocus disk.
-        auto p = random_in_unit_disk();
+        auto p = random_in_unit_disk(s);
         return center + (p[0] * defocus_disk_u) + (p[1] * defocus_disk_v);
     }
 
-	color ray_color(const ray& r, int depth, const hittable& world) const {
+	color ray_color(const ray& r, const hittable& world, sampler& s, surface_features* first_hit = nullptr) const {
+        // Follows the path iteratively, carrying the product of the attenuations seen so far
+        // as the path throughput, instead of multiplying them back up a recursive call stack.
+        //
+        // With next-event estimation, every diffuse hit also sends a shadow ray toward a
+        // sampled light. Emitters can then be reached two ways, and each estimate is weighted
+        // by the power heuristic on the two sampling densities (multiple importance sampling).
+        color radiance(0, 0, 0);
+        color throughput(1.0, 1.0, 1.0);
+        ray path_ray = r;
+        hit_record rec;
+        double scatter_pdf = 0;  // Density of path_ray's direction, 0 if it can't be light-sampled
+        bool sample_lights = next_event_estimation && !scene_lights->empty();
+
+        for (int bounce = 0; bounce < max_depth; bounce++) {
+            bool hit = world.hit(path_ray, interval(0.001, infinity), rec);
+            if (hit)
+                evaluate_texture(rec, path_ray, bounce);
+            if (bounce == 0 && first_hit) {
+                first_hit->albedo = hit ? scene_materials->albedo(rec) : background(path_ray);
+                first_hit->normal = hit ? rec.normal : vec3(0, 0, 0);
+            }
+            if (!hit)
+                return radiance + throughput * background(path_ray);
+
+            auto emission = scene_materials->emitted(rec.mat, rec);
+            if (emission.x() > 0 || emission.y() > 0 || emission.z() > 0) {
+                double weight = 1;
+                if (sample_lights && scatter_pdf > 0 && rec.mat.kind() == material_kind::diffuse_light) {
+                    auto light = scene_materials->get<diffuse_light>(rec.mat.index()).light();
+                    weight = power_heuristic(scatter_pdf, scene_lights->pdf(light, path_ray.origin()));
+                }
+                radiance += throughput * emission * weight;
+            }
+
+            // Light sampling happens after the scatter, so the scatter keeps the bounce's first
+            // sample dimensions, and only where a further bounce could have found the light.
+            bool diffuse = rec.mat.kind() == material_kind::lambertian;
+            auto vertex_throughput = throughput;
+            bool alive = extend_path(path_ray, rec, bounce, throughput, s);
+
+            scatter_pdf = 0;
+            if (diffuse && sample_lights && bounce + 1 < max_depth) {
+                const auto& mat = scene_materials->get<lambertian>(rec.mat.index());
+                radiance += vertex_throughput * sample_light(world, mat, rec, path_ray.time(), s);
+                if (alive)
+                    scatter_pdf = mat.scattering_pdf(rec, path_ray.direction());
+            }
+
+            if (!alive)
+                return radiance;
+        }
+
         // If we've exceeded the ray bounce limit, no more light is gathered.
-        if (depth <= 0)
+        return radiance;
+	}
+
+    color sample_light(
+        const hittable& world, const lambertian& mat, const hit_record& rec, real time, sampler& s
+    ) const {
+        // One light sample's contribution at a diffuse hit, MIS-weighted against the chance of
+        // scatter() finding the same light.
+        light_list::light_sample light;
+        if (!scene_lights->sample(rec.p, s, light))
+            return color(0, 0, 0);
+
+        auto scatter_pdf = mat.scattering_pdf(rec, light.direction);
+        if (scatter_pdf <= 0)
             return color(0, 0, 0);
-        
-        hit_record rec;
 
-		if (world.hit(r, interval(0.001, infinity), rec)) {
-            ray scattered;
-            color attenuation;
-            if (rec.mat->scatter(r, rec, attenuation, scattered))
-                return attenuation * ray_color(scattered, depth - 1, world);
+        // Stop the shadow ray just short of the light's own surface.
+        hit_record blocker;
+        if (world.hit(ray(rec.p, light.direction, time), interval(0.001, light.distance * real(0.9999)), blocker))
             return color(0, 0, 0);
-		}
 
+        auto weight = power_heuristic(light.pdf, scatter_pdf);
+        return mat.evaluate(rec, light.direction) * light.emission * real(weight / light.pdf);
+    }
+
+    static double power_heuristic(double pdf, double other_pdf) {
+        auto a = pdf * pdf, b = other_pdf * other_pdf;
+        return a + b > 0 ? a / (a + b) : 0;
+    }
+
+    void evaluate_texture(hit_record& rec, const ray& r, int bounce) const {
+        // Looks up the hit material's texture, if any, into rec.texture_color. The lookup is
+        // filtered over the pixel's footprint on the surface. For camera rays that comes from
+        // ray differentials: the rays through the neighbouring pixels, from the same lens
+        // point, meet the tangent plane at dpdx and dpdy from the hit. Later bounces have no
+        // differentials to follow, so they use the footprint a camera ray would have at that
+        // distance, which underestimates the blur of curved reflections but stays stable.
+        auto tex = scene_materials->texture(rec.mat);
+        if (!tex)
+            return;
+
+        vec3 dpdx, dpdy;
+        if (bounce == 0) {
+            auto plane_offset = [&](const vec3& direction) {
+                auto along = dot(rec.normal, direction);
+                if (std::fabs(along) < real(1e-8))
+                    return vec3(0, 0, 0);
+                return r.origin() + (dot(rec.normal, rec.p - r.origin()) / along) * direction - rec.p;
+            };
+            dpdx = plane_offset(r.direction() + pixel_delta_u);
+            dpdy = plane_offset(r.direction() + pixel_delta_v);
+        }
+        else {
+            auto width = real(pixel_spread) * (rec.p - center).length();
+            auto tangent = rec.dpdu - dot(rec.dpdu, rec.normal) * rec.normal;
+            if (tangent.near_zero())
+                tangent = cross(rec.normal, std::fabs(rec.normal.x()) > real(0.9) ? vec3(0, 1, 0) : vec3(1, 0, 0));
+            tangent = unit_vector(tangent);
+            dpdx = width * tangent;
+            dpdy = width * cross(rec.normal, tangent);
+        }
+
+        // Least-squares (du, dv) for each offset: dp = du * dpdu + dv * dpdv.
+        texture_lookup at;
+        at.p = rec.p;
+        at.u = rec.u;
+        at.v = rec.v;
+        auto a = dot(rec.dpdu, rec.dpdu), b = dot(rec.dpdu, rec.dpdv), c = dot(rec.dpdv, rec.dpdv);
+        auto det = a * c - b * b;
+        if (std::fabs(det) > real(1e-20)) {
+            auto solve = [&](const vec3& dp, real& du, real& dv) {
+                auto pu = dot(rec.dpdu, dp), pv = dot(rec.dpdv, dp);
+                du = (c * pu - b * pv) / det;
+                dv = (a * pv - b * pu) / det;
+            };
+            solve(dpdx, at.dudx, at.dvdx);
+            solve(dpdy, at.dudy, at.dvdy);
+        }
+        rec.texture_color = scene_materials->textures.value(tex, at);
+    }
+
+    bool extend_path(ray& path_ray, const hit_record& rec, int bounce, color& throughput, sampler& s) const {
+        return scene_materials->visit(rec.mat, [&](const auto& mat) {
+            return extend_path_as(mat, path_ray, rec, bounce, throughput, s);
+        });
+    }
+
+    template <typename Material>
+    bool extend_path_as(
+        const Material& mat, ray& path_ray, const hit_record& rec, int bounce, color& throughput,
+        sampler& s
+    ) const {
+        // Scatters the path off the surface it hit, replacing `path_ray` with the next segment
+        // and folding the attenuation into `throughput`. Returns false if the path ends here.
+        ray scattered;
+        color attenuation;
+        s.start_bounce(bounce);
+        if (!mat.scatter(path_ray, rec, attenuation, scattered, s))
+            return false;
+
+        throughput = throughput * attenuation;
+
+        if (russian_roulette_depth >= 0 && bounce >= russian_roulette_depth) {
+            // Russian roulette: continue with a probability that follows the throughput,
+            // and reweight the survivors so the estimate stays unbiased.
+            auto p = std::fmin(0.95, std::fmax(throughput.x(), std::fmax(throughput.y(), throughput.z())));
+            if (s.random_double() >= p)
+                return false;
+            throughput /= p;
+        }
+
+        path_ray = scattered;
+        return true;
+    }
+
+    color background(const ray& r) const {
+        if (!sky_light)
+            return color(0, 0, 0);
 		vec3 unit_direction = unit_vector(r.direction());
 		auto a = 0.5 * (unit_direction.y() + 1.0);
 		return (1.0 - a) * color(1.0, 1.0, 1.0) + a * color(0.5, 0.7, 1.0);
-	}
+    }
 };
 
 #endif
\ No newline at end of file
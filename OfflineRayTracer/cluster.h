@@ -0,0 +1,181 @@
+#pragma once
+#ifndef CLUSTER_H
+#define CLUSTER_H
+
+#include "accumulation_buffer.h"
+
+#include <cstdint>
+#include <string>
+
+// Wire format of distributed renders. A coordinator hands (tile, pass) jobs to worker processes
+// over TCP and merges the float sums they send back. All messages are fixed-size structs in
+// host byte order, so coordinator and workers must share an architecture.
+//
+//   worker -> coordinator  cluster_hello, once after connecting
+//   coordinator -> worker  cluster_job, repeatedly; a job with tile == cluster_job::done ends
+//   worker -> coordinator  cluster_result per job, followed by the tile's RGB float sums and
+//                          uint32 sample counts, row by row
+
+struct cluster_hello {
+    checkpoint_header settings;  // Must match the coordinator's, or it hangs up
+    uint32_t tile_size = 0;
+    uint32_t max_depth = 0;
+};
+
+struct cluster_job {
+    static const uint32_t done = 0xFFFFFFFFu;
+    uint32_t tile = done;
+    uint32_t pass = 0;
+};
+
+struct cluster_result {
+    uint32_t tile = 0;
+    uint32_t pass = 0;
+};
+
+static_assert(sizeof(cluster_hello) == 48, "cluster_hello must have no padding");
+
+#ifndef _WIN32
+#define OFFLINERT_CLUSTER
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+class socket_connection {
+public:
+    // A connected TCP stream with blocking whole-message sends and receives.
+    socket_connection() {}
+    explicit socket_connection(int fd) : fd(fd) {
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+    socket_connection(socket_connection&& other) noexcept : fd(other.fd) { other.fd = -1; }
+    socket_connection& operator=(socket_connection&& other) noexcept {
+        if (this != &other) {
+            close();
+            fd = other.fd;
+            other.fd = -1;
+        }
+        return *this;
+    }
+    socket_connection(const socket_connection&) = delete;
+    socket_connection& operator=(const socket_connection&) = delete;
+    ~socket_connection() { close(); }
+
+    static socket_connection connect_to(const std::string& address) {
+        // `address` is "host:port". Returns a closed connection on failure.
+        auto colon = address.rfind(':');
+        if (colon == std::string::npos)
+            return socket_connection();
+        std::string host = address.substr(0, colon), port = address.substr(colon + 1);
+
+        addrinfo hints = {}, *found = nullptr;
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(host.c_str(), port.c_str(), &hints, &found) != 0)
+            return socket_connection();
+
+        int fd = -1;
+        for (auto* a = found; a && fd < 0; a = a->ai_next) {
+            fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+            if (fd >= 0 && connect(fd, a->ai_addr, a->ai_addrlen) != 0) {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+        freeaddrinfo(found);
+        return fd >= 0 ? socket_connection(fd) : socket_connection();
+    }
+
+    bool is_open() const { return fd >= 0; }
+    int handle() const { return fd; }
+
+    bool send_all(const void* data, size_t size) {
+        auto* p = static_cast<const char*>(data);
+        while (size > 0) {
+            auto sent = ::send(fd, p, size, MSG_NOSIGNAL);
+            if (sent <= 0)
+                return false;
+            p += sent;
+            size -= size_t(sent);
+        }
+        return true;
+    }
+
+    bool receive_all(void* data, size_t size) {
+        auto* p = static_cast<char*>(data);
+        while (size > 0) {
+            auto received = ::recv(fd, p, size, 0);
+            if (received <= 0)
+                return false;
+            p += received;
+            size -= size_t(received);
+        }
+        return true;
+    }
+
+    void close() {
+        if (fd >= 0)
+            ::close(fd);
+        fd = -1;
+    }
+
+private:
+    int fd = -1;
+};
+
+class socket_listener {
+public:
+    // A listening TCP socket. Port 0 picks a free port; `local_only` binds to loopback.
+    socket_listener(int port, bool local_only) {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0)
+            return;
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(local_only ? INADDR_LOOPBACK : INADDR_ANY);
+        address.sin_port = htons(uint16_t(port));
+        socklen_t length = sizeof(address);
+        if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+            || listen(fd, 64) != 0
+            || getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+            close();
+            return;
+        }
+        bound_port = ntohs(address.sin_port);
+    }
+    socket_listener(const socket_listener&) = delete;
+    socket_listener& operator=(const socket_listener&) = delete;
+    ~socket_listener() { close(); }
+
+    bool is_open() const { return fd >= 0; }
+    int handle() const { return fd; }
+    int port() const { return bound_port; }
+
+    socket_connection accept_connection() {
+        int client = ::accept(fd, nullptr, nullptr);
+        return client >= 0 ? socket_connection(client) : socket_connection();
+    }
+
+    void close() {
+        if (fd >= 0)
+            ::close(fd);
+        fd = -1;
+    }
+
+private:
+    int fd = -1;
+    int bound_port = 0;
+};
+
+#endif
+
+#endif
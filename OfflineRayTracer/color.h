@@ -3,11 +3,14 @@
 #define COLOR_H
 
 #include "interval.h"
+#include "simd4.h"
 #include "vec3.h"
 
+#include <cstdint>
+
 using color = vec3;
 
-inline double linear_to_gamma(double linear_component)
+inline real linear_to_gamma(real linear_component)
 {
 	if (linear_component > 0)
 		return std::sqrt(linear_component);
@@ -15,24 +18,59 @@ inline double linear_to_gamma(double linear_component)
 	return 0;
 }
 
-void write_color(std::ostream& out, const color& pixel_color) {
-	auto r = pixel_color.x();
-	auto g = pixel_color.y();
-	auto b = pixel_color.z();
-
-	// Apply a linear to gamma transform for gamma 2
-	r = linear_to_gamma(r);
-	g = linear_to_gamma(g);
-	b = linear_to_gamma(b);
-
-	// Translate the [0,1] component values to the byte range [0,255].
+inline int color_to_byte(real linear_component)
+{
+	// Apply a linear to gamma transform for gamma 2, then translate the [0,1] component value
+	// to the byte range [0,255].
 	static const interval intensity(0.000, 0.999);
-	int rbyte = int(256 * intensity.clamp(r));
-	int gbyte = int(256 * intensity.clamp(g));
-	int bbyte = int(256 * intensity.clamp(b));
+	return int(256 * intensity.clamp(linear_to_gamma(linear_component)));
+}
+
+inline void write_color(std::ostream& out, const color& pixel_color) {
+	int rbyte = color_to_byte(pixel_color.x());
+	int gbyte = color_to_byte(pixel_color.y());
+	int bbyte = color_to_byte(pixel_color.z());
 
 	// Write out the pixel color components
 	out << rbyte << ' ' << gbyte << ' ' << bbyte << '\n';
 }
 
+inline void quantize_colors(const color* pixels, size_t count, uint8_t* rgb) {
+	// Converts `count` linear colors to packed 8-bit gamma-2 RGB, giving the same bytes as
+	// color_to_byte. Four pixels at a time are gathered into twelve contiguous components and
+	// quantized as three SIMD packs.
+	size_t p = 0;
+
+#ifdef OFFLINERT_SIMD4
+	using pack = simd4<real>;
+	const auto zero = pack::set1(0), top = pack::set1(real(0.999)), scale = pack::set1(256);
+
+	for (; p + 4 <= count; p += 4) {
+		alignas(16) real components[12];
+		alignas(16) int32_t bytes[12];
+		for (int k = 0; k < 4; k++) {
+			components[3 * k + 0] = pixels[p + k].x();
+			components[3 * k + 1] = pixels[p + k].y();
+			components[3 * k + 2] = pixels[p + k].z();
+		}
+
+		for (int q = 0; q < 12; q += 4) {
+			// max() returns its second operand for NaN lanes, so NaN maps to 0 as in the
+			// scalar path.
+			auto v = pack::sqrt(pack::max(pack::load(components + q), zero));
+			pack::store_int(bytes + q, pack::min(v, top) * scale);
+		}
+
+		for (int q = 0; q < 12; q++)
+			rgb[3 * p + q] = uint8_t(bytes[q]);
+	}
+#endif
+
+	for (; p < count; p++) {
+		rgb[3 * p + 0] = uint8_t(color_to_byte(pixels[p].x()));
+		rgb[3 * p + 1] = uint8_t(color_to_byte(pixels[p].y()));
+		rgb[3 * p + 2] = uint8_t(color_to_byte(pixels[p].z()));
+	}
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,253 @@
+#pragma once
+#ifndef DENOISER_H
+#define DENOISER_H
+
+#include "framebuffer.h"
+#include "simd4.h"
+#include "tile_scheduler.h"
+
+#include <algorithm>
+#include <vector>
+
+class denoiser {
+public:
+    // Edge-avoiding a-trous wavelet filter (Dammertz et al., "Edge-Avoiding A-Trous Wavelet
+    // Transform for fast Global Illumination Filtering", 2010). Each pass blurs with a 5x5
+    // B3-spline kernel whose taps lie 2^pass pixels apart, so five passes reach 62 pixels
+    // across for 25 taps per pixel per pass. Each tap is weighted down by how much its
+    // radiance, first-hit albedo and first-hit normal differ from the center pixel's, which
+    // keeps the edges and texture that the albedo and normal images show. Radiance differences
+    // are measured against the noise around the center pixel, its 3x3 luminance variance in
+    // the input, so noisy regions are smoothed hard while clean detail such as sharp
+    // reflections is left alone.
+    //
+    // The passes run on float planes, one per channel, split into tiles that workers filter
+    // in parallel. Within a row, four neighbouring pixels are filtered at once with simd4.
+
+    int   iterations = 5;       // Filter passes
+    float color_sigma = 5;      // Radiance difference scale, in local standard deviations;
+                                // halved every pass
+    float normal_sigma = 0.3f;  // Normal difference scale
+    float albedo_sigma = 0.1f;  // Albedo difference scale
+    int   thread_count = 0;     // Worker threads (0 uses every hardware thread)
+    int   tile_size = 64;       // Edge length of the square tiles handed to workers
+
+    void apply(framebuffer& image, const framebuffer& albedo, const framebuffer& normal) const {
+        // Filters `image` in place. The feature images must have the same size.
+        int width = image.width(), height = image.height();
+        if (width < 4 || height < 1)
+            return;
+
+        planes p;
+        p.width = width;
+        p.height = height;
+        for (auto* set : { &p.color, &p.filtered, &p.albedo, &p.normal })
+            for (auto& plane : *set)
+                plane.resize(image.size());
+
+        tile_scheduler::parallel_chunks(image.size(), 65536, thread_count,
+            [&](size_t, size_t begin, size_t end) {
+                for (size_t k = begin; k < end; k++) {
+                    for (int c = 0; c < 3; c++) {
+                        p.color[c][k] = float(image[k][c]);
+                        p.albedo[c][k] = float(albedo[k][c]);
+                        p.normal[c][k] = float(normal[k][c]);
+                    }
+                }
+            });
+
+        // Estimate the noise from the unfiltered input; the epsilon keeps flat regions finite.
+        p.color_scale.resize(image.size());
+        tile_scheduler::parallel_chunks(size_t(height), 64, thread_count,
+            [&](size_t, size_t begin, size_t end) {
+                for (int y = int(begin); y < int(end); y++)
+                    for (int x = 0; x < width; x++)
+                        p.color_scale[size_t(y) * width + x] = 1 / (local_variance(p, x, y) + 1e-4f);
+            });
+
+        tile_scheduler tiles(width, height, tile_size);
+        for (int pass = 0; pass < iterations; pass++) {
+            pass_settings settings;
+            settings.step = 1 << pass;
+            auto sigma = color_sigma / float(1 << pass);  // Noise drops as passes smooth it
+            settings.color_scale = 1 / (sigma * sigma);
+            settings.normal_scale = 1 / (normal_sigma * normal_sigma);
+            settings.albedo_scale = 1 / (albedo_sigma * albedo_sigma);
+
+            tiles.run(thread_count, [&](const tile& t) { filter_tile(p, settings, t); });
+            std::swap(p.color, p.filtered);
+        }
+
+        tile_scheduler::parallel_chunks(image.size(), 65536, thread_count,
+            [&](size_t, size_t begin, size_t end) {
+                for (size_t k = begin; k < end; k++)
+                    image[k] = color(p.color[0][k], p.color[1][k], p.color[2][k]);
+            });
+    }
+
+private:
+    struct planes {
+        int width, height;
+        std::vector<float> color[3];     // Input of the current pass
+        std::vector<float> filtered[3];  // Output of the current pass
+        std::vector<float> albedo[3];
+        std::vector<float> normal[3];
+        std::vector<float> color_scale;  // Per pixel: 1 / local radiance variance
+    };
+
+    struct pass_settings {
+        int   step;
+        float color_scale, normal_scale, albedo_scale;  // Inverse squared sigmas
+    };
+
+    static constexpr float kernel[5] = { 1.0f / 16, 1.0f / 4, 3.0f / 8, 1.0f / 4, 1.0f / 16 };
+
+    static float local_variance(const planes& p, int x, int y) {
+        // Luminance variance over the 3x3 neighbourhood.
+        float sum = 0, sum_squares = 0;
+        for (int dy = -1; dy <= 1; dy++) {
+            int yq = std::min(std::max(y + dy, 0), p.height - 1);
+            for (int dx = -1; dx <= 1; dx++) {
+                int xq = std::min(std::max(x + dx, 0), p.width - 1);
+                size_t q = size_t(yq) * p.width + xq;
+                float l = 0.2126f * p.color[0][q] + 0.7152f * p.color[1][q] + 0.0722f * p.color[2][q];
+                sum += l;
+                sum_squares += l * l;
+            }
+        }
+        float mean = sum / 9;
+        return std::max(0.0f, sum_squares / 9 - mean * mean);
+    }
+
+    static float exp_neg(float x) {
+        // exp(-x) for x >= 0 as (1 - x/256)^256, which is within 1e-3 and costs eight squarings.
+        float t = std::max(0.0f, 1 - x * (1.0f / 256));
+        for (int k = 0; k < 8; k++)
+            t *= t;
+        return t;
+    }
+
+    static void filter_tile(planes& p, const pass_settings& settings, const tile& t) {
+        for (int y = t.y0; y < t.y1; y++) {
+            int x = t.x0;
+#ifdef OFFLINERT_SIMD4
+            // Four pixels at a time; a final group that would run past the tile is moved back
+            // to end at its edge, refiltering a few pixels rather than falling back to scalar.
+            // Tiles narrower than a group, at the right edge of the image, are filtered scalar.
+            if (t.x1 - t.x0 >= 4) {
+                for (; x < t.x1; x += 4)
+                    filter_group(p, settings, std::min(x, t.x1 - 4), y);
+                continue;
+            }
+#endif
+            for (; x < t.x1; x++)
+                filter_pixel(p, settings, x, y);
+        }
+    }
+
+    static void filter_pixel(planes& p, const pass_settings& settings, int x, int y) {
+        size_t center = size_t(y) * p.width + x;
+        float c0[3], a0[3], n0[3];
+        for (int c = 0; c < 3; c++) {
+            c0[c] = p.color[c][center];
+            a0[c] = p.albedo[c][center];
+            n0[c] = p.normal[c][center];
+        }
+        float color_scale = settings.color_scale * p.color_scale[center];
+
+        float weight_sum = 0, sum[3] = { 0, 0, 0 };
+        for (int dy = -2; dy <= 2; dy++) {
+            int yq = std::min(std::max(y + dy * settings.step, 0), p.height - 1);
+            for (int dx = -2; dx <= 2; dx++) {
+                int xq = std::min(std::max(x + dx * settings.step, 0), p.width - 1);
+                size_t q = size_t(yq) * p.width + xq;
+
+                float dc = 0, da = 0, dn = 0, cq[3];
+                for (int c = 0; c < 3; c++) {
+                    cq[c] = p.color[c][q];
+                    dc += (cq[c] - c0[c]) * (cq[c] - c0[c]);
+                    da += (p.albedo[c][q] - a0[c]) * (p.albedo[c][q] - a0[c]);
+                    dn += (p.normal[c][q] - n0[c]) * (p.normal[c][q] - n0[c]);
+                }
+
+                float w = kernel[dy + 2] * kernel[dx + 2]
+                        * exp_neg(dc * color_scale + da * settings.albedo_scale + dn * settings.normal_scale);
+                weight_sum += w;
+                for (int c = 0; c < 3; c++)
+                    sum[c] += w * cq[c];
+            }
+        }
+
+        // The center tap alone has weight 9/64, so the sum is never zero.
+        for (int c = 0; c < 3; c++)
+            p.filtered[c][center] = sum[c] / weight_sum;
+    }
+
+#ifdef OFFLINERT_SIMD4
+    static void filter_group(planes& p, const pass_settings& settings, int x, int y) {
+        // filter_pixel for pixels x..x+3 of row y, one per lane.
+        using pack = simd4<float>;
+        size_t center = size_t(y) * p.width + x;
+
+        pack c0[3], a0[3], n0[3];
+        for (int c = 0; c < 3; c++) {
+            c0[c] = pack::load(&p.color[c][center]);
+            a0[c] = pack::load(&p.albedo[c][center]);
+            n0[c] = pack::load(&p.normal[c][center]);
+        }
+        auto one = pack::set1(1);
+        auto color_scale = pack::set1(settings.color_scale) * pack::load(&p.color_scale[center]);
+        auto albedo_scale = pack::set1(settings.albedo_scale);
+        auto normal_scale = pack::set1(settings.normal_scale);
+        auto exp_step = pack::set1(1.0f / 256);
+        auto zero = pack::set1(0);
+
+        auto weight_sum = zero;
+        pack sum[3] = { zero, zero, zero };
+        for (int dy = -2; dy <= 2; dy++) {
+            int yq = std::min(std::max(y + dy * settings.step, 0), p.height - 1);
+            size_t row = size_t(yq) * p.width;
+            for (int dx = -2; dx <= 2; dx++) {
+                int xq = x + dx * settings.step;
+                bool inside = xq >= 0 && xq + 4 <= p.width;
+
+                // Taps past the left or right edge repeat the edge pixel, lane by lane.
+                auto load = [&](const std::vector<float>& plane) {
+                    if (inside)
+                        return pack::load(&plane[row + xq]);
+                    float lanes[4];
+                    for (int lane = 0; lane < 4; lane++)
+                        lanes[lane] = plane[row + std::min(std::max(xq + lane, 0), p.width - 1)];
+                    return pack::load(lanes);
+                };
+
+                auto dc = zero, da = zero, dn = zero;
+                pack cq[3];
+                for (int c = 0; c < 3; c++) {
+                    cq[c] = load(p.color[c]);
+                    auto d = cq[c] - c0[c];
+                    dc = dc + d * d;
+                    d = load(p.albedo[c]) - a0[c];
+                    da = da + d * d;
+                    d = load(p.normal[c]) - n0[c];
+                    dn = dn + d * d;
+                }
+
+                auto t = pack::max(zero, one - (dc * color_scale + da * albedo_scale + dn * normal_scale) * exp_step);
+                for (int k = 0; k < 8; k++)
+                    t = t * t;
+                auto w = pack::set1(kernel[dy + 2] * kernel[dx + 2]) * t;
+
+                weight_sum = weight_sum + w;
+                for (int c = 0; c < 3; c++)
+                    sum[c] = sum[c] + w * cq[c];
+            }
+        }
+
+        for (int c = 0; c < 3; c++)
+            pack::store(&p.filtered[c][center], sum[c] / weight_sum);
+    }
+#endif
+};
+
+#endif
@@ -0,0 +1,320 @@
+#pragma once
+#ifndef FLAT_BVH_H
+#define FLAT_BVH_H
+
+#include "aabb.h"
+#include "motion.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+class flat_bvh {
+public:
+    // A BVH over caller-owned primitives, stored as one array of nodes in depth-first order
+    // (a node's left child directly follows it). It only knows the primitives' boxes: leaves
+    // refer to runs of `primitives`, which maps leaf slots back to the caller's indices, and
+    // traverse() hands each leaf run to a callback that does the real intersection.
+    //
+    // build() lays the tree out with the same 12-bin SAH as bvh_node. refit() keeps the
+    // layout and only recomputes bounds, for primitives that have moved since.
+    //
+    // For motion blur, refit_motion() gives every node a box at each of `segments` + 1 keyframe
+    // times, and traverse() tests the box interpolated to the ray's time instead of the node's
+    // box over the whole motion, which for fast movers would overlap most of the tree. The
+    // topology comes from an ordinary build over the whole-motion boxes.
+
+    struct node {
+        aabb     bounds;
+        uint32_t offset;  // Leaves: first slot in `primitives`. Interior nodes: the right child.
+        uint16_t count;   // Primitives in a leaf, 0 for interior nodes
+        uint16_t axis;    // Split axis of interior nodes
+    };
+
+    std::vector<node>     nodes;
+    std::vector<uint32_t> primitives;
+    int                   segments = 0;  // Keyframe steps of key_bounds, 0 when static
+    std::vector<aabb>     key_bounds;    // segments + 1 boxes per node, by time
+
+    void build(const std::vector<aabb>& boxes, int max_leaf_size) {
+        nodes.clear();
+        clear_motion();
+        primitives.resize(boxes.size());
+        if (boxes.empty())
+            return;
+
+        std::vector<point3> centroids(boxes.size());
+        for (uint32_t k = 0; k < boxes.size(); k++) {
+            primitives[k] = k;
+            centroids[k] = boxes[k].centroid();
+        }
+
+        nodes.reserve(2 * boxes.size() / max_leaf_size + 1);
+        build_node(boxes, centroids, 0, uint32_t(boxes.size()), std::max(1, max_leaf_size), 0);
+    }
+
+    void refit(const std::vector<aabb>& boxes) {
+        // Children always sit after their parent, so one backward sweep sees every child
+        // before its parent.
+        clear_motion();
+        for (size_t n = nodes.size(); n-- > 0;) {
+            auto& current = nodes[n];
+            if (current.count > 0) {
+                current.bounds = aabb::empty;
+                for (uint32_t k = current.offset; k < current.offset + current.count; k++)
+                    current.bounds = aabb(current.bounds, boxes[primitives[k]]);
+            }
+            else {
+                current.bounds = aabb(nodes[n + 1].bounds, nodes[current.offset].bounds);
+            }
+        }
+    }
+
+    void refit_motion(const std::vector<aabb>& keyed_boxes, int segment_count) {
+        // Like refit, from `segment_count` + 1 boxes per primitive (primitive p's box at key k is
+        // keyed_boxes[p * (segment_count + 1) + k]). Each node's box at a key encloses its
+        // children's at that key; if every primitive moves linearly between keys, so does the
+        // interpolated node box, which then encloses them at every time. Node bounds become
+        // the union over the keys.
+        segments = segment_count;
+        size_t keys = size_t(segments) + 1;
+        key_bounds.assign(nodes.size() * keys, aabb::empty);
+        for (size_t n = nodes.size(); n-- > 0;) {
+            auto& current = nodes[n];
+            auto* key_box = &key_bounds[n * keys];
+            for (size_t k = 0; k < keys; k++) {
+                if (current.count > 0) {
+                    for (uint32_t slot = current.offset; slot < current.offset + current.count; slot++)
+                        key_box[k] = aabb(key_box[k], keyed_boxes[primitives[slot] * keys + k]);
+                }
+                else {
+                    key_box[k] = aabb(key_bounds[(n + 1) * keys + k], key_bounds[current.offset * keys + k]);
+                }
+            }
+            current.bounds = aabb::empty;
+            for (size_t k = 0; k < keys; k++)
+                current.bounds = aabb(current.bounds, key_box[k]);
+        }
+    }
+
+    aabb bounds() const { return nodes.empty() ? aabb::empty : nodes[0].bounds; }
+
+    aabb bounds_at(real time) const {
+        if (nodes.empty())
+            return aabb::empty;
+        if (segments == 0)
+            return nodes[0].bounds;
+        motion_step step(time, segments);
+        return lerp(key_bounds[step.segment], key_bounds[step.segment + 1], step.fraction);
+    }
+
+    bool valid(size_t slot_count) const {
+        // Whether stored nodes form a tree traverse() can walk: leaves within `slot_count`
+        // slots, right children after their parent.
+        for (size_t n = 0; n < nodes.size(); n++) {
+            const auto& current = nodes[n];
+            bool ok = current.count > 0
+                    ? size_t(current.offset) + current.count <= slot_count
+                    : n + 1 < nodes.size() && current.offset > n && current.offset < nodes.size() && current.axis < 3;
+            if (!ok)
+                return false;
+        }
+        return true;
+    }
+
+    size_t memory_bytes() const {
+        return nodes.capacity() * sizeof(node) + primitives.capacity() * sizeof(uint32_t)
+             + key_bounds.capacity() * sizeof(aabb);
+    }
+
+    template <typename LeafHit>
+    void traverse(const ray& r, real t_min, const real& t_max, LeafHit&& leaf_hit) const {
+        // Calls leaf_hit(first_slot, count) for every leaf whose box the ray enters before
+        // t_max. The callback may lower t_max (the caller's variable) as it finds closer hits,
+        // which prunes the rest of the walk.
+        if (nodes.empty())
+            return;
+
+        if (segments == 0) {
+            walk(r, t_min, t_max, leaf_hit, [&](uint32_t n) -> const aabb& { return nodes[n].bounds; });
+            return;
+        }
+
+        // Moving trees test each node's box at the ray's time, between two of its keys.
+        const size_t keys = size_t(segments) + 1;
+        const motion_step step(r.time(), segments);
+        walk(r, t_min, t_max, leaf_hit, [&](uint32_t n) {
+            const auto* key_box = &key_bounds[n * keys + step.segment];
+            return lerp(key_box[0], key_box[1], step.fraction);
+        });
+    }
+
+private:
+    static const int sah_bin_count = 12;
+
+    static const int sah_max_depth = 32;  // Median splits below this keep traverse()'s stack small
+
+    void clear_motion() {
+        segments = 0;
+        key_bounds.clear();
+    }
+
+    template <typename LeafHit, typename NodeBounds>
+    void walk(const ray& r, real t_min, const real& t_max, LeafHit& leaf_hit, NodeBounds&& node_bounds) const {
+        const vec3 inv_dir(1 / r.direction().x(), 1 / r.direction().y(), 1 / r.direction().z());
+        const bool dir_negative[3] = { inv_dir.x() < 0, inv_dir.y() < 0, inv_dir.z() < 0 };
+
+        uint32_t stack[64];
+        int stack_size = 0;
+        uint32_t node_index = 0;
+
+        while (true) {
+            const auto& current = nodes[node_index];
+            if (box_hit(node_bounds(node_index), r.origin(), inv_dir, t_min, t_max)) {
+                if (current.count > 0) {
+                    leaf_hit(current.offset, uint32_t(current.count));
+                }
+                else {
+                    // Visit the child on the near side of the split first; it's more likely to
+                    // hold the closest hit, which then prunes the far child.
+                    uint32_t near_child = node_index + 1, far_child = current.offset;
+                    if (dir_negative[current.axis])
+                        std::swap(near_child, far_child);
+                    stack[stack_size++] = far_child;
+                    node_index = near_child;
+                    continue;
+                }
+            }
+            if (stack_size == 0)
+                break;
+            node_index = stack[--stack_size];
+        }
+    }
+
+    static bool box_hit(const aabb& box, const point3& origin, const vec3& inv_dir, real t_min, real t_max) {
+        // Slab test with a precomputed reciprocal direction. Unlike aabb::hit, zero-thickness
+        // boxes (flat axis-aligned triangles) still count as hit.
+        for (int axis = 0; axis < 3; axis++) {
+            const interval& ax = box.axis_interval(axis);
+            auto t0 = (ax.min - origin[axis]) * inv_dir[axis];
+            auto t1 = (ax.max - origin[axis]) * inv_dir[axis];
+            if (t1 < t0)
+                std::swap(t0, t1);
+            t_min = t0 > t_min ? t0 : t_min;
+            t_max = t1 < t_max ? t1 : t_max;
+            if (t_max < t_min)
+                return false;
+        }
+        return true;
+    }
+
+    uint32_t build_node(
+        const std::vector<aabb>& boxes, const std::vector<point3>& centroids,
+        uint32_t start, uint32_t end, int max_leaf_size, int depth
+    ) {
+        // Appends the subtree over primitives[start, end) and returns its root's index. Past
+        // `sah_max_depth`, splits fall back to the median, which bounds the tree's depth.
+        auto node_index = uint32_t(nodes.size());
+        nodes.push_back(node());
+
+        aabb bounds = aabb::empty, centroid_bounds = aabb::empty;
+        for (uint32_t k = start; k < end; k++) {
+            bounds = aabb(bounds, boxes[primitives[k]]);
+            centroid_bounds = aabb(centroid_bounds, aabb(centroids[primitives[k]], centroids[primitives[k]]));
+        }
+        nodes[node_index].bounds = bounds;
+
+        uint32_t span = end - start;
+        if (span <= uint32_t(max_leaf_size)) {
+            nodes[node_index].offset = start;
+            nodes[node_index].count = uint16_t(span);
+            return node_index;
+        }
+
+        int axis = centroid_bounds.longest_axis();
+        uint32_t mid = start + span / 2;
+        if (depth >= sah_max_depth
+            || !find_sah_split(boxes, centroids, start, end, centroid_bounds, axis, mid)) {
+            std::nth_element(primitives.begin() + start, primitives.begin() + mid, primitives.begin() + end,
+                [&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+        }
+
+        build_node(boxes, centroids, start, mid, max_leaf_size, depth + 1);
+        uint32_t right = build_node(boxes, centroids, mid, end, max_leaf_size, depth + 1);
+        nodes[node_index].offset = right;
+        nodes[node_index].count = 0;
+        nodes[node_index].axis = uint16_t(axis);
+        return node_index;
+    }
+
+    bool find_sah_split(
+        const std::vector<aabb>& boxes, const std::vector<point3>& centroids,
+        uint32_t start, uint32_t end, const aabb& centroid_bounds, int& best_axis, uint32_t& mid
+    ) {
+        // Bins the primitives by centroid along each axis and partitions them about the
+        // cheapest bin boundary. Returns false if no boundary separates the centroids.
+        double best_cost = infinity;
+        int best_split = -1;
+
+        for (int axis = 0; axis < 3; axis++) {
+            auto extent = centroid_bounds.axis_interval(axis);
+            if (extent.size() <= 0)
+                continue;
+            auto scale = sah_bin_count / extent.size();
+
+            aabb bin_bounds[sah_bin_count];
+            int bin_counts[sah_bin_count] = {};
+            for (uint32_t k = start; k < end; k++) {
+                int b = bin_index(centroids[primitives[k]][axis], extent.min, scale);
+                bin_counts[b]++;
+                bin_bounds[b] = aabb(bin_bounds[b], boxes[primitives[k]]);
+            }
+
+            double right_area[sah_bin_count];
+            int right_count[sah_bin_count];
+            aabb right_box;
+            int count = 0;
+            for (int b = sah_bin_count - 1; b > 0; b--) {
+                right_box = aabb(right_box, bin_bounds[b]);
+                count += bin_counts[b];
+                right_area[b] = right_box.surface_area();
+                right_count[b] = count;
+            }
+
+            aabb left_box;
+            count = 0;
+            for (int b = 0; b < sah_bin_count - 1; b++) {
+                left_box = aabb(left_box, bin_bounds[b]);
+                count += bin_counts[b];
+                if (count == 0 || right_count[b + 1] == 0)
+                    continue;
+                auto cost = left_box.surface_area() * count + right_area[b + 1] * right_count[b + 1];
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_split = b;
+                }
+            }
+        }
+
+        if (best_split < 0)
+            return false;
+
+        auto extent = centroid_bounds.axis_interval(best_axis);
+        auto scale = sah_bin_count / extent.size();
+        int axis = best_axis;
+        auto it = std::partition(primitives.begin() + start, primitives.begin() + end, [&](uint32_t k) {
+            return bin_index(centroids[k][axis], extent.min, scale) <= best_split;
+        });
+
+        mid = uint32_t(it - primitives.begin());
+        return mid != start && mid != end;
+    }
+
+    static int bin_index(real centroid, real min, real scale) {
+        int b = int((centroid - min) * scale);
+        return b < 0 ? 0 : (b >= sah_bin_count ? sah_bin_count - 1 : b);
+    }
+};
+
+#endif
@@ -0,0 +1,42 @@
+#pragma once
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include "color.h"
+
+#include <cstdint>
+#include <vector>
+
+class framebuffer {
+public:
+    // A width x height image of linear radiance, stored row-major from the top-left pixel.
+    // Values are kept unclamped and before gamma, so HDR writers can store them as is.
+    framebuffer(int width, int height)
+      : image_width(width), image_height(height), pixels(size_t(width) * height) {}
+
+    int width() const { return image_width; }
+    int height() const { return image_height; }
+    size_t size() const { return pixels.size(); }
+
+    color& at(int i, int j) { return pixels[size_t(j) * image_width + i]; }
+    const color& at(int i, int j) const { return pixels[size_t(j) * image_width + i]; }
+
+    color& operator[](size_t p) { return pixels[p]; }
+    const color& operator[](size_t p) const { return pixels[p]; }
+
+    const color* data() const { return pixels.data(); }
+
+    std::vector<uint8_t> to_rgb8() const {
+        // Returns the image as packed 8-bit gamma-2 RGB, three bytes per pixel.
+        std::vector<uint8_t> rgb(3 * pixels.size());
+        quantize_colors(pixels.data(), pixels.size(), rgb.data());
+        return rgb;
+    }
+
+private:
+    int image_width;
+    int image_height;
+    std::vector<color> pixels;
+};
+
+#endif
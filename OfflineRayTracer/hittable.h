@@ -2,15 +2,20 @@
 #ifndef HITTABLE_H
 #define HITTABLE_H
 
-class material;
+#include "aabb.h"
+#include "material_handle.h"
+#include "ray_packet.h"
 
 class hit_record {
 public:
 	point3 p;
 	vec3 normal;
-	shared_ptr<material> mat;
-	double t;
+	material_handle mat;  // Refers into the scene's material_library
+	real t;
 	bool front_face;
+	real u, v;            // Surface coordinates, for texturing
+	vec3 dpdu, dpdv;      // How the point moves with u and v, for texture filtering
+	color texture_color;  // The material's texture at the hit, when it has one (see camera)
 
 	void set_face_normal(const ray& r, const vec3& outward_normal) {
 		// Sets the hit record normal vector.
@@ -26,6 +31,30 @@ public:
 	virtual ~hittable() = default;
 
 	virtual bool hit(const ray& r, interval ray_t, hit_record& rec) const = 0;
+
+	virtual aabb bounding_box() const = 0;  // Encloses the object at every time
+
+	// Moving objects move linearly between keyframes evenly spaced over ray times 0..1, in
+	// `motion_segments` steps (0 for objects that don't move). Motion-aware hierarchies lay
+	// bounds at those times and interpolate them for each ray, rather than using one box over
+	// the whole motion. Objects whose box can't be interpolated that way report 0 and use
+	// bounding_box() throughout.
+	virtual int motion_segments() const { return 0; }
+	virtual aabb bounds_at(real time) const { return bounding_box(); }
+
+	virtual uint32_t hit_packet(ray_packet& packet, real t_min, hit_record* recs) const {
+		// Tests the active rays of the packet, each in (t_min, packet.t_max[i]). For every ray
+		// that finds a closer hit, fills recs[i], shrinks t_max[i] and sets bit i of the
+		// returned mask. This default traces the rays one at a time.
+		uint32_t hits = 0;
+		for (int i = 0; i < packet.size; i++) {
+			if ((packet.active & (1u << i)) && hit(packet.rays[i], interval(t_min, packet.t_max[i]), recs[i])) {
+				packet.t_max[i] = recs[i].t;
+				hits |= 1u << i;
+			}
+		}
+		return hits;
+	}
 };
 
 #endif
\ No newline at end of file
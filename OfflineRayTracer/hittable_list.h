@@ -2,6 +2,7 @@
 #ifndef HITTABLE_LIST_H
 #define HITTABLE_LIST_H
 
+#include "aabb.h"
 #include "hittable.h"
 
 #include <vector>
@@ -13,10 +14,14 @@ public:
     hittable_list() {}
     hittable_list(shared_ptr<hittable> object) { add(object); }
 
-    void clear() { objects.clear(); }
+    void clear() {
+        objects.clear();
+        bbox = aabb();
+    }
 
     void add(shared_ptr<hittable> object) {
         objects.push_back(object);
+        bbox = aabb(bbox, object->bounding_box());
     }
 
     bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
@@ -34,6 +39,18 @@ public:
 
         return hit_anything;
     }
+
+    uint32_t hit_packet(ray_packet& packet, real t_min, hit_record* recs) const override {
+        uint32_t hits = 0;
+        for (const auto& object : objects)
+            hits |= object->hit_packet(packet, t_min, recs);
+        return hits;
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+private:
+    aabb bbox;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,202 @@
+#pragma once
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include "framebuffer.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <stdio.h>
+#endif
+
+// Writers that turn a framebuffer into an image file. Each writer encodes the whole image into
+// one memory buffer and hands it to the stream in a single write, so the per-pixel cost is the
+// encoding alone rather than a formatted stream operation per component.
+
+enum class image_format {
+    ppm_ascii,   // P3: gamma-2 8-bit text, as the book's renderer wrote it
+    ppm_binary,  // P6: gamma-2 8-bit binary
+    pfm,         // Portable float map: linear 32-bit float RGB, for HDR tools
+    tiled_raw    // Linear 32-bit float RGB laid out tile by tile, behind a small header
+};
+
+class image_writer {
+public:
+    virtual ~image_writer() = default;
+
+    virtual void write(const framebuffer& image, std::ostream& out) const = 0;
+
+protected:
+    static void write_buffer(std::ostream& out, const std::vector<char>& buffer) {
+        out.write(buffer.data(), std::streamsize(buffer.size()));
+        out.flush();
+    }
+
+    static void append(std::vector<char>& buffer, const std::string& text) {
+        buffer.insert(buffer.end(), text.begin(), text.end());
+    }
+
+    static char* put_rgb(char* out, const color& pixel) {
+        // Stores one pixel as three 32-bit floats and returns the position after it.
+        float rgb[3] = { float(pixel.x()), float(pixel.y()), float(pixel.z()) };
+        std::memcpy(out, rgb, sizeof(rgb));
+        return out + sizeof(rgb);
+    }
+
+    static void append_uint32(std::vector<char>& buffer, uint32_t value) {
+        // Always little-endian, whatever the host.
+        for (int shift = 0; shift < 32; shift += 8)
+            buffer.push_back(char((value >> shift) & 0xff));
+    }
+
+    static bool host_is_little_endian() {
+        uint16_t probe = 1;
+        uint8_t first;
+        std::memcpy(&first, &probe, 1);
+        return first == 1;
+    }
+
+    static std::string ppm_header(const char* magic, const framebuffer& image) {
+        return std::string(magic) + "\n" + std::to_string(image.width()) + ' '
+             + std::to_string(image.height()) + "\n255\n";
+    }
+};
+
+class ppm_ascii_writer : public image_writer {
+public:
+    void write(const framebuffer& image, std::ostream& out) const override {
+        auto rgb = image.to_rgb8();
+        std::vector<char> buffer;
+        append(buffer, ppm_header("P3", image));
+
+        // One "r g b" line per pixel, matching write_color. Each component takes at most four
+        // characters with its separator.
+        auto header_size = buffer.size();
+        buffer.resize(header_size + rgb.size() * 4);
+        char* next = buffer.data() + header_size;
+        for (size_t k = 0; k < rgb.size(); k++) {
+            next = std::to_chars(next, next + 3, int(rgb[k])).ptr;
+            *next++ = k % 3 == 2 ? '\n' : ' ';
+        }
+        buffer.resize(size_t(next - buffer.data()));
+
+        write_buffer(out, buffer);
+    }
+};
+
+class ppm_binary_writer : public image_writer {
+public:
+    void write(const framebuffer& image, std::ostream& out) const override {
+        auto rgb = image.to_rgb8();
+        std::vector<char> buffer;
+        buffer.reserve(rgb.size() + 32);
+        append(buffer, ppm_header("P6", image));
+        buffer.insert(buffer.end(), rgb.begin(), rgb.end());
+        write_buffer(out, buffer);
+    }
+};
+
+class pfm_writer : public image_writer {
+public:
+    void write(const framebuffer& image, std::ostream& out) const override {
+        // PFM stores rows bottom to top, in host byte order flagged by the sign of the scale.
+        std::vector<char> buffer;
+        append(buffer, "PF\n" + std::to_string(image.width()) + ' ' + std::to_string(image.height())
+                       + (host_is_little_endian() ? "\n-1.0\n" : "\n1.0\n"));
+
+        auto header_size = buffer.size();
+        buffer.resize(header_size + image.size() * 3 * sizeof(float));
+        char* next = buffer.data() + header_size;
+        for (int j = image.height() - 1; j >= 0; j--)
+            for (int i = 0; i < image.width(); i++)
+                next = put_rgb(next, image.at(i, j));
+
+        write_buffer(out, buffer);
+    }
+};
+
+class tiled_raw_writer : public image_writer {
+public:
+    // Layout, all fields little-endian uint32:
+    //   "ORTR" magic, version, width, height, tile size, channel count (3)
+    // followed by the tiles in row-major tile order (the tile_scheduler grid). Each tile holds
+    // its own rows top to bottom, clipped at the image edge, as 32-bit float linear RGB in host
+    // byte order. A reader can seek straight to any tile.
+    static const uint32_t version = 1;
+
+    tiled_raw_writer(int tile_size) : tile_size(std::max(1, tile_size)) {}
+
+    void write(const framebuffer& image, std::ostream& out) const override {
+        std::vector<char> buffer;
+        append(buffer, "ORTR");
+        append_uint32(buffer, version);
+        append_uint32(buffer, uint32_t(image.width()));
+        append_uint32(buffer, uint32_t(image.height()));
+        append_uint32(buffer, uint32_t(tile_size));
+        append_uint32(buffer, 3);
+
+        auto header_size = buffer.size();
+        buffer.resize(header_size + image.size() * 3 * sizeof(float));
+        char* next = buffer.data() + header_size;
+        for (int y0 = 0; y0 < image.height(); y0 += tile_size) {
+            for (int x0 = 0; x0 < image.width(); x0 += tile_size) {
+                int x1 = std::min(x0 + tile_size, image.width());
+                int y1 = std::min(y0 + tile_size, image.height());
+                for (int j = y0; j < y1; j++)
+                    for (int i = x0; i < x1; i++)
+                        next = put_rgb(next, image.at(i, j));
+            }
+        }
+
+        write_buffer(out, buffer);
+    }
+
+private:
+    int tile_size;
+};
+
+inline std::unique_ptr<image_writer> make_image_writer(image_format format, int tile_size) {
+    switch (format) {
+        case image_format::ppm_ascii:
+            return std::unique_ptr<image_writer>(new ppm_ascii_writer());
+        case image_format::pfm:
+            return std::unique_ptr<image_writer>(new pfm_writer());
+        case image_format::tiled_raw:
+            return std::unique_ptr<image_writer>(new tiled_raw_writer(tile_size));
+        default:
+            return std::unique_ptr<image_writer>(new ppm_binary_writer());
+    }
+}
+
+inline bool write_image(const framebuffer& image, const image_writer& writer, const std::string& path) {
+    // Writes to `path`, or to stdout when the path is empty. Returns false if the file could
+    // not be written.
+    if (path.empty()) {
+#ifdef _WIN32
+        // Keep the C runtime from expanding '\n' to "\r\n" inside binary pixel data.
+        std::cout.flush();
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        writer.write(image, std::cout);
+        return bool(std::cout);
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    writer.write(image, file);
+    return bool(file);
+}
+
+#endif
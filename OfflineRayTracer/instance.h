@@ -0,0 +1,108 @@
+#pragma once
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include "aabb.h"
+#include "hittable.h"
+#include "motion.h"
+#include "transform.h"
+
+#include <vector>
+
+class instance final : public hittable {
+public:
+    // Places a shared object (typically a triangle_mesh) in the scene under an affine
+    // transform. Rays are taken into object space rather than the geometry into world space,
+    // so any number of instances share one copy of the object and its BVH. The direction is
+    // not renormalized, which keeps the hit distance t the same in both spaces. An optional
+    // material replaces the object's own.
+    //
+    // The transform may also be keyframed over ray times 0..1 (set_motion), for motion blur.
+    // Between keys it is blended entry by entry, see transform::lerp.
+    instance(shared_ptr<hittable> object, const transform& object_to_world, material_handle mat = material_handle())
+      : object(object), object_to_world(object_to_world), mat(mat)
+    {
+        bbox = object_to_world.bounds(object->bounding_box());
+    }
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        if (keys.empty())
+            return hit_with(object_to_world, r, ray_t, rec);
+        return hit_with(transform_at(r.time()), r, ray_t, rec);
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+    int motion_segments() const override {
+        // A moving object under a moving transform doesn't move linearly between keys, so
+        // that case falls back to the whole-motion box.
+        int object_segments = object->motion_segments();
+        if (keys.empty())
+            return object_segments;
+        return object_segments == 0 ? int(keys.size() - 1) : 0;
+    }
+
+    aabb bounds_at(real time) const override {
+        if (keys.empty())
+            return object_to_world.bounds(object->bounds_at(time));
+        return motion_segments() > 0 ? transform_at(time).bounds(object->bounding_box()) : bbox;
+    }
+
+    const transform& get_transform() const { return object_to_world; }
+
+    void set_transform(const transform& t) {
+        // Moves the instance, and stops any keyframed motion. The object itself is untouched.
+        object_to_world = t;
+        keys.clear();
+        bbox = object_to_world.bounds(object->bounding_box());
+    }
+
+    void set_motion(const std::vector<transform>& key_transforms) {
+        // Keyframes evenly spaced over ray times 0..1; fewer than two leave the instance still
+        // at the first. Corners of the object's box move linearly between keys, so the boxes
+        // at the keys together enclose the whole motion.
+        if (key_transforms.size() < 2) {
+            set_transform(key_transforms.empty() ? object_to_world : key_transforms[0]);
+            return;
+        }
+        object_to_world = key_transforms[0];
+        keys = key_transforms;
+        bbox = aabb::empty;
+        auto object_box = object->bounding_box();
+        for (const auto& key : keys)
+            bbox = aabb(bbox, key.bounds(object_box));
+    }
+
+private:
+    shared_ptr<hittable> object;
+    transform object_to_world;  // At time 0 when moving
+    std::vector<transform> keys;
+    material_handle mat;
+    aabb bbox;
+
+    transform transform_at(real time) const {
+        if (keys.empty())
+            return object_to_world;
+        motion_step step(time, int(keys.size() - 1));
+        return transform::lerp(keys[step.segment], keys[step.segment + 1], step.fraction);
+    }
+
+    bool hit_with(const transform& t, const ray& r, interval ray_t, hit_record& rec) const {
+        ray object_ray(t.inverse_point(r.origin()), t.inverse_vector(r.direction()), r.time());
+        if (!object->hit(object_ray, ray_t, rec))
+            return false;
+
+        // Normals go back through the inverse transpose, which preserves their side relative
+        // to the ray, so front_face carries over unchanged.
+        rec.p = t.point(rec.p);
+        rec.normal = unit_vector(t.normal(rec.normal));
+        rec.dpdu = t.vector(rec.dpdu);
+        rec.dpdv = t.vector(rec.dpdv);
+        if (mat)
+            rec.mat = mat;
+
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,132 @@
+#pragma once
+#ifndef LIGHT_LIST_H
+#define LIGHT_LIST_H
+
+#include "alias_table.h"
+#include "material.h"
+
+#include <cstdint>
+#include <vector>
+
+class light_list {
+public:
+    // The emitters that the camera samples directly (next-event estimation). Lights are
+    // spheres: add_sphere() registers one and returns the diffuse_light material to give the
+    // matching sphere in the world. Call build() once every light is added; it prepares an
+    // alias table that picks lights in proportion to their power, so a light sample costs
+    // the same with thousands of lights as with one.
+
+    struct light_sample {
+        vec3   direction;  // Unit vector from the shading point toward the light
+        real   distance;   // Along `direction` to the light's surface
+        color  emission;
+        double pdf;        // Solid-angle density of the sample, selection included
+    };
+
+    material_handle add_sphere(
+        const point3& center, real radius, const color& emission, material_library& materials
+    ) {
+        auto index = uint32_t(lights.size());
+        lights.push_back({ center, radius, emission });
+        return materials.add(diffuse_light(emission, index));
+    }
+
+    bool save(binary_writer& out) const {
+        out.put_array(lights);
+        return true;
+    }
+
+    bool load(binary_reader& in) {
+        // The diffuse_light materials come back with the material_library. Call build() after.
+        selection = alias_table();
+        return in.get_array(lights);
+    }
+
+    void build() {
+        std::vector<double> power(lights.size());
+        for (size_t k = 0; k < lights.size(); k++) {
+            const auto& e = lights[k].emission;
+            auto r = double(lights[k].radius);
+            power[k] = (0.2126 * e.x() + 0.7152 * e.y() + 0.0722 * e.z()) * 4 * pi * r * r;
+        }
+        selection = alias_table(power);
+    }
+
+    size_t size() const { return lights.size(); }
+    bool empty() const { return selection.size() == 0; }  // Also true before build()
+
+    bool sample(const point3& origin, sampler& s, light_sample& out) const {
+        // Picks a light, then a direction uniformly within the cone the light subtends from
+        // `origin`. Fails if there are no lights or `origin` is inside the chosen one.
+        if (empty())
+            return false;
+
+        auto index = selection.sample(s.random_double());
+        const auto& light = lights[index];
+        vec3 to_center = light.center - origin;
+        auto distance_squared = double(to_center.length_squared());
+        auto sin2_max = double(light.radius) * light.radius / distance_squared;
+        if (sin2_max >= 1)
+            return false;
+
+        // 1 - cos(theta_max), written to keep its precision for small, distant lights.
+        auto cos_max = std::sqrt(1 - sin2_max);
+        auto one_minus_cos_max = sin2_max / (1 + cos_max);
+
+        double u, v;
+        s.next_2d(u, v);
+        auto cos_theta = 1 - v * one_minus_cos_max;
+        auto sin_theta = std::sqrt(std::fmax(0.0, 1 - cos_theta * cos_theta));
+        auto phi = 2 * pi * u;
+
+        vec3 w = to_center / real(std::sqrt(distance_squared)), a, b;
+        tangent_frame(w, a, b);
+        out.direction = unit_vector(real(sin_theta * std::cos(phi)) * a
+                                  + real(sin_theta * std::sin(phi)) * b + real(cos_theta) * w);
+
+        // Nearest root of the ray-sphere quadratic; the direction stays inside the cone, so
+        // the discriminant is non-negative up to rounding.
+        auto h = double(dot(out.direction, to_center));
+        auto discriminant = h * h - (distance_squared - double(light.radius) * light.radius);
+        out.distance = real(h - std::sqrt(std::fmax(0.0, discriminant)));
+        out.emission = light.emission;
+        out.pdf = selection.pmf(index) / (2 * pi * one_minus_cos_max);
+        return true;
+    }
+
+    double pdf(uint32_t index, const point3& origin) const {
+        // The density with which sample() would have chosen a direction from `origin` that
+        // hits light `index`.
+        if (index >= selection.size())
+            return 0;
+
+        const auto& light = lights[index];
+        auto distance_squared = double((light.center - origin).length_squared());
+        auto sin2_max = double(light.radius) * light.radius / distance_squared;
+        if (sin2_max >= 1)
+            return 0;
+        auto one_minus_cos_max = sin2_max / (1 + std::sqrt(1 - sin2_max));
+        return selection.pmf(index) / (2 * pi * one_minus_cos_max);
+    }
+
+private:
+    struct sphere_light {
+        point3 center;
+        real   radius;
+        color  emission;
+    };
+
+    std::vector<sphere_light> lights;
+    alias_table selection;
+
+    static void tangent_frame(const vec3& n, vec3& a, vec3& b) {
+        // Two unit vectors completing an orthonormal basis with unit `n` (Duff et al., 2017).
+        real sign = std::copysign(real(1), n.z());
+        real c = -1 / (sign + n.z());
+        real d = n.x() * n.y() * c;
+        a = vec3(1 + sign * n.x() * n.x() * c, sign * d, -sign * n.x());
+        b = vec3(d, sign + n.y() * n.y() * c, -n.y());
+    }
+};
+
+#endif
@@ -0,0 +1,169 @@
+#pragma once
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+class mapped_file {
+public:
+    // A whole file mapped into memory. Opening an existing file maps it read-only; creating one
+    // sizes it first and maps it writable, so filling it is a plain memory copy and the OS
+    // writes the pages back in its own time. Failures leave the object closed.
+
+    mapped_file() {}
+
+    explicit mapped_file(const std::string& path) {
+        // Maps an existing file for reading.
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL, nullptr);
+        LARGE_INTEGER file_size;
+        if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+            close();
+            return;
+        }
+        map(size_t(file_size.QuadPart), false);
+#else
+        fd = ::open(path.c_str(), O_RDONLY);
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) != 0 || info.st_size == 0) {
+            close();
+            return;
+        }
+        map(size_t(info.st_size), false);
+#endif
+    }
+
+    mapped_file(const std::string& path, size_t size) {
+        // Creates (or truncates) a file of `size` bytes and maps it for writing.
+        if (size == 0)
+            return;
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                           FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            close();
+            return;
+        }
+#else
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || ftruncate(fd, off_t(size)) != 0) {
+            close();
+            return;
+        }
+#endif
+        map(size, true);
+    }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    mapped_file(mapped_file&& other) noexcept { swap(other); }
+    mapped_file& operator=(mapped_file&& other) noexcept {
+        if (this != &other) {
+            close();
+            swap(other);
+        }
+        return *this;
+    }
+
+    ~mapped_file() { close(); }
+
+    bool is_open() const { return bytes != nullptr; }
+    size_t size() const { return byte_count; }
+    char* data() { return bytes; }
+    const char* data() const { return bytes; }
+
+    void flush() {
+        // Starts writing dirty pages back without waiting for the disk.
+        if (!bytes || !writable)
+            return;
+#ifdef _WIN32
+        FlushViewOfFile(bytes, 0);
+#else
+        msync(bytes, byte_count, MS_ASYNC);
+#endif
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (bytes)
+            UnmapViewOfFile(bytes);
+        if (mapping)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (bytes)
+            munmap(bytes, byte_count);
+        if (fd >= 0)
+            ::close(fd);
+        fd = -1;
+#endif
+        bytes = nullptr;
+        byte_count = 0;
+        writable = false;
+    }
+
+private:
+    char*  bytes = nullptr;
+    size_t byte_count = 0;
+    bool   writable = false;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int    fd = -1;
+#endif
+
+    void map(size_t size, bool write) {
+#ifdef _WIN32
+        auto high = DWORD(uint64_t(size) >> 32), low = DWORD(size & 0xffffffffu);
+        mapping = CreateFileMappingA(file, nullptr, write ? PAGE_READWRITE : PAGE_READONLY, high, low, nullptr);
+        void* view = mapping ? MapViewOfFile(mapping, write ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size) : nullptr;
+#else
+        void* view = mmap(nullptr, size, write ? PROT_READ | PROT_WRITE : PROT_READ,
+                          write ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+        if (view == MAP_FAILED)
+            view = nullptr;
+#endif
+        if (!view) {
+            close();
+            return;
+        }
+        bytes = static_cast<char*>(view);
+        byte_count = size;
+        writable = write;
+    }
+
+    void swap(mapped_file& other) {
+        std::swap(bytes, other.bytes);
+        std::swap(byte_count, other.byte_count);
+        std::swap(writable, other.writable);
+#ifdef _WIN32
+        std::swap(file, other.file);
+        std::swap(mapping, other.mapping);
+#else
+        std::swap(fd, other.fd);
+#endif
+    }
+};
+
+#endif
@@ -2,89 +2,138 @@
 #ifndef MATERIAL_H
 #define MATERIAL_H
 
+#include "binary_io.h"
 #include "hittable.h"
+#include "material_handle.h"
+#include "texture.h"
+
+#include <vector>
 
 class material {
 public:
+	// Base class for custom materials. The built-in lambertian, metal and dielectric types
+	// don't derive from it: a material_library keeps them by value in arrays of their own, and
+	// only custom materials go through this virtual scatter.
 	virtual ~material() = default;
 
 	virtual bool scatter(
-		const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered
+		const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered, sampler& s
 	) const {
 		return false;
 	}
+
+	virtual color emitted(const hit_record& rec) const {
+		return color(0, 0, 0);
+	}
+
+	virtual color get_albedo() const {
+		return color(1, 1, 1);
+	}
 };
 
-class lambertian : public material {
+class lambertian final {
 public:
     lambertian(const color& albedo) : albedo(albedo) {}
+    lambertian(texture_handle tex, const color& tint = color(1, 1, 1)) : albedo(tint), tex(tex) {}
 
-    bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered)
-    const override {
-        auto scatter_direction = rec.normal + random_unit_vector();
+    bool scatter(
+        const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered, sampler& s
+    ) const {
+        auto scatter_direction = rec.normal + random_unit_vector(s);
         
         // Catch degenerate scatter direction
         if (scatter_direction.near_zero())
             scatter_direction = rec.normal;
         
-        scattered = ray(rec.p, scatter_direction);
-        attenuation = albedo;
+        scattered = ray(rec.p, scatter_direction, r_in.time());
+        attenuation = albedo_at(rec);
         return true;
     }
 
+    // For light sampling: the density with which scatter() picks `direction` (it follows the
+    // cosine to the normal), and the BRDF times that cosine for the same direction.
+    double scattering_pdf(const hit_record& rec, const vec3& direction) const {
+        auto cosine = dot(rec.normal, unit_vector(direction));
+        return cosine > 0 ? cosine / pi : 0;
+    }
+
+    color evaluate(const hit_record& rec, const vec3& direction) const {
+        return albedo_at(rec) * real(scattering_pdf(rec, direction));
+    }
+
+    const color& get_albedo() const { return albedo; }
+
+    // Textured materials take their color from rec.texture_color, which the camera fills in
+    // before shading, tinted by `albedo`.
+    texture_handle texture() const { return tex; }
+    color albedo_at(const hit_record& rec) const { return tex ? albedo * rec.texture_color : albedo; }
+
 private:
     color albedo;
+    texture_handle tex;
 };
 
-class metal : public material {
+class metal final {
 public:
-    metal(const color& albedo, double fuzz) : albedo(albedo), fuzz(fuzz < 1 ? fuzz : 1) {}
+    metal(const color& albedo, real fuzz) : albedo(albedo), fuzz(fuzz < 1 ? fuzz : 1) {}
+    metal(texture_handle tex, real fuzz, const color& tint = color(1, 1, 1))
+      : albedo(tint), fuzz(fuzz < 1 ? fuzz : 1), tex(tex) {}
 
-    bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered)
-    const override {
+    bool scatter(
+        const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered, sampler& s
+    ) const {
         vec3 reflected = reflect(r_in.direction(), rec.normal);
-        reflected = unit_vector(reflected) + (fuzz * random_unit_vector());
-        scattered = ray(rec.p, reflected);
-        attenuation = albedo;
+        reflected = unit_vector(reflected) + (fuzz * random_unit_vector(s));
+        scattered = ray(rec.p, reflected, r_in.time());
+        attenuation = albedo_at(rec);
         return (dot(scattered.direction(), rec.normal) > 0);
     }
 
+    const color& get_albedo() const { return albedo; }
+
+    texture_handle texture() const { return tex; }
+    color albedo_at(const hit_record& rec) const { return tex ? albedo * rec.texture_color : albedo; }
+
 private:
     color albedo;
-    double fuzz;
+    real fuzz;
+    texture_handle tex;
 };
 
-class dielectric : public material {
+class dielectric final {
 public:
-    dielectric(double refraction_index) : refraction_index(refraction_index) {}
+    dielectric(real refraction_index) : refraction_index(refraction_index) {}
 
-    bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered)
-        const override {
+    bool scatter(
+        const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered, sampler& s
+    ) const {
         attenuation = color(1.0, 1.0, 1.0);
-        double ri = rec.front_face ? (1.0 / refraction_index) : refraction_index;
+        real ri = rec.front_face ? (1 / refraction_index) : refraction_index;
 
         vec3 unit_direction = unit_vector(r_in.direction());
-        double cos_theta = std::fmin(dot(-unit_direction, rec.normal), 1.0);
-        double sin_theta = std::sqrt(1.0 - cos_theta * cos_theta);
+        real cos_theta = std::fmin(dot(-unit_direction, rec.normal), real(1));
+        real sin_theta = std::sqrt(1 - cos_theta * cos_theta);
 
         bool cannot_refract = ri * sin_theta > 1.0;
         vec3 direction;
 
-        if (cannot_refract || reflectance(cos_theta, ri) > random_double())
+        if (cannot_refract || reflectance(cos_theta, ri) > s.random_double())
             direction = reflect(unit_direction, rec.normal);
         else
             direction = refract(unit_direction, rec.normal, ri);
 
-        scattered = ray(rec.p, direction);
+        scattered = ray(rec.p, direction, r_in.time());
         return true;
     }
 
+    color get_albedo() const { return color(1, 1, 1); }
+
 private:
     // Refractive index in vacuum or air, or the ratio of the material's refractive index over
     // the refractive index of the enclosing media
-    double refraction_index;
+    real refraction_index;
 
-    static double reflectance(double cosine, double refraction_index) {
+    static real reflectance(real cosine, real refraction_index) {
         // Use Schlick's approximation for reflectance.
         auto r0 = (1 - refraction_index) / (1 + refraction_index);
         r0 = r0 * r0;
@@ -92,4 +141,153 @@ private:
     }
 };
 
+class diffuse_light final {
+public:
+    // Emits `emission` from the front side of a surface and scatters nothing. A light_list
+    // creates one per light it samples, recording the light's index for MIS; lights made
+    // directly keep `no_light` and are only found by paths that happen to hit them.
+    static const uint32_t no_light = 0xFFFFFFFFu;
+
+    diffuse_light(const color& emission, uint32_t light_index = no_light)
+      : emission(emission), light_index(light_index) {}
+
+    bool scatter(
+        const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered, sampler& s
+    ) const {
+        return false;
+    }
+
+    color emitted(const hit_record& rec) const {
+        return rec.front_face ? emission : color(0, 0, 0);
+    }
+
+    color get_albedo() const { return color(1, 1, 1); }
+
+    uint32_t light() const { return light_index; }
+
+private:
+    color emission;
+    uint32_t light_index;
+};
+
+class material_library {
+public:
+    // Every material of a scene, stored by type in contiguous arrays and referred to by
+    // material_handle. visit() switches on the handle's tag and hands the callback the
+    // concrete material, so calls on the built-in types are static and can be inlined.
+    //
+    // The textures that lambertian and metal materials refer to live in `textures`.
+
+    texture_library textures;
+
+    material_handle add(const lambertian& mat) { return append(lambertians, material_kind::lambertian, mat, bool(mat.texture())); }
+    material_handle add(const metal& mat) { return append(metals, material_kind::metal, mat, bool(mat.texture())); }
+    material_handle add(const dielectric& mat) { return append(dielectrics, material_kind::dielectric, mat); }
+    material_handle add(const diffuse_light& mat) { return append(diffuse_lights, material_kind::diffuse_light, mat); }
+    material_handle add(shared_ptr<material> mat) { return append(others, material_kind::other, mat); }
+
+    template <typename Material>
+    const Material& get(uint32_t index) const;
+
+    template <typename Visitor>
+    auto visit(material_handle handle, Visitor&& visitor) const {
+        switch (handle.kind()) {
+            case material_kind::lambertian: return visitor(lambertians[handle.index()]);
+            case material_kind::metal:      return visitor(metals[handle.index()]);
+            case material_kind::dielectric: return visitor(dielectrics[handle.index()]);
+            case material_kind::diffuse_light: return visitor(diffuse_lights[handle.index()]);
+            default:                        return visitor(*others[handle.index()]);
+        }
+    }
+
+    bool scatter(
+        material_handle handle, const ray& r_in, const hit_record& rec, color& attenuation,
+        ray& scattered, sampler& s
+    ) const {
+        return visit(handle, [&](const auto& mat) {
+            return mat.scatter(r_in, rec, attenuation, scattered, s);
+        });
+    }
+
+    color emitted(material_handle handle, const hit_record& rec) const {
+        // Only lights and custom materials emit; the common case returns without a call.
+        switch (handle.kind()) {
+            case material_kind::diffuse_light: return diffuse_lights[handle.index()].emitted(rec);
+            case material_kind::other:         return others[handle.index()]->emitted(rec);
+            default:                           return color(0, 0, 0);
+        }
+    }
+
+    texture_handle texture(material_handle handle) const {
+        // The material's texture, if it has one.
+        switch (handle.kind()) {
+            case material_kind::lambertian: return lambertians[handle.index()].texture();
+            case material_kind::metal:      return metals[handle.index()].texture();
+            default:                        return texture_handle();
+        }
+    }
+
+    color albedo(const hit_record& rec) const {
+        // The surface color at a hit, for the denoiser's feature images. Clear and emissive
+        // materials count as white.
+        switch (rec.mat.kind()) {
+            case material_kind::lambertian: return lambertians[rec.mat.index()].albedo_at(rec);
+            case material_kind::metal:      return metals[rec.mat.index()].albedo_at(rec);
+            default: return visit(rec.mat, [](const auto& mat) { return color(mat.get_albedo()); });
+        }
+    }
+
+    size_t size() const {
+        return lambertians.size() + metals.size() + dielectrics.size() + diffuse_lights.size()
+             + others.size();
+    }
+
+    size_t memory_bytes() const {
+        // Array storage, plus the separately allocated custom materials' pointers.
+        return lambertians.capacity() * sizeof(lambertian) + metals.capacity() * sizeof(metal)
+             + dielectrics.capacity() * sizeof(dielectric)
+             + diffuse_lights.capacity() * sizeof(diffuse_light)
+             + others.capacity() * sizeof(shared_ptr<material>);
+    }
+
+    bool save(binary_writer& out) const {
+        // Custom materials have no stored form, so a library holding any can't be saved.
+        if (!others.empty())
+            return false;
+        out.put_array(lambertians);
+        out.put_array(metals);
+        out.put_array(dielectrics);
+        out.put_array(diffuse_lights);
+        textures.save(out);
+        return true;
+    }
+
+    bool load(binary_reader& in) {
+        // Handles index each type's array, so they stay valid across a save and load. The
+        // textures must still be empty.
+        others.clear();
+        return in.get_array(lambertians) && in.get_array(metals) && in.get_array(dielectrics)
+            && in.get_array(diffuse_lights) && textures.load(in);
+    }
+
+private:
+    std::vector<lambertian> lambertians;
+    std::vector<metal> metals;
+    std::vector<dielectric> dielectrics;
+    std::vector<diffuse_light> diffuse_lights;
+    std::vector<shared_ptr<material>> others;
+
+    template <typename T>
+    static material_handle append(std::vector<T>& array, material_kind kind, const T& mat, bool textured = false) {
+        array.push_back(mat);
+        return material_handle(kind, uint32_t(array.size() - 1), textured);
+    }
+};
+
+template <> inline const lambertian& material_library::get<lambertian>(uint32_t index) const { return lambertians[index]; }
+template <> inline const metal& material_library::get<metal>(uint32_t index) const { return metals[index]; }
+template <> inline const dielectric& material_library::get<dielectric>(uint32_t index) const { return dielectrics[index]; }
+template <> inline const diffuse_light& material_library::get<diffuse_light>(uint32_t index) const { return diffuse_lights[index]; }
+template <> inline const material& material_library::get<material>(uint32_t index) const { return *others[index]; }
+
 #endif
\ No newline at end of file
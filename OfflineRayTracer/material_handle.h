@@ -0,0 +1,43 @@
+#pragma once
+#ifndef MATERIAL_HANDLE_H
+#define MATERIAL_HANDLE_H
+
+#include <cstdint>
+
+// The material types that a material_library stores in arrays of their own. Custom materials
+// derived from `material` are kept behind pointers, as `other`.
+enum class material_kind : uint32_t {
+	other,
+	lambertian,
+	metal,
+	dielectric,
+	diffuse_light
+};
+
+class material_handle {
+public:
+	// A 32-bit reference to a material in a material_library: the type tag in the top bits, a
+	// flag for textured materials, and the index into that type's array below.
+	// Default-constructed handles refer to nothing.
+	static const int kind_shift = 28;
+	static const int index_bits = 27;
+	static const uint32_t max_index = (1u << index_bits) - 1;
+
+	material_handle() : bits(0xFFFFFFFFu) {}
+	material_handle(material_kind kind, uint32_t index, bool textured = false)
+		: bits(uint32_t(kind) << kind_shift | (textured ? 1u << index_bits : 0) | (index & max_index)) {}
+
+	material_kind kind() const { return material_kind(bits >> kind_shift); }
+	uint32_t index() const { return bits & max_index; }
+
+	// Whether hits need surface coordinates for a texture lookup. Shapes skip computing them
+	// otherwise. An empty handle counts as textured, since an instance may supply the material.
+	bool textured() const { return (bits >> index_bits & 1) != 0; }
+
+	explicit operator bool() const { return bits != 0xFFFFFFFFu; }
+
+private:
+	uint32_t bits;
+};
+
+#endif
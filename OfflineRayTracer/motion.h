@@ -0,0 +1,43 @@
+#pragma once
+#ifndef MOTION_H
+#define MOTION_H
+
+#include "aabb.h"
+
+#include <algorithm>
+#include <numeric>
+
+// Keyframed motion over ray times 0..1: `segments` equal steps between segments + 1 keys, with
+// linear interpolation between neighbouring keys.
+
+struct motion_step {
+    int  segment;   // Keys `segment` and `segment + 1` bracket the time
+    real fraction;  // Position between the two, 0..1
+
+    motion_step(real time, int segments) {
+        auto scaled = std::min(std::max(time, real(0)), real(1)) * segments;
+        segment = std::min(int(scaled), segments - 1);
+        fraction = scaled - segment;
+    }
+};
+
+inline point3 lerp(const point3& a, const point3& b, real f) {
+    return a + f * (b - a);
+}
+
+inline aabb lerp(const aabb& a, const aabb& b, real f) {
+    return aabb(
+        interval(a.x.min + f * (b.x.min - a.x.min), a.x.max + f * (b.x.max - a.x.max)),
+        interval(a.y.min + f * (b.y.min - a.y.min), a.y.max + f * (b.y.max - a.y.max)),
+        interval(a.z.min + f * (b.z.min - a.z.min), a.z.max + f * (b.z.max - a.z.max)));
+}
+
+inline int common_motion_segments(int a, int b) {
+    // The fewest segments whose keys fall on both motions' keys, so that both move linearly
+    // within each of its segments.
+    if (a <= 0 || b <= 0)
+        return std::max(a, b);
+    return std::lcm(a, b);
+}
+
+#endif
@@ -0,0 +1,124 @@
+#pragma once
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Triangles read from a Wavefront OBJ file. Positions, normals and texture coordinates are
+// indexed separately, as in the file, with three indices per triangle; `normal_indices` is
+// empty when any face lacks normals, and `texcoord_indices` when any lacks texture
+// coordinates. Groups and materials are skipped.
+struct texcoord {
+    real u, v;
+};
+
+struct obj_mesh {
+    std::vector<point3>   positions;
+    std::vector<vec3>     normals;
+    std::vector<texcoord> texcoords;
+    std::vector<uint32_t> position_indices;
+    std::vector<uint32_t> normal_indices;
+    std::vector<uint32_t> texcoord_indices;
+};
+
+inline bool load_obj(const std::string& path, obj_mesh& mesh) {
+    // Faces with more than three corners are split into triangle fans, and negative (relative)
+    // indices are resolved against the elements read so far. Returns false if the file can't
+    // be opened or a face refers to an element that doesn't exist.
+    std::ifstream file(path);
+    if (!file)
+        return false;
+
+    mesh = obj_mesh();
+    bool every_face_has_normals = true, every_face_has_texcoords = true;
+    std::vector<long> corner_positions, corner_normals, corner_texcoords;
+    std::string line;
+
+    auto resolve = [](long index, size_t count) -> long {
+        return index < 0 ? long(count) + index : index - 1;
+    };
+
+    while (std::getline(file, line)) {
+        const char* c = line.c_str();
+        while (*c == ' ' || *c == '\t')
+            c++;
+
+        char* end;
+        if (c[0] == 'v' && (c[1] == ' ' || c[1] == '\t')) {
+            double x = std::strtod(c + 2, &end);
+            double y = std::strtod(end, &end);
+            double z = std::strtod(end, &end);
+            mesh.positions.push_back(point3(x, y, z));
+        }
+        else if (c[0] == 'v' && c[1] == 'n' && (c[2] == ' ' || c[2] == '\t')) {
+            double x = std::strtod(c + 3, &end);
+            double y = std::strtod(end, &end);
+            double z = std::strtod(end, &end);
+            mesh.normals.push_back(vec3(x, y, z));
+        }
+        else if (c[0] == 'v' && c[1] == 't' && (c[2] == ' ' || c[2] == '\t')) {
+            double u = std::strtod(c + 3, &end);
+            double v = std::strtod(end, &end);
+            mesh.texcoords.push_back({ real(u), real(v) });
+        }
+        else if (c[0] == 'f' && (c[1] == ' ' || c[1] == '\t')) {
+            // Each corner is v, v/vt, v//vn or v/vt/vn.
+            corner_positions.clear();
+            corner_normals.clear();
+            corner_texcoords.clear();
+            c += 2;
+            while (true) {
+                long v = std::strtol(c, &end, 10);
+                if (end == c)
+                    break;
+                c = end;
+                long vt = 0, vn = 0;
+                if (*c == '/') {
+                    c++;
+                    vt = std::strtol(c, &end, 10);
+                    c = end;
+                    if (*c == '/') {
+                        c++;
+                        vn = std::strtol(c, &end, 10);
+                        c = end;
+                    }
+                }
+                corner_positions.push_back(resolve(v, mesh.positions.size()));
+                corner_normals.push_back(vn ? resolve(vn, mesh.normals.size()) : -1);
+                corner_texcoords.push_back(vt ? resolve(vt, mesh.texcoords.size()) : -1);
+            }
+
+            for (size_t k = 0; k < corner_positions.size(); k++) {
+                if (corner_positions[k] < 0 || corner_positions[k] >= long(mesh.positions.size())
+                    || corner_normals[k] >= long(mesh.normals.size())
+                    || corner_texcoords[k] >= long(mesh.texcoords.size()))
+                    return false;
+                if (corner_normals[k] < 0)
+                    every_face_has_normals = false;
+                if (corner_texcoords[k] < 0)
+                    every_face_has_texcoords = false;
+            }
+
+            for (size_t k = 2; k < corner_positions.size(); k++) {
+                for (size_t corner : { size_t(0), k - 1, k }) {
+                    mesh.position_indices.push_back(uint32_t(corner_positions[corner]));
+                    mesh.normal_indices.push_back(uint32_t(corner_normals[corner] < 0 ? 0 : corner_normals[corner]));
+                    mesh.texcoord_indices.push_back(uint32_t(corner_texcoords[corner] < 0 ? 0 : corner_texcoords[corner]));
+                }
+            }
+        }
+    }
+
+    if (!every_face_has_normals || mesh.normals.empty())
+        mesh.normal_indices.clear();
+    if (!every_face_has_texcoords || mesh.texcoords.empty())
+        mesh.texcoord_indices.clear();
+
+    return true;
+}
+
+#endif
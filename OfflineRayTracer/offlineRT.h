@@ -8,6 +8,24 @@
 #include <limits>
 #include <memory>
 
+// Precision and SIMD Switches
+//
+// Define OFFLINERT_USE_FLOAT to render in single precision. Defining OFFLINERT_USE_SSE as well
+// runs the vec3 arithmetic on SSE registers.
+
+#ifdef OFFLINERT_USE_FLOAT
+using real = float;
+#else
+using real = double;
+#endif
+
+#ifdef OFFLINERT_USE_SSE
+#ifndef OFFLINERT_USE_FLOAT
+#error "OFFLINERT_USE_SSE requires OFFLINERT_USE_FLOAT"
+#endif
+#include <xmmintrin.h>
+#endif
+
 // C++ Std Usings
 
 using std::make_shared;
@@ -15,7 +33,7 @@ using std::shared_ptr;
 
 // Constants
 
-const double infinity = std::numeric_limits<double>::infinity();
+const real infinity = std::numeric_limits<real>::infinity();
 const double pi = 3.1415926535897932385;
 
 // Utility Functions
@@ -24,21 +42,12 @@ inline double degrees_to_radians(double degrees) {
     return degrees * pi / 180.0;
 }
 
-inline double random_double() {
-    // Returns a random real in [0,1).
-    return std::rand() / (RAND_MAX + 1.0);
-}
-
-inline double random_double(double min, double max) {
-    // Returns a random real in [min,max).
-    return min + (max - min) * random_double();
-}
-
 // Common Headers
 
 #include "color.h"
 #include "interval.h"
 #include "ray.h"
+#include "sampler.h"
 #include "vec3.h"
 
 #endif
\ No newline at end of file
@@ -0,0 +1,348 @@
+#pragma once
+#ifndef PNG_READER_H
+#define PNG_READER_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// A self-contained PNG decoder, enough for the textures under */Assets/Textures: every color
+// type, 8- and 16-bit samples (16-bit ones keep their high byte), no interlacing. Decoding
+// happens once per image, when the texture cache builds its tiled mip file, so the inflater
+// favours brevity over speed: Huffman codes are decoded a bit at a time as in zlib's puff.c.
+
+class inflater {
+public:
+    // Decompresses a zlib stream (RFC 1950/1951) into `out`. Returns false on corrupt data.
+    static bool zlib(const std::vector<uint8_t>& in, std::vector<uint8_t>& out) {
+        if (in.size() < 2 || (in[0] & 0x0F) != 8 || ((in[0] << 8) | in[1]) % 31 != 0 || (in[1] & 0x20))
+            return false;  // Not deflate, bad header check, or a preset dictionary
+        inflater state(in.data() + 2, in.size() - 2, out);
+        return state.run();
+    }
+
+private:
+    struct huffman {
+        uint16_t count[16];   // Codes of each length
+        uint16_t symbol[288]; // Symbols ordered by code
+    };
+
+    const uint8_t* data;
+    size_t size, position = 0;
+    uint32_t bit_buffer = 0;
+    int bit_count = 0;
+    bool overrun = false;
+    std::vector<uint8_t>& out;
+
+    inflater(const uint8_t* data, size_t size, std::vector<uint8_t>& out) : data(data), size(size), out(out) {}
+
+    int bits(int need) {
+        // The next `need` bits, least significant first.
+        uint32_t value = bit_buffer;
+        while (bit_count < need) {
+            if (position >= size) {
+                overrun = true;
+                return 0;
+            }
+            value |= uint32_t(data[position++]) << bit_count;
+            bit_count += 8;
+        }
+        bit_buffer = value >> need;
+        bit_count -= need;
+        return int(value & ((1u << need) - 1));
+    }
+
+    static bool construct(huffman& h, const uint16_t* lengths, int n) {
+        // Canonical code from code lengths. Incomplete codes are allowed, over-full ones are not.
+        std::memset(h.count, 0, sizeof(h.count));
+        for (int s = 0; s < n; s++)
+            h.count[lengths[s]]++;
+        if (h.count[0] == n)
+            return true;
+
+        int left = 1;
+        for (int len = 1; len < 16; len++) {
+            left = 2 * left - h.count[len];
+            if (left < 0)
+                return false;
+        }
+
+        uint16_t offsets[16];
+        offsets[1] = 0;
+        for (int len = 1; len < 15; len++)
+            offsets[len + 1] = uint16_t(offsets[len] + h.count[len]);
+        for (int s = 0; s < n; s++) {
+            if (lengths[s] != 0)
+                h.symbol[offsets[lengths[s]]++] = uint16_t(s);
+        }
+        return true;
+    }
+
+    int decode(const huffman& h) {
+        // Walks the canonical code one bit at a time; returns -1 for an invalid code.
+        int code = 0, first = 0, index = 0;
+        for (int len = 1; len < 16; len++) {
+            code |= bits(1);
+            int count = h.count[len];
+            if (code - count < first)
+                return h.symbol[index + (code - first)];
+            index += count;
+            first = (first + count) << 1;
+            code <<= 1;
+        }
+        return -1;
+    }
+
+    bool stored() {
+        bit_buffer = 0;  // Stored blocks start on a byte boundary
+        bit_count = 0;
+        if (position + 4 > size)
+            return false;
+        unsigned length = data[position] | (data[position + 1] << 8);
+        unsigned check = data[position + 2] | (data[position + 3] << 8);
+        position += 4;
+        if (length != (~check & 0xFFFF) || position + length > size)
+            return false;
+        out.insert(out.end(), data + position, data + position + length);
+        position += length;
+        return true;
+    }
+
+    bool codes(const huffman& lengths, const huffman& distances) {
+        static const uint16_t length_base[29] = {
+            3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+            35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+        static const uint8_t length_extra[29] = {
+            0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+        static const uint16_t distance_base[30] = {
+            1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+            257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+        static const uint8_t distance_extra[30] = {
+            0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+        while (true) {
+            int symbol = decode(lengths);
+            if (symbol < 0 || overrun)
+                return false;
+            if (symbol < 256) {
+                out.push_back(uint8_t(symbol));
+                continue;
+            }
+            if (symbol == 256)
+                return true;
+
+            symbol -= 257;
+            if (symbol >= 29)
+                return false;
+            size_t length = length_base[symbol] + bits(length_extra[symbol]);
+            int d = decode(distances);
+            if (d < 0 || d >= 30)
+                return false;
+            size_t distance = distance_base[d] + bits(distance_extra[d]);
+            if (overrun || distance > out.size())
+                return false;
+
+            // Copies may overlap their own output, so go a byte at a time.
+            size_t from = out.size() - distance;
+            for (size_t k = 0; k < length; k++)
+                out.push_back(out[from + k]);
+        }
+    }
+
+    bool fixed() {
+        static huffman lengths, distances;
+        static const bool built = [] {
+            uint16_t l[288];
+            for (int s = 0; s < 288; s++)
+                l[s] = uint16_t(s < 144 ? 8 : s < 256 ? 9 : s < 280 ? 7 : 8);
+            construct(lengths, l, 288);
+            for (int s = 0; s < 30; s++)
+                l[s] = 5;
+            construct(distances, l, 30);
+            return true;
+        }();
+        (void)built;
+        return codes(lengths, distances);
+    }
+
+    bool dynamic() {
+        static const uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+        int literal_count = bits(5) + 257, distance_count = bits(5) + 1, code_count = bits(4) + 4;
+        if (literal_count > 286 || distance_count > 30)
+            return false;
+
+        uint16_t l[320] = {};
+        for (int k = 0; k < code_count; k++)
+            l[order[k]] = uint16_t(bits(3));
+        huffman code_lengths, lengths, distances;
+        if (!construct(code_lengths, l, 19))
+            return false;
+
+        int index = 0;
+        while (index < literal_count + distance_count) {
+            int symbol = decode(code_lengths);
+            if (symbol < 0 || overrun)
+                return false;
+            if (symbol < 16) {
+                l[index++] = uint16_t(symbol);
+                continue;
+            }
+            uint16_t repeat_length = 0;
+            int repeat;
+            if (symbol == 16) {
+                if (index == 0)
+                    return false;
+                repeat_length = l[index - 1];
+                repeat = 3 + bits(2);
+            }
+            else {
+                repeat = symbol == 17 ? 3 + bits(3) : 11 + bits(7);
+            }
+            if (index + repeat > literal_count + distance_count)
+                return false;
+            while (repeat-- > 0)
+                l[index++] = repeat_length;
+        }
+        if (l[256] == 0)
+            return false;  // No end-of-block code
+
+        return construct(lengths, l, literal_count)
+            && construct(distances, l + literal_count, distance_count)
+            && codes(lengths, distances);
+    }
+
+    bool run() {
+        bool last = false;
+        while (!last) {
+            last = bits(1) != 0;
+            int type = bits(2);
+            bool ok = type == 0 ? stored() : type == 1 ? fixed() : type == 2 ? dynamic() : false;
+            if (!ok || overrun)
+                return false;
+        }
+        return true;
+    }
+};
+
+inline bool read_png(const std::string& path, int& width, int& height, std::vector<uint8_t>& rgba) {
+    // Decodes `path` into 8-bit RGBA rows, top row first. Returns false if the file can't be
+    // read or isn't a PNG this decoder handles.
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    if (bytes.size() < 8 || std::memcmp(bytes.data(), signature, 8) != 0)
+        return false;
+
+    auto be32 = [&](size_t at) {
+        return uint32_t(bytes[at]) << 24 | uint32_t(bytes[at + 1]) << 16 | uint32_t(bytes[at + 2]) << 8 | bytes[at + 3];
+    };
+
+    int bit_depth = 0, color_type = -1;
+    std::vector<uint8_t> compressed, palette, palette_alpha;
+    width = height = 0;
+    for (size_t at = 8; at + 12 <= bytes.size();) {
+        uint32_t length = be32(at);
+        if (length > bytes.size() - at - 12)
+            return false;
+        const uint8_t* body = &bytes[at + 8];
+        std::string type(reinterpret_cast<const char*>(&bytes[at + 4]), 4);
+
+        if (type == "IHDR" && length >= 13) {
+            width = int(be32(at + 8));
+            height = int(be32(at + 12));
+            bit_depth = body[8];
+            color_type = body[9];
+            if (body[10] != 0 || body[11] != 0 || body[12] != 0)
+                return false;  // Unknown compression or filter method, or interlaced
+        }
+        else if (type == "PLTE") {
+            palette.assign(body, body + length);
+        }
+        else if (type == "tRNS") {
+            palette_alpha.assign(body, body + length);
+        }
+        else if (type == "IDAT") {
+            compressed.insert(compressed.end(), body, body + length);
+        }
+        else if (type == "IEND") {
+            break;
+        }
+        at += 12 + size_t(length);
+    }
+
+    int channels = color_type == 0 ? 1 : color_type == 2 ? 3 : color_type == 3 ? 1 : color_type == 4 ? 2 : color_type == 6 ? 4 : 0;
+    bool depth_ok = color_type == 3 ? (bit_depth == 8) : (bit_depth == 8 || bit_depth == 16);
+    if (width <= 0 || height <= 0 || width > (1 << 16) || height > (1 << 16) || channels == 0 || !depth_ok)
+        return false;
+
+    std::vector<uint8_t> raw;
+    size_t bytes_per_pixel = size_t(channels) * (bit_depth / 8);
+    size_t stride = bytes_per_pixel * width;
+    raw.reserve((stride + 1) * height);
+    if (!inflater::zlib(compressed, raw) || raw.size() < (stride + 1) * height)
+        return false;
+
+    // Undo each row's filter (PNG spec section 9) in place, against the row above.
+    std::vector<uint8_t> previous(stride, 0);
+    for (int y = 0; y < height; y++) {
+        uint8_t filter = raw[y * (stride + 1)];
+        uint8_t* row = &raw[y * (stride + 1) + 1];
+        for (size_t k = 0; k < stride; k++) {
+            int a = k >= bytes_per_pixel ? row[k - bytes_per_pixel] : 0;
+            int b = previous[k];
+            int c = k >= bytes_per_pixel ? previous[k - bytes_per_pixel] : 0;
+            int predictor = 0;
+            switch (filter) {
+                case 0: break;
+                case 1: predictor = a; break;
+                case 2: predictor = b; break;
+                case 3: predictor = (a + b) / 2; break;
+                case 4: {
+                    int p = a + b - c, pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+                    predictor = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+                    break;
+                }
+                default: return false;
+            }
+            row[k] = uint8_t(row[k] + predictor);
+        }
+        std::memcpy(previous.data(), row, stride);
+    }
+
+    rgba.resize(size_t(width) * height * 4);
+    size_t sample_bytes = size_t(bit_depth / 8);
+    for (int y = 0; y < height; y++) {
+        const uint8_t* row = &raw[y * (stride + 1) + 1];
+        for (int x = 0; x < width; x++) {
+            const uint8_t* in = row + x * bytes_per_pixel;
+            auto sample = [&](int channel) { return in[channel * sample_bytes]; };  // High byte
+            uint8_t* o = &rgba[(size_t(y) * width + x) * 4];
+            switch (color_type) {
+                case 0: o[0] = o[1] = o[2] = sample(0); o[3] = 255; break;
+                case 2: o[0] = sample(0); o[1] = sample(1); o[2] = sample(2); o[3] = 255; break;
+                case 3: {
+                    size_t entry = in[0];
+                    if (3 * entry + 2 >= palette.size())
+                        return false;
+                    o[0] = palette[3 * entry];
+                    o[1] = palette[3 * entry + 1];
+                    o[2] = palette[3 * entry + 2];
+                    o[3] = entry < palette_alpha.size() ? palette_alpha[entry] : 255;
+                    break;
+                }
+                case 4: o[0] = o[1] = o[2] = sample(0); o[3] = sample(1); break;
+                default: o[0] = sample(0); o[1] = sample(1); o[2] = sample(2); o[3] = sample(3); break;
+            }
+        }
+    }
+    return true;
+}
+
+#endif
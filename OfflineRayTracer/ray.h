@@ -4,25 +4,31 @@
 
 #include "vec3.h"
 
-class ray {
+template <typename T>
+class ray_t {
 public:
-	ray() {}
+	ray_t() {}
 
-	ray(const point3& origin, const vec3& direction) :
+	ray_t(const vec3_t<T>& origin, const vec3_t<T>& direction, T time = 0) :
 		orig(origin),
-		dir(direction) {}
+		dir(direction),
+		tm(time) {}
 
-	const point3& origin() const	{ return orig; }
-	const vec3& direction() const	{ return dir;  }
+	const vec3_t<T>& origin() const	{ return orig; }
+	const vec3_t<T>& direction() const	{ return dir;  }
+	T time() const { return tm; }  // Within the shutter interval, 0..1 over an animation step
 
-	point3 at(double t) const {
+	vec3_t<T> at(T t) const {
 		return orig + t * dir;
 	}
 
 private:
-	point3 orig;
-	vec3 dir;
+	vec3_t<T> orig;
+	vec3_t<T> dir;
+	T tm = 0;
 };
 
+using ray = ray_t<real>;
+
 
 #endif
\ No newline at end of file
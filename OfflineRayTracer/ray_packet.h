@@ -0,0 +1,49 @@
+#pragma once
+#ifndef RAY_PACKET_H
+#define RAY_PACKET_H
+
+#include <cstdint>
+
+// A group of up to 16 rays traced together through hittable::hit_packet. Bit i of `active`
+// marks ray i as still taking part in the current traversal, and t_max[i] holds the closest hit
+// found for it so far. The ray origins and inverse directions are also kept as
+// structure-of-arrays so box tests can run several rays per SIMD register.
+
+class ray_packet {
+public:
+    static constexpr int max_size = 16;
+
+    int      size = 0;
+    uint32_t active = 0;
+    ray      rays[max_size];
+
+    alignas(16) real t_max[max_size] = {};
+    alignas(16) real origin_x[max_size] = {};
+    alignas(16) real origin_y[max_size] = {};
+    alignas(16) real origin_z[max_size] = {};
+    alignas(16) real inv_dir_x[max_size] = {};
+    alignas(16) real inv_dir_y[max_size] = {};
+    alignas(16) real inv_dir_z[max_size] = {};
+
+    void clear() {
+        size = 0;
+        active = 0;
+    }
+
+    bool full() const { return size == max_size; }
+
+    void add(const ray& r, real ray_t_max) {
+        int i = size++;
+        rays[i] = r;
+        t_max[i] = ray_t_max;
+        origin_x[i] = r.origin().x();
+        origin_y[i] = r.origin().y();
+        origin_z[i] = r.origin().z();
+        inv_dir_x[i] = 1 / r.direction().x();
+        inv_dir_y[i] = 1 / r.direction().y();
+        inv_dir_z[i] = 1 / r.direction().z();
+        active |= 1u << i;
+    }
+};
+
+#endif
@@ -0,0 +1,270 @@
+#pragma once
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <cstdint>
+#include <memory>
+
+// Sources of random numbers for the renderer. Every consumer (camera, vec3 helpers, materials)
+// draws through a `sampler&` handed down the call chain rather than from global state, so each
+// render thread owns its own generator and results can be made reproducible.
+//
+// Draws come in two flavours. `random_double` is a plain uniform variate. `next_2d` is a
+// sample from the next 2D dimension pair of the current (pixel, sample, bounce); the
+// low-discrepancy samplers below only stratify these, so the camera's pixel and lens
+// offsets and each bounce's direction should be drawn with `next_2d`.
+
+class sampler {
+public:
+    virtual ~sampler() = default;
+
+    // Called by the camera before each camera ray and at each bounce, so that stateless
+    // samplers can key their output on where in the image and path they are.
+    virtual void start_pixel(int i, int j, int sample_index) {}
+    virtual void start_bounce(int bounce) {}
+
+    // Returns 32 uniformly distributed random bits.
+    virtual uint32_t next_uint() = 0;
+
+    // Returns a point in [0,1)^2 from the next dimension pair.
+    virtual void next_2d(double& u, double& v) {
+        u = random_double();
+        v = random_double();
+    }
+
+    double random_double() {
+        // Returns a random real in [0,1).
+        return next_uint() * (1.0 / 4294967296.0);
+    }
+
+    double random_double(double min, double max) {
+        // Returns a random real in [min,max).
+        return min + (max - min) * random_double();
+    }
+};
+
+class pcg32_sampler : public sampler {
+public:
+    // PCG-XSH-RR with 64-bit state (O'Neill, 2014). Distinct stream ids give independent
+    // sequences from the same seed.
+    pcg32_sampler(uint64_t seed = 0x853c49e6748fea9bULL, uint64_t stream = 0xda3e39cb94b95bdbULL) {
+        state = 0;
+        inc = (stream << 1) | 1;
+        next_uint();
+        state += seed;
+        next_uint();
+    }
+
+    uint32_t next_uint() override {
+        uint64_t old_state = state;
+        state = old_state * 6364136223846793005ULL + inc;
+        auto xorshifted = uint32_t(((old_state >> 18) ^ old_state) >> 27);
+        auto rot = uint32_t(old_state >> 59);
+        return (xorshifted >> rot) | (xorshifted << ((0u - rot) & 31));
+    }
+
+private:
+    uint64_t state;
+    uint64_t inc;
+};
+
+class counter_sampler : public sampler {
+public:
+    // A stateless generator: every value is a hash of (seed, pixel, sample, bounce, dimension),
+    // where the dimension counts draws since the last start_pixel/start_bounce call. Any one
+    // sample can be regenerated in isolation, independent of render order.
+    counter_sampler(uint64_t seed = 0) : seed(seed) {}
+
+    void start_pixel(int i, int j, int sample_index) override {
+        pixel_i = i;
+        pixel_j = j;
+        sample = sample_index;
+        pixel_key = mix(seed ^ mix((uint64_t(uint32_t(j)) << 32 | uint32_t(i)) + 0x9E3779B97F4A7C15ULL));
+        sample_key = mix(pixel_key ^ uint64_t(uint32_t(sample_index)));
+        start_bounce(-1);
+    }
+
+    void start_bounce(int bounce) override {
+        bounce_key = mix(sample_key ^ (uint64_t(uint32_t(bounce)) << 32));
+        dimension_key = mix(seed ^ (uint64_t(uint32_t(bounce)) << 32));
+        dimension = 0;
+        pair = 0;
+    }
+
+    uint32_t next_uint() override {
+        return uint32_t(mix(bounce_key + dimension++) >> 32);
+    }
+
+protected:
+    uint64_t seed;
+    int      pixel_i = 0, pixel_j = 0;
+    int      sample = 0;
+    uint64_t pixel_key = 0;      // Hash of (seed, pixel)
+    uint64_t sample_key = 0;     // Hash of (seed, pixel, sample)
+    uint64_t bounce_key = 0;     // Hash of (seed, pixel, sample, bounce)
+    uint64_t dimension_key = 0;  // Hash of (seed, bounce), shared by every pixel
+    uint64_t dimension = 0;      // 1D draws since the last bounce started
+    uint32_t pair = 0;           // 2D draws since the last bounce started
+
+    static uint64_t mix(uint64_t z) {
+        // The SplitMix64 finalizer: a cheap bijective hash with good avalanche.
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    static double to_unit(uint32_t x) {
+        return x * (1.0 / 4294967296.0);
+    }
+};
+
+class stratified_sampler : public counter_sampler {
+public:
+    // Jittered stratification of each dimension pair over a pixel's samples. The strata are
+    // visited in a different pseudorandom order for every pixel and dimension pair, so the
+    // pairs stay decorrelated from each other.
+    stratified_sampler(uint64_t seed, int samples_per_pixel) : counter_sampler(seed) {
+        strata_x = 1;
+        while ((strata_x + 1) * (strata_x + 1) <= samples_per_pixel)
+            strata_x++;
+        strata_y = (samples_per_pixel + strata_x - 1) / strata_x;
+    }
+
+    void next_2d(double& u, double& v) override {
+        auto key = mix(pixel_key ^ (dimension_key + pair++));
+        auto strata = uint32_t(strata_x * strata_y);
+        auto stratum = permute(uint32_t(sample) % strata, strata, uint32_t(key));
+
+        auto jitter = mix(key ^ uint64_t(uint32_t(sample)));
+        u = (stratum % strata_x + to_unit(uint32_t(jitter))) / strata_x;
+        v = (stratum / strata_x + to_unit(uint32_t(jitter >> 32))) / strata_y;
+    }
+
+private:
+    int strata_x, strata_y;
+
+    static uint32_t permute(uint32_t i, uint32_t l, uint32_t p) {
+        // Kensler's hashed permutation of [0, l) ("Correlated Multi-Jittered Sampling", 2013).
+        uint32_t w = l - 1;
+        w |= w >> 1; w |= w >> 2; w |= w >> 4; w |= w >> 8; w |= w >> 16;
+        do {
+            i ^= p; i *= 0xe170893d; i ^= p >> 16; i ^= (i & w) >> 4;
+            i ^= p >> 8; i *= 0x0929eb3f; i ^= p >> 23; i ^= (i & w) >> 1;
+            i *= 1 | p >> 27; i *= 0x6935fa69; i ^= (i & w) >> 11; i *= 0x74dcb303;
+            i ^= (i & w) >> 2; i *= 0x9e501cc3; i ^= (i & w) >> 2; i *= 0xc860a3df;
+            i &= w; i ^= i >> 5;
+        } while (i >= l);
+        return (i + p) % l;
+    }
+};
+
+class sobol_sampler : public counter_sampler {
+public:
+    // The first two Sobol dimensions with hash-based Owen scrambling (Burley, "Practical
+    // Hash-based Owen Scrambling", 2020). Higher dimensions are padded by giving each pair its
+    // own scramble seeds and a shuffled sample order. With `screen_space_blue_noise`, every
+    // pixel instead takes a consecutive run of one shared sequence, in a scrambled Morton order
+    // of the pixels, which pushes the remaining error into blue noise across the image (Ahmed
+    // and Wonka, "Screen-Space Blue-Noise Diffusion of Monte Carlo Sampling Error via
+    // Hierarchical Ordering of Pixels", 2020).
+    sobol_sampler(uint64_t seed, int samples_per_pixel, bool screen_space_blue_noise)
+        : counter_sampler(seed), samples_per_pixel(samples_per_pixel),
+          blue_noise(screen_space_blue_noise) {}
+
+    void next_2d(double& u, double& v) override {
+        auto pair_seed = mix(dimension_key + pair++);
+        uint32_t index;
+
+        if (blue_noise) {
+            // All pixels share this pair's scrambling, and are told apart only by where their
+            // run sits in the sequence.
+            auto rank = nested_uniform_scramble(morton(pixel_i, pixel_j), uint32_t(pair_seed));
+            index = rank * uint32_t(samples_per_pixel) + uint32_t(sample);
+            index = nested_uniform_scramble(index, uint32_t(pair_seed >> 32));
+        }
+        else {
+            auto key = mix(pixel_key ^ pair_seed);
+            index = nested_uniform_scramble(uint32_t(sample), uint32_t(key));
+            pair_seed = key;
+        }
+
+        u = to_unit(nested_uniform_scramble(sobol_0(index), uint32_t(pair_seed)));
+        v = to_unit(nested_uniform_scramble(sobol_1(index), uint32_t(pair_seed >> 32)));
+    }
+
+private:
+    int  samples_per_pixel;
+    bool blue_noise;
+
+    static uint32_t reverse_bits(uint32_t x) {
+        x = (x << 16) | (x >> 16);
+        x = ((x & 0x00ff00ff) << 8) | ((x & 0xff00ff00) >> 8);
+        x = ((x & 0x0f0f0f0f) << 4) | ((x & 0xf0f0f0f0) >> 4);
+        x = ((x & 0x33333333) << 2) | ((x & 0xcccccccc) >> 2);
+        x = ((x & 0x55555555) << 1) | ((x & 0xaaaaaaaa) >> 1);
+        return x;
+    }
+
+    static uint32_t laine_karras_permutation(uint32_t x, uint32_t seed) {
+        x += seed;
+        x ^= x * 0x6c50b47cu;
+        x ^= x * 0xb82f1e52u;
+        x ^= x * 0xc7afe638u;
+        x ^= x * 0x8d22f6e6u;
+        return x;
+    }
+
+    static uint32_t nested_uniform_scramble(uint32_t x, uint32_t seed) {
+        // An Owen scramble: each bit is flipped based on a hash of the bits above it.
+        return reverse_bits(laine_karras_permutation(reverse_bits(x), seed));
+    }
+
+    static uint32_t sobol_0(uint32_t index) {
+        // The first Sobol dimension is the base-2 van der Corput sequence.
+        return reverse_bits(index);
+    }
+
+    static uint32_t sobol_1(uint32_t index) {
+        uint32_t result = 0;
+        for (uint32_t v = 1u << 31; index; index >>= 1, v ^= v >> 1)
+            if (index & 1)
+                result ^= v;
+        return result;
+    }
+
+    static uint32_t morton(int i, int j) {
+        uint32_t code = 0;
+        for (int bit = 0; bit < 16; bit++) {
+            code |= ((uint32_t(i) >> bit) & 1) << (2 * bit);
+            code |= ((uint32_t(j) >> bit) & 1) << (2 * bit + 1);
+        }
+        return code;
+    }
+};
+
+enum class sampler_type {
+    pcg32,      // Fast sequential generator, one stream per tile
+    counter,    // Stateless, keyed on (pixel, sample, bounce)
+    stratified, // Jittered strata per dimension pair
+    sobol,      // Owen-scrambled Sobol per pixel
+    blue_noise  // Owen-scrambled Sobol, ordered for blue-noise error across pixels
+};
+
+inline std::unique_ptr<sampler> make_sampler(
+    sampler_type type, uint64_t seed, uint64_t stream, int samples_per_pixel
+) {
+    switch (type) {
+        case sampler_type::counter:
+            return std::unique_ptr<sampler>(new counter_sampler(seed));
+        case sampler_type::stratified:
+            return std::unique_ptr<sampler>(new stratified_sampler(seed, samples_per_pixel));
+        case sampler_type::sobol:
+            return std::unique_ptr<sampler>(new sobol_sampler(seed, samples_per_pixel, false));
+        case sampler_type::blue_noise:
+            return std::unique_ptr<sampler>(new sobol_sampler(seed, samples_per_pixel, true));
+        default:
+            return std::unique_ptr<sampler>(new pcg32_sampler(seed, stream));
+    }
+}
+
+#endif
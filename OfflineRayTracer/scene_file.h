@@ -0,0 +1,484 @@
+#pragma once
+#ifndef SCENE_FILE_H
+#define SCENE_FILE_H
+
+#include "binary_io.h"
+#include "camera.h"
+#include "hittable_list.h"
+#include "light_list.h"
+#include "material.h"
+#include "sphere_batch.h"
+#include "tlas.h"
+#include "transform.h"
+#include "triangle_mesh.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Scene files describe a camera, materials, spheres, meshes and mesh instances. The text form
+// has one statement per line; '#' starts a comment.
+//
+//   camera aspect_ratio 1.7778        also image_width, samples_per_pixel, max_depth, vfov,
+//   camera lookfrom 13 2 3            lookat, vup, defocus_angle, focus_dist and sky_light (0/1)
+//   camera denoise 1                  denoise the image (0/1); also albedo_path and normal_path,
+//   camera albedo_path albedo.pfm     feature images to write, relative to the working directory
+//   texture wood image wood.png               PNG relative to the scene file; add "linear"
+//   texture tiles checker 0.5 1 1 1 0 0 0     for data images. Checker: cell size, two colors
+//   texture marble noise 4                    Perlin marble, at a frequency
+//   material ground lambertian 0.5 0.5 0.5
+//   material floor lambertian tiles           a texture in place of the albedo
+//   material steel metal 0.7 0.6 0.5 0.1      albedo or texture, fuzz
+//   material glass dielectric 1.5             refraction index
+//   material lamp light 4 4 4                 emission
+//   sphere 0 -1000 0 1000 ground              center, radius, material
+//   mesh helix helix.obj steel                name, OBJ path relative to the scene file, material
+//   instance helix translate 0 1 0 rotate 0 1 0 45 scale 2 material glass
+//
+// An instance places a mesh under transform steps applied in the order written: "translate x
+// y z", "rotate ax ay az degrees", "scale s" or "scale x y z". "material" overrides the mesh's.
+// Spheres with a light material are added to the light list as well.
+//
+// The binary form holds the same scene after loading: material arrays, the spheres in one
+// sphere_batch and every mesh with their BVHs already built, and the instance list. Loading it
+// maps the file and copies each array out in one piece, so it costs little more than reading
+// the bytes. Image textures are kept by path, and their texels are paged in on use as in the
+// text form. Binary files are a cache for the machine that wrote them: they are in host byte
+// order and keep `real`, and a file from a different build is refused.
+
+struct scene_instance {
+    uint32_t        mesh;  // Index into scene::meshes
+    material_handle mat;   // Replaces the mesh's own material unless empty
+    transform       object_to_world;
+};
+
+class scene {
+public:
+    camera                                 cam;  // The file's camera settings, on defaults
+    material_library                       materials;
+    light_list                             lights;
+    shared_ptr<sphere_batch>               spheres = make_shared<sphere_batch>();
+    std::vector<shared_ptr<triangle_mesh>> meshes;
+    std::vector<scene_instance>            instances;
+    hittable_list                          world;  // Spheres and instances, ready to render
+
+    bool load(const std::string& path) {
+        // Reads either form, told apart by the binary form's magic number. Problems are logged.
+        {
+            std::ifstream probe(path, std::ios::binary);
+            char magic[4] = {};
+            if (!probe || !probe.read(magic, 4)) {
+                std::clog << "Could not read scene '" << path << "'\n";
+                return false;
+            }
+            if (std::memcmp(magic, binary_header().magic, 4) != 0)
+                return load_text(path);
+        }
+        return load_binary(path);
+    }
+
+    bool save_binary(const std::string& path) const {
+        binary_writer out(path);
+        out.put(binary_header());
+        out.put(camera_settings::from(cam));
+        out.put_array(camera_settings::paths_of(cam));
+        if (!materials.save(out)) {
+            std::clog << "Scenes with custom materials can't be saved\n";
+            return false;
+        }
+        lights.save(out);
+        spheres->save(out);
+        out.put(uint64_t(meshes.size()));
+        for (const auto& mesh : meshes)
+            mesh->save(out);
+        out.put_array(instances);
+
+        if (!out.ok())
+            std::clog << "Could not write scene '" << path << "'\n";
+        return out.ok();
+    }
+
+private:
+    struct binary_header {
+        char     magic[4] = { 'O', 'R', 'T', 'S' };
+        uint32_t version = 3;
+        uint32_t real_size = sizeof(real);
+        uint32_t reserved = 0;
+    };
+
+    struct camera_settings {
+        // The camera fields a scene file sets, as stored in the binary form.
+        double   aspect_ratio, vfov, defocus_angle, focus_dist;
+        double   lookfrom[3], lookat[3], vup[3];
+        int32_t  image_width, samples_per_pixel, max_depth, sky_light, denoise;
+
+        static camera_settings from(const camera& cam) {
+            camera_settings c;
+            c.aspect_ratio = cam.aspect_ratio;
+            c.vfov = cam.vfov;
+            c.defocus_angle = cam.defocus_angle;
+            c.focus_dist = cam.focus_dist;
+            for (int k = 0; k < 3; k++) {
+                c.lookfrom[k] = cam.lookfrom[k];
+                c.lookat[k] = cam.lookat[k];
+                c.vup[k] = cam.vup[k];
+            }
+            c.image_width = cam.image_width;
+            c.samples_per_pixel = cam.samples_per_pixel;
+            c.max_depth = cam.max_depth;
+            c.sky_light = cam.sky_light;
+            c.denoise = cam.denoise;
+            return c;
+        }
+
+        static std::vector<char> paths_of(const camera& cam) {
+            // The feature image paths, each ended by a zero, stored after the settings.
+            std::vector<char> paths;
+            for (const auto* path : { &cam.albedo_path, &cam.normal_path }) {
+                paths.insert(paths.end(), path->begin(), path->end());
+                paths.push_back('\0');
+            }
+            return paths;
+        }
+
+        void apply(camera& cam) const {
+            cam.aspect_ratio = aspect_ratio;
+            cam.vfov = vfov;
+            cam.defocus_angle = defocus_angle;
+            cam.focus_dist = focus_dist;
+            cam.lookfrom = point3(lookfrom[0], lookfrom[1], lookfrom[2]);
+            cam.lookat = point3(lookat[0], lookat[1], lookat[2]);
+            cam.vup = vec3(vup[0], vup[1], vup[2]);
+            cam.image_width = image_width;
+            cam.samples_per_pixel = samples_per_pixel;
+            cam.max_depth = max_depth;
+            cam.sky_light = sky_light != 0;
+            cam.denoise = denoise != 0;
+        }
+
+        static bool apply_paths(const std::vector<char>& paths, camera& cam) {
+            auto start = paths.begin();
+            for (auto* path : { &cam.albedo_path, &cam.normal_path }) {
+                auto end = std::find(start, paths.end(), '\0');
+                if (end == paths.end())
+                    return false;
+                path->assign(start, end);
+                start = end + 1;
+            }
+            return true;
+        }
+    };
+
+    bool load_binary(const std::string& path) {
+        binary_reader in(path);
+        binary_header header, expected;
+        camera_settings settings;
+        std::vector<char> camera_paths;
+        uint64_t mesh_count = 0;
+
+        bool ok = in.is_open() && in.get(header) && header.version == expected.version
+               && header.real_size == expected.real_size && in.get(settings)
+               && in.get_array(camera_paths) && camera_settings::apply_paths(camera_paths, cam)
+               && materials.load(in) && lights.load(in) && spheres->load(in) && in.get(mesh_count);
+        for (uint64_t k = 0; ok && k < mesh_count; k++) {
+            auto mesh = triangle_mesh::load(in);
+            ok = mesh != nullptr;
+            meshes.push_back(mesh);
+        }
+        ok = ok && in.get_array(instances);
+        for (size_t k = 0; ok && k < instances.size(); k++)
+            ok = instances[k].mesh < meshes.size();
+
+        if (!ok) {
+            std::clog << "Could not load scene '" << path << "': "
+                      << (header.real_size != expected.real_size ? "written with another real type"
+                                                                 : "damaged or from another version") << '\n';
+            return false;
+        }
+        settings.apply(cam);
+        finish();
+        return true;
+    }
+
+    bool load_text(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        std::stringstream contents;
+        contents << file.rdbuf();
+        std::string text = contents.str();
+
+        auto slash = path.find_last_of("/\\");
+        std::string directory = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+
+        std::unordered_map<std::string, material_handle> named;
+        std::unordered_map<std::string, texture_handle> named_textures;
+        pcg32_sampler noise_tables;           // Draws each noise texture's tables in turn
+        std::unordered_map<std::string, color> emitters;     // Light materials, by name
+        std::unordered_map<std::string, uint32_t> mesh_names;
+        std::string last_name;                // Material of the previous sphere
+        material_handle last_mat;
+        const color* last_emission = nullptr;
+        int line_number = 0;
+
+        auto fail = [&](const std::string& message) {
+            std::clog << path << ':' << line_number << ": " << message << '\n';
+            return false;
+        };
+
+        // Light materials become a light per sphere, or one shared unsampled diffuse_light
+        // for everything else that uses them.
+        auto find_material = [&](const std::string& name, material_handle& mat) {
+            auto it = named.find(name);
+            if (it == named.end()) {
+                auto e = emitters.find(name);
+                if (e == emitters.end())
+                    return false;
+                it = named.emplace(name, materials.add(diffuse_light(e->second))).first;
+            }
+            mat = it->second;
+            return true;
+        };
+
+        const char* c = text.c_str();
+        while (*c) {
+            line_number++;
+            const char* line_end = std::strchr(c, '\n');
+            if (!line_end)
+                line_end = c + std::strlen(c);
+            auto comment = static_cast<const char*>(std::memchr(c, '#', size_t(line_end - c)));
+            statement s{ c, comment ? comment : line_end };
+            c = *line_end ? line_end + 1 : line_end;
+
+            auto keyword = s.word();
+            if (keyword.empty())
+                continue;
+
+            if (keyword == "sphere") {
+                double x = 0, y = 0, z = 0, radius = 0;
+                auto name = (s.number(x) && s.number(y) && s.number(z) && s.number(radius)) ? s.word() : "";
+                if (name != last_name) {
+                    // Runs of spheres often share a material; look it up once per run.
+                    auto e = emitters.find(name);
+                    last_emission = e != emitters.end() ? &e->second : nullptr;
+                    if (!last_emission && !find_material(name, last_mat))
+                        return fail(name.empty() ? "expected: sphere x y z radius material" : "unknown material '" + name + "'");
+                    last_name = name;
+                }
+                auto mat = last_emission ? lights.add_sphere(point3(x, y, z), real(radius), *last_emission, materials)
+                                         : last_mat;
+                spheres->add(point3(x, y, z), real(radius), mat);
+            }
+            else if (keyword == "texture") {
+                auto name = s.word(), type = s.word();
+                double v[7];
+                bool ok = !name.empty();
+                if (ok && type == "image") {
+                    auto file_name = s.word(), option = s.word();
+                    if (file_name.empty() || !(option.empty() || option == "linear"))
+                        return fail("expected: texture name image path [linear]");
+                    auto full_path = file_name[0] == '/' ? file_name : directory + file_name;
+                    named_textures[name] = materials.textures.add_image(full_path, option.empty());
+                }
+                else if (ok && type == "checker" && s.numbers(v, 7) && v[0] > 0)
+                    named_textures[name] = materials.textures.add(
+                        checker_texture(real(v[0]), color(v[1], v[2], v[3]), color(v[4], v[5], v[6])));
+                else if (ok && type == "noise" && s.numbers(v, 1))
+                    named_textures[name] = materials.textures.add(noise_texture(real(v[0]), noise_tables));
+                else
+                    return fail("expected: texture name image|checker|noise values...");
+            }
+            else if (keyword == "material") {
+                auto name = s.word(), type = s.word();
+                double v[4];
+                bool ok = !name.empty();
+                emitters.erase(name);  // A later definition replaces an earlier one
+                last_name.clear();
+
+                // Lambertian and metal take either an albedo or a texture's name.
+                texture_handle tex;
+                auto albedo_or_texture = [&]() {
+                    if (s.numbers(v, 3))
+                        return true;
+                    auto it = named_textures.find(s.word());
+                    if (it == named_textures.end())
+                        return false;
+                    tex = it->second;
+                    return true;
+                };
+
+                if (ok && type == "lambertian" && albedo_or_texture())
+                    named[name] = tex ? materials.add(lambertian(tex)) : materials.add(lambertian(color(v[0], v[1], v[2])));
+                else if (ok && type == "metal" && albedo_or_texture() && s.number(v[3]))
+                    named[name] = tex ? materials.add(metal(tex, v[3])) : materials.add(metal(color(v[0], v[1], v[2]), v[3]));
+                else if (ok && type == "dielectric" && s.numbers(v, 1))
+                    named[name] = materials.add(dielectric(v[0]));
+                else if (ok && type == "light" && s.numbers(v, 3)) {
+                    named.erase(name);
+                    emitters[name] = color(v[0], v[1], v[2]);
+                }
+                else
+                    return fail("expected: material name lambertian|metal|dielectric|light values...");
+            }
+            else if (keyword == "camera") {
+                if (!camera_setting(s))
+                    return fail("unknown or incomplete camera setting");
+            }
+            else if (keyword == "mesh") {
+                auto name = s.word(), file_name = s.word(), material_name = s.word();
+                material_handle mat;
+                if (material_name.empty())
+                    return fail("expected: mesh name path material");
+                if (!find_material(material_name, mat))
+                    return fail("unknown material '" + material_name + "'");
+                auto full_path = file_name[0] == '/' ? file_name : directory + file_name;
+                auto mesh = triangle_mesh::load_obj(full_path, mat);
+                if (!mesh)
+                    return fail("could not load '" + full_path + "'");
+                mesh_names[name] = uint32_t(meshes.size());
+                meshes.push_back(mesh);
+            }
+            else if (keyword == "instance") {
+                auto it = mesh_names.find(s.word());
+                if (it == mesh_names.end())
+                    return fail("unknown mesh");
+                scene_instance placed{ it->second, material_handle(), transform() };
+                for (auto step = s.word(); !step.empty(); step = s.word()) {
+                    double v[4];
+                    if (step == "translate" && s.numbers(v, 3))
+                        placed.object_to_world = transform::translate(vec3(v[0], v[1], v[2])) * placed.object_to_world;
+                    else if (step == "rotate" && s.numbers(v, 4))
+                        placed.object_to_world = transform::rotate(vec3(v[0], v[1], v[2]), v[3]) * placed.object_to_world;
+                    else if (step == "scale" && s.number(v[0])) {
+                        if (s.numbers(v + 1, 2))
+                            placed.object_to_world = transform::scale(vec3(v[0], v[1], v[2])) * placed.object_to_world;
+                        else
+                            placed.object_to_world = transform::scale(real(v[0])) * placed.object_to_world;
+                    }
+                    else if (step == "material") {
+                        auto name = s.word();
+                        if (!find_material(name, placed.mat))
+                            return fail("unknown material '" + name + "'");
+                    }
+                    else
+                        return fail("bad instance step '" + step + "'");
+                }
+                instances.push_back(placed);
+            }
+            else {
+                return fail("unknown statement '" + keyword + "'");
+            }
+        }
+
+        spheres->build();
+        finish();
+        return true;
+    }
+
+    struct statement {
+        // The rest of one line of a text scene file.
+        const char* c;
+        const char* end;
+
+        void skip_space() {
+            while (c < end && (*c == ' ' || *c == '\t' || *c == '\r'))
+                c++;
+        }
+
+        std::string word() {
+            skip_space();
+            const char* start = c;
+            while (c < end && *c != ' ' && *c != '\t' && *c != '\r')
+                c++;
+            return std::string(start, c);
+        }
+
+        bool number(double& value) {
+            skip_space();
+            if (c < end && *c == '+')
+                c++;  // from_chars takes no plus sign
+            auto result = std::from_chars(c, end, value);
+            if (result.ec != std::errc())
+                return false;
+            c = result.ptr;
+            return true;
+        }
+
+        bool numbers(double* values, int count) {
+            // All or nothing: on failure the position is left as it was.
+            const char* start = c;
+            for (int k = 0; k < count; k++) {
+                if (!number(values[k])) {
+                    c = start;
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+
+    bool camera_setting(statement& s) {
+        auto name = s.word();
+        double v[3];
+        auto vector = [&](vec3& out) {
+            if (!s.numbers(v, 3))
+                return false;
+            out = vec3(v[0], v[1], v[2]);
+            return true;
+        };
+        auto integer = [&](int& out) {
+            if (!s.number(v[0]))
+                return false;
+            out = int(v[0]);
+            return true;
+        };
+        auto scalar = [&](double& out) { return s.number(out); };
+        auto flag = [&](bool& out) {
+            int on;
+            if (!integer(on))
+                return false;
+            out = on != 0;
+            return true;
+        };
+        auto path = [&](std::string& out) {
+            out = s.word();
+            return !out.empty();
+        };
+
+        if (name == "aspect_ratio")      return scalar(cam.aspect_ratio);
+        if (name == "vfov")              return scalar(cam.vfov);
+        if (name == "defocus_angle")     return scalar(cam.defocus_angle);
+        if (name == "focus_dist")        return scalar(cam.focus_dist);
+        if (name == "lookfrom")          return vector(cam.lookfrom);
+        if (name == "lookat")            return vector(cam.lookat);
+        if (name == "vup")               return vector(cam.vup);
+        if (name == "image_width")       return integer(cam.image_width);
+        if (name == "samples_per_pixel") return integer(cam.samples_per_pixel);
+        if (name == "max_depth")         return integer(cam.max_depth);
+        if (name == "albedo_path")       return path(cam.albedo_path);
+        if (name == "normal_path")       return path(cam.normal_path);
+        if (name == "sky_light")         return flag(cam.sky_light);
+        if (name == "denoise")           return flag(cam.denoise);
+        return false;
+    }
+
+    void finish() {
+        // Gathers the loaded geometry into `world`.
+        if (spheres->size() > 0)
+            world.add(spheres);
+        if (!instances.empty()) {
+            auto top = make_shared<tlas>();
+            for (const auto& placed : instances)
+                top->add(meshes[placed.mesh], placed.object_to_world, placed.mat);
+            top->build();
+            world.add(top);
+        }
+        lights.build();
+    }
+};
+
+#endif
@@ -0,0 +1,79 @@
+#pragma once
+#ifndef SIMD4_H
+#define SIMD4_H
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OFFLINERT_SIMD4
+#include <cstdint>
+#include <emmintrin.h>
+
+// Four-lane packs for the SIMD intersectors: a single SSE register of floats, or a pair of
+// SSE2 registers of doubles. Comparisons return all-ones/all-zeros lane masks, and `store_int`
+// truncates toward zero like a cast. On targets without SSE2, OFFLINERT_SIMD4 stays undefined
+// and callers use their scalar loops.
+template <typename T> struct simd4;
+
+template <> struct simd4<float> {
+    __m128 v;
+
+    static simd4 load(const float* p) { return { _mm_loadu_ps(p) }; }
+    static simd4 set1(float x) { return { _mm_set1_ps(x) }; }
+    static void store(float* p, simd4 a) { _mm_storeu_ps(p, a.v); }
+    static void store_int(int32_t* p, simd4 a) { _mm_storeu_si128((__m128i*)p, _mm_cvttps_epi32(a.v)); }
+
+    friend simd4 operator+(simd4 a, simd4 b) { return { _mm_add_ps(a.v, b.v) }; }
+    friend simd4 operator-(simd4 a, simd4 b) { return { _mm_sub_ps(a.v, b.v) }; }
+    friend simd4 operator*(simd4 a, simd4 b) { return { _mm_mul_ps(a.v, b.v) }; }
+    friend simd4 operator/(simd4 a, simd4 b) { return { _mm_div_ps(a.v, b.v) }; }
+    friend simd4 operator&(simd4 a, simd4 b) { return { _mm_and_ps(a.v, b.v) }; }
+
+    static simd4 sqrt(simd4 a) { return { _mm_sqrt_ps(a.v) }; }
+    static simd4 min(simd4 a, simd4 b) { return { _mm_min_ps(a.v, b.v) }; }
+    static simd4 max(simd4 a, simd4 b) { return { _mm_max_ps(a.v, b.v) }; }
+    static simd4 less(simd4 a, simd4 b) { return { _mm_cmplt_ps(a.v, b.v) }; }
+    static simd4 greater_equal(simd4 a, simd4 b) { return { _mm_cmpge_ps(a.v, b.v) }; }
+    static bool none(simd4 mask) { return _mm_movemask_ps(mask.v) == 0; }
+    static int bits(simd4 mask) { return _mm_movemask_ps(mask.v); }
+
+    static simd4 select(simd4 mask, simd4 a, simd4 b) {
+        return { _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)) };
+    }
+};
+
+template <> struct simd4<double> {
+    __m128d lo, hi;
+
+    static simd4 load(const double* p) { return { _mm_loadu_pd(p), _mm_loadu_pd(p + 2) }; }
+    static simd4 set1(double x) { return { _mm_set1_pd(x), _mm_set1_pd(x) }; }
+    static void store(double* p, simd4 a) { _mm_storeu_pd(p, a.lo); _mm_storeu_pd(p + 2, a.hi); }
+    static void store_int(int32_t* p, simd4 a) {
+        auto packed = _mm_unpacklo_epi64(_mm_cvttpd_epi32(a.lo), _mm_cvttpd_epi32(a.hi));
+        _mm_storeu_si128((__m128i*)p, packed);
+    }
+
+    friend simd4 operator+(simd4 a, simd4 b) { return { _mm_add_pd(a.lo, b.lo), _mm_add_pd(a.hi, b.hi) }; }
+    friend simd4 operator-(simd4 a, simd4 b) { return { _mm_sub_pd(a.lo, b.lo), _mm_sub_pd(a.hi, b.hi) }; }
+    friend simd4 operator*(simd4 a, simd4 b) { return { _mm_mul_pd(a.lo, b.lo), _mm_mul_pd(a.hi, b.hi) }; }
+    friend simd4 operator/(simd4 a, simd4 b) { return { _mm_div_pd(a.lo, b.lo), _mm_div_pd(a.hi, b.hi) }; }
+    friend simd4 operator&(simd4 a, simd4 b) { return { _mm_and_pd(a.lo, b.lo), _mm_and_pd(a.hi, b.hi) }; }
+
+    static simd4 sqrt(simd4 a) { return { _mm_sqrt_pd(a.lo), _mm_sqrt_pd(a.hi) }; }
+    static simd4 min(simd4 a, simd4 b) { return { _mm_min_pd(a.lo, b.lo), _mm_min_pd(a.hi, b.hi) }; }
+    static simd4 max(simd4 a, simd4 b) { return { _mm_max_pd(a.lo, b.lo), _mm_max_pd(a.hi, b.hi) }; }
+    static simd4 less(simd4 a, simd4 b) { return { _mm_cmplt_pd(a.lo, b.lo), _mm_cmplt_pd(a.hi, b.hi) }; }
+    static simd4 greater_equal(simd4 a, simd4 b) {
+        return { _mm_cmpge_pd(a.lo, b.lo), _mm_cmpge_pd(a.hi, b.hi) };
+    }
+    static bool none(simd4 mask) { return _mm_movemask_pd(_mm_or_pd(mask.lo, mask.hi)) == 0; }
+    static int bits(simd4 mask) { return _mm_movemask_pd(mask.lo) | (_mm_movemask_pd(mask.hi) << 2); }
+
+    static simd4 select(simd4 mask, simd4 a, simd4 b) {
+        return {
+            _mm_or_pd(_mm_and_pd(mask.lo, a.lo), _mm_andnot_pd(mask.lo, b.lo)),
+            _mm_or_pd(_mm_and_pd(mask.hi, a.hi), _mm_andnot_pd(mask.hi, b.hi))
+        };
+    }
+};
+#endif
+
+#endif
@@ -3,13 +3,33 @@
 #define SPHERE_H
 
 #include "hittable.h"
+#include "motion.h"
+
+#include <vector>
 
 class sphere : public hittable {
 public:
-    sphere(const point3& center, double radius, shared_ptr<material> mat)
-        : center(center), radius(std::fmax(0, radius)), mat(mat) {}
+    sphere(const point3& center, real radius, material_handle mat)
+        : center(center), radius(std::fmax(real(0), radius)), mat(mat)
+    {
+        auto rvec = vec3(radius, radius, radius);
+        bbox = aabb(center - rvec, center + rvec);
+    }
+
+    sphere(const std::vector<point3>& centers, real radius, material_handle mat)
+        : sphere(centers.empty() ? point3() : centers[0], radius, mat)
+    {
+        // A moving sphere, with keyframed centers evenly spaced over ray times 0..1. Two
+        // centers give linear motion.
+        if (centers.size() < 2)
+            return;
+        keys = centers;
+        for (const auto& c : keys)
+            bbox = aabb(bbox, key_bounds(c));
+    }
 
     bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        auto center = center_at(r.time());
         vec3 oc = center - r.origin();
         auto a = r.direction().length_squared();
         auto h = dot(r.direction(), oc);
@@ -34,14 +54,56 @@ public:
         vec3 outward_normal = (rec.p - center) / radius;
         rec.set_face_normal(r, outward_normal);
         rec.mat = mat;
+        if (mat.textured())
+            set_sphere_uv(rec, outward_normal, radius);
 
         return true;
     }
 
+    static void set_sphere_uv(hit_record& rec, const vec3& p, real radius) {
+        // p: a given point on the sphere of radius one, centered at the origin.
+        // u: returned value [0,1] of angle around the Y axis from X=-1.
+        // v: returned value [0,1] of angle from Y=-1 to Y=+1.
+        //     <1 0 0> yields <0.50 0.50>       <-1  0  0> yields <0.00 0.50>
+        //     <0 1 0> yields <0.50 1.00>       < 0 -1  0> yields <0.50 0.00>
+        //     <0 0 1> yields <0.25 0.50>       < 0  0 -1> yields <0.75 0.50>
+        //
+        // Also sets the partial derivatives of the point on the actual sphere; the poles,
+        // where v's derivative has no direction, get none.
+        auto theta = std::acos(std::fmin(std::fmax(-p.y(), real(-1)), real(1)));
+        auto phi = std::atan2(-p.z(), p.x()) + pi;
+        rec.u = real(phi / (2 * pi));
+        rec.v = real(theta / pi);
+
+        auto d = radius * p;
+        auto rho = std::sqrt(d.x() * d.x() + d.z() * d.z());
+        rec.dpdu = real(2 * pi) * vec3(d.z(), 0, -d.x());
+        rec.dpdv = rho > 0 ? real(pi) * vec3(-d.x() * d.y() / rho, rho, -d.y() * d.z() / rho) : vec3(0, 0, 0);
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+    int motion_segments() const override { return keys.empty() ? 0 : int(keys.size() - 1); }
+    aabb bounds_at(real time) const override { return keys.empty() ? bbox : key_bounds(center_at(time)); }
+
 private:
     point3 center;
-    double radius;
-    shared_ptr<material> mat;
+    real radius;
+    material_handle mat;
+    aabb bbox;
+    std::vector<point3> keys;  // Keyframed centers, or empty for a sphere at rest
+
+    point3 center_at(real time) const {
+        if (keys.empty())
+            return center;
+        motion_step step(time, motion_segments());
+        return lerp(keys[step.segment], keys[step.segment + 1], step.fraction);
+    }
+
+    aabb key_bounds(const point3& c) const {
+        auto rvec = vec3(radius, radius, radius);
+        return aabb(c - rvec, c + rvec);
+    }
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,334 @@
+#pragma once
+#ifndef SPHERE_BATCH_H
+#define SPHERE_BATCH_H
+
+#include "aabb.h"
+#include "binary_io.h"
+#include "flat_bvh.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "simd4.h"
+#include "sphere.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+class sphere_batch : public hittable {
+public:
+    // Spheres are stored structure-of-arrays and tested `lane_width` at a time: one SIMD
+    // quadratic solve per group (SSE2, two registers per group in double precision), then a
+    // masked reduction to the closest hit. Groups where no lane's discriminant is positive are
+    // skipped before the square root. Without SSE2 the same loop runs lane by lane.
+    //
+    // A small batch is a BVH leaf and tests all its spheres. A batch holding a whole scene's
+    // spheres calls build() instead, which indexes its groups with a flat_bvh of its own.
+    static constexpr int lane_width = 4;
+
+    sphere_batch() {}
+
+    void add(const point3& center, real radius, material_handle mat) {
+        // Adding drops the index of any earlier build().
+        bvh.nodes.clear();
+        sphere_count++;
+        size_t slot = count++;
+        if (slot % lane_width == 0) {
+            // Open a new group, padded to a full set of lanes. Padding lanes get NaN centers, so
+            // every comparison in hit() rejects them.
+            size_t padded = slot + lane_width;
+            auto nan = std::numeric_limits<real>::quiet_NaN();
+            center_x.resize(padded, nan);
+            center_y.resize(padded, nan);
+            center_z.resize(padded, nan);
+            radii.resize(padded, 0);
+            materials.resize(padded);
+        }
+
+        radius = std::fmax(real(0), radius);
+        center_x[slot] = center.x();
+        center_y[slot] = center.y();
+        center_z[slot] = center.z();
+        radii[slot] = radius;
+        materials[slot] = mat;
+
+        auto rvec = vec3(radius, radius, radius);
+        bbox = aabb(bbox, aabb(center - rvec, center + rvec));
+    }
+
+    size_t size() const { return sphere_count; }
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        real closest = ray_t.max;
+        size_t closest_index = count;
+
+        if (bvh.nodes.empty()) {
+            hit_groups(r, ray_t.min, 0, count, closest, closest_index);
+        }
+        else {
+            bvh.traverse(r, ray_t.min, closest, [&](uint32_t first, uint32_t groups) {
+                hit_groups(r, ray_t.min, size_t(first) * lane_width, size_t(first + groups) * lane_width,
+                           closest, closest_index);
+            });
+        }
+
+        if (closest_index == count)
+            return false;
+
+        auto center = point3(center_x[closest_index], center_y[closest_index], center_z[closest_index]);
+        rec.t = closest;
+        rec.p = r.at(rec.t);
+        vec3 outward_normal = (rec.p - center) / radii[closest_index];
+        rec.set_face_normal(r, outward_normal);
+        rec.mat = materials[closest_index];
+        if (rec.mat.textured())
+            sphere::set_sphere_uv(rec, outward_normal, radii[closest_index]);
+
+        return true;
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+    hittable_list split(size_t batch_size = lane_width) const {
+        // Regroups the spheres into spatially coherent batches of at most `batch_size`, by
+        // recursive median splits along the longest axis of the sphere centers. The returned
+        // list is meant to be handed to bvh_node, making each batch one BVH leaf.
+        hittable_list batches;
+        auto refs = sphere_refs();
+        partition(refs, 0, refs.size(), std::max<size_t>(1, batch_size), [&](size_t start, size_t end) {
+            auto batch = make_shared<sphere_batch>();
+            for (size_t i = start; i < end; i++) {
+                const auto& c = refs[i].center;
+                batch->add(point3(c[0], c[1], c[2]), refs[i].radius, refs[i].mat);
+            }
+            batches.add(batch);
+        });
+        return batches;
+    }
+
+    void build() {
+        // Regroups the spheres as split() does, one lane group per batch, and lays a flat_bvh
+        // over the groups. The groups are then stored in leaf order, so that the BVH's slots
+        // are group numbers.
+        auto refs = sphere_refs();
+        std::vector<size_t> groups;  // First ref of each group
+        partition(refs, 0, refs.size(), lane_width, [&](size_t start, size_t) { groups.push_back(start); });
+
+        auto group_end = [&](size_t start) { return std::min(start + lane_width, refs.size()); };
+        std::vector<aabb> boxes(groups.size());
+        for (size_t g = 0; g < groups.size(); g++) {
+            boxes[g] = aabb::empty;
+            for (size_t i = groups[g]; i < group_end(groups[g]); i++)
+                boxes[g] = aabb(boxes[g], sphere_bounds(refs[i]));
+        }
+        bvh.build(boxes, max_leaf_groups);
+
+        size_t slots = groups.size() * lane_width;
+        auto nan = std::numeric_limits<real>::quiet_NaN();
+        std::vector<real> x(slots, nan), y(slots, nan), z(slots, nan), r(slots, 0);
+        std::vector<material_handle> m(slots);
+        for (size_t g = 0; g < groups.size(); g++) {
+            auto start = groups[bvh.primitives[g]];
+            for (size_t i = start, slot = g * lane_width; i < group_end(start); i++, slot++) {
+                x[slot] = refs[i].center[0];
+                y[slot] = refs[i].center[1];
+                z[slot] = refs[i].center[2];
+                r[slot] = refs[i].radius;
+                m[slot] = refs[i].mat;
+            }
+        }
+        center_x.swap(x);
+        center_y.swap(y);
+        center_z.swap(z);
+        radii.swap(r);
+        materials.swap(m);
+        count = slots;
+        bvh.primitives = std::vector<uint32_t>();
+    }
+
+    size_t memory_bytes() const {
+        return 4 * center_x.capacity() * sizeof(real) + materials.capacity() * sizeof(material_handle)
+             + bvh.memory_bytes();
+    }
+
+    bool save(binary_writer& out) const {
+        // Stores the batch as it is, BVH included, so load() needs no rebuild.
+        out.put(uint64_t(sphere_count));
+        for (const auto* array : { &center_x, &center_y, &center_z, &radii })
+            out.put_array(*array);
+        out.put_array(materials);
+        out.put_array(bvh.nodes);
+        return true;
+    }
+
+    bool load(binary_reader& in) {
+        uint64_t spheres;
+        *this = sphere_batch();
+        if (!in.get(spheres))
+            return false;
+        for (auto* array : { &center_x, &center_y, &center_z, &radii })
+            if (!in.get_array(*array))
+                return false;
+        if (!in.get_array(materials) || !in.get_array(bvh.nodes))
+            return false;
+
+        count = center_x.size();
+        sphere_count = size_t(spheres);
+        if (count % lane_width != 0 || center_y.size() != count || center_z.size() != count
+            || radii.size() != count || materials.size() != count || sphere_count > count
+            || !bvh.valid(count / lane_width)) {
+            *this = sphere_batch();
+            return false;
+        }
+
+        if (!bvh.nodes.empty()) {
+            bbox = bvh.bounds();
+        }
+        else {
+            for (const auto& ref : sphere_refs())
+                bbox = aabb(bbox, sphere_bounds(ref));
+        }
+        return true;
+    }
+
+private:
+    static constexpr int max_leaf_groups = 2;
+
+    size_t count = 0;         // Slots in use, padding lanes inside a built batch included
+    size_t sphere_count = 0;
+    std::vector<real> center_x, center_y, center_z, radii;
+    std::vector<material_handle> materials;
+    flat_bvh bvh;             // Over lane groups; empty unless built
+    aabb bbox;
+
+    struct sphere_ref {
+        real            center[3];
+        real            radius;
+        material_handle mat;
+    };
+
+    static aabb sphere_bounds(const sphere_ref& ref) {
+        const auto* c = ref.center;
+        auto r = ref.radius;
+        return aabb(point3(c[0] - r, c[1] - r, c[2] - r), point3(c[0] + r, c[1] + r, c[2] + r));
+    }
+
+    std::vector<sphere_ref> sphere_refs() const {
+        // Every sphere as one compact record, so that partition() and build() move whole
+        // spheres through memory in order rather than gathering from five arrays at random.
+        // Padding lanes have NaN centers and are left out.
+        std::vector<sphere_ref> refs;
+        refs.reserve(sphere_count);
+        for (size_t k = 0; k < count; k++)
+            if (!std::isnan(center_x[k]))
+                refs.push_back({ { center_x[k], center_y[k], center_z[k] }, radii[k], materials[k] });
+        return refs;
+    }
+
+    void hit_groups(
+        const ray& r, real t_min, size_t begin, size_t end, real& closest, size_t& closest_index
+    ) const {
+        // Tests slots [begin, end), whole lane groups, for hits closer than `closest`.
+        const real ox = r.origin().x(), oy = r.origin().y(), oz = r.origin().z();
+        const real dx = r.direction().x(), dy = r.direction().y(), dz = r.direction().z();
+        const real a = dx * dx + dy * dy + dz * dz;
+
+        for (size_t base = begin; base < end; base += lane_width) {
+            alignas(16) real t[lane_width];
+
+#ifdef OFFLINERT_SIMD4
+            using pack = simd4<real>;
+            auto ocx = pack::load(&center_x[base]) - pack::set1(ox);
+            auto ocy = pack::load(&center_y[base]) - pack::set1(oy);
+            auto ocz = pack::load(&center_z[base]) - pack::set1(oz);
+            auto rad = pack::load(&radii[base]);
+            auto h = pack::set1(dx) * ocx + pack::set1(dy) * ocy + pack::set1(dz) * ocz;
+            auto c = ocx * ocx + ocy * ocy + ocz * ocz - rad * rad;
+            auto discriminant = h * h - pack::set1(a) * c;
+
+            // Padding lanes hold NaN centers, so they fail this test along with real misses.
+            auto hit_mask = pack::greater_equal(discriminant, pack::set1(0));
+            if (pack::none(hit_mask))
+                continue;
+
+            auto sqrtd = pack::sqrt(pack::max(discriminant, pack::set1(0)));
+            auto inv_a = pack::set1(1 / a);
+            auto root0 = (h - sqrtd) * inv_a;
+            auto root1 = (h + sqrtd) * inv_a;
+            auto lo = pack::set1(t_min), hi = pack::set1(closest);
+            auto miss = pack::set1(infinity);
+
+            // Take the nearer root if it lies in the acceptable range, else the farther one,
+            // else report a miss as infinity.
+            auto root = pack::select(pack::less(lo, root1) & pack::less(root1, hi), root1, miss);
+            root = pack::select(pack::less(lo, root0) & pack::less(root0, hi), root0, root);
+            pack::store(t, pack::select(hit_mask, root, miss));
+#else
+            const real t_max = closest;
+            for (int lane = 0; lane < lane_width; lane++) {
+                size_t k = base + lane;
+                real ocx = center_x[k] - ox;
+                real ocy = center_y[k] - oy;
+                real ocz = center_z[k] - oz;
+                real h = dx * ocx + dy * ocy + dz * ocz;
+                real c = ocx * ocx + ocy * ocy + ocz * ocz - radii[k] * radii[k];
+                real discriminant = h * h - a * c;
+
+                t[lane] = infinity;
+                if (!(discriminant >= 0))
+                    continue;
+
+                real sqrtd = std::sqrt(discriminant);
+                real root0 = (h - sqrtd) / a;
+                real root1 = (h + sqrtd) / a;
+                if (t_min < root0 && root0 < t_max)
+                    t[lane] = root0;
+                else if (t_min < root1 && root1 < t_max)
+                    t[lane] = root1;
+            }
+#endif
+
+            // Masked closest-hit reduction across the group's lanes.
+            for (int lane = 0; lane < lane_width; lane++) {
+                if (t[lane] < closest) {
+                    closest = t[lane];
+                    closest_index = base + lane;
+                }
+            }
+        }
+    }
+
+    template <typename Leaf>
+    static void partition(
+        std::vector<sphere_ref>& refs, size_t start, size_t end, size_t batch_size, Leaf&& leaf
+    ) {
+        // Median splits of refs[start, end) down to runs of at most `batch_size`, which are
+        // handed to leaf(start, end) from left to right.
+        if (end - start <= batch_size) {
+            leaf(start, end);
+            return;
+        }
+
+        real low[3], high[3];
+        for (int axis = 0; axis < 3; axis++)
+            low[axis] = high[axis] = refs[start].center[axis];
+        for (size_t i = start + 1; i < end; i++) {
+            for (int axis = 0; axis < 3; axis++) {
+                low[axis] = std::fmin(low[axis], refs[i].center[axis]);
+                high[axis] = std::fmax(high[axis], refs[i].center[axis]);
+            }
+        }
+        int axis = aabb(point3(low[0], low[1], low[2]), point3(high[0], high[1], high[2])).longest_axis();
+
+        // Split on a whole number of batches, so every batch but the last fills its lanes.
+        size_t batch_count = (end - start + batch_size - 1) / batch_size;
+        size_t mid = start + (batch_count / 2) * batch_size;
+        std::nth_element(refs.begin() + start, refs.begin() + mid, refs.begin() + end,
+            [axis](const sphere_ref& a, const sphere_ref& b) { return a.center[axis] < b.center[axis]; });
+
+        partition(refs, start, mid, batch_size, leaf);
+        partition(refs, mid, end, batch_size, leaf);
+    }
+};
+
+#endif
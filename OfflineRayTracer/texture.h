@@ -0,0 +1,173 @@
+#pragma once
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include "binary_io.h"
+#include "perlin.h"
+#include "texture_cache.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Where a texture is looked up: the hit point, its surface coordinates, and how far (u, v)
+// move across one pixel's footprint, from the camera's ray differentials. Filtered textures
+// average over that footprint rather than point sampling, which keeps distant or grazing
+// texture detail from aliasing.
+struct texture_lookup {
+    point3 p;
+    real   u = 0, v = 0;
+    real   dudx = 0, dvdx = 0, dudy = 0, dvdy = 0;
+
+    real width() const {
+        // Extent of the footprint in uv units, along its longer axis.
+        return std::sqrt(std::fmax(dudx * dudx + dvdx * dvdx, dudy * dudy + dvdy * dvdy));
+    }
+};
+
+enum class texture_kind : uint32_t {
+    checker,
+    noise,
+    image
+};
+
+class texture_handle {
+public:
+    // A 32-bit reference to a texture in a texture_library, laid out like material_handle.
+    static const int index_bits = 28;
+    static const uint32_t max_index = (1u << index_bits) - 1;
+
+    texture_handle() : bits(0xFFFFFFFFu) {}
+    texture_handle(texture_kind kind, uint32_t index)
+        : bits(uint32_t(kind) << index_bits | (index & max_index)) {}
+
+    texture_kind kind() const { return texture_kind(bits >> index_bits); }
+    uint32_t index() const { return bits & max_index; }
+
+    explicit operator bool() const { return bits != 0xFFFFFFFFu; }
+
+private:
+    uint32_t bits;
+};
+
+class checker_texture final {
+public:
+    // Alternating 3D cells of `scale` on a side, as in "Ray Tracing: The Next Week".
+    checker_texture(real scale, const color& even, const color& odd)
+      : inv_scale(1 / scale), even(even), odd(odd) {}
+
+    color value(const texture_lookup& at) const {
+        auto x = int(std::floor(inv_scale * at.p.x()));
+        auto y = int(std::floor(inv_scale * at.p.y()));
+        auto z = int(std::floor(inv_scale * at.p.z()));
+        return (x + y + z) % 2 == 0 ? even : odd;
+    }
+
+private:
+    real inv_scale;
+    color even, odd;
+};
+
+class noise_texture final {
+public:
+    // Marble-like veins of turbulent Perlin noise along z.
+    noise_texture(real scale, sampler& s) : noise(s), scale(scale) {}
+
+    color value(const texture_lookup& at) const {
+        return color(.5, .5, .5) * (1 + std::sin(scale * at.p.z() + 10 * noise.turb(at.p, 7)));
+    }
+
+private:
+    perlin noise;
+    real scale;
+};
+
+class image_texture final {
+public:
+    // An image from the library's texture_cache, filtered over the lookup's footprint.
+    explicit image_texture(uint32_t image) : image(image) {}
+
+    uint32_t image_id() const { return image; }
+
+private:
+    uint32_t image;
+};
+
+class texture_library {
+public:
+    // Every texture of a scene, stored by type like material_library's materials. Image
+    // textures only hold an id into `images`, which pages their texels in as they are used.
+
+    texture_cache images;
+
+    texture_handle add(const checker_texture& tex) { return append(checkers, texture_kind::checker, tex); }
+    texture_handle add(const noise_texture& tex) { return append(noises, texture_kind::noise, tex); }
+    texture_handle add(const image_texture& tex) { return append(image_textures, texture_kind::image, tex); }
+
+    texture_handle add_image(const std::string& path, bool srgb = true) {
+        return add(image_texture(images.add(path, srgb)));
+    }
+
+    color value(texture_handle handle, const texture_lookup& at) const {
+        switch (handle.kind()) {
+            case texture_kind::checker: return checkers[handle.index()].value(at);
+            case texture_kind::noise:   return noises[handle.index()].value(at);
+            default:
+                return images.sample(image_textures[handle.index()].image_id(), at.u, at.v, at.width());
+        }
+    }
+
+    bool empty() const { return checkers.empty() && noises.empty() && image_textures.empty(); }
+
+    void save(binary_writer& out) const {
+        // Images are stored by path, one NUL-terminated string each, with their sRGB flags.
+        std::vector<char> paths;
+        std::vector<uint8_t> srgb;
+        for (uint32_t k = 0; k < images.size(); k++) {
+            const auto& path = images.path(k);
+            paths.insert(paths.end(), path.begin(), path.end());
+            paths.push_back('\0');
+            srgb.push_back(images.is_srgb(k) ? 1 : 0);
+        }
+        out.put_array(checkers);
+        out.put_array(noises);
+        out.put_array(image_textures);
+        out.put_array(paths);
+        out.put_array(srgb);
+    }
+
+    bool load(binary_reader& in) {
+        // Must be called on an empty library, so image ids come back as they were saved.
+        std::vector<char> paths;
+        std::vector<uint8_t> srgb;
+        if (!in.get_array(checkers) || !in.get_array(noises) || !in.get_array(image_textures)
+            || !in.get_array(paths) || !in.get_array(srgb) || images.size() != 0)
+            return false;
+
+        size_t start = 0;
+        for (size_t k = 0; k < srgb.size(); k++) {
+            auto end = std::find(paths.begin() + start, paths.end(), '\0');
+            if (end == paths.end() || images.add(std::string(paths.begin() + start, end), srgb[k] != 0) != k)
+                return false;
+            start = size_t(end - paths.begin()) + 1;
+        }
+        for (const auto& tex : image_textures) {
+            if (tex.image_id() >= images.size())
+                return false;
+        }
+        return true;
+    }
+
+private:
+    std::vector<checker_texture> checkers;
+    std::vector<noise_texture>   noises;
+    std::vector<image_texture>   image_textures;
+
+    template <typename T>
+    static texture_handle append(std::vector<T>& array, texture_kind kind, const T& tex) {
+        array.push_back(tex);
+        return texture_handle(kind, uint32_t(array.size() - 1));
+    }
+};
+
+#endif
@@ -0,0 +1,425 @@
+#pragma once
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include "color.h"
+#include "mapped_file.h"
+#include "png_reader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class texture_cache {
+public:
+    // Mip-mapped images, paged in tile by tile under a fixed memory budget, so a scene can
+    // refer to many large textures while only the parts rays actually land on stay resident.
+    //
+    // add() only records a path. The first lookup into an image converts it, once, into a
+    // tiled mip file in `directory`: every level of the pyramid cut into 32x32 RGBA8 tiles of
+    // 4 KB, each contiguous, so one tile covers a compact patch of texels and reading it
+    // touches a single page. Later runs reuse the file as long as the source's size and
+    // modification time still match. Tiled files are mapped rather than read, and tiles are
+    // copied into resident slots on demand; when the budget is full, the least recently used
+    // tile is evicted. Slots are split into shards by tile, each with its own lock and LRU
+    // list, so render threads rarely contend.
+    //
+    // Color images are stored sRGB-encoded and filtered in linear space; images added with
+    // `srgb` false (roughness, normals) are taken as linear values.
+
+    static constexpr int    tile_size = 32;  // Texels along a tile edge
+    static constexpr size_t tile_bytes = size_t(tile_size) * tile_size * 4;
+
+    size_t      budget_bytes = size_t(64) << 20;  // Resident tile memory; set before the first lookup
+    std::string directory;  // Where tiled mip files are kept (empty = the system temp directory)
+
+    struct statistics {
+        uint64_t lookups = 0;    // Texel fetches
+        uint64_t misses = 0;     // Fetches that had to page a tile in
+        uint64_t evictions = 0;  // Tiles dropped to make room
+        size_t   resident_bytes = 0;
+    };
+
+    texture_cache() {}
+    texture_cache(const texture_cache&) = delete;
+    texture_cache& operator=(const texture_cache&) = delete;
+
+    uint32_t add(const std::string& path, bool srgb = true) {
+        // Returns the image's id for sample(). The file isn't touched until then.
+        for (uint32_t k = 0; k < images.size(); k++) {
+            if (images[k]->path == path && images[k]->srgb == srgb)
+                return k;
+        }
+        images.emplace_back(new image());
+        images.back()->path = path;
+        images.back()->srgb = srgb;
+        return uint32_t(images.size() - 1);
+    }
+
+    size_t size() const { return images.size(); }
+    const std::string& path(uint32_t id) const { return images[id]->path; }
+    bool is_srgb(uint32_t id) const { return images[id]->srgb; }
+
+    color sample(uint32_t id, real u, real v, real width) const {
+        // Trilinear lookup at (u, v), with v = 0 at the bottom row and wrapping beyond 0..1.
+        // `width` is the footprint's extent in uv units; it picks the pair of mip levels whose
+        // texels are about that size. Images that fail to load come back magenta.
+        auto& img = *images[id];
+        std::call_once(img.opened, [&] { open(img); });
+        if (!img.ok)
+            return color(1, 0, 1);
+        std::call_once(shards_ready, [&] { allocate_shards(); });
+
+        if (!std::isfinite(u) || !std::isfinite(v))
+            u = v = 0;
+        int last_level = int(img.levels.size()) - 1;
+        auto texels = double(width) * std::max(img.levels[0].width, img.levels[0].height);
+        auto lod = texels > 1 ? std::min(std::log2(texels), double(last_level)) : 0.0;
+        int level = int(lod);
+        auto blend = real(lod - level);
+
+        auto c = bilinear(img, id, level, u, v);
+        if (blend > 0 && level < last_level)
+            c = (1 - blend) * c + blend * bilinear(img, id, level + 1, u, v);
+        return c;
+    }
+
+    statistics stats() const {
+        statistics total;
+        if (!shards)
+            return total;
+        for (int k = 0; k < shard_count; k++) {
+            std::lock_guard<std::mutex> guard(shards[k].lock);
+            total.lookups += shards[k].lookups;
+            total.misses += shards[k].misses;
+            total.evictions += shards[k].evictions;
+            total.resident_bytes += shards[k].keys.size() * tile_bytes;
+        }
+        return total;
+    }
+
+private:
+    static constexpr int shard_count = 16;
+    static constexpr uint32_t none = 0xFFFFFFFFu;
+
+    struct file_header {
+        char     magic[4] = { 'O', 'R', 'T', 'T' };
+        uint32_t version = 1;
+        uint64_t source_size = 0;
+        int64_t  source_time = 0;
+        uint32_t width = 0, height = 0, level_count = 0, srgb = 0;
+        uint32_t tile = tile_size;
+        uint32_t reserved = 0;
+    };
+    static constexpr size_t header_bytes = tile_bytes;  // Keeps the tiles page-aligned
+
+    struct level {
+        int    width, height;
+        int    tiles_x, tiles_y;
+        size_t first_tile;  // Tiles of all the larger levels come first
+    };
+
+    struct image {
+        std::string        path;
+        bool               srgb = true;
+        std::once_flag     opened;
+        bool               ok = false;
+        mapped_file        file;
+        std::vector<level> levels;
+    };
+
+    struct shard {
+        // A share of the resident tiles: slot storage, the key held in each slot, and a doubly
+        // linked LRU list through the slots.
+        std::mutex                             lock;
+        std::unordered_map<uint64_t, uint32_t> slot_of;
+        std::vector<uint64_t>                  keys;
+        std::vector<uint32_t>                  newer, older;
+        std::vector<uint8_t>                   texels;
+        uint32_t capacity = 1;
+        uint32_t newest = none, oldest = none;
+        uint64_t lookups = 0, misses = 0, evictions = 0;
+
+        void unlink(uint32_t slot) {
+            (newer[slot] == none ? newest : older[newer[slot]]) = older[slot];
+            (older[slot] == none ? oldest : newer[older[slot]]) = newer[slot];
+        }
+
+        void push_newest(uint32_t slot) {
+            newer[slot] = none;
+            older[slot] = newest;
+            (newest == none ? oldest : newer[newest]) = slot;
+            newest = slot;
+        }
+    };
+
+    std::vector<std::unique_ptr<image>> images;
+    mutable std::once_flag              shards_ready;
+    mutable std::unique_ptr<shard[]>    shards;
+
+    void allocate_shards() const {
+        shards.reset(new shard[shard_count]);
+        auto tiles = std::max<size_t>(budget_bytes / tile_bytes, shard_count);
+        for (int k = 0; k < shard_count; k++)
+            shards[k].capacity = uint32_t(tiles / shard_count);
+    }
+
+    color bilinear(const image& img, uint32_t id, int level_index, real u, real v) const {
+        const auto& l = img.levels[level_index];
+        auto x = double(u) * l.width - 0.5, y = (1 - double(v)) * l.height - 0.5;
+        auto x0 = std::floor(x), y0 = std::floor(y);
+        auto fx = real(x - x0), fy = real(y - y0);
+
+        auto wrap = [](double c, int size) { return int(c - size * std::floor(c / size)) % size; };
+        int xa = wrap(x0, l.width), xb = (xa + 1) % l.width;
+        int ya = wrap(y0, l.height), yb = (ya + 1) % l.height;
+
+        auto c00 = texel(img, id, level_index, xa, ya), c10 = texel(img, id, level_index, xb, ya);
+        auto c01 = texel(img, id, level_index, xa, yb), c11 = texel(img, id, level_index, xb, yb);
+        return (1 - fy) * ((1 - fx) * c00 + fx * c10) + fy * ((1 - fx) * c01 + fx * c11);
+    }
+
+    color texel(const image& img, uint32_t id, int level_index, int x, int y) const {
+        const auto& l = img.levels[level_index];
+        size_t tile = l.first_tile + size_t(y / tile_size) * l.tiles_x + size_t(x / tile_size);
+        uint64_t key = uint64_t(id) << 40 | tile;
+        auto& s = shards[std::hash<uint64_t>()(key * 0x9E3779B97F4A7C15ull >> 32) % shard_count];
+
+        uint8_t rgba[4];
+        {
+            std::lock_guard<std::mutex> guard(s.lock);
+            const uint8_t* t = resident_tile(s, img, key, tile);
+            std::memcpy(rgba, t + (size_t(y % tile_size) * tile_size + x % tile_size) * 4, 4);
+        }
+
+        if (!img.srgb)
+            return color(rgba[0] / real(255), rgba[1] / real(255), rgba[2] / real(255));
+        const auto& table = srgb_table();
+        return color(table[rgba[0]], table[rgba[1]], table[rgba[2]]);
+    }
+
+    static const uint8_t* resident_tile(shard& s, const image& img, uint64_t key, size_t tile) {
+        // The tile's resident copy, paging it in (and evicting the oldest) if needed. The
+        // shard's lock must be held.
+        s.lookups++;
+        auto found = s.slot_of.find(key);
+        if (found != s.slot_of.end()) {
+            uint32_t slot = found->second;
+            if (s.newest != slot) {
+                s.unlink(slot);
+                s.push_newest(slot);
+            }
+            return &s.texels[size_t(slot) * tile_bytes];
+        }
+
+        s.misses++;
+        uint32_t slot;
+        if (s.keys.size() < s.capacity) {
+            slot = uint32_t(s.keys.size());
+            s.keys.push_back(key);
+            s.newer.push_back(none);
+            s.older.push_back(none);
+            s.texels.resize(s.keys.size() * tile_bytes);
+        }
+        else {
+            slot = s.oldest;
+            s.unlink(slot);
+            s.slot_of.erase(s.keys[slot]);
+            s.keys[slot] = key;
+            s.evictions++;
+        }
+        s.slot_of[key] = slot;
+        s.push_newest(slot);
+
+        auto* t = &s.texels[size_t(slot) * tile_bytes];
+        std::memcpy(t, img.file.data() + header_bytes + tile * tile_bytes, tile_bytes);
+        return t;
+    }
+
+    static const std::vector<real>& srgb_table() {
+        static const std::vector<real> table = [] {
+            std::vector<real> t(256);
+            for (int k = 0; k < 256; k++) {
+                double c = k / 255.0;
+                t[k] = real(c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4));
+            }
+            return t;
+        }();
+        return table;
+    }
+
+    static uint8_t encode(float value, bool srgb) {
+        double c = std::min(std::max(double(value), 0.0), 1.0);
+        if (srgb)
+            c = c <= 0.0031308 ? c * 12.92 : 1.055 * std::pow(c, 1 / 2.4) - 0.055;
+        return uint8_t(c * 255 + 0.5);
+    }
+
+    void open(image& img) const {
+        // Maps the image's tiled mip file, building it first if it's missing or stale.
+        namespace fs = std::filesystem;
+        std::error_code error;
+        file_header expected;
+        expected.source_size = uint64_t(fs::file_size(img.path, error));
+        if (error) {
+            std::clog << "Could not read texture '" << img.path << "'\n";
+            return;
+        }
+        expected.source_time = int64_t(fs::last_write_time(img.path, error).time_since_epoch().count());
+        expected.srgb = img.srgb ? 1 : 0;
+
+        auto absolute = fs::absolute(img.path, error).string();
+        fs::path folder = directory.empty() ? fs::temp_directory_path(error) : fs::path(directory);
+        fs::create_directories(folder, error);
+        char name[32];
+        std::snprintf(name, sizeof(name), "-%016llx.tiles",
+                      (unsigned long long)(std::hash<std::string>()(absolute) ^ (img.srgb ? 0 : 1)));
+        auto tiled = (folder / (fs::path(img.path).stem().string() + name)).string();
+
+        if (!map_tiles(img, tiled, expected)) {
+            if (!build_tiles(img, tiled, expected) || !map_tiles(img, tiled, expected)) {
+                std::clog << "Could not load texture '" << img.path << "'\n";
+                return;
+            }
+        }
+        img.ok = true;
+    }
+
+    static void lay_out(image& img, int width, int height) {
+        img.levels.clear();
+        size_t tiles = 0;
+        while (true) {
+            level l;
+            l.width = width;
+            l.height = height;
+            l.tiles_x = (width + tile_size - 1) / tile_size;
+            l.tiles_y = (height + tile_size - 1) / tile_size;
+            l.first_tile = tiles;
+            tiles += size_t(l.tiles_x) * l.tiles_y;
+            img.levels.push_back(l);
+            if (width == 1 && height == 1)
+                break;
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+        }
+    }
+
+    static bool map_tiles(image& img, const std::string& tiled, const file_header& expected) {
+        mapped_file file(tiled);
+        file_header header;
+        if (!file.is_open() || file.size() < header_bytes)
+            return false;
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (std::memcmp(header.magic, expected.magic, 4) != 0 || header.version != expected.version
+            || header.source_size != expected.source_size || header.source_time != expected.source_time
+            || header.srgb != expected.srgb || header.tile != expected.tile
+            || header.width == 0 || header.height == 0)
+            return false;
+
+        lay_out(img, int(header.width), int(header.height));
+        const auto& last = img.levels.back();
+        size_t tiles = last.first_tile + size_t(last.tiles_x) * last.tiles_y;
+        if (header.level_count != img.levels.size() || file.size() != header_bytes + tiles * tile_bytes)
+            return false;
+        img.file = std::move(file);
+        return true;
+    }
+
+    static bool build_tiles(image& img, const std::string& tiled, file_header header) {
+        // Decodes the source, box-filters the pyramid in linear float, and writes every level's
+        // tiles. The file is written under a temporary name and renamed into place, so other
+        // processes never map a partial file.
+        int width, height;
+        std::vector<uint8_t> rgba;
+        if (!read_png(img.path, width, height, rgba))
+            return false;
+
+        lay_out(img, width, height);
+        header.width = uint32_t(width);
+        header.height = uint32_t(height);
+        header.level_count = uint32_t(img.levels.size());
+
+        const auto& table = srgb_table();
+        std::vector<float> current(rgba.size());
+        for (size_t k = 0; k < rgba.size(); k++)
+            current[k] = (img.srgb && k % 4 != 3) ? float(table[rgba[k]]) : rgba[k] / 255.0f;
+
+        auto temporary = tiled + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()))
+                       + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+        {
+            std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+            std::vector<char> padded(header_bytes, 0);
+            std::memcpy(padded.data(), &header, sizeof(header));
+            out.write(padded.data(), std::streamsize(padded.size()));
+
+            std::vector<uint8_t> tile(tile_bytes);
+            for (size_t n = 0; n < img.levels.size(); n++) {
+                const auto& l = img.levels[n];
+                if (n > 0) {
+                    // Each texel averages the 2x2 block above it; odd edges repeat their last texel.
+                    const auto& above = img.levels[n - 1];
+                    std::vector<float> next(size_t(l.width) * l.height * 4);
+                    for (int y = 0; y < l.height; y++) {
+                        for (int x = 0; x < l.width; x++) {
+                            for (int c = 0; c < 4; c++) {
+                                float sum = 0;
+                                for (int dy = 0; dy < 2; dy++)
+                                    for (int dx = 0; dx < 2; dx++) {
+                                        int sx = std::min(2 * x + dx, above.width - 1);
+                                        int sy = std::min(2 * y + dy, above.height - 1);
+                                        sum += current[(size_t(sy) * above.width + sx) * 4 + c];
+                                    }
+                                next[(size_t(y) * l.width + x) * 4 + c] = sum / 4;
+                            }
+                        }
+                    }
+                    current.swap(next);
+                }
+
+                for (int ty = 0; ty < l.tiles_y; ty++) {
+                    for (int tx = 0; tx < l.tiles_x; tx++) {
+                        for (int y = 0; y < tile_size; y++) {
+                            for (int x = 0; x < tile_size; x++) {
+                                int sx = std::min(tx * tile_size + x, l.width - 1);
+                                int sy = std::min(ty * tile_size + y, l.height - 1);
+                                const float* in = &current[(size_t(sy) * l.width + sx) * 4];
+                                uint8_t* o = &tile[(size_t(y) * tile_size + x) * 4];
+                                for (int c = 0; c < 4; c++)
+                                    o[c] = encode(in[c], img.srgb && c != 3);
+                            }
+                        }
+                        out.write(reinterpret_cast<const char*>(tile.data()), std::streamsize(tile.size()));
+                    }
+                }
+            }
+            if (!out) {
+                // Drop the partial file rather than leave it in the cache directory.
+                out.close();
+                std::error_code error;
+                std::filesystem::remove(temporary, error);
+                return false;
+            }
+        }
+
+        // If another process renamed its copy into place first, this one is simply dropped.
+        std::error_code error;
+        std::filesystem::rename(temporary, tiled, error);
+        if (error)
+            std::filesystem::remove(temporary, error);
+        return true;
+    }
+};
+
+#endif
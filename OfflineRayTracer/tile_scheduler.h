@@ -0,0 +1,140 @@
+#pragma once
+#ifndef TILE_SCHEDULER_H
+#define TILE_SCHEDULER_H
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct tile {
+    int index;          // Position of the tile in row-major tile order
+    int x0, y0;         // Upper-left pixel of the tile (inclusive)
+    int x1, y1;         // Lower-right pixel of the tile (exclusive)
+};
+
+class tile_scheduler {
+public:
+    tile_scheduler(int image_width, int image_height, int tile_size) {
+        // Cut the image into a fixed grid of tiles. The grid depends only on the image and tile
+        // dimensions, never on the worker count, so per-tile work is reproducible.
+
+        tile_size = std::max(1, tile_size);
+        int index = 0;
+        for (int y = 0; y < image_height; y += tile_size) {
+            for (int x = 0; x < image_width; x += tile_size) {
+                tiles.push_back({
+                    index++, x, y,
+                    std::min(x + tile_size, image_width), std::min(y + tile_size, image_height)
+                });
+            }
+        }
+    }
+
+    size_t tile_count() const { return tiles.size(); }
+    const tile& tile_at(size_t index) const { return tiles[index]; }
+
+    static int resolve_thread_count(int requested) {
+        // A non-positive request means "use every hardware thread".
+        if (requested > 0)
+            return requested;
+        int hw = int(std::thread::hardware_concurrency());
+        return hw > 0 ? hw : 1;
+    }
+
+    void run(int thread_count, const std::function<void(const tile&)>& render_tile) {
+        // Deal the tiles round-robin into one queue per worker. Each worker drains its own queue
+        // from the front and, once empty, steals from the back of the other queues.
+
+        thread_count = std::max(1, std::min(resolve_thread_count(thread_count), int(tiles.size())));
+
+        std::vector<worker_queue> queues(thread_count);
+        for (size_t i = 0; i < tiles.size(); i++)
+            queues[i % thread_count].tiles.push_back(&tiles[i]);
+
+        if (thread_count == 1) {
+            work(0, queues, render_tile);
+            return;
+        }
+
+        std::vector<std::thread> workers;
+        workers.reserve(thread_count);
+        for (int id = 0; id < thread_count; id++)
+            workers.emplace_back([&, id] { work(id, queues, render_tile); });
+
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    static void parallel_chunks(
+        size_t count, size_t chunk_size, int thread_count,
+        const std::function<void(size_t chunk, size_t begin, size_t end)>& body
+    ) {
+        // Runs body over [0, count) in fixed-size chunks, handed out to workers from a shared
+        // counter. Chunk boundaries never depend on the worker count, so per-chunk work is
+        // reproducible.
+        size_t chunk_count = (count + chunk_size - 1) / chunk_size;
+        thread_count = std::max(1, std::min(resolve_thread_count(thread_count), int(chunk_count)));
+
+        std::atomic<size_t> next_chunk(0);
+        auto work = [&] {
+            for (size_t chunk; (chunk = next_chunk++) < chunk_count;)
+                body(chunk, chunk * chunk_size, std::min(count, (chunk + 1) * chunk_size));
+        };
+
+        if (thread_count == 1) {
+            work();
+            return;
+        }
+
+        std::vector<std::thread> workers;
+        for (int id = 0; id < thread_count; id++)
+            workers.emplace_back(work);
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+private:
+    std::vector<tile> tiles;
+
+    struct worker_queue {
+        std::mutex         lock;
+        std::deque<tile*>  tiles;
+    };
+
+    static void work(
+        int id, std::vector<worker_queue>& queues, const std::function<void(const tile&)>& render_tile
+    ) {
+        const tile* next;
+        while ((next = pop_own(queues[id])) || (next = steal(id, queues)))
+            render_tile(*next);
+    }
+
+    static const tile* pop_own(worker_queue& queue) {
+        std::lock_guard<std::mutex> guard(queue.lock);
+        if (queue.tiles.empty())
+            return nullptr;
+        auto t = queue.tiles.front();
+        queue.tiles.pop_front();
+        return t;
+    }
+
+    static const tile* steal(int thief, std::vector<worker_queue>& queues) {
+        int n = int(queues.size());
+        for (int offset = 1; offset < n; offset++) {
+            auto& victim = queues[(thief + offset) % n];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.tiles.empty()) {
+                auto t = victim.tiles.back();
+                victim.tiles.pop_back();
+                return t;
+            }
+        }
+        return nullptr;
+    }
+};
+
+#endif
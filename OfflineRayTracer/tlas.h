@@ -0,0 +1,126 @@
+#pragma once
+#ifndef TLAS_H
+#define TLAS_H
+
+#include "aabb.h"
+#include "flat_bvh.h"
+#include "hittable.h"
+#include "instance.h"
+#include "transform.h"
+
+#include <vector>
+
+class tlas : public hittable {
+public:
+    // The top level of a two-level acceleration structure, as in RealTimeRayTracing's
+    // TLAS/BLAS split: a flat_bvh over instances, each of which places a bottom-level object
+    // (a triangle_mesh with its own BVH, or any other hittable) under a transform. Moving
+    // instances only changes their transforms, so per-frame updates never touch the bottom
+    // levels, and memory grows with the unique geometry plus a small fixed cost per instance.
+    //
+    // After adding or moving instances, call build() to lay the top level out afresh, or the
+    // cheaper refit() to keep its layout and only recompute bounds. Refitting is exact but
+    // the tree loosens as instances drift from where it was built, so animations should
+    // rebuild now and then.
+    //
+    // Instances with keyframed motion (set_motion, or moving objects) get a motion-aware top
+    // level: build() and refit() lay the tree out over whole-motion boxes, then give every
+    // node boxes at common keyframe times so rays test them at their own time.
+
+    size_t add(shared_ptr<hittable> object, const transform& object_to_world, material_handle mat = material_handle()) {
+        // Returns the instance's id, for later set_transform calls.
+        instances.emplace_back(object, object_to_world, mat);
+        return instances.size() - 1;
+    }
+
+    size_t size() const { return instances.size(); }
+
+    const transform& get_transform(size_t id) const { return instances[id].get_transform(); }
+    void set_transform(size_t id, const transform& t) { instances[id].set_transform(t); }
+    void set_motion(size_t id, const std::vector<transform>& keys) { instances[id].set_motion(keys); }
+
+    void build() {
+        bvh.build(instance_bounds(), max_leaf_size);
+        fit_motion();
+    }
+
+    void refit() {
+        if (bvh.primitives.size() != instances.size()) {
+            build();  // Instances were added since the last build
+            return;
+        }
+        bvh.refit(instance_bounds());
+        fit_motion();
+    }
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        real closest = ray_t.max;
+        bool hit_anything = false;
+
+        bvh.traverse(r, ray_t.min, closest, [&](uint32_t first, uint32_t count) {
+            for (uint32_t k = first; k < first + count; k++) {
+                if (instances[bvh.primitives[k]].hit(r, interval(ray_t.min, closest), rec)) {
+                    closest = rec.t;
+                    hit_anything = true;
+                }
+            }
+        });
+
+        return hit_anything;
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+    int motion_segments() const override { return bvh.segments; }
+    aabb bounds_at(real time) const override { return bvh.bounds_at(time); }
+
+    size_t memory_bytes() const {
+        // The top level alone; bottom levels are shared and counted by their owners.
+        return instances.capacity() * sizeof(instance) + bvh.memory_bytes();
+    }
+
+private:
+    static const int max_leaf_size = 2;
+    static const int max_motion_segments = 16;
+
+    std::vector<instance> instances;
+    flat_bvh bvh;
+    aabb bbox;
+
+    std::vector<aabb> instance_bounds() const {
+        std::vector<aabb> boxes(instances.size());
+        for (size_t k = 0; k < instances.size(); k++)
+            boxes[k] = instances[k].bounding_box();
+        return boxes;
+    }
+
+    void fit_motion() {
+        // Keys fall on every instance's keys where that takes at most max_motion_segments
+        // steps. Instances whose keys miss the grid keep their whole-motion box at every key.
+        int segments = 0;
+        for (const auto& inst : instances) {
+            int combined = common_motion_segments(segments, inst.motion_segments());
+            if (combined <= max_motion_segments)
+                segments = combined;
+        }
+
+        if (segments > 0) {
+            size_t keys = size_t(segments) + 1;
+            std::vector<aabb> keyed_boxes(instances.size() * keys);
+            for (size_t k = 0; k < instances.size(); k++) {
+                const auto& inst = instances[k];
+                int own = inst.motion_segments();
+                bool on_grid = own > 0 && segments % own == 0;
+                for (size_t key = 0; key < keys; key++) {
+                    keyed_boxes[k * keys + key] = on_grid
+                        ? inst.bounds_at(real(key) / real(segments))
+                        : inst.bounding_box();
+                }
+            }
+            bvh.refit_motion(keyed_boxes, segments);
+        }
+        bbox = bvh.bounds();
+    }
+};
+
+#endif
@@ -0,0 +1,163 @@
+#pragma once
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include "aabb.h"
+
+class transform {
+public:
+    // An affine transform, stored as the top three rows of a 4x4 matrix acting on column
+    // vectors, together with its inverse. Compose with operator*: (a * b) applies b first.
+
+    transform() {
+        for (int r = 0; r < 3; r++)
+            for (int c = 0; c < 4; c++)
+                m[r][c] = inv[r][c] = (r == c) ? 1 : 0;
+    }
+
+    static transform translate(const vec3& offset) {
+        transform t;
+        for (int r = 0; r < 3; r++) {
+            t.m[r][3] = offset[r];
+            t.inv[r][3] = -offset[r];
+        }
+        return t;
+    }
+
+    static transform scale(const vec3& factors) {
+        transform t;
+        for (int r = 0; r < 3; r++) {
+            t.m[r][r] = factors[r];
+            t.inv[r][r] = 1 / factors[r];
+        }
+        return t;
+    }
+
+    static transform scale(real factor) { return scale(vec3(factor, factor, factor)); }
+
+    static transform rotate(const vec3& axis, double degrees) {
+        // Rodrigues' rotation about `axis`. The inverse of a rotation is its transpose.
+        auto a = unit_vector(axis);
+        auto theta = degrees_to_radians(degrees);
+        auto s = std::sin(theta), c = std::cos(theta), k = 1 - c;
+
+        transform t;
+        t.m[0][0] = real(a.x() * a.x() * k + c);
+        t.m[0][1] = real(a.x() * a.y() * k - a.z() * s);
+        t.m[0][2] = real(a.x() * a.z() * k + a.y() * s);
+        t.m[1][0] = real(a.y() * a.x() * k + a.z() * s);
+        t.m[1][1] = real(a.y() * a.y() * k + c);
+        t.m[1][2] = real(a.y() * a.z() * k - a.x() * s);
+        t.m[2][0] = real(a.z() * a.x() * k - a.y() * s);
+        t.m[2][1] = real(a.z() * a.y() * k + a.x() * s);
+        t.m[2][2] = real(a.z() * a.z() * k + c);
+        for (int r = 0; r < 3; r++)
+            for (int col = 0; col < 3; col++)
+                t.inv[r][col] = t.m[col][r];
+        return t;
+    }
+
+    friend transform operator*(const transform& a, const transform& b) {
+        transform t;
+        multiply(a.m, b.m, t.m);
+        multiply(b.inv, a.inv, t.inv);
+        return t;
+    }
+
+    static transform lerp(const transform& a, const transform& b, real f) {
+        // Blends the matrices entry by entry and inverts the result. A rotation blended this way
+        // shrinks a little midway, by 1 - cos(angle / 2), which is negligible for the small
+        // steps between animation keyframes.
+        transform t;
+        for (int r = 0; r < 3; r++)
+            for (int c = 0; c < 4; c++)
+                t.m[r][c] = a.m[r][c] + f * (b.m[r][c] - a.m[r][c]);
+        t.invert();
+        return t;
+    }
+
+    transform inverse() const {
+        transform t;
+        for (int r = 0; r < 3; r++) {
+            for (int c = 0; c < 4; c++) {
+                t.m[r][c] = inv[r][c];
+                t.inv[r][c] = m[r][c];
+            }
+        }
+        return t;
+    }
+
+    point3 point(const point3& p) const { return apply(m, p, 1); }
+    vec3 vector(const vec3& v) const { return apply(m, v, 0); }
+
+    vec3 normal(const vec3& n) const {
+        // Normals transform by the inverse transpose. The result is not normalized.
+        return vec3(
+            inv[0][0] * n.x() + inv[1][0] * n.y() + inv[2][0] * n.z(),
+            inv[0][1] * n.x() + inv[1][1] * n.y() + inv[2][1] * n.z(),
+            inv[0][2] * n.x() + inv[1][2] * n.y() + inv[2][2] * n.z()
+        );
+    }
+
+    point3 inverse_point(const point3& p) const { return apply(inv, p, 1); }
+    vec3 inverse_vector(const vec3& v) const { return apply(inv, v, 0); }
+
+    aabb bounds(const aabb& box) const {
+        // The box enclosing all eight transformed corners of `box`.
+        aabb result = aabb::empty;
+        for (int corner = 0; corner < 8; corner++) {
+            auto p = point(point3(
+                (corner & 1) ? box.x.max : box.x.min,
+                (corner & 2) ? box.y.max : box.y.min,
+                (corner & 4) ? box.z.max : box.z.min
+            ));
+            result = aabb(result, aabb(p, p));
+        }
+        return result;
+    }
+
+private:
+    real m[3][4];    // Object to world
+    real inv[3][4];  // World to object
+
+    void invert() {
+        // Sets `inv` from `m`: the 3x3 part by cofactors, then the translation taken back
+        // through it.
+        real det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+                 - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+                 + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+        real s = 1 / det;
+        inv[0][0] = (m[1][1] * m[2][2] - m[1][2] * m[2][1]) * s;
+        inv[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * s;
+        inv[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * s;
+        inv[1][0] = (m[1][2] * m[2][0] - m[1][0] * m[2][2]) * s;
+        inv[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * s;
+        inv[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * s;
+        inv[2][0] = (m[1][0] * m[2][1] - m[1][1] * m[2][0]) * s;
+        inv[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * s;
+        inv[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * s;
+        for (int r = 0; r < 3; r++)
+            inv[r][3] = -(inv[r][0] * m[0][3] + inv[r][1] * m[1][3] + inv[r][2] * m[2][3]);
+    }
+
+    static vec3 apply(const real (&a)[3][4], const vec3& v, real w) {
+        return vec3(
+            a[0][0] * v.x() + a[0][1] * v.y() + a[0][2] * v.z() + a[0][3] * w,
+            a[1][0] * v.x() + a[1][1] * v.y() + a[1][2] * v.z() + a[1][3] * w,
+            a[2][0] * v.x() + a[2][1] * v.y() + a[2][2] * v.z() + a[2][3] * w
+        );
+    }
+
+    static void multiply(const real (&a)[3][4], const real (&b)[3][4], real (&out)[3][4]) {
+        // The implicit fourth rows are (0, 0, 0, 1).
+        for (int r = 0; r < 3; r++) {
+            for (int c = 0; c < 4; c++) {
+                out[r][c] = a[r][0] * b[0][c] + a[r][1] * b[1][c] + a[r][2] * b[2][c];
+                if (c == 3)
+                    out[r][c] += a[r][3];
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,272 @@
+#pragma once
+#ifndef TRIANGLE_MESH_H
+#define TRIANGLE_MESH_H
+
+#include "aabb.h"
+#include "binary_io.h"
+#include "flat_bvh.h"
+#include "hittable.h"
+#include "obj_loader.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class triangle_mesh : public hittable {
+public:
+    // An indexed triangle mesh with its own BVH. Vertex positions (and optional per-corner
+    // normals and texture coordinates) are shared packed arrays, triangles are three indices
+    // each, and the BVH is a flat_bvh over the triangle list reordered into leaf order, so the
+    // whole mesh is a handful of contiguous allocations however many instances place it in the
+    // scene.
+
+    triangle_mesh(
+        std::vector<point3> positions, std::vector<uint32_t> indices, material_handle mat,
+        std::vector<vec3> normals = {}, std::vector<uint32_t> normal_indices = {},
+        std::vector<texcoord> texcoords = {}, std::vector<uint32_t> texcoord_indices = {}
+    ) : positions(std::move(positions)), normals(std::move(normals)), texcoords(std::move(texcoords)),
+        indices(std::move(indices)), normal_indices(std::move(normal_indices)),
+        texcoord_indices(std::move(texcoord_indices)), mat(mat)
+    {
+        if (this->normal_indices.size() != this->indices.size())
+            this->normal_indices.clear();
+        if (this->texcoord_indices.size() != this->indices.size())
+            this->texcoord_indices.clear();
+        build();
+    }
+
+    static shared_ptr<triangle_mesh> load_obj(const std::string& path, material_handle mat) {
+        // Returns null if the file can't be read.
+        obj_mesh mesh;
+        if (!::load_obj(path, mesh))
+            return nullptr;
+        return make_shared<triangle_mesh>(
+            std::move(mesh.positions), std::move(mesh.position_indices), mat,
+            std::move(mesh.normals), std::move(mesh.normal_indices),
+            std::move(mesh.texcoords), std::move(mesh.texcoord_indices));
+    }
+
+    bool save(binary_writer& out) const {
+        // Stores the mesh as built, BVH included, so load() needs no rebuild.
+        out.put(mat);
+        out.put_array(positions);
+        out.put_array(normals);
+        out.put_array(indices);
+        out.put_array(normal_indices);
+        out.put_array(texcoords);
+        out.put_array(texcoord_indices);
+        out.put_array(bvh.nodes);
+        return true;
+    }
+
+    static shared_ptr<triangle_mesh> load(binary_reader& in) {
+        // Returns null if the stored mesh is cut short or refers past its own arrays.
+        shared_ptr<triangle_mesh> mesh(new triangle_mesh());
+        if (!in.get(mesh->mat) || !in.get_array(mesh->positions) || !in.get_array(mesh->normals)
+            || !in.get_array(mesh->indices) || !in.get_array(mesh->normal_indices)
+            || !in.get_array(mesh->texcoords) || !in.get_array(mesh->texcoord_indices)
+            || !in.get_array(mesh->bvh.nodes))
+            return nullptr;
+
+        auto in_range = [](const std::vector<uint32_t>& list, size_t size) {
+            return std::all_of(list.begin(), list.end(), [&](uint32_t k) { return k < size; });
+        };
+        if (mesh->indices.size() % 3 != 0 || !in_range(mesh->indices, mesh->positions.size())
+            || (!mesh->normal_indices.empty() && mesh->normal_indices.size() != mesh->indices.size())
+            || !in_range(mesh->normal_indices, mesh->normals.size())
+            || (!mesh->texcoord_indices.empty() && mesh->texcoord_indices.size() != mesh->indices.size())
+            || !in_range(mesh->texcoord_indices, mesh->texcoords.size())
+            || !mesh->bvh.valid(mesh->triangle_count()))
+            return nullptr;
+
+        mesh->set_bounds();
+        return mesh;
+    }
+
+    size_t triangle_count() const { return indices.size() / 3; }
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        real closest = ray_t.max;
+        uint32_t closest_triangle = 0;
+        real closest_u = 0, closest_v = 0;
+        bool hit_anything = false;
+
+        bvh.traverse(r, ray_t.min, closest, [&](uint32_t first, uint32_t count) {
+            for (uint32_t k = first; k < first + count; k++) {
+                real t, u, v;
+                if (triangle_hit(k, r, ray_t.min, closest, t, u, v)) {
+                    closest = t;
+                    closest_triangle = k;
+                    closest_u = u;
+                    closest_v = v;
+                    hit_anything = true;
+                }
+            }
+        });
+
+        if (!hit_anything)
+            return false;
+
+        const uint32_t* tri = &indices[3 * size_t(closest_triangle)];
+        const point3& p0 = positions[tri[0]];
+        vec3 geometric_normal = unit_vector(cross(positions[tri[1]] - p0, positions[tri[2]] - p0));
+
+        rec.t = closest;
+        rec.p = r.at(rec.t);
+        rec.front_face = dot(r.direction(), geometric_normal) < 0;
+
+        vec3 shading_normal = geometric_normal;
+        if (!normal_indices.empty()) {
+            // Interpolate the corner normals, keeping the geometric normal's notion of which
+            // side is outside.
+            const uint32_t* ntri = &normal_indices[3 * size_t(closest_triangle)];
+            auto n = (1 - closest_u - closest_v) * normals[ntri[0]]
+                   + closest_u * normals[ntri[1]] + closest_v * normals[ntri[2]];
+            if (n.length_squared() > 0) {
+                shading_normal = unit_vector(n);
+                if (dot(shading_normal, geometric_normal) < 0)
+                    shading_normal = -shading_normal;
+            }
+        }
+        rec.normal = rec.front_face ? shading_normal : -shading_normal;
+        rec.mat = mat;
+        if (mat.textured())
+            set_surface_coordinates(rec, closest_triangle, closest_u, closest_v);
+
+        return true;
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+    size_t memory_bytes() const {
+        return positions.capacity() * sizeof(point3) + normals.capacity() * sizeof(vec3)
+             + texcoords.capacity() * sizeof(texcoord)
+             + (indices.capacity() + normal_indices.capacity() + texcoord_indices.capacity()) * sizeof(uint32_t)
+             + bvh.memory_bytes();
+    }
+
+private:
+    static const int max_leaf_size = 4;
+
+    std::vector<point3>   positions;
+    std::vector<vec3>     normals;
+    std::vector<texcoord> texcoords;
+    std::vector<uint32_t> indices;           // Three per triangle, in BVH leaf order
+    std::vector<uint32_t> normal_indices;    // Three per triangle, or empty
+    std::vector<uint32_t> texcoord_indices;  // Three per triangle, or empty
+    flat_bvh              bvh;
+    material_handle       mat;
+    aabb bbox;
+
+    triangle_mesh() {}
+
+    bool triangle_hit(uint32_t k, const ray& r, real t_min, real t_max, real& t, real& u, real& v) const {
+        // Moller-Trumbore: solve for the hit's distance and barycentrics in one pass, using
+        // Cramer's rule on the triangle's edge vectors.
+        const uint32_t* tri = &indices[3 * size_t(k)];
+        const point3& p0 = positions[tri[0]];
+        vec3 edge1 = positions[tri[1]] - p0;
+        vec3 edge2 = positions[tri[2]] - p0;
+
+        vec3 pvec = cross(r.direction(), edge2);
+        real det = dot(edge1, pvec);
+        if (std::fabs(det) < real(1e-12))
+            return false;  // Ray parallel to the triangle's plane
+        real inv_det = 1 / det;
+
+        vec3 tvec = r.origin() - p0;
+        u = dot(tvec, pvec) * inv_det;
+        if (u < 0 || u > 1)
+            return false;
+
+        vec3 qvec = cross(tvec, edge1);
+        v = dot(r.direction(), qvec) * inv_det;
+        if (v < 0 || u + v > 1)
+            return false;
+
+        t = dot(edge2, qvec) * inv_det;
+        return t_min < t && t < t_max;
+    }
+
+    void set_surface_coordinates(hit_record& rec, uint32_t k, real b1, real b2) const {
+        // Interpolates the corners' texture coordinates at barycentrics (b1, b2), and solves
+        // for the partial derivatives that map them onto the triangle's edges. Meshes without
+        // texture coordinates use the barycentrics themselves.
+        const uint32_t* tri = &indices[3 * size_t(k)];
+        vec3 edge1 = positions[tri[1]] - positions[tri[0]];
+        vec3 edge2 = positions[tri[2]] - positions[tri[0]];
+        if (texcoord_indices.empty()) {
+            rec.u = b1;
+            rec.v = b2;
+            rec.dpdu = edge1;
+            rec.dpdv = edge2;
+            return;
+        }
+
+        const uint32_t* ttri = &texcoord_indices[3 * size_t(k)];
+        const texcoord& t0 = texcoords[ttri[0]];
+        const texcoord& t1 = texcoords[ttri[1]];
+        const texcoord& t2 = texcoords[ttri[2]];
+        rec.u = (1 - b1 - b2) * t0.u + b1 * t1.u + b2 * t2.u;
+        rec.v = (1 - b1 - b2) * t0.v + b1 * t1.v + b2 * t2.v;
+
+        real du1 = t1.u - t0.u, dv1 = t1.v - t0.v, du2 = t2.u - t0.u, dv2 = t2.v - t0.v;
+        real det = du1 * dv2 - dv1 * du2;
+        if (std::fabs(det) < real(1e-12)) {
+            rec.dpdu = rec.dpdv = vec3(0, 0, 0);  // Degenerate mapping: no filtering
+            return;
+        }
+        rec.dpdu = (dv2 * edge1 - dv1 * edge2) / det;
+        rec.dpdv = (du1 * edge2 - du2 * edge1) / det;
+    }
+
+    aabb triangle_bounds(uint32_t k) const {
+        const uint32_t* tri = &indices[3 * size_t(k)];
+        return aabb(aabb(positions[tri[0]], positions[tri[1]]), aabb(positions[tri[2]], positions[tri[2]]));
+    }
+
+    void build() {
+        size_t count = triangle_count();
+        if (count == 0)
+            return;
+
+        std::vector<aabb> boxes(count);
+        for (uint32_t k = 0; k < count; k++)
+            boxes[k] = triangle_bounds(k);
+        bvh.build(boxes, max_leaf_size);
+
+        // Rewrite the index arrays in leaf order, so that triangle k is leaf slot k and the
+        // BVH's slot-to-triangle map is no longer needed.
+        std::vector<uint32_t> sorted(indices.size()), sorted_normals(normal_indices.size()),
+                              sorted_texcoords(texcoord_indices.size());
+        for (size_t k = 0; k < count; k++) {
+            auto source = size_t(bvh.primitives[k]);
+            for (int corner = 0; corner < 3; corner++) {
+                sorted[3 * k + corner] = indices[3 * source + corner];
+                if (!normal_indices.empty())
+                    sorted_normals[3 * k + corner] = normal_indices[3 * source + corner];
+                if (!texcoord_indices.empty())
+                    sorted_texcoords[3 * k + corner] = texcoord_indices[3 * source + corner];
+            }
+        }
+        indices.swap(sorted);
+        normal_indices.swap(sorted_normals);
+        texcoord_indices.swap(sorted_texcoords);
+        bvh.primitives = std::vector<uint32_t>();
+        set_bounds();
+    }
+
+    void set_bounds() {
+        // Flat meshes lying in an axis plane get a sliver of thickness, so that enclosing
+        // hierarchies that use aabb::hit still find them.
+        bbox = bvh.bounds();
+        const real min_size = real(1e-4);
+        bbox = aabb(
+            bbox.x.size() < min_size ? bbox.x.expand(min_size) : bbox.x,
+            bbox.y.size() < min_size ? bbox.y.expand(min_size) : bbox.y,
+            bbox.z.size() < min_size ? bbox.z.expand(min_size) : bbox.z);
+    }
+};
+
+#endif
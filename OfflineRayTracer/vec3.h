@@ -2,131 +2,204 @@
 #ifndef VEC3_H
 #define VEC3_H
 
-class vec3 {
-public:
-	double e[3];
+#include "sampler.h"
 
-    vec3() : e{ 0,0,0 } {}
-    vec3(double e0, double e1, double e2) : e{ e0, e1, e2 } {}
+#include <type_traits>
 
-    double x() const { return e[0]; }
-    double y() const { return e[1]; }
-    double z() const { return e[2]; }
+template <typename T>
+class vec3_t {
+public:
+    // With OFFLINERT_USE_SSE, single-precision vectors carry a fourth lane, which is kept at
+    // zero, so that each vector fills one SSE register.
+#ifdef OFFLINERT_USE_SSE
+    static constexpr bool use_sse = std::is_same<T, float>::value;
+#else
+    static constexpr bool use_sse = false;
+#endif
+
+	alignas(use_sse ? 16 : alignof(T)) T e[use_sse ? 4 : 3];
+
+    vec3_t() : e{ 0,0,0 } {}
+    vec3_t(T e0, T e1, T e2) : e{ e0, e1, e2 } {}
+
+    T x() const { return e[0]; }
+    T y() const { return e[1]; }
+    T z() const { return e[2]; }
+
+    vec3_t operator-() const {
+#ifdef OFFLINERT_USE_SSE
+        if constexpr (use_sse) return vec3_t(_mm_sub_ps(_mm_setzero_ps(), load()));
+#endif
+        return vec3_t(-e[0], -e[1], -e[2]);
+    }
 
-    vec3 operator-() const { return vec3(-e[0], -e[1], -e[2]); }
-    double operator[](int i) const { return e[i]; }
-    double& operator[](int i) { return e[i]; }
+    T operator[](int i) const { return e[i]; }
+    T& operator[](int i) { return e[i]; }
 
-    vec3& operator+=(const vec3& v) {
-        e[0] += v.e[0];
-        e[1] += v.e[1];
-        e[2] += v.e[2];
-        return *this;
+    vec3_t& operator+=(const vec3_t& v) {
+        return *this = *this + v;
     }
 
-    vec3& operator*=(double t) {
-        e[0] *= t;
-        e[1] *= t;
-        e[2] *= t;
-        return *this;
+    vec3_t& operator*=(T t) {
+        return *this = *this * t;
     }
 
-    vec3& operator/=(double t) {
+    vec3_t& operator/=(T t) {
         return *this *= 1 / t;
     }
 
-    double length() const {
+    T length() const {
         return std::sqrt(length_squared());
     }
 
-    double length_squared() const {
-        return e[0] * e[0] + e[1] * e[1] + e[2] * e[2];
+    T length_squared() const {
+        return dot(*this, *this);
     }
 
     bool near_zero() const {
         // Return true if the vector is close to zero in all dimensions.
-        auto s = 1e-8;
+        auto s = T(1e-8);
         return (std::fabs(e[0]) < s) && (std::fabs(e[1]) < s) && (std::fabs(e[2]) < s);
     }
 
-    static vec3 random() {
-        return vec3(random_double(), random_double(), random_double());
+    static vec3_t random(sampler& s) {
+        return vec3_t(T(s.random_double()), T(s.random_double()), T(s.random_double()));
     }
 
-    static vec3 random(double min, double max) {
-        return vec3(random_double(min, max), random_double(min, max), random_double(min, max));
+    static vec3_t random(sampler& s, double min, double max) {
+        return vec3_t(T(s.random_double(min, max)), T(s.random_double(min, max)), T(s.random_double(min, max)));
     }
-};
 
-// point3 is just an alias for vec3, but useful for geometric clarity in the code.
-using point3 = vec3;
+    // Vector Utility Functions
+    //
+    // These are hidden friends rather than free templates, so a scalar of another type (such
+    // as a double literal against a float vector) converts instead of failing deduction.
 
+    friend std::ostream& operator<<(std::ostream& out, const vec3_t& v) {
+        return out << v.e[0] << ' ' << v.e[1] << ' ' << v.e[2];
+    }
 
-// Vector Utility Functions
+    friend vec3_t operator+(const vec3_t& u, const vec3_t& v) {
+#ifdef OFFLINERT_USE_SSE
+        if constexpr (use_sse) return vec3_t(_mm_add_ps(u.load(), v.load()));
+#endif
+        return vec3_t(u.e[0] + v.e[0], u.e[1] + v.e[1], u.e[2] + v.e[2]);
+    }
 
-inline std::ostream& operator<<(std::ostream& out, const vec3& v) {
-    return out << v.e[0] << ' ' << v.e[1] << ' ' << v.e[2];
-}
+    friend vec3_t operator-(const vec3_t& u, const vec3_t& v) {
+#ifdef OFFLINERT_USE_SSE
+        if constexpr (use_sse) return vec3_t(_mm_sub_ps(u.load(), v.load()));
+#endif
+        return vec3_t(u.e[0] - v.e[0], u.e[1] - v.e[1], u.e[2] - v.e[2]);
+    }
 
-inline vec3 operator+(const vec3& u, const vec3& v) {
-    return vec3(u.e[0] + v.e[0], u.e[1] + v.e[1], u.e[2] + v.e[2]);
-}
+    friend vec3_t operator*(const vec3_t& u, const vec3_t& v) {
+#ifdef OFFLINERT_USE_SSE
+        if constexpr (use_sse) return vec3_t(_mm_mul_ps(u.load(), v.load()));
+#endif
+        return vec3_t(u.e[0] * v.e[0], u.e[1] * v.e[1], u.e[2] * v.e[2]);
+    }
 
-inline vec3 operator-(const vec3& u, const vec3& v) {
-    return vec3(u.e[0] - v.e[0], u.e[1] - v.e[1], u.e[2] - v.e[2]);
-}
+    friend vec3_t operator*(T t, const vec3_t& v) {
+#ifdef OFFLINERT_USE_SSE
+        if constexpr (use_sse) return vec3_t(_mm_mul_ps(_mm_set1_ps(t), v.load()));
+#endif
+        return vec3_t(t * v.e[0], t * v.e[1], t * v.e[2]);
+    }
 
-inline vec3 operator*(const vec3& u, const vec3& v) {
-    return vec3(u.e[0] * v.e[0], u.e[1] * v.e[1], u.e[2] * v.e[2]);
-}
+    friend vec3_t operator*(const vec3_t& v, T t) {
+        return t * v;
+    }
 
-inline vec3 operator*(double t, const vec3& v) {
-    return vec3(t * v.e[0], t * v.e[1], t * v.e[2]);
-}
+    friend vec3_t operator/(const vec3_t& v, T t) {
+        return (1 / t) * v;
+    }
 
-inline vec3 operator*(const vec3& v, double t) {
-    return t * v;
-}
+    friend T dot(const vec3_t& u, const vec3_t& v) {
+#ifdef OFFLINERT_USE_SSE
+        if constexpr (use_sse) {
+            // Multiply lane-wise, then fold x+y+z into the lowest lane. The zero w lane keeps
+            // the fourth product out of the sum.
+            auto m = _mm_mul_ps(u.load(), v.load());
+            auto shuf = _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1));
+            auto sums = _mm_add_ps(m, shuf);
+            shuf = _mm_movehl_ps(shuf, sums);
+            return _mm_cvtss_f32(_mm_add_ss(sums, shuf));
+        }
+#endif
+        return u.e[0] * v.e[0]
+            + u.e[1] * v.e[1]
+            + u.e[2] * v.e[2];
+    }
 
-inline vec3 operator/(const vec3& v, double t) {
-    return (1 / t) * v;
-}
+    friend vec3_t cross(const vec3_t& u, const vec3_t& v) {
+#ifdef OFFLINERT_USE_SSE
+        if constexpr (use_sse) {
+            auto a = u.load(), b = v.load();
+            auto a_yzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+            auto b_yzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+            auto c = _mm_sub_ps(_mm_mul_ps(a, b_yzx), _mm_mul_ps(a_yzx, b));
+            return vec3_t(_mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1)));
+        }
+#endif
+        return vec3_t(u.e[1] * v.e[2] - u.e[2] * v.e[1],
+            u.e[2] * v.e[0] - u.e[0] * v.e[2],
+            u.e[0] * v.e[1] - u.e[1] * v.e[0]);
+    }
 
-inline double dot(const vec3& u, const vec3& v) {
-    return u.e[0] * v.e[0]
-        + u.e[1] * v.e[1]
-        + u.e[2] * v.e[2];
-}
+    friend vec3_t unit_vector(const vec3_t& v) {
+        return v / v.length();
+    }
 
-inline vec3 cross(const vec3& u, const vec3& v) {
-    return vec3(u.e[1] * v.e[2] - u.e[2] * v.e[1],
-        u.e[2] * v.e[0] - u.e[0] * v.e[2],
-        u.e[0] * v.e[1] - u.e[1] * v.e[0]);
-}
+private:
+#ifdef OFFLINERT_USE_SSE
+    explicit vec3_t(__m128 m) { _mm_store_ps(e, m); }
+    __m128 load() const { return _mm_load_ps(e); }
+#endif
+};
+
+// vec3 is the renderer's working precision; see `real` in offlineRT.h.
+using vec3 = vec3_t<real>;
+
+// point3 is just an alias for vec3, but useful for geometric clarity in the code.
+using point3 = vec3;
 
-inline vec3 unit_vector(const vec3& v) {
-    return v / v.length();
-}
 
-inline vec3 random_in_unit_disk() {
-    while (true) {
-        auto p = vec3(random_double(-1, 1), random_double(-1, 1), 0);
-        if (p.length_squared() < 1)
-            return p;
+inline vec3 random_in_unit_disk(sampler& s) {
+    // Shirley-Chiu concentric mapping of one 2D sample onto the disk. Unlike rejection
+    // sampling, it always consumes exactly one dimension pair and keeps the sample's
+    // stratification.
+    double u, v;
+    s.next_2d(u, v);
+    u = 2 * u - 1;
+    v = 2 * v - 1;
+    if (u == 0 && v == 0)
+        return vec3(0, 0, 0);
+
+    double r, theta;
+    if (std::fabs(u) > std::fabs(v)) {
+        r = u;
+        theta = (pi / 4) * (v / u);
     }
+    else {
+        r = v;
+        theta = (pi / 2) - (pi / 4) * (u / v);
+    }
+    return vec3(real(r * std::cos(theta)), real(r * std::sin(theta)), 0);
 }
 
-inline vec3 random_unit_vector() {
-    while (true) {
-        auto p = vec3::random(-1, 1);
-        auto lensq = p.length_squared();
-        if (1e-160 < lensq && lensq <= 1)
-            return p / sqrt(lensq);
-    }
+inline vec3 random_unit_vector(sampler& s) {
+    // Maps one 2D sample uniformly onto the unit sphere.
+    double u, v;
+    s.next_2d(u, v);
+    auto z = 1 - 2 * u;
+    auto r = std::sqrt(std::fmax(0.0, 1 - z * z));
+    auto phi = 2 * pi * v;
+    return vec3(real(r * std::cos(phi)), real(r * std::sin(phi)), real(z));
 }
 
-inline vec3 random_on_hemisphere(const vec3& normal) {
-    vec3 on_unit_sphere = random_unit_vector();
+inline vec3 random_on_hemisphere(sampler& s, const vec3& normal) {
+    vec3 on_unit_sphere = random_unit_vector(s);
     if (dot(on_unit_sphere, normal) > 0.0) // In the same hemisphere as the normal
         return on_unit_sphere;
     else
@@ -137,10 +210,10 @@ inline vec3 reflect(const vec3& v, const vec3& n) {
     return v - 2 * dot(v, n) * n;
 }
 
-inline vec3 refract(const vec3& uv, const vec3& n, double etai_over_etat) {
-    auto cos_theta = std::fmin(dot(-uv, n), 1.0);
+inline vec3 refract(const vec3& uv, const vec3& n, real etai_over_etat) {
+    auto cos_theta = std::fmin(dot(-uv, n), real(1));
     vec3 r_out_perp = etai_over_etat * (uv + cos_theta * n);
-    vec3 r_out_parallel = -std::sqrt(std::fabs(1.0 - r_out_perp.length_squared())) * n;
+    vec3 r_out_parallel = -std::sqrt(std::fabs(1 - r_out_perp.length_squared())) * n;
     return r_out_perp + r_out_parallel;
 }
 
@@ -0,0 +1,66 @@
+#pragma once
+#ifndef WAVEFRONT_H
+#define WAVEFRONT_H
+
+#include "hittable.h"
+
+#include <cstdint>
+#include <vector>
+
+// Structure-of-arrays state for the wavefront renderer (render_mode::wavefront). Each slot holds
+// one in-flight path; the per-stage loops in camera::render_wavefront sweep these arrays a field
+// at a time rather than chasing one path through the whole bounce.
+
+class path_queue {
+public:
+    std::vector<real>     origin_x, origin_y, origin_z;
+    std::vector<real>     dir_x, dir_y, dir_z;
+    std::vector<real>     time;         // Ray time, for motion blur
+    std::vector<real>     throughput_r, throughput_g, throughput_b;
+    std::vector<uint32_t> pixel;        // Index into the accumulation buffer
+    std::vector<int>      sample;       // Sample index within the pixel
+    std::vector<int>      bounce;       // Bounces taken so far
+    std::vector<uint8_t>  alive;        // Path still in flight
+    std::vector<uint8_t>  hit;          // Extend stage found a surface
+    std::vector<hit_record> hits;       // Closest hit from the extend stage
+
+    explicit path_queue(size_t size) {
+        for (auto* field : { &origin_x, &origin_y, &origin_z, &dir_x, &dir_y, &dir_z, &time,
+                             &throughput_r, &throughput_g, &throughput_b })
+            field->resize(size);
+        pixel.resize(size);
+        sample.resize(size);
+        bounce.resize(size);
+        alive.resize(size, 0);
+        hit.resize(size, 0);
+        hits.resize(size);
+    }
+
+    size_t size() const { return alive.size(); }
+
+    ray path_ray(size_t k) const {
+        return ray(point3(origin_x[k], origin_y[k], origin_z[k]), vec3(dir_x[k], dir_y[k], dir_z[k]), time[k]);
+    }
+
+    void set_ray(size_t k, const ray& r) {
+        origin_x[k] = r.origin().x();
+        origin_y[k] = r.origin().y();
+        origin_z[k] = r.origin().z();
+        dir_x[k] = r.direction().x();
+        dir_y[k] = r.direction().y();
+        dir_z[k] = r.direction().z();
+        time[k] = r.time();
+    }
+
+    color throughput(size_t k) const {
+        return color(throughput_r[k], throughput_g[k], throughput_b[k]);
+    }
+
+    void set_throughput(size_t k, const color& c) {
+        throughput_r[k] = c.x();
+        throughput_g[k] = c.y();
+        throughput_b[k] = c.z();
+    }
+};
+
+#endif
@@ -44,3 +44,13 @@ struct RaytracingEntityData
 {
 	MaterialData mat[MAX_INSTANCES_PER_BLAS];
 };
+
+// Per-mesh vertex layout for raytracing, as local root constants
+// (positions are offset + packed * scale when packed)
+struct RaytracingMeshData
+{
+	DirectX::XMFLOAT3 positionOffset;
+	unsigned int packedVertices;
+	DirectX::XMFLOAT3 positionScale;
+	float pad;
+};
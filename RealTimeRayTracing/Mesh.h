@@ -5,12 +5,14 @@
 #include <string>
 
 #include "Vertex.h"
+#include "VertexPacking.h"
 
 struct MeshRaytracingData
 {
 	D3D12_GPU_DESCRIPTOR_HANDLE IndexBufferSRV { };
 	D3D12_GPU_DESCRIPTOR_HANDLE VertexBufferSRV { };
 	Microsoft::WRL::ComPtr<ID3D12Resource> BLAS;
+	Microsoft::WRL::ComPtr<ID3D12Resource> PositionTransform; // For packed vertices
 	unsigned int HitGroupIndex = 0;
 };
 
@@ -26,7 +28,8 @@ public:
 	);
 	Mesh(
 		std::string name,
-		const wchar_t* filename
+		const wchar_t* filename,
+		bool packVertices = false
 	);
 	~Mesh();
 
@@ -40,12 +43,19 @@ public:
 
 	MeshRaytracingData GetRaytracingData() { return raytracingData; }
 
+	// Packed meshes hold PackedVertex instead of Vertex (see VertexPacking.h)
+	bool HasPackedVertices() { return packedVertices; }
+	VertexQuantization GetVertexQuantization() { return quantization; }
+
 private:
 	std::string name = "MyMesh";
 
 	int numVertices;
 	int numIndices;
 
+	bool packedVertices = false;
+	VertexQuantization quantization{};
+
 	Microsoft::WRL::ComPtr<ID3D12Resource> vertexBuffer;
 	D3D12_VERTEX_BUFFER_VIEW vbView{};
 	Microsoft::WRL::ComPtr<ID3D12Resource> indexBuffer;
@@ -55,9 +65,9 @@ private:
 
 	void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
 	void CreateBuffers(
-		void* vertices, 
+		const void* vertices, 
 		int numVertices, 
-		void* indices, 
+		const void* indices, 
 		int numIndices
 	);
 };
\ No newline at end of file
@@ -0,0 +1,249 @@
+#include <cfloat>
+#include <cstring>
+#include <fstream>
+#include <Windows.h>
+
+#include "MeshCache.h"
+
+namespace
+{
+	const char Magic[8] = { 'M', 'E', 'S', 'H', 'C', 'A', 'C', 'H' };
+
+	// A 64-bit hash of a block of bytes, mixed in a word at a time so
+	// even large sources hash far faster than they parse
+	uint64_t HashBytes(const unsigned char* data, size_t size)
+	{
+		uint64_t h = 0x9E3779B97F4A7C15ull ^ size;
+		size_t i = 0;
+		for (; i + 8 <= size; i += 8)
+		{
+			uint64_t word;
+			std::memcpy(&word, data + i, 8);
+			h = (h ^ word) * 0xC2B2AE3D27D4EB4Full;
+			h ^= h >> 31;
+		}
+
+		uint64_t tail = 0;
+		std::memcpy(&tail, data + i, size - i);
+		h = (h ^ tail) * 0x165667B19E3779F9ull;
+		return h ^ (h >> 32);
+	}
+
+	bool HashSource(const std::filesystem::path& sourcePath, uint64_t& hash)
+	{
+		MappedFile source;
+		if (!source.Open(sourcePath))
+			return false;
+		hash = HashBytes(source.Data(), source.Size());
+		return true;
+	}
+
+	bool StampSource(const std::filesystem::path& sourcePath, uint64_t& size, int64_t& writeTime)
+	{
+		std::error_code ec;
+		size = std::filesystem::file_size(sourcePath, ec);
+		if (ec)
+			return false;
+		writeTime = std::filesystem::last_write_time(sourcePath, ec).time_since_epoch().count();
+		return !ec;
+	}
+}
+
+
+// --------------------------------------------------------
+// Maps a file with the Win32 file mapping API
+// --------------------------------------------------------
+bool MappedFile::Open(const std::filesystem::path& path)
+{
+	Close();
+
+	HANDLE handle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle == INVALID_HANDLE_VALUE)
+		return false;
+	file = handle;
+
+	// Empty files can't be mapped
+	LARGE_INTEGER fileSize{};
+	if (!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+
+	mapping = CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping)
+		data = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!data)
+	{
+		Close();
+		return false;
+	}
+
+	size = (size_t)fileSize.QuadPart;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (data)
+		UnmapViewOfFile(data);
+	if (mapping)
+		CloseHandle(mapping);
+	if (file)
+		CloseHandle(file);
+
+	file = nullptr;
+	mapping = nullptr;
+	data = nullptr;
+	size = 0;
+}
+
+
+// --------------------------------------------------------
+// Checks a cache against its source and maps it
+//
+// - The header is read on its own first, so a stale cache
+//   costs one small read
+// - A source with a new timestamp but the same size is hashed;
+//   if its contents are unchanged after all, the cache's
+//   timestamp is updated so the next load skips the hash
+// - The mapped file is checked for truncation and for indices
+//   out of range, since either would otherwise reach the GPU
+// --------------------------------------------------------
+bool MeshCache::Open(const std::filesystem::path& sourcePath, size_t vertexSize)
+{
+	Close();
+
+	uint64_t sourceSize = 0;
+	int64_t sourceWriteTime = 0;
+	if (!StampSource(sourcePath, sourceSize, sourceWriteTime))
+		return false;
+
+	std::filesystem::path cachePath = MeshCachePath(sourcePath);
+	MeshCacheHeader header{};
+	{
+		std::ifstream in(cachePath, std::ios::binary);
+		if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)))
+			return false;
+	}
+
+	if (std::memcmp(header.Magic, Magic, sizeof(Magic)) != 0 ||
+		header.Version != MeshCacheVersion ||
+		header.VertexSize != vertexSize ||
+		header.SourceSize != sourceSize)
+		return false;
+
+	if (header.SourceWriteTime != sourceWriteTime)
+	{
+		uint64_t hash = 0;
+		if (!HashSource(sourcePath, hash) || hash != header.SourceHash)
+			return false;
+
+		header.SourceWriteTime = sourceWriteTime;
+		std::fstream out(cachePath, std::ios::binary | std::ios::in | std::ios::out);
+		out.seekp(offsetof(MeshCacheHeader, SourceWriteTime));
+		out.write(reinterpret_cast<const char*>(&sourceWriteTime), sizeof(sourceWriteTime));
+	}
+
+	// The file may have been replaced since its header was read, so
+	// everything is checked against the mapped copy
+	if (!file.Open(cachePath))
+		return false;
+
+	size_t bodySize = file.Size() - sizeof(MeshCacheHeader);
+	bool valid = file.Size() >= sizeof(MeshCacheHeader) &&
+		std::memcmp(file.Data(), &header, sizeof(header)) == 0 &&
+		header.VertexCount <= 0xFFFFFFFFull &&
+		header.VertexCount <= bodySize / vertexSize &&
+		header.IndexCount % 3 == 0 &&
+		header.IndexCount <= bodySize / sizeof(unsigned int) &&
+		bodySize - header.VertexCount * vertexSize == header.IndexCount * sizeof(unsigned int);
+
+	const unsigned int* indices = valid ? Indices() : nullptr;
+	for (size_t i = 0; valid && i < header.IndexCount; i++)
+		valid = indices[i] < header.VertexCount;
+
+	if (!valid)
+		Close();
+	return valid;
+}
+
+const unsigned int* MeshCache::Indices() const
+{
+	const unsigned char* vertices = static_cast<const unsigned char*>(Vertices());
+	return reinterpret_cast<const unsigned int*>(vertices + Header().VertexCount * Header().VertexSize);
+}
+
+
+std::filesystem::path MeshCachePath(const std::filesystem::path& sourcePath)
+{
+	std::filesystem::path cachePath = sourcePath;
+	cachePath += ".meshcache";
+	return cachePath;
+}
+
+
+// --------------------------------------------------------
+// Writes a cache to a temporary file and renames it over the
+// old one, so no load ever sees a cache half written
+// --------------------------------------------------------
+bool WriteMeshCache(
+	const std::filesystem::path& sourcePath,
+	const void* vertices,
+	size_t vertexSize,
+	size_t vertexCount,
+	const unsigned int* indices,
+	size_t indexCount,
+	const float* bounds)
+{
+	MeshCacheHeader header{};
+	std::memcpy(header.Magic, Magic, sizeof(Magic));
+	header.Version = MeshCacheVersion;
+	header.VertexSize = (uint32_t)vertexSize;
+	header.VertexCount = vertexCount;
+	header.IndexCount = indexCount;
+	if (!StampSource(sourcePath, header.SourceSize, header.SourceWriteTime) ||
+		!HashSource(sourcePath, header.SourceHash))
+		return false;
+
+	// Bounds of the positions that start each vertex, if not given
+	const unsigned char* vertexBytes = static_cast<const unsigned char*>(vertices);
+	for (int k = 0; k < 3; k++)
+	{
+		header.BoundsMin[k] = bounds ? bounds[k] : (vertexCount > 0 ? FLT_MAX : 0.0f);
+		header.BoundsMax[k] = bounds ? bounds[k + 3] : (vertexCount > 0 ? -FLT_MAX : 0.0f);
+	}
+	for (size_t i = 0; !bounds && i < vertexCount; i++)
+	{
+		float position[3];
+		std::memcpy(position, vertexBytes + i * vertexSize, sizeof(position));
+		for (int k = 0; k < 3; k++)
+		{
+			if (position[k] < header.BoundsMin[k]) header.BoundsMin[k] = position[k];
+			if (position[k] > header.BoundsMax[k]) header.BoundsMax[k] = position[k];
+		}
+	}
+
+	std::filesystem::path cachePath = MeshCachePath(sourcePath);
+	std::filesystem::path tempPath = cachePath;
+	tempPath += ".tmp";
+
+	std::error_code ec;
+	bool written = false;
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(static_cast<const char*>(vertices), (std::streamsize)(vertexCount * vertexSize));
+		out.write(reinterpret_cast<const char*>(indices), (std::streamsize)(indexCount * sizeof(unsigned int)));
+		written = out.good();
+	}
+
+	if (written)
+		std::filesystem::rename(tempPath, cachePath, ec);
+	if (!written || ec)
+	{
+		std::filesystem::remove(tempPath, ec);
+		return false;
+	}
+	return true;
+}
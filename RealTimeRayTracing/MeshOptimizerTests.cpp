@@ -0,0 +1,238 @@
+// --------------------------------------------------------
+// Tests for MeshOptimizer: the FIFO cache simulation on
+// small hand-built index lists, and the three passes on the
+// bundled models and a shuffled grid
+//
+// This is a console program of its own, not part of the
+// project.  Build it with any C++20 compiler, for example:
+//
+//   cl /O2 /std:c++20 /EHsc MeshOptimizerTests.cpp MeshOptimizer.cpp ObjParser.cpp
+//   g++ -O2 -std=c++20 MeshOptimizerTests.cpp MeshOptimizer.cpp ObjParser.cpp
+//
+// Usage: MeshOptimizerTests [models directory]
+//
+// The directory defaults to Assets/Models/.  Exits with 1 if
+// any check fails.
+// --------------------------------------------------------
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "MeshOptimizer.h"
+#include "ObjParser.h"
+
+namespace
+{
+	int failures = 0;
+
+	void Check(bool passed, const std::string& what)
+	{
+		std::printf("%s  %s\n", passed ? "ok  " : "FAIL", what.c_str());
+		if (!passed)
+			failures++;
+	}
+
+	bool Near(float a, float b)
+	{
+		return std::fabs(a - b) < 1e-5f;
+	}
+
+	// --------------------------------------------------------
+	// AnalyzeVertexCache on lists whose misses are easy to count
+	// by hand, with a three-vertex cache
+	// --------------------------------------------------------
+	void TestFifoCache()
+	{
+		// The same triangle twice: only the first draw misses
+		const unsigned int repeat[] = { 0, 1, 2, 0, 1, 2 };
+		VertexCacheStats stats = AnalyzeVertexCache(repeat, 6, 3, 3);
+		Check(Near(stats.ACMR, 3 / 2.0f) && Near(stats.ATVR, 1.0f), "FIFO: a repeated triangle misses 3 times");
+
+		// A neighbor sharing an edge misses only its new vertex
+		const unsigned int neighbors[] = { 0, 1, 2, 2, 1, 3 };
+		stats = AnalyzeVertexCache(neighbors, 6, 4, 3);
+		Check(Near(stats.ACMR, 4 / 2.0f) && Near(stats.ATVR, 1.0f), "FIFO: an edge-sharing neighbor misses once");
+
+		// Hits don't move a vertex back to the front, as they would in
+		// an LRU cache: 3 evicts 0 even though 0 was just used, so the
+		// last triangle misses all three (LRU would miss only 2)
+		const unsigned int fifo[] = { 0, 1, 2, 0, 1, 3, 0, 1, 2 };
+		stats = AnalyzeVertexCache(fifo, 9, 4, 3);
+		Check(Near(stats.ACMR, 7 / 3.0f) && Near(stats.ATVR, 7 / 4.0f), "FIFO: hits don't refresh, 7 misses");
+
+		// Six distinct vertices cycle a three-vertex cache completely
+		const unsigned int disjoint[] = { 0, 1, 2, 3, 4, 5, 0, 1, 2 };
+		stats = AnalyzeVertexCache(disjoint, 9, 6, 3);
+		Check(Near(stats.ACMR, 3.0f), "FIFO: evicted vertices miss again");
+
+		// ... but fit a six-vertex one
+		stats = AnalyzeVertexCache(disjoint, 9, 6, 6);
+		Check(Near(stats.ACMR, 2.0f) && Near(stats.ATVR, 1.0f), "FIFO: a larger cache keeps them");
+
+		stats = AnalyzeVertexCache(nullptr, 0, 0, 3);
+		Check(stats.ACMR == 0.0f && stats.ATVR == 0.0f, "FIFO: no triangles");
+	}
+
+	// Each triangle rotated to start at its smallest index, which keeps
+	// its winding, then sorted
+	std::vector<std::array<unsigned int, 3>> TriangleSet(const std::vector<unsigned int>& indices)
+	{
+		std::vector<std::array<unsigned int, 3>> triangles;
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			std::array<unsigned int, 3> t = { indices[i], indices[i + 1], indices[i + 2] };
+			std::rotate(t.begin(), std::min_element(t.begin(), t.end()), t.end());
+			triangles.push_back(t);
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+
+	// --------------------------------------------------------
+	// Runs all three passes as Mesh does, checking that they
+	// draw the same triangles with the same winding, that the
+	// overdraw pass stays within its ACMR threshold, and that
+	// the final order meets the given cache bounds
+	// --------------------------------------------------------
+	void TestPasses(const std::string& name, std::vector<ObjFloat3> positions, std::vector<unsigned int> indices,
+		float maxACMR, float maxATVR)
+	{
+		const std::vector<unsigned int> original = indices;
+		size_t vertexCount = positions.size();
+		VertexCacheStats before = AnalyzeVertexCache(&indices[0], indices.size(), vertexCount);
+
+		OptimizeVertexCache(&indices[0], indices.size(), vertexCount);
+		VertexCacheStats cacheOrdered = AnalyzeVertexCache(&indices[0], indices.size(), vertexCount);
+		OptimizeOverdraw(&indices[0], indices.size(), &positions[0].x, sizeof(ObjFloat3), vertexCount);
+		VertexCacheStats overdrawOrdered = AnalyzeVertexCache(&indices[0], indices.size(), vertexCount);
+
+		std::vector<unsigned int> remap;
+		OptimizeVertexFetch(&indices[0], indices.size(), vertexCount, remap);
+		RemapVertices(positions, remap);
+		VertexCacheStats after = AnalyzeVertexCache(&indices[0], indices.size(), vertexCount);
+
+		std::printf("      %s: %zu triangles, %zu vertices, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+			name.c_str(), indices.size() / 3, vertexCount, before.ACMR, after.ACMR, before.ATVR, after.ATVR);
+
+		// The remap must be a permutation, and undoing it must give back the input's triangles
+		std::vector<unsigned int> oldNumber(vertexCount, ~0u);
+		bool permutation = remap.size() == vertexCount;
+		for (size_t v = 0; permutation && v < vertexCount; v++)
+		{
+			permutation = remap[v] < vertexCount && oldNumber[remap[v]] == ~0u;
+			if (permutation)
+				oldNumber[remap[v]] = (unsigned int)v;
+		}
+		Check(permutation, name + ": the vertex remap is a permutation");
+
+		bool fetchOrdered = true;
+		unsigned int nextNew = 0;
+		for (unsigned int index : indices)
+		{
+			fetchOrdered &= index <= nextNew;
+			if (index == nextNew)
+				nextNew++;
+		}
+		Check(fetchOrdered, name + ": vertices are numbered in first-use order");
+
+		std::vector<unsigned int> undone(indices.size());
+		for (size_t i = 0; permutation && i < indices.size(); i++)
+			undone[i] = oldNumber[indices[i]];
+		Check(permutation && TriangleSet(undone) == TriangleSet(original), name + ": same triangles, same winding");
+
+		Check(overdrawOrdered.ACMR <= cacheOrdered.ACMR * 1.05f + 1e-6f, name + ": the overdraw pass keeps ACMR within 5%");
+		Check(after.ACMR == overdrawOrdered.ACMR, name + ": the fetch pass leaves the cache behavior alone");
+		Check(after.ACMR <= maxACMR, name + ": ACMR at most " + std::to_string(maxACMR).substr(0, 4));
+		Check(after.ATVR <= maxATVR, name + ": ATVR at most " + std::to_string(maxATVR).substr(0, 4));
+	}
+
+	// Loads and welds a model the way Mesh does
+	bool LoadModel(const std::filesystem::path& path, std::vector<ObjFloat3>& positions, std::vector<unsigned int>& indices)
+	{
+		ObjData obj;
+		std::string error;
+		if (!LoadObj(path, obj, &error))
+		{
+			Check(false, path.string() + ": " + error);
+			return false;
+		}
+
+		std::vector<ObjCorner> corners;
+		WeldObjCorners(obj, corners, indices);
+		positions.resize(corners.size());
+		for (size_t i = 0; i < corners.size(); i++)
+			positions[i] = obj.Positions[corners[i].Position];
+		return true;
+	}
+
+	// A side x side grid of quads, with its triangles shuffled,
+	// as worst-case input
+	void ShuffledGrid(int side, std::vector<ObjFloat3>& positions, std::vector<unsigned int>& indices)
+	{
+		positions.clear();
+		for (int y = 0; y <= side; y++)
+			for (int x = 0; x <= side; x++)
+				positions.push_back({ (float)x, (float)y, std::sin(x * 0.1f) * std::cos(y * 0.1f) });
+
+		std::vector<std::array<unsigned int, 3>> triangles;
+		for (int y = 0; y < side; y++)
+		{
+			for (int x = 0; x < side; x++)
+			{
+				unsigned int a = y * (side + 1) + x, b = a + 1, c = a + side + 1, d = c + 1;
+				triangles.push_back({ a, c, b });
+				triangles.push_back({ b, c, d });
+			}
+		}
+		std::mt19937 rng(12345);
+		for (size_t i = triangles.size() - 1; i > 0; i--)
+			std::swap(triangles[i], triangles[rng() % (i + 1)]);
+
+		indices.clear();
+		for (const auto& t : triangles)
+			indices.insert(indices.end(), t.begin(), t.end());
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::filesystem::path models = argc > 1 ? argv[1] : "Assets/Models/";
+
+	TestFifoCache();
+
+	// Bounds a little above what the passes reach on each model, with a
+	// 16-vertex FIFO cache.  The cube's and quads' faces share no
+	// vertices, so they can't do better than 2 triangles per 4 vertices.
+	struct Model { const char* file; float maxACMR, maxATVR; };
+	const Model bundled[] =
+	{
+		{ "cube.obj", 2.00f, 1.00f },
+		{ "cylinder.obj", 1.15f, 1.10f },
+		{ "helix.obj", 1.05f, 1.05f },
+		{ "quad.obj", 2.00f, 1.00f },
+		{ "quad_double_sided.obj", 2.00f, 1.00f },
+		{ "sphere.obj", 0.80f, 1.40f },
+		{ "torus.obj", 0.75f, 1.35f },
+	};
+	for (const Model& model : bundled)
+	{
+		std::vector<ObjFloat3> positions;
+		std::vector<unsigned int> indices;
+		if (LoadModel(models / model.file, positions, indices))
+			TestPasses(model.file, positions, indices, model.maxACMR, model.maxATVR);
+	}
+
+	std::vector<ObjFloat3> positions;
+	std::vector<unsigned int> indices;
+	ShuffledGrid(200, positions, indices);
+	TestPasses("shuffled 200x200 grid", positions, indices, 0.75f, 1.45f);
+
+	std::printf(failures == 0 ? "All checks passed\n" : "%d checks failed\n", failures);
+	return failures == 0 ? 0 : 1;
+}
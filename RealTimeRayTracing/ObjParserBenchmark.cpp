@@ -0,0 +1,197 @@
+// --------------------------------------------------------
+// OBJ loading throughput: ObjParser against the getline +
+// sscanf loop that Mesh used before it
+//
+// This is a console program of its own, not part of the
+// project.  Build it with any C++20 compiler, for example:
+//
+//   cl /O2 /std:c++20 /EHsc ObjParserBenchmark.cpp ObjParser.cpp
+//   g++ -O2 -std=c++20 ObjParserBenchmark.cpp ObjParser.cpp
+//
+// Usage: ObjParserBenchmark [file.obj ...] [--synthetic MB]
+//
+// With --synthetic, it first writes a generated OBJ of about
+// that many MB (a finely tessellated torus, as exported by
+// modeling tools: v/vt/vn triangles and quads) to the system
+// temp directory, times it with the rest, and deletes it.
+// --------------------------------------------------------
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ObjParser.h"
+
+namespace
+{
+	double SecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// The previous loader's parsing, without building vertices, for comparison
+	size_t LegacyParse(const std::filesystem::path& path)
+	{
+		std::ifstream obj(path);
+		std::vector<ObjFloat3> positions, normals;
+		std::vector<ObjFloat2> uvs;
+		size_t triangles = 0;
+		char chars[100];
+
+		while (obj.good())
+		{
+			obj.getline(chars, 100);
+			if (chars[0] == 'v' && chars[1] == 'n')
+			{
+				ObjFloat3 n{};
+				std::sscanf(chars, "vn %f %f %f", &n.x, &n.y, &n.z);
+				normals.push_back(n);
+			}
+			else if (chars[0] == 'v' && chars[1] == 't')
+			{
+				ObjFloat2 uv{};
+				std::sscanf(chars, "vt %f %f", &uv.x, &uv.y);
+				uvs.push_back(uv);
+			}
+			else if (chars[0] == 'v')
+			{
+				ObjFloat3 p{};
+				std::sscanf(chars, "v %f %f %f", &p.x, &p.y, &p.z);
+				positions.push_back(p);
+			}
+			else if (chars[0] == 'f')
+			{
+				unsigned int i[12]{};
+				int numbersRead = std::sscanf(chars, "f %u/%u/%u %u/%u/%u %u/%u/%u %u/%u/%u",
+					&i[0], &i[1], &i[2], &i[3], &i[4], &i[5], &i[6], &i[7], &i[8], &i[9], &i[10], &i[11]);
+				if (numbersRead == 1)
+					numbersRead = std::sscanf(chars, "f %u//%u %u//%u %u//%u %u//%u",
+						&i[0], &i[2], &i[3], &i[5], &i[6], &i[8], &i[9], &i[11]);
+				triangles += (numbersRead == 12 || numbersRead == 8) ? 2 : 1;
+			}
+		}
+		return triangles;
+	}
+
+	// Writes a torus of roughly the given size as an OBJ file
+	void WriteSyntheticObj(const std::filesystem::path& path, double megabytes)
+	{
+		// About 200 bytes of text per grid point (v, vt, vn and half a quad of each)
+		int side = (int)std::sqrt(megabytes * 1024 * 1024 / 200.0);
+		if (side < 3)
+			side = 3;
+
+		std::ofstream out(path, std::ios::binary);
+		char line[256];
+		const double pi = 3.14159265358979;
+		for (int i = 0; i < side; i++)
+		{
+			for (int j = 0; j < side; j++)
+			{
+				double a = 2 * pi * i / side, b = 2 * pi * j / side;
+				double nx = std::cos(a) * std::cos(b), ny = std::sin(b), nz = std::sin(a) * std::cos(b);
+				int n = std::snprintf(line, sizeof(line),
+					"v %.6f %.6f %.6f\nvt %.6f %.6f\nvn %.6f %.6f %.6f\n",
+					2 * std::cos(a) + 0.5 * nx, 0.5 * ny, 2 * std::sin(a) + 0.5 * nz,
+					double(i) / side, double(j) / side, nx, ny, nz);
+				out.write(line, n);
+			}
+		}
+
+		// Alternate quads and pairs of triangles, using negative indices for some
+		for (int i = 0; i < side; i++)
+		{
+			for (int j = 0; j < side; j++)
+			{
+				int a = i * side + j + 1;
+				int b = ((i + 1) % side) * side + j + 1;
+				int c = ((i + 1) % side) * side + (j + 1) % side + 1;
+				int d = i * side + (j + 1) % side + 1;
+				if ((i + j) % 2 != 0)
+				{
+					// Relative to the end of the vertex list
+					int count = side * side;
+					a -= count + 1; b -= count + 1; c -= count + 1; d -= count + 1;
+				}
+				int n = (i + j) % 2 == 0
+					? std::snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n",
+						a, a, a, b, b, b, c, c, c, d, d, d)
+					: std::snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d\nf %d/%d/%d %d/%d/%d %d/%d/%d\n",
+						a, a, a, b, b, b, c, c, c, a, a, a, c, c, c, d, d, d);
+				out.write(line, n);
+			}
+		}
+	}
+
+	void Benchmark(const std::filesystem::path& path)
+	{
+		std::error_code ec;
+		double megabytes = std::filesystem::file_size(path, ec) / (1024.0 * 1024.0);
+		if (ec)
+		{
+			std::cout << path.string() << ": could not open file\n";
+			return;
+		}
+
+		// Best of a few runs, so the file is in the OS cache for both
+		int runs = megabytes < 50 ? 5 : 2;
+		double parserSeconds = 1e30, legacySeconds = 1e30;
+		size_t parserTriangles = 0, legacyTriangles = 0;
+		for (int run = 0; run < runs; run++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			ObjData data;
+			std::string error;
+			if (!LoadObj(path, data, &error))
+			{
+				std::cout << path.string() << ": " << error << "\n";
+				return;
+			}
+			parserSeconds = std::min(parserSeconds, SecondsSince(start));
+			parserTriangles = data.Corners.size() / 3;
+
+			start = std::chrono::steady_clock::now();
+			legacyTriangles = LegacyParse(path);
+			legacySeconds = std::min(legacySeconds, SecondsSince(start));
+		}
+
+		std::printf("%s: %.1f MB, %zu triangles\n", path.string().c_str(), megabytes, parserTriangles);
+		std::printf("  ObjParser       %8.3f s  %8.1f MB/s\n", parserSeconds, megabytes / parserSeconds);
+		std::printf("  getline+sscanf  %8.3f s  %8.1f MB/s  (%zu triangles)\n",
+			legacySeconds, megabytes / legacySeconds, legacyTriangles);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<std::filesystem::path> files;
+	double syntheticMegabytes = 0;
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::string(argv[i]) == "--synthetic" && i + 1 < argc)
+			syntheticMegabytes = std::atof(argv[++i]);
+		else
+			files.push_back(argv[i]);
+	}
+	if (files.empty() && syntheticMegabytes <= 0)
+		files.push_back("Assets/Models/helix.obj");
+
+	for (const auto& path : files)
+		Benchmark(path);
+
+	if (syntheticMegabytes > 0)
+	{
+		auto path = std::filesystem::temp_directory_path() / "ObjParserBenchmark.obj";
+		auto start = std::chrono::steady_clock::now();
+		WriteSyntheticObj(path, syntheticMegabytes);
+		std::printf("Wrote %s in %.1f s\n", path.string().c_str(), SecondsSince(start));
+		Benchmark(path);
+		std::filesystem::remove(path);
+	}
+}
@@ -191,7 +191,7 @@ void RayTracing::CreateRaytracingRootSignatures()
 		cbufferRange.RegisterSpace = 0;
 
 		// One parameter: Descriptor table housing the index and vertex buffer descriptors
-		D3D12_ROOT_PARAMETER rootParams[2] = {};
+		D3D12_ROOT_PARAMETER rootParams[3] = {};
 
 		// Range of SRVs for geometry (verts & indices)
 		rootParams[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
@@ -205,6 +205,13 @@ void RayTracing::CreateRaytracingRootSignatures()
 		rootParams[1].DescriptorTable.NumDescriptorRanges = 1;
 		rootParams[1].DescriptorTable.pDescriptorRanges = &cbufferRange;
 
+		// Constants describing the mesh's vertex layout, at register(b2)
+		rootParams[2].ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+		rootParams[2].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+		rootParams[2].Constants.ShaderRegister = 2;
+		rootParams[2].Constants.RegisterSpace = 0;
+		rootParams[2].Constants.Num32BitValues = sizeof(RaytracingMeshData) / sizeof(unsigned int);
+
 		// Create the local root sig (ensure we denote it as a local sig)
 		Microsoft::WRL::ComPtr<ID3DBlob> blob;
 		Microsoft::WRL::ComPtr<ID3DBlob> errors;
@@ -408,11 +415,11 @@ void RayTracing::CreateShaderTable()
 	// 2 - Closest hit shader
 	// Note: All records must have the same size, so we need to calculate
 	//       the size of the largest possible entry for our program
-	//       - This will be the default (32) + one descriptor table pointer (8)
+	//       - This will be the default (32) + two descriptor table pointers (8 each) + mesh constants
 	//       - This also must be aligned up to D3D12_RAYTRACING_SHADER_BINDING_TABLE_RECORD_BYTE_ALIGNMENT
 	UINT64 shaderTableRayGenRecordSize = D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES;
 	UINT64 shaderTableMissRecordSize = D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES;
-	UINT64 shaderTableHitGroupRecordSize = D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES + sizeof(D3D12_GPU_DESCRIPTOR_HANDLE) * 2; // CBV & SRV
+	UINT64 shaderTableHitGroupRecordSize = D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES + sizeof(D3D12_GPU_DESCRIPTOR_HANDLE) * 2 + sizeof(RaytracingMeshData); // CBV & SRV & constants
 
 	// Align them
 	shaderTableRayGenRecordSize = ALIGN(shaderTableRayGenRecordSize, D3D12_RAYTRACING_SHADER_RECORD_BYTE_ALIGNMENT);
@@ -566,6 +573,21 @@ MeshRaytracingData RayTracing::CreateBottomLevelAccelerationStructureForMesh(Mes
 	geometryDesc.Triangles.Transform3x4 = 0;
 	geometryDesc.Flags = D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE; // Performance boost when dealing with opaque geometry
 
+	// Packed vertices start with 16-bit snorm positions (see VertexPacking.h),
+	// which a 3x4 transform scales and offsets back to the mesh's bounds
+	VertexQuantization quantization = mesh->GetVertexQuantization();
+	if (mesh->HasPackedVertices())
+	{
+		float positionTransform[12] = {
+			quantization.Scale[0], 0, 0, quantization.Offset[0],
+			0, quantization.Scale[1], 0, quantization.Offset[1],
+			0, 0, quantization.Scale[2], quantization.Offset[2] };
+		rayTracingData.PositionTransform = Graphics::CreateStaticBuffer(sizeof(positionTransform), 1, positionTransform);
+
+		geometryDesc.Triangles.VertexFormat = DXGI_FORMAT_R16G16B16A16_SNORM;
+		geometryDesc.Triangles.Transform3x4 = rayTracingData.PositionTransform->GetGPUVirtualAddress();
+	}
+
 	// Describe our overall input so we can get sizing info
 	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS accelStructInputs = {};
 	accelStructInputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL;
@@ -636,7 +658,7 @@ MeshRaytracingData RayTracing::CreateBottomLevelAccelerationStructureForMesh(Mes
 	vertexSRVDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_RAW;
 	vertexSRVDesc.Buffer.StructureByteStride = 0;
 	vertexSRVDesc.Buffer.FirstElement = 0;
-	vertexSRVDesc.Buffer.NumElements = (UINT)((mesh->GetVertexCount() * sizeof(Vertex)) / sizeof(float)); // How many floats total?
+	vertexSRVDesc.Buffer.NumElements = mesh->GetVertexBufferView().SizeInBytes / sizeof(float); // How many 4-byte values total?
 	vertexSRVDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
 	DXRDevice->CreateShaderResourceView(mesh->GetVertexBuffer().Get(), &vertexSRVDesc, vb_cpu);
 
@@ -664,6 +686,16 @@ MeshRaytracingData RayTracing::CreateBottomLevelAccelerationStructureForMesh(Mes
 			tablePointer,
 			&rayTracingData.IndexBufferSRV,
 			sizeof(D3D12_GPU_DESCRIPTOR_HANDLE));
+
+		// Then the vertex layout constants, after the SRV and CBV tables
+		RaytracingMeshData meshData = {};
+		meshData.positionOffset = DirectX::XMFLOAT3(quantization.Offset);
+		meshData.positionScale = DirectX::XMFLOAT3(quantization.Scale);
+		meshData.packedVertices = mesh->HasPackedVertices();
+		memcpy(
+			tablePointer + sizeof(D3D12_GPU_DESCRIPTOR_HANDLE) * 2,
+			&meshData,
+			sizeof(RaytracingMeshData));
 	}
 	// All done
 	ShaderTable->Unmap(0, 0);
@@ -14,6 +14,11 @@ struct Vertex
 // 11 floats total per vertex * 4 bytes each
 static const uint VertexSizeInBytes = 11 * 4; 
 
+// Packed vertices (PackedVertex in VertexPacking.h): 4 snorm16 position
+// components, 2 half uv components, then 2 + 2 snorm8 octahedral
+// normal and tangent components
+static const uint PackedVertexSizeInBytes = 16;
+
 
 // Payload for rays (data that is "sent along" with each ray during raytrace)
 // Note: This should be as small as possible, and must match our C++ size definition
@@ -53,6 +58,16 @@ cbuffer ObjectData : register(b1)
     MaterialData mat[MAX_INSTANCES_PER_BLAS];
 };
 
+// Vertex layout of the mesh that was hit (local root constants,
+// matching RaytracingMeshData in C++)
+cbuffer MeshData : register(b2)
+{
+    float3 positionOffset;
+    uint packedVertices;
+    float3 positionScale;
+    float meshDataPad;
+};
+
 
 // === Resources ===
 
@@ -97,6 +112,32 @@ float3 RandomCosineWeightedHemisphere(float u0, float u1, float3 uintNormal)
     return float3(x, y, z);
 }
 
+// Sign extends the two 16-bit halves of a uint and reads them as snorm
+float2 UnpackSnorm16x2(uint packed)
+{
+    int2 values = int2(packed << 16, packed) >> 16;
+    return max(values / 32767.0f, -1.0f);
+}
+
+// Sign extends the four bytes of a uint and reads them as snorm
+float4 UnpackSnorm8x4(uint packed)
+{
+    int4 values = int4(packed << 24, packed << 16, packed << 8, packed) >> 24;
+    return max(values / 127.0f, -1.0f);
+}
+
+// Unit vector from its octahedral encoding (OctDecode in VertexPacking.cpp)
+float3 OctDecode(float2 encoded)
+{
+    float3 v = float3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+    if (v.z < 0)
+    {
+        float2 signs = float2(v.x >= 0 ? 1.0f : -1.0f, v.y >= 0 ? 1.0f : -1.0f);
+        v.xy = (1.0f - abs(v.yx)) * signs;
+    }
+    return normalize(v);
+}
+
 // Loads the indices of the specified triangle from the index buffer
 uint3 LoadIndices(uint triangleIndex)
 {
@@ -126,6 +167,20 @@ Vertex InterpolateVertices(uint triangleIndex, float2 barycentrics)
 	// Loop through the barycentric data and interpolate
 	for (uint i = 0; i < 3; i++)
 	{
+		// Packed vertices are one 16-byte load, then unpacked
+		if (packedVertices)
+		{
+			uint4 data = VertexBuffer.Load4(indices[i] * PackedVertexSizeInBytes);
+			float3 position = float3(UnpackSnorm16x2(data.x), UnpackSnorm16x2(data.y).x);
+			float4 octahedral = UnpackSnorm8x4(data.w);
+
+			vert.localPosition += (positionOffset + positionScale * position) * barycentricData[i];
+			vert.uv += f16tof32(uint2(data.z, data.z >> 16)) * barycentricData[i];
+			vert.normal += OctDecode(octahedral.xy) * barycentricData[i];
+			vert.tangent += OctDecode(octahedral.zw) * barycentricData[i];
+			continue;
+		}
+
 		// Get the index of the first piece of data for this vertex
 		uint dataIndex = indices[i] * VertexSizeInBytes;
 
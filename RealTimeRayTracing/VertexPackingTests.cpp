@@ -0,0 +1,420 @@
+// --------------------------------------------------------
+// Tests for VertexPacking: half conversion against the
+// compiler's own half type, the octahedral and position
+// error bounds VertexPacking.h promises, and packing and
+// unpacking the bundled models
+//
+// This is a console program of its own, not part of the
+// project.  Build it with any C++20 compiler, for example:
+//
+//   cl /O2 /std:c++20 /EHsc VertexPackingTests.cpp VertexPacking.cpp ObjParser.cpp
+//   g++ -O2 -std=c++20 VertexPackingTests.cpp VertexPacking.cpp ObjParser.cpp
+//
+// Usage: VertexPackingTests [--all-floats] [models directory]
+//
+// The directory defaults to Assets/Models/.  The half checks
+// need a compiler with _Float16 (GCC or Clang on x64 or ARM)
+// and are skipped elsewhere.  They go through the special
+// values and an even spread of other floats; --all-floats
+// goes through every float instead, which takes a few
+// minutes.  Exits with 1 if any check fails.
+// --------------------------------------------------------
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ObjParser.h"
+#include "VertexPacking.h"
+
+namespace
+{
+	int failures = 0;
+
+	void Check(bool passed, const std::string& what)
+	{
+		std::printf("%s  %s\n", passed ? "ok  " : "FAIL", what.c_str());
+		if (!passed)
+			failures++;
+	}
+
+	// The promised bounds (see VertexPacking.h)
+	const double maxOctDegrees = 0.64;
+	const double maxUVError = 1.0 / 2048;
+
+	const double degreesPerRadian = 57.29577951308232;
+
+	// Angle between two vectors, in degrees, in double so the
+	// measurement adds no error of its own
+	double AngleDegrees(const float a[3], const float b[3])
+	{
+		double dot = 0, la = 0, lb = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			dot += (double)a[k] * b[k];
+			la += (double)a[k] * a[k];
+			lb += (double)b[k] * b[k];
+		}
+		double cosine = dot / std::sqrt(la * lb);
+		return std::acos(std::clamp(cosine, -1.0, 1.0)) * degreesPerRadian;
+	}
+
+	// How far a half is from the float it came from, relative to
+	// it; below half float's smallest normal, 2^-14, the error is
+	// at most half a denormal step instead
+	bool UVWithinBound(float original, float unpacked)
+	{
+		double error = std::fabs((double)unpacked - original);
+		return error <= std::max(std::fabs((double)original) * maxUVError, 0x1p-25);
+	}
+
+	// --------------------------------------------------------
+	// FloatToHalf and HalfToFloat against _Float16, which
+	// converts with round to nearest even, bit for bit over
+	// every half and either every float or a sample of them.
+	// The two differ on purpose where VertexPacking clamps to
+	// 65504 instead of rounding to infinity, and in which NaN
+	// they give.
+	// --------------------------------------------------------
+	void TestHalfConversion(bool allFloats)
+	{
+#ifdef __FLT16_MAX__
+		size_t mismatches = 0, tested = 0;
+		uint32_t firstMismatch = 0;
+		auto checkFloat = [&](uint32_t bits)
+		{
+			float value;
+			std::memcpy(&value, &bits, sizeof(value));
+			uint16_t packed = FloatToHalf(value);
+
+			uint16_t expected;
+			_Float16 half = (_Float16)value;
+			std::memcpy(&expected, &half, sizeof(expected));
+			if (std::isnan(value))
+				expected = (uint16_t)((bits >> 16) & 0x8000) | 0x7E00;
+			else if ((expected & 0x7FFF) == 0x7C00)
+				expected = (expected & 0x8000) | 0x7BFF;
+
+			if (packed != expected && mismatches++ == 0)
+				firstMismatch = bits;
+			tested++;
+		};
+
+		char what[128];
+		if (allFloats)
+		{
+			uint32_t bits = 0;
+			do
+				checkFloat(bits);
+			while (++bits != 0);
+			std::snprintf(what, sizeof(what), "FloatToHalf matches _Float16 on all 2^32 floats");
+		}
+		else
+		{
+			// Both signs of zero, float denormals, limits, infinity
+			// and NaNs, and half's own edges: its smallest denormal
+			// and the tie below it, its smallest normal, its largest
+			// value and where rounding would reach infinity.  Each
+			// comes with its neighbours a few steps either side.
+			const float special[] =
+			{
+				0.0f, FLT_TRUE_MIN, FLT_MIN, FLT_MAX, INFINITY, NAN,
+				0x1p-25f, 0x1.8p-25f, 0x1p-24f, 0x1p-14f, 0.5f, 1.0f, 2048.0f,
+				65504.0f, 65519.0f, 65520.0f, 65536.0f,
+			};
+			for (float value : special)
+			{
+				uint32_t center;
+				std::memcpy(&center, &value, sizeof(center));
+				for (uint32_t sign : { 0u, 0x80000000u })
+					for (int step = -3; step <= 3; step++)
+						checkFloat((center ^ sign) + (uint32_t)step);
+			}
+			checkFloat(0x7F800001);  // Signalling NaN
+			checkFloat(0xFFFFFFFF);  // NaN with every payload bit
+
+			// An odd stride, so that every low mantissa pattern is
+			// reached, over the whole range
+			const uint32_t stride = 251;
+			for (uint64_t bits = 0; bits <= 0xFFFFFFFF; bits += stride)
+				checkFloat((uint32_t)bits);
+			std::snprintf(what, sizeof(what), "FloatToHalf matches _Float16 on %zu sampled floats", tested);
+		}
+		if (mismatches != 0)
+		{
+			size_t length = std::strlen(what);
+			std::snprintf(what + length, sizeof(what) - length, " (%zu differ, first 0x%08X)", mismatches, firstMismatch);
+		}
+		Check(mismatches == 0, what);
+
+		mismatches = 0;
+		for (uint32_t h = 0; h <= 0xFFFF; h++)
+		{
+			uint16_t half = (uint16_t)h;
+			_Float16 reference;
+			std::memcpy(&reference, &half, sizeof(reference));
+			float expected = (float)reference, unpacked = HalfToFloat(half);
+
+			bool same = std::isnan(expected)
+				? std::isnan(unpacked)
+				: std::memcmp(&expected, &unpacked, sizeof(float)) == 0;
+			mismatches += !same;
+		}
+		Check(mismatches == 0, "HalfToFloat matches _Float16 on all 2^16 halves");
+#else
+		std::printf("skip  half conversion: this compiler has no _Float16\n");
+#endif
+
+		// Half float's range, which the GPU would otherwise round to infinity
+		Check(FloatToHalf(1e9f) == 0x7BFF && FloatToHalf(-INFINITY) == 0xFBFF, "FloatToHalf clamps to +-65504");
+		Check(HalfToFloat(FloatToHalf(0.5f)) == 0.5f && HalfToFloat(FloatToHalf(-2048.0f)) == -2048.0f,
+			"FloatToHalf keeps exact values exact");
+	}
+
+	// --------------------------------------------------------
+	// Octahedral round trips over random unit vectors, the axes
+	// and the diagonals, where the folding has its edges
+	// --------------------------------------------------------
+	void TestOctahedral()
+	{
+		std::vector<std::array<float, 3>> vectors;
+		for (int x = -1; x <= 1; x++)
+			for (int y = -1; y <= 1; y++)
+				for (int z = -1; z <= 1; z++)
+					if (x != 0 || y != 0 || z != 0)
+						vectors.push_back({ (float)x, (float)y, (float)z });
+
+		std::mt19937 rng(2024);
+		std::normal_distribution<float> gaussian;
+		while (vectors.size() < 4000000)
+			vectors.push_back({ gaussian(rng), gaussian(rng), gaussian(rng) });
+
+		double worst = 0, total = 0;
+		for (auto& v : vectors)
+		{
+			int8_t encoded[2];
+			float decoded[3];
+			OctEncode(v.data(), encoded);
+			OctDecode(encoded, decoded);
+
+			double angle = AngleDegrees(v.data(), decoded);
+			worst = std::max(worst, angle);
+			total += angle;
+		}
+
+		char what[128];
+		std::snprintf(what, sizeof(what), "octahedral: largest error %.3f degrees (average %.3f) over %zu vectors",
+			worst, total / vectors.size(), vectors.size());
+		Check(worst <= maxOctDegrees, what);
+
+		// Unnormalized vectors encode their direction
+		const float longVector[3] = { 0, 0, -40 };
+		int8_t encoded[2];
+		float decoded[3];
+		OctEncode(longVector, encoded);
+		OctDecode(encoded, decoded);
+		Check(decoded[2] == -1.0f, "octahedral: length doesn't matter");
+
+		const float zero[3] = { 0, 0, 0 };
+		OctEncode(zero, encoded);
+		OctDecode(encoded, decoded);
+		Check(decoded[0] == 0.0f && decoded[1] == 0.0f && decoded[2] == 1.0f, "octahedral: zero becomes +Z");
+	}
+
+	// --------------------------------------------------------
+	// Checks every vertex's unpacked position, uv, normal and
+	// tangent against the bounds, measuring positions in steps
+	// of scale / 32767
+	// --------------------------------------------------------
+	void CheckRoundTrip(const std::string& name, const std::vector<float>& vertices)
+	{
+		size_t count = vertices.size() / 11;
+		std::vector<PackedVertex> packed(count);
+		float boundsMin[3], boundsMax[3];
+		PackVertices(&vertices[0], 11 * sizeof(float), count, &packed[0], boundsMin, boundsMax);
+		VertexQuantization quantization = QuantizeBounds(boundsMin, boundsMax);
+
+		bool boundsMatch = true;
+		for (int k = 0; k < 3; k++)
+		{
+			float lowest = FLT_MAX, highest = -FLT_MAX;
+			for (size_t i = 0; i < count; i++)
+			{
+				lowest = std::min(lowest, vertices[i * 11 + k]);
+				highest = std::max(highest, vertices[i * 11 + k]);
+			}
+			boundsMatch &= boundsMin[k] == lowest && boundsMax[k] == highest;
+		}
+
+		double worstSteps = 0, worstNormal = 0, worstTangent = 0;
+		bool uvsWithin = true;
+		for (size_t i = 0; i < count; i++)
+		{
+			const float* original = &vertices[i * 11];
+			float unpacked[11];
+			UnpackVertex(packed[i], quantization, unpacked);
+
+			// Allow for the float arithmetic in unpacking, a few ulps
+			// of the coordinate, on top of the half step
+			for (int k = 0; k < 3; k++)
+			{
+				double step = quantization.Scale[k] / 32767.0;
+				double error = std::fabs((double)unpacked[k] - original[k]);
+				double slack = 4 * FLT_EPSILON * (std::fabs(quantization.Offset[k]) + quantization.Scale[k]);
+				worstSteps = std::max(worstSteps, step > 0 ? std::max(0.0, error - slack) / step : error > 0 ? 1.0 : 0.0);
+			}
+
+			uvsWithin &= UVWithinBound(original[3], unpacked[3]) && UVWithinBound(original[4], unpacked[4]);
+			worstNormal = std::max(worstNormal, AngleDegrees(original + 5, unpacked + 5));
+			worstTangent = std::max(worstTangent, AngleDegrees(original + 8, unpacked + 8));
+		}
+
+		char what[160];
+		Check(boundsMatch, name + ": the bounds are the positions' own");
+		std::snprintf(what, sizeof(what), "%s: positions within half a step (largest %.3f)", name.c_str(), worstSteps);
+		Check(worstSteps <= 0.5, what);
+		Check(uvsWithin, name + ": uvs within 1/2048 of their value");
+		std::snprintf(what, sizeof(what), "%s: normals within %.2f degrees (largest %.3f), tangents too (largest %.3f)",
+			name.c_str(), maxOctDegrees, worstNormal, worstTangent);
+		Check(worstNormal <= maxOctDegrees && worstTangent <= maxOctDegrees, what);
+	}
+
+	// --------------------------------------------------------
+	// Random vertices, to reach every corner of the bounds,
+	// offset far from the origin and squeezed thin along one
+	// axis, and all in one plane along another
+	// --------------------------------------------------------
+	void TestRandomVertices()
+	{
+		std::mt19937 rng(7);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::normal_distribution<float> gaussian;
+
+		const float offset[3] = { 1000.0f, -3.0f, 0.0f };
+		const float size[3] = { 50.0f, 0.001f, 0.0f };
+		std::vector<float> vertices;
+		for (int i = 0; i < 100000; i++)
+		{
+			for (int k = 0; k < 3; k++)
+				vertices.push_back(offset[k] + size[k] * unit(rng));
+			vertices.push_back(unit(rng) * 8.0f);
+			vertices.push_back(unit(rng) * 0.01f);
+			for (int k = 0; k < 6; k++)
+				vertices.push_back(gaussian(rng));
+		}
+		CheckRoundTrip("random vertices", vertices);
+	}
+
+	// --------------------------------------------------------
+	// Builds a model's vertices the way Mesh does, and their
+	// tangents the way Mesh::CalculateTangents does, though
+	// without DirectXMath.  Triangles whose uvs are degenerate
+	// don't add to their vertices' tangents here, which would
+	// make them NaN in Mesh.
+	// --------------------------------------------------------
+	bool LoadModel(const std::filesystem::path& path, std::vector<float>& vertices)
+	{
+		ObjData obj;
+		std::string error;
+		if (!LoadObj(path, obj, &error))
+		{
+			Check(false, path.string() + ": " + error);
+			return false;
+		}
+
+		std::vector<ObjCorner> corners;
+		std::vector<unsigned int> indices;
+		WeldObjCorners(obj, corners, indices);
+
+		vertices.assign(corners.size() * 11, 0.0f);
+		for (size_t i = 0; i < corners.size(); i++)
+		{
+			float* v = &vertices[i * 11];
+			ObjFloat3 pos = obj.Positions[corners[i].Position];
+			ObjFloat2 uv = corners[i].UV >= 0 ? obj.UVs[corners[i].UV] : ObjFloat2{ 0, 0 };
+			ObjFloat3 norm = corners[i].Normal >= 0 ? obj.Normals[corners[i].Normal] : ObjFloat3{ 0, 1, 0 };
+			float values[8] = { pos.x, pos.y, -pos.z, uv.x, 1.0f - uv.y, norm.x, norm.y, -norm.z };
+			std::copy(values, values + 8, v);
+		}
+
+		for (size_t t = 0; t + 2 < indices.size(); t += 3)
+		{
+			float* v[3] = { &vertices[indices[t] * 11], &vertices[indices[t + 2] * 11], &vertices[indices[t + 1] * 11] };
+			float s1 = v[1][3] - v[0][3], t1 = v[1][4] - v[0][4];
+			float s2 = v[2][3] - v[0][3], t2 = v[2][4] - v[0][4];
+			float determinant = s1 * t2 - s2 * t1;
+			if (determinant == 0.0f)
+				continue;
+			for (int k = 0; k < 3; k++)
+			{
+				float tangent = (t2 * (v[1][k] - v[0][k]) - t1 * (v[2][k] - v[0][k])) / determinant;
+				for (float* corner : v)
+					corner[8 + k] += tangent;
+			}
+		}
+
+		// Gram-Schmidt against the normal, leaving tangents of
+		// vertices with no usable uvs zero
+		for (size_t i = 0; i < corners.size(); i++)
+		{
+			float* v = &vertices[i * 11];
+			float* n = v + 5;
+			float* t = v + 8;
+			float nn = n[0] * n[0] + n[1] * n[1] + n[2] * n[2];
+			float dot = (n[0] * t[0] + n[1] * t[1] + n[2] * t[2]) / nn;
+			for (int k = 0; k < 3; k++)
+				t[k] -= n[k] * dot;
+			float length = std::sqrt(t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+			if (length > 0.0f)
+				for (int k = 0; k < 3; k++)
+					t[k] /= length;
+			else
+				t[2] = 1.0f;
+		}
+		return true;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	bool allFloats = false;
+	std::filesystem::path models = "Assets/Models/";
+	for (int k = 1; k < argc; k++)
+	{
+		if (std::strcmp(argv[k], "--all-floats") == 0)
+			allFloats = true;
+		else
+			models = argv[k];
+	}
+
+	TestHalfConversion(allFloats);
+	TestOctahedral();
+	TestRandomVertices();
+
+	const char* bundled[] =
+	{
+		"cube.obj",
+		"cylinder.obj",
+		"helix.obj",
+		"quad.obj",
+		"quad_double_sided.obj",
+		"sphere.obj",
+		"torus.obj",
+	};
+	for (const char* file : bundled)
+	{
+		std::vector<float> vertices;
+		if (LoadModel(models / file, vertices))
+			CheckRoundTrip(file, vertices);
+	}
+
+	std::printf(failures == 0 ? "All checks passed\n" : "%d checks failed\n", failures);
+	return failures == 0 ? 0 : 1;
+}